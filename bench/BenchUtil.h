@@ -0,0 +1,100 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../include/Timer.h"
+
+/*
+ * Fixed-size sample buffer with percentile reporting, shared by the benchmark programs
+ */
+class BenchSamples {
+	public:
+		BenchSamples(size_t capacity) : capacity(capacity) {
+			samples = new uint64_t[capacity];
+		}
+
+		~BenchSamples() {
+			delete[] samples;
+		}
+
+		void add(uint64_t sample) {
+			if (length < capacity) {
+				samples[length++] = sample;
+			}
+		}
+
+		void reset() {
+			length = 0;
+			sorted = false;
+		}
+
+		size_t getLength() const {
+			return length;
+		}
+
+		/*
+		 * Value at the given fraction (0 to 1) of the sorted samples
+		 */
+		uint64_t percentile(double fraction) {
+			if (length == 0) {
+				return 0;
+			}
+			sort();
+			size_t index = (size_t) (fraction * (length - 1) + 0.5);
+			return samples[index];
+		}
+
+		uint64_t max() {
+			return percentile(1.0);
+		}
+
+		void print(const char *label) {
+			printf("%-28s n=%-8zu p50=%8.2f us  p99=%8.2f us  p99.9=%8.2f us  max=%8.2f us\n",
+				label, length,
+				percentile(0.5) / 1000.0, percentile(0.99) / 1000.0,
+				percentile(0.999) / 1000.0, max() / 1000.0);
+		}
+
+	private:
+		uint64_t *samples;
+		size_t capacity;
+		size_t length = 0;
+		bool sorted = false;
+
+		static int compare(const void *a, const void *b) {
+			uint64_t x = *(const uint64_t*) a;
+			uint64_t y = *(const uint64_t*) b;
+			return (x > y) - (x < y);
+		}
+
+		void sort() {
+			if (!sorted) {
+				qsort(samples, length, sizeof(uint64_t), compare);
+				sorted = true;
+			}
+		}
+};
+
+/*
+ * Busy-wait for the given duration, standing in for work done on the dispatch thread
+ */
+inline void benchSpin_ns(uint64_t duration_ns) {
+	uint64_t end = Timer::now_ns() + duration_ns;
+	while (Timer::now_ns() < end) {}
+}
+
+/*
+ * Sleep until the given CLOCK_MONOTONIC time (see Timer::now_ns())
+ */
+inline void benchSleepUntil_ns(uint64_t deadline_ns) {
+	struct timespec deadline;
+	deadline.tv_sec = deadline_ns / 1000000000ull;
+	deadline.tv_nsec = deadline_ns % 1000000000ull;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+}
+
+#endif
@@ -0,0 +1,445 @@
+/*
+ * Throughput stress test of the MIDI dispatch pipeline. Synthetic MIDI is parsed, queued and
+ * dispatched to OutputManager and OutputBank on a SimBoard, wired up and threaded as in
+ * main() with the default board replaced by its simulated models, at offered rates stepping
+ * from DIN speed (about 1000 events/s) far past what USB MIDI and DAWs send, and then as fast
+ * as the producer can go. The producer stands in for the MIDI reader: it parses bytes as they
+ * arrive, pushes the events into a queue that drops them when full, and notifies the
+ * dispatch loop once per burst.
+ *
+ * Three mixes are offered:
+ *   chords   - eight-note chords on channel 1, pressed and released together
+ *   flood    - note on/off pairs rotating over all 16 channels
+ *   storm    - eight notes on channel 1, then all-notes-off (controllers 123 to 127) on
+ *              every channel
+ *
+ * Reported per step: offered and sustained events/s, the queue's high-water mark, dropped
+ * events and the latency from an event's read to its dispatch. A step breaks down when it
+ * drops events, its p99 latency passes the threshold, or it sustains less than 95% of the
+ * rate offered. Each step is rerun until most of its attempts agree, so a single preempted
+ * attempt cannot decide the result. The program exits with status 1 if any mix breaks down
+ * below the minimum rate, or if the dispatch loop stalls, so that `make bench-stress` fails on
+ * a regression.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "BenchUtil.h"
+#include "SimBoard.h"
+#include "../include/MIDIParser.h"
+
+static const uint64_t DEFAULT_STEP_TIME_MS = 500;
+static const double DEFAULT_MAX_LATENCY_US = 1000;
+static const double DEFAULT_MIN_RATE = 10000;
+static const double MIN_SUSTAINED_FRACTION = 0.95;
+
+// Offered rates in events/s; 0 offers events as fast as the producer can generate them
+static const double RATES[] = {1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000, 0};
+static const size_t NUM_RATES = sizeof(RATES) / sizeof(RATES[0]);
+
+// Steps past the first breakdown before the paced part of a sweep stops
+static const uint8_t STEPS_AFTER_BREAKDOWN = 1;
+
+// Times a step may be run; the outcome of a majority of them decides it
+static const uint8_t STEP_ATTEMPTS = 3;
+
+// Most events the producer parses before notifying the dispatch loop, as MIDIInput::BUFFER_SIZE
+// bytes of three-byte messages would give
+static const uint16_t MAX_BURST = 85;
+static const uint64_t PRODUCER_SLEEP_NS = 50000;
+static const uint64_t DRAIN_TIMEOUT_NS = 2000000000ull;
+
+static const uint8_t NUM_CHANNELS = 16;
+
+enum class Mix {
+	CHORDS,
+	FLOOD,
+	STORM
+};
+
+static const char *getMixName(Mix mix) {
+	switch (mix) {
+		case Mix::CHORDS:
+			return "chords";
+		case Mix::FLOOD:
+			return "flood";
+		default:
+			return "storm";
+	}
+}
+
+/*
+ * Bytes of message index of a mix
+ */
+static void generate(Mix mix, uint64_t index, uint8_t *bytes) {
+	const uint8_t intervals[SimBoard::NUM_OUTPUTS] = {0, 4, 7, 11, 12, 16, 19, 23};
+	switch (mix) {
+		case Mix::CHORDS: {
+			// Eight note ons, then the same eight note offs
+			uint64_t cycle = index / (2 * SimBoard::NUM_OUTPUTS);
+			uint8_t voice = index % SimBoard::NUM_OUTPUTS;
+			bool on = index % (2 * SimBoard::NUM_OUTPUTS) < SimBoard::NUM_OUTPUTS;
+			bytes[0] = on ? 0x90 : 0x80;
+			bytes[1] = 24 + cycle % 12 + intervals[voice];
+			bytes[2] = on ? 100 : 0;
+			break;
+		}
+		case Mix::FLOOD: {
+			// Each channel in turn gets a note on, and on its next turn the note off
+			uint64_t turn = index / NUM_CHANNELS;
+			uint8_t channel = index % NUM_CHANNELS;
+			bool on = turn % 2 == 0;
+			bytes[0] = (on ? 0x90 : 0x80) | channel;
+			bytes[1] = 36 + (turn / 2 + channel) % 48;
+			bytes[2] = on ? 100 : 0;
+			break;
+		}
+		case Mix::STORM: {
+			uint64_t cycle = index / (SimBoard::NUM_OUTPUTS + NUM_CHANNELS);
+			uint8_t position = index % (SimBoard::NUM_OUTPUTS + NUM_CHANNELS);
+			if (position < SimBoard::NUM_OUTPUTS) {
+				bytes[0] = 0x90;
+				bytes[1] = 36 + cycle % 12 + intervals[position];
+				bytes[2] = 100;
+			}
+			else {
+				// Controllers 123 to 127 are all-notes-off or imply it
+				bytes[0] = 0xB0 | (position - SimBoard::NUM_OUTPUTS);
+				bytes[1] = 123 + (cycle + position) % 5;
+				bytes[2] = 0;
+			}
+			break;
+		}
+	}
+}
+
+struct Step {
+	double rate = 0;           // Offered, 0 if unpaced
+	double offered = 0;        // Events/s actually generated
+	double sustained = 0;      // Events/s dispatched within the step
+	uint64_t generated = 0;
+	uint64_t dropped = 0;
+	size_t highWater = 0;
+	uint64_t latencyCount = 0;
+	double p50_us = 0;
+	double p99_us = 0;
+	double max_us = 0;
+	uint64_t drain_ns = 0;     // From the end of the step until the queue was empty
+	const char *breakdown = nullptr;
+};
+
+/*
+ * Percentiles of the values a histogram recorded since its bucket counts were copied to before
+ */
+static double stepPercentile(const MetricHistogram &histogram, const uint64_t *before, uint64_t count, double fraction) {
+	if (count == 0) {
+		return 0;
+	}
+	uint64_t target = (uint64_t) (fraction * (count - 1)) + 1;
+	uint64_t seen = 0;
+	for (uint16_t i = 0; i < MetricHistogram::NUM_BUCKETS; ++i) {
+		seen += histogram.getBucketCount(i) - before[i];
+		if (seen >= target) {
+			return MetricHistogram::getBucketStart(i);
+		}
+	}
+	return histogram.getMax();
+}
+
+class Harness {
+	public:
+		Harness(uint64_t perByteLatency_ns) : board(perByteLatency_ns, MIDIEventRing::OverflowPolicy::DROP_NEWEST) {}
+
+		bool start() {
+			return board.start(ThreadSchedule(), ThreadSchedule());
+		}
+
+		void stop() {
+			board.stop();
+		}
+
+		/*
+		 * Offer a mix at rate events/s (0 = unpaced) for duration_ns, then wait for the queue
+		 * to drain. Returns false if the dispatch loop stopped taking events.
+		 */
+		bool run(Mix mix, double rate, uint64_t duration_ns, Step *step) {
+			const MetricHistogram &latency_ns = board.getMetrics()->eventLatency_ns;
+			uint64_t before[MetricHistogram::NUM_BUCKETS];
+			for (uint16_t i = 0; i < MetricHistogram::NUM_BUCKETS; ++i) {
+				before[i] = latency_ns.getBucketCount(i);
+			}
+			uint64_t countBefore = latency_ns.getCount();
+			uint64_t droppedBefore = board.queue.getOverflowCount();
+			uint64_t dispatchedBefore = board.dispatched.load(std::memory_order_acquire);
+
+			step->rate = rate;
+			uint64_t start_ns = Timer::now_ns();
+			uint64_t end_ns = start_ns + duration_ns;
+			uint64_t generated = 0;
+			uint64_t now_ns = start_ns;
+			while (now_ns < end_ns) {
+				uint64_t due = rate > 0 ? (uint64_t) ((now_ns - start_ns) * rate / 1e9) : generated + MAX_BURST;
+				if (due <= generated) {
+					benchSleepUntil_ns(now_ns + PRODUCER_SLEEP_NS);
+					now_ns = Timer::now_ns();
+					continue;
+				}
+				uint64_t burst = due - generated < MAX_BURST ? due - generated : MAX_BURST;
+				for (uint64_t i = 0; i < burst; ++i) {
+					uint8_t bytes[3];
+					generate(mix, messageIndex++, bytes);
+					for (uint8_t j = 0; j < 3; ++j) {
+						MIDIEvent event;
+						if (parser.parse(bytes[j], now_ns, &event)) {
+							board.queue.push(event);
+						}
+					}
+				}
+				generated += burst;
+				size_t length = board.queue.getLength();
+				step->highWater = length > step->highWater ? length : step->highWater;
+				board.notifier.notify();
+				now_ns = Timer::now_ns();
+			}
+			uint64_t elapsed_ns = now_ns - start_ns;
+			uint64_t dispatchedInStep = board.dispatched.load(std::memory_order_acquire) - dispatchedBefore;
+
+			uint64_t stop_ns = Timer::now_ns();
+			uint64_t dropped = board.queue.getOverflowCount() - droppedBefore;
+			while (board.dispatched.load(std::memory_order_acquire) - dispatchedBefore < generated - dropped &&
+				Timer::now_ns() - stop_ns < DRAIN_TIMEOUT_NS) {
+				usleep(50);
+			}
+			step->drain_ns = Timer::now_ns() - stop_ns;
+
+			step->generated = generated;
+			step->dropped = dropped;
+			step->offered = generated * 1e9 / elapsed_ns;
+			step->sustained = dispatchedInStep * 1e9 / elapsed_ns;
+			step->latencyCount = latency_ns.getCount() - countBefore;
+			step->p50_us = stepPercentile(latency_ns, before, step->latencyCount, 0.5) / 1000.0;
+			step->p99_us = stepPercentile(latency_ns, before, step->latencyCount, 0.99) / 1000.0;
+			step->max_us = stepPercentile(latency_ns, before, step->latencyCount, 1.0) / 1000.0;
+
+			// Release whatever the mix left sounding, so steps start alike
+			uint64_t expected = board.dispatched.load(std::memory_order_acquire);
+			for (uint8_t channel = 0; channel < NUM_CHANNELS; ++channel) {
+				uint8_t bytes[3] = {(uint8_t) (0xB0 | channel), 123, 0};
+				for (uint8_t j = 0; j < 3; ++j) {
+					MIDIEvent event;
+					if (parser.parse(bytes[j], Timer::now_ns(), &event) && board.queue.push(event)) {
+						++expected;
+					}
+				}
+			}
+			board.notifier.notify();
+			uint64_t release_ns = Timer::now_ns();
+			while (board.dispatched.load(std::memory_order_acquire) < expected) {
+				if (Timer::now_ns() - release_ns >= DRAIN_TIMEOUT_NS) {
+					printf("Error: The dispatch loop did not take the note releases within %.0f ms\n", DRAIN_TIMEOUT_NS / 1e6);
+					return false;
+				}
+				usleep(50);
+			}
+			messageIndex = 0;
+			return true;
+		}
+
+		const Metrics *getMetrics() const {
+			return board.getMetrics();
+		}
+
+	private:
+		SimBoard board;
+		MIDIParser parser;
+		uint64_t messageIndex = 0;
+};
+
+static void printStep(const Step &step, bool rerunning) {
+	char rate[16];
+	if (step.rate > 0) {
+		snprintf(rate, sizeof(rate), "%.0f", step.rate);
+	}
+	else {
+		snprintf(rate, sizeof(rate), "unpaced");
+	}
+	printf("  %-9s offered=%9.0f/s  sustained=%9.0f/s  high-water=%4zu  dropped=%-8llu latency p50=%8.2f us  p99=%8.2f us  max=%8.2f us  drain=%7.2f ms%s%s%s\n",
+		rate, step.offered, step.sustained, step.highWater, (unsigned long long) step.dropped,
+		step.p50_us, step.p99_us, step.max_us, step.drain_ns / 1e6,
+		step.breakdown ? "  BREAKDOWN: " : "", step.breakdown ? step.breakdown : "", rerunning ? ", rerunning" : "");
+}
+
+/*
+ * Reason a step breaks down, or nullptr if it kept up
+ */
+static const char *getBreakdown(const Step &step, double maxLatency_us) {
+	if (step.dropped > 0) {
+		return "dropped events";
+	}
+	if (step.p99_us > maxLatency_us) {
+		return "p99 latency";
+	}
+	if (step.rate > 0 && step.sustained < MIN_SUSTAINED_FRACTION * step.offered) {
+		return "fell behind";
+	}
+	return nullptr;
+}
+
+/*
+ * Run one rate until a majority of its attempts agree on whether it breaks down, and fill in
+ * the slowest attempt of that majority. Returns false if the dispatch loop stalled.
+ */
+static bool runStep(Harness *harness, Mix mix, double rate, uint64_t stepTime_ns, double maxLatency_us, Step *step) {
+	const uint8_t MAJORITY = STEP_ATTEMPTS / 2 + 1;
+	Step attempts[STEP_ATTEMPTS];
+	uint8_t numBrokeDown = 0, numKeptUp = 0;
+	for (uint8_t i = 0; numBrokeDown < MAJORITY && numKeptUp < MAJORITY; ++i) {
+		if (!harness->run(mix, rate, stepTime_ns, &attempts[i])) {
+			return false;
+		}
+		attempts[i].breakdown = getBreakdown(attempts[i], maxLatency_us);
+		++(attempts[i].breakdown ? numBrokeDown : numKeptUp);
+		printStep(attempts[i], numBrokeDown < MAJORITY && numKeptUp < MAJORITY);
+	}
+
+	bool brokeDown = numBrokeDown >= MAJORITY;
+	const Step *slowest = nullptr;
+	for (uint8_t i = 0; i < numBrokeDown + numKeptUp; ++i) {
+		if ((attempts[i].breakdown != nullptr) == brokeDown && (!slowest || attempts[i].sustained < slowest->sustained)) {
+			slowest = &attempts[i];
+		}
+	}
+	*step = *slowest;
+	return true;
+}
+
+/*
+ * Sweep the rates for one mix, returning the highest offered rate sustained before the first
+ * breakdown, or -1 if the dispatch loop stalled
+ */
+static double runSweep(Harness *harness, Mix mix, uint64_t stepTime_ns, double maxLatency_us, bool *brokeDown) {
+	printf("%s:\n", getMixName(mix));
+	double headroom = 0;
+	*brokeDown = 0;
+	uint8_t stepsAfterBreakdown = 0;
+	for (size_t i = 0; i < NUM_RATES; ++i) {
+		if (RATES[i] > 0 && *brokeDown && stepsAfterBreakdown++ >= STEPS_AFTER_BREAKDOWN) {
+			continue;
+		}
+		Step step;
+		if (!runStep(harness, mix, RATES[i], stepTime_ns, maxLatency_us, &step)) {
+			return -1;
+		}
+		if (step.breakdown == nullptr && !*brokeDown) {
+			headroom = step.rate > 0 ? step.offered : step.sustained;
+		}
+		else if (step.breakdown != nullptr && !*brokeDown) {
+			*brokeDown = 1;
+			if (step.rate == 0) {
+				// Only the unpaced step broke down: it can still say what was sustained
+				headroom = headroom > step.sustained ? headroom : step.sustained;
+			}
+		}
+	}
+	return headroom;
+}
+
+static void printUsage(const char *name) {
+	printf("Usage: %s [-d ms] [-l latency] [-t max-latency] [-m min-rate] [-x mix]\n", name);
+	printf("  -d ms           Time each rate is offered for (default %llu)\n", (unsigned long long) DEFAULT_STEP_TIME_MS);
+	printf("  -l latency      Simulated I2C time per byte in ns (default 0; about 90000 at 100 kHz)\n");
+	printf("  -t max-latency  A step breaks down if its p99 latency exceeds this many us (default %.0f)\n", DEFAULT_MAX_LATENCY_US);
+	printf("  -m min-rate     Fail if any mix breaks down below this many events/s (default %.0f)\n", DEFAULT_MIN_RATE);
+	printf("  -x mix          Only run one mix: chords, flood or storm\n");
+}
+
+int main(int argc, char **argv) {
+	uint64_t stepTime_ns = DEFAULT_STEP_TIME_MS * Timer::NS_PER_MS;
+	uint64_t perByteLatency_ns = 0;
+	double maxLatency_us = DEFAULT_MAX_LATENCY_US;
+	double minRate = DEFAULT_MIN_RATE;
+	Mix mixes[] = {Mix::CHORDS, Mix::FLOOD, Mix::STORM};
+	size_t numMixes = sizeof(mixes) / sizeof(mixes[0]);
+	int option;
+	while ((option = getopt(argc, argv, "d:l:t:m:x:h")) != -1) {
+		switch (option) {
+			case 'd':
+				stepTime_ns = strtoull(optarg, nullptr, 10) * Timer::NS_PER_MS;
+				break;
+			case 'l':
+				perByteLatency_ns = strtoull(optarg, nullptr, 10);
+				break;
+			case 't':
+				maxLatency_us = atof(optarg);
+				break;
+			case 'm':
+				minRate = atof(optarg);
+				break;
+			case 'x': {
+				size_t found = numMixes;
+				for (size_t i = 0; i < numMixes; ++i) {
+					if (strcmp(optarg, getMixName(mixes[i])) == 0) {
+						found = i;
+					}
+				}
+				if (found == numMixes) {
+					printUsage(argv[0]);
+					return 1;
+				}
+				mixes[0] = mixes[found];
+				numMixes = 1;
+				break;
+			}
+			default:
+				printUsage(argv[0]);
+				return option == 'h' ? 0 : 1;
+		}
+	}
+	if (stepTime_ns == 0) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	Harness harness(perByteLatency_ns);
+	if (!harness.start()) {
+		return 1;
+	}
+
+	printf("Dispatch stress: %.0f ms per rate, %.1f us simulated I2C time per byte, queue of %zu events, breakdown at p99 > %.0f us\n",
+		stepTime_ns / 1e6, perByteLatency_ns / 1000.0, MIDIEventRing::CAPACITY, maxLatency_us);
+
+	bool passed = true;
+	double headrooms[3];
+	bool brokeDown[3];
+	for (size_t i = 0; i < numMixes; ++i) {
+		headrooms[i] = runSweep(&harness, mixes[i], stepTime_ns, maxLatency_us, &brokeDown[i]);
+		if (headrooms[i] < 0) {
+			// Returning would join the stalled dispatch thread
+			printf("FAIL: %s stalled the dispatch loop\n", getMixName(mixes[i]));
+			exit(1);
+		}
+	}
+	harness.stop();
+
+	for (size_t i = 0; i < numMixes; ++i) {
+		if (brokeDown[i]) {
+			printf("%-8s sustains %.0f events/s before breaking down\n", getMixName(mixes[i]), headrooms[i]);
+		}
+		else {
+			printf("%-8s sustains %.0f events/s without breaking down\n", getMixName(mixes[i]), headrooms[i]);
+		}
+		if (headrooms[i] < minRate) {
+			printf("FAIL: %s breaks down below %.0f events/s\n", getMixName(mixes[i]), minRate);
+			passed = false;
+		}
+	}
+	const MetricHistogram &dispatchTime_ns = harness.getMetrics()->dispatchTime_ns;
+	printf("Dispatch per event: p50 %.2f us, p99 %.2f us, max %.2f us\n", dispatchTime_ns.percentile(0.5) / 1000.0,
+		dispatchTime_ns.percentile(0.99) / 1000.0, dispatchTime_ns.getMax() / 1000.0);
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,639 @@
+/*
+ * End-to-end MIDI-to-CV latency benchmark. Synthetic MIDI byte streams are fed through
+ * MIDIParser into a SimBoard, which runs MIDIEventRing, MIDIDispatcher, OutputManager and
+ * OutputBank as main() does, with the default board's expander and DAC replaced by their
+ * simulated models.
+ *
+ * Latency runs from the time the status byte of a message is read to the time its gate edge
+ * or pitch update reaches the simulated device. Skew is the spread of those times across the
+ * voices of one chord, and settle time runs from the last byte of a burst to the last output
+ * change it caused. Trigger widths are taken from the expander's edges. After each step, the
+ * gate and pitch of every output must match the last message sent for it.
+ *
+ * The program exits with status 1 if any output is left in another state, or if any p99
+ * latency, skew or trigger width error exceeds its threshold, so that `make bench-latency`
+ * fails on a regression. A pulse cannot end more precisely than the host's timers wake, so
+ * the threads run under SCHED_FIFO as in main() with -r, along with a probe of timerfd
+ * lateness. Where the process may not use SCHED_FIFO, timers can wake milliseconds late, and
+ * the trigger width check is skipped.
+ */
+
+#include <sys/prctl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <poll.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#include "BenchUtil.h"
+#include "SimBoard.h"
+#include "../include/MIDIParser.h"
+#include "../include/PitchCalibration.h"
+#include "../include/DeadlineTimer.h"
+#include "../include/RealTime.h"
+
+static const size_t DEFAULT_STEPS = 500;
+static const double DEFAULT_MAX_LATENCY_US = 2000;
+static const double DEFAULT_MAX_SKEW_US = 500;
+static const double DEFAULT_MAX_TRIGGER_ERROR_US = 250;
+
+// As in main(), where the MIDI reader takes the place of the thread feeding the parser
+static const int MIDI_PRIORITY = 45;
+static const int OUTPUT_PRIORITY = 44;
+static const int DISPATCH_PRIORITY = 43;
+
+// Time on the wire of one byte at the 31250 baud of a DIN MIDI port
+static const uint64_t DIN_BYTE_TIME_NS = 320000;
+
+// Added to the trigger width, so every trigger started by a step has been turned off again
+static const uint64_t SETTLE_TIME_NS = 500000;
+static const uint64_t QUIET_TIME_NS = 200000;
+
+static const size_t MAX_VOICES = 64;
+static const size_t MAX_SAMPLES = 100000;
+
+/*
+ * Thread measuring how late a timerfd armed one trigger width ahead wakes, with the timer
+ * slack and schedule the worker uses, for as long as the scenarios run
+ */
+struct TimerProbe {
+	BenchSamples lateness{MAX_SAMPLES};
+	uint64_t interval_ns = 0;
+	DeadlineTimer timer;
+	std::atomic<bool> running{true};
+	RealTimeThread thread{"timer probe"};
+};
+
+/*
+ * Run the calling thread under SCHED_FIFO at the MIDI reader's priority, or return false if the
+ * process may not use it
+ */
+static bool feedUnderRealTime() {
+	struct sched_param param;
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = MIDI_PRIORITY;
+	return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+static void *probeTimer(void *arg) {
+	TimerProbe *probe = (TimerProbe*) arg;
+	prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0);
+	struct pollfd timerDesc;
+	timerDesc.fd = probe->timer.getFd();
+	timerDesc.events = POLLIN;
+	while (probe->running.load()) {
+		uint64_t deadline_ns = Timer::now_ns() + probe->interval_ns;
+		probe->timer.arm(deadline_ns);
+		while (poll(&timerDesc, 1, -1) < 1) {}
+		probe->lateness.add(Timer::now_ns() - deadline_ns);
+		probe->timer.acknowledge();
+	}
+	return nullptr;
+}
+
+/*
+ * A message whose effect on one output is looked for in the device logs
+ */
+struct Voice {
+	uint8_t output = 0;
+	bool gate = 0;
+	bool hasPitch = 0;
+	uint16_t pitch = 0;
+	uint64_t sent_ns = 0;
+};
+
+struct Report {
+	BenchSamples gateLatency{MAX_SAMPLES};
+	BenchSamples pitchLatency{MAX_SAMPLES};
+	BenchSamples gateSkew{MAX_SAMPLES};
+	BenchSamples pitchSkew{MAX_SAMPLES};
+	BenchSamples settle{MAX_SAMPLES};
+	uint64_t supersededGates = 0;    // Not seen on the device, with a later message for the output in the step
+	uint64_t supersededPitches = 0;
+	uint64_t lostGates = 0;          // Outputs whose device does not end up in the last state asked for
+	uint64_t lostPitches = 0;
+};
+
+class Harness {
+	public:
+		BenchSamples triggerWidths{MAX_SAMPLES};
+		BenchSamples triggerErrors{MAX_SAMPLES};
+
+		Harness(uint64_t byteInterval_ns, uint64_t perByteLatency_ns, uint64_t triggerWidth_ns) :
+			board(perByteLatency_ns, MIDIEventRing::OverflowPolicy::WAIT), byteInterval_ns(byteInterval_ns),
+			triggerWidth_ns(triggerWidth_ns) {}
+
+		/*
+		 * Start the output workers and the dispatch thread, under SCHED_FIFO if realTime is set
+		 */
+		bool start(bool realTime) {
+			ThreadSchedule outputSchedule, dispatchSchedule;
+			if (realTime) {
+				outputSchedule.priority = OUTPUT_PRIORITY;
+				dispatchSchedule.priority = DISPATCH_PRIORITY;
+			}
+			for (uint8_t i = 0; i < SimBoard::NUM_OUTPUTS; ++i) {
+				if (!board.bank.setTriggerWidth(i, triggerWidth_ns)) {
+					return false;
+				}
+			}
+			if (!board.start(outputSchedule, dispatchSchedule)) {
+				return false;
+			}
+			settle();
+			return true;
+		}
+
+		void stop() {
+			board.stop();
+		}
+
+		/*
+		 * Feed one message to the parser a byte at a time, as midiRead() does, returning the
+		 * time its status byte was read
+		 */
+		uint64_t send(uint8_t status, uint8_t data1, uint8_t data2) {
+			uint8_t bytes[3] = {status, data1, data2};
+			uint64_t sent_ns = 0;
+			for (uint8_t i = 0; i < 3; ++i) {
+				if (byteInterval_ns > 0) {
+					if (nextByte_ns == 0 || nextByte_ns < Timer::now_ns()) {
+						nextByte_ns = Timer::now_ns();
+					}
+					benchSleepUntil_ns(nextByte_ns);
+					nextByte_ns += byteInterval_ns;
+				}
+				uint64_t now_ns = Timer::now_ns();
+				if (i == 0) {
+					sent_ns = now_ns;
+				}
+				MIDIEvent event;
+				board.getMetrics()->midiBytesRead.add();
+				if (parser.parse(bytes[i], now_ns, &event)) {
+					board.queue.push(event);
+					board.getMetrics()->midiEventsQueued.add();
+					board.notifier.notify();
+					++pushed;
+				}
+			}
+			lastSent_ns = sent_ns;
+			return sent_ns;
+		}
+
+		uint64_t noteOn(uint8_t note, uint8_t output, Voice *voices, size_t *numVoices) {
+			Voice &voice = voices[(*numVoices)++];
+			voice.output = output;
+			voice.gate = 1;
+			voice.hasPitch = output < SimBoard::NUM_DACS * DAC::NUM_CHANNELS;
+			voice.pitch = PitchCalibration::getNominalValue(note);
+			voice.sent_ns = send(0x90, note, 100);
+			return voice.sent_ns;
+		}
+
+		uint64_t noteOff(uint8_t note, uint8_t output, Voice *voices, size_t *numVoices) {
+			Voice &voice = voices[(*numVoices)++];
+			voice.output = output;
+			voice.gate = 0;
+			voice.hasPitch = 0;
+			voice.sent_ns = send(0x80, note, 0);
+			return voice.sent_ns;
+		}
+
+		/*
+		 * Wait until everything sent has been dispatched, every trigger has expired and the
+		 * worker has gone quiet
+		 */
+		void settle() {
+			while (board.dispatched.load(std::memory_order_acquire) != pushed) {
+				usleep(20);
+			}
+			benchSleepUntil_ns(Timer::now_ns() + triggerWidth_ns + SETTLE_TIME_NS);
+			OutputWorker::Stats stats;
+			while (true) {
+				uint64_t transfers = board.bus.transfers.load(std::memory_order_acquire);
+				benchSleepUntil_ns(Timer::now_ns() + QUIET_TIME_NS);
+				board.bank.getWorker(0)->getStats(&stats);
+				if (!board.bus.busy.load(std::memory_order_acquire) && stats.queueDepth == 0 &&
+					board.bus.transfers.load(std::memory_order_acquire) == transfers) {
+					break;
+				}
+			}
+		}
+
+		/*
+		 * Match the voices of one settled step against the device logs and the last voice of
+		 * each output against the devices' final state, then clear the logs
+		 */
+		void measure(const Voice *voices, size_t numVoices, bool measureGates, Report *report) {
+			uint64_t firstGate_ns = 0, lastGate_ns = 0;
+			uint64_t firstPitch_ns = 0, lastPitch_ns = 0;
+			uint8_t numGates = 0, numPitches = 0;
+			for (size_t v = 0; v < numVoices; ++v) {
+				const Voice &voice = voices[v];
+				bool gateSuperseded = 0, pitchSuperseded = 0;
+				for (size_t w = v + 1; w < numVoices; ++w) {
+					if (voices[w].output == voice.output) {
+						gateSuperseded = 1;
+						pitchSuperseded = pitchSuperseded || voices[w].hasPitch;
+					}
+				}
+
+				// An update that repeats the output's state is not sent, so only the final state
+				// tells whether the last one for each output was lost
+				if (measureGates) {
+					uint64_t gate_ns = findGateEdge(voice);
+					if (gate_ns != 0) {
+						report->gateLatency.add(gate_ns - voice.sent_ns);
+						track(gate_ns, &firstGate_ns, &lastGate_ns, &numGates);
+					}
+					else if (gateSuperseded) {
+						++report->supersededGates;
+					}
+				}
+				if (!gateSuperseded && ((board.expander.getOutputs(SimBoard::GATE_PORT) >> voice.output) & 1) != voice.gate) {
+					++report->lostGates;
+				}
+				if (voice.hasPitch) {
+					const SimDAC &dac = board.dacs[voice.output / DAC::NUM_CHANNELS];
+					uint64_t pitch_ns = findPitchUpdate(voice);
+					if (pitch_ns != 0) {
+						report->pitchLatency.add(pitch_ns - voice.sent_ns);
+						track(pitch_ns, &firstPitch_ns, &lastPitch_ns, &numPitches);
+					}
+					else if (pitchSuperseded) {
+						++report->supersededPitches;
+					}
+					if (!pitchSuperseded && dac.getOutput(voice.output % DAC::NUM_CHANNELS) != voice.pitch) {
+						++report->lostPitches;
+					}
+				}
+			}
+			if (numGates > 1) {
+				report->gateSkew.add(lastGate_ns - firstGate_ns);
+			}
+			if (numPitches > 1) {
+				report->pitchSkew.add(lastPitch_ns - firstPitch_ns);
+			}
+
+			// Triggers turning themselves off later are not part of settling
+			uint64_t lastChange_ns = 0;
+			for (uint64_t i = 0; i < board.expander.getNumEdges(); ++i) {
+				const SimMCP23017::Edge &edge = board.expander.getEdge(i);
+				if (edge.port == SimBoard::GATE_PORT || edge.value) {
+					lastChange_ns = edge.timestamp_ns;
+				}
+			}
+			for (uint8_t i = 0; i < SimBoard::NUM_DACS; ++i) {
+				if (board.dacs[i].getNumUpdates() > 0) {
+					uint64_t update_ns = board.dacs[i].getUpdate(board.dacs[i].getNumUpdates() - 1).timestamp_ns;
+					lastChange_ns = update_ns > lastChange_ns ? update_ns : lastChange_ns;
+				}
+			}
+			if (lastChange_ns > lastSent_ns) {
+				report->settle.add(lastChange_ns - lastSent_ns);
+			}
+
+			clearLogs();
+		}
+
+		void clearLogs() {
+			collectTriggerWidths();
+			board.clearLogs();
+		}
+
+		const Metrics *getMetrics() const {
+			return board.getMetrics();
+		}
+
+		uint64_t getInvalidFrames() const {
+			return board.getInvalidFrames();
+		}
+
+	private:
+		SimBoard board;
+		MIDIParser parser;
+		uint64_t byteInterval_ns;
+		uint64_t triggerWidth_ns;
+		uint64_t nextByte_ns = 0;
+		uint64_t pushed = 0;
+		uint64_t lastSent_ns = 0;
+
+		uint64_t findGateEdge(const Voice &voice) const {
+			for (uint64_t i = 0; i < board.expander.getNumEdges(); ++i) {
+				const SimMCP23017::Edge &edge = board.expander.getEdge(i);
+				if (edge.port == SimBoard::GATE_PORT && edge.pin == voice.output && edge.value == voice.gate && edge.timestamp_ns >= voice.sent_ns) {
+					return edge.timestamp_ns;
+				}
+			}
+			return 0;
+		}
+
+		uint64_t findPitchUpdate(const Voice &voice) const {
+			const SimDAC &dac = board.dacs[voice.output / DAC::NUM_CHANNELS];
+			for (uint64_t i = 0; i < dac.getNumUpdates(); ++i) {
+				const SimDAC::Update &update = dac.getUpdate(i);
+				if (update.channel == voice.output % DAC::NUM_CHANNELS && update.value == voice.pitch && update.timestamp_ns >= voice.sent_ns) {
+					return update.timestamp_ns;
+				}
+			}
+			return 0;
+		}
+
+		/*
+		 * Width of every complete trigger pulse in the expander log
+		 */
+		void collectTriggerWidths() {
+			uint64_t rise_ns[SimBoard::NUM_OUTPUTS] = {0};
+			for (uint64_t i = 0; i < board.expander.getNumEdges() && i < SimMCP23017::LOG_CAPACITY; ++i) {
+				const SimMCP23017::Edge &edge = board.expander.getEdge(i);
+				if (edge.port != SimBoard::TRIGGER_PORT) {
+					continue;
+				}
+				if (edge.value) {
+					rise_ns[edge.pin] = edge.timestamp_ns;
+				}
+				else if (rise_ns[edge.pin] != 0) {
+					uint64_t width_ns = edge.timestamp_ns - rise_ns[edge.pin];
+					triggerWidths.add(width_ns);
+					triggerErrors.add(width_ns > triggerWidth_ns ? width_ns - triggerWidth_ns : triggerWidth_ns - width_ns);
+					rise_ns[edge.pin] = 0;
+				}
+			}
+		}
+
+		static void track(uint64_t time_ns, uint64_t *first_ns, uint64_t *last_ns, uint8_t *count) {
+			if (*count == 0 || time_ns < *first_ns) {
+				*first_ns = time_ns;
+			}
+			if (*count == 0 || time_ns > *last_ns) {
+				*last_ns = time_ns;
+			}
+			++*count;
+		}
+};
+
+// Scenarios
+
+/*
+ * One note at a time on output 0
+ */
+static void runSingleNotes(Harness *harness, size_t steps, Report *on, Report *off) {
+	Voice voices[MAX_VOICES];
+	for (size_t step = 0; step < steps; ++step) {
+		uint8_t note = 36 + step % 24;
+
+		size_t numVoices = 0;
+		harness->noteOn(note, 0, voices, &numVoices);
+		harness->settle();
+		harness->measure(voices, numVoices, true, on);
+
+		numVoices = 0;
+		harness->noteOff(note, 0, voices, &numVoices);
+		harness->settle();
+		harness->measure(voices, numVoices, true, off);
+	}
+}
+
+/*
+ * Eight-note chords, each voice landing on the next free output
+ */
+static void runChords(Harness *harness, size_t steps, Report *on, Report *off) {
+	const uint8_t intervals[SimBoard::NUM_OUTPUTS] = {0, 4, 7, 11, 12, 16, 19, 23};
+	Voice voices[MAX_VOICES];
+	for (size_t step = 0; step < steps; ++step) {
+		uint8_t root = 24 + step % 12;
+
+		size_t numVoices = 0;
+		for (uint8_t i = 0; i < SimBoard::NUM_OUTPUTS; ++i) {
+			harness->noteOn(root + intervals[i], i, voices, &numVoices);
+		}
+		harness->settle();
+		harness->measure(voices, numVoices, true, on);
+
+		numVoices = 0;
+		for (uint8_t i = 0; i < SimBoard::NUM_OUTPUTS; ++i) {
+			harness->noteOff(root + intervals[i], i, voices, &numVoices);
+		}
+		harness->settle();
+		harness->measure(voices, numVoices, true, off);
+	}
+}
+
+/*
+ * Bursts of 64 back-to-back messages: a rolling eight-voice run where each note is released
+ * eight notes after it started. Gates superseded within one batch never reach the expander,
+ * so only pitch and settle time are measured, along with the final gates.
+ */
+static void runFloods(Harness *harness, size_t steps, Report *report) {
+	const uint8_t NOTES_PER_BURST = 32;
+	Voice voices[MAX_VOICES];
+	Voice releases[MAX_VOICES];
+	for (size_t step = 0; step < steps; ++step) {
+		uint8_t base = 24 + step % 3;
+
+		size_t numVoices = 0;
+		for (uint8_t j = 0; j < NOTES_PER_BURST; ++j) {
+			if (j >= SimBoard::NUM_OUTPUTS) {
+				size_t numReleases = 0;
+				harness->noteOff(base + j - SimBoard::NUM_OUTPUTS, j % SimBoard::NUM_OUTPUTS, releases, &numReleases);
+			}
+			harness->noteOn(base + j, j % SimBoard::NUM_OUTPUTS, voices, &numVoices);
+		}
+		harness->settle();
+		harness->measure(voices, numVoices, false, report);
+
+		size_t numReleases = 0;
+		for (uint8_t j = NOTES_PER_BURST - SimBoard::NUM_OUTPUTS; j < NOTES_PER_BURST; ++j) {
+			harness->noteOff(base + j, j % SimBoard::NUM_OUTPUTS, releases, &numReleases);
+		}
+		harness->settle();
+		harness->clearLogs();
+	}
+}
+
+/*
+ * A note buried in the middle of 96 pitch bend messages
+ */
+static void runBendStorms(Harness *harness, size_t steps, Report *report) {
+	const uint16_t BENDS = 96;
+	Voice voices[MAX_VOICES];
+	for (size_t step = 0; step < steps; ++step) {
+		uint8_t note = step % 2 ? 48 : 50;
+
+		size_t numVoices = 0;
+		for (uint16_t i = 0; i < BENDS; ++i) {
+			uint16_t bend = (step * BENDS + i) * 97 % 16384;
+			harness->send(0xE0, bend & 0x7F, bend >> 7);
+			if (i == BENDS / 2) {
+				harness->noteOn(note, 0, voices, &numVoices);
+			}
+		}
+		harness->settle();
+		harness->measure(voices, numVoices, true, report);
+
+		size_t numReleases = 0;
+		Voice releases[1];
+		harness->noteOff(note, 0, releases, &numReleases);
+		harness->settle();
+		harness->clearLogs();
+	}
+}
+
+static bool check(const char *label, BenchSamples *samples, double max_us) {
+	if (samples->getLength() == 0 || samples->percentile(0.99) / 1000.0 <= max_us) {
+		return true;
+	}
+	printf("FAIL: %s p99 %.2f us exceeds %.2f us\n", label, samples->percentile(0.99) / 1000.0, max_us);
+	return false;
+}
+
+static bool printReport(const char *name, Report *report, double maxLatency_us, double maxSkew_us) {
+	char label[64];
+	bool passed = true;
+	struct {
+		const char *series;
+		BenchSamples *samples;
+		double max_us;
+	} rows[] = {
+		{"gate", &report->gateLatency, maxLatency_us},
+		{"pitch", &report->pitchLatency, maxLatency_us},
+		{"gate skew", &report->gateSkew, maxSkew_us},
+		{"pitch skew", &report->pitchSkew, maxSkew_us},
+		{"settle", &report->settle, maxLatency_us}
+	};
+	for (size_t i = 0; i < sizeof(rows) / sizeof(rows[0]); ++i) {
+		if (rows[i].samples->getLength() == 0) {
+			continue;
+		}
+		snprintf(label, sizeof(label), "%s %s", name, rows[i].series);
+		rows[i].samples->print(label);
+		passed = check(label, rows[i].samples, rows[i].max_us) && passed;
+	}
+	if (report->supersededGates > 0 || report->supersededPitches > 0) {
+		printf("%-28s superseded gates=%llu pitches=%llu\n", "",
+			(unsigned long long) report->supersededGates, (unsigned long long) report->supersededPitches);
+	}
+	if (report->lostGates > 0 || report->lostPitches > 0) {
+		printf("FAIL: %s lost gates=%llu pitches=%llu: outputs did not end up in their last state\n", name,
+			(unsigned long long) report->lostGates, (unsigned long long) report->lostPitches);
+		passed = false;
+	}
+	return passed;
+}
+
+static void printHistogram(const char *label, const MetricHistogram &histogram) {
+	printf("%-28s n=%-8llu p50=%8.2f us  p99=%8.2f us  p99.9=%8.2f us  max=%8.2f us\n", label,
+		(unsigned long long) histogram.getCount(),
+		histogram.percentile(0.5) / 1000.0, histogram.percentile(0.99) / 1000.0,
+		histogram.percentile(0.999) / 1000.0, histogram.getMax() / 1000.0);
+}
+
+static void printUsage(const char *name) {
+	printf("Usage: %s [-n steps] [-w] [-l latency] [-T width] [-t max-latency] [-k max-skew] [-e max-error]\n", name);
+	printf("  -n steps        Steps per scenario (default %zu)\n", DEFAULT_STEPS);
+	printf("  -w              Pace bytes at DIN MIDI speed (320 us per byte) instead of back to back\n");
+	printf("  -l latency      Simulated I2C time per byte in ns (default 0; about 90000 at 100 kHz)\n");
+	printf("  -t max-latency  Fail if any p99 latency exceeds this many us (default %.0f)\n", DEFAULT_MAX_LATENCY_US);
+	printf("  -T width        Trigger pulse width in us (default %.0f)\n", OutputWorker::DEFAULT_TRIGGER_WIDTH_NS / 1000.0);
+	printf("  -k max-skew     Fail if any p99 inter-voice skew exceeds this many us (default %.0f)\n", DEFAULT_MAX_SKEW_US);
+	printf("  -e max-error    Fail if the p99 trigger width error exceeds this many us (default %.0f); checked\n", DEFAULT_MAX_TRIGGER_ERROR_US);
+	printf("                  only where the process may use SCHED_FIFO\n");
+}
+
+int main(int argc, char **argv) {
+	size_t steps = DEFAULT_STEPS;
+	uint64_t byteInterval_ns = 0;
+	uint64_t perByteLatency_ns = 0;
+	double maxLatency_us = DEFAULT_MAX_LATENCY_US;
+	double maxSkew_us = DEFAULT_MAX_SKEW_US;
+	double maxTriggerError_us = DEFAULT_MAX_TRIGGER_ERROR_US;
+	uint64_t triggerWidth_ns = OutputWorker::DEFAULT_TRIGGER_WIDTH_NS;
+	int option;
+	while ((option = getopt(argc, argv, "n:wl:T:t:k:e:h")) != -1) {
+		switch (option) {
+			case 'n':
+				steps = strtoull(optarg, nullptr, 10);
+				break;
+			case 'w':
+				byteInterval_ns = DIN_BYTE_TIME_NS;
+				break;
+			case 'l':
+				perByteLatency_ns = strtoull(optarg, nullptr, 10);
+				break;
+			case 't':
+				maxLatency_us = atof(optarg);
+				break;
+			case 'T':
+				triggerWidth_ns = (uint64_t) (atof(optarg) * 1000 + 0.5);
+				break;
+			case 'k':
+				maxSkew_us = atof(optarg);
+				break;
+			case 'e':
+				maxTriggerError_us = atof(optarg);
+				break;
+			default:
+				printUsage(argv[0]);
+				return option == 'h' ? 0 : 1;
+		}
+	}
+
+	printf("MIDI-to-CV latency: %zu steps per scenario, %s input, %.1f us simulated I2C time per byte, %.1f us triggers\n",
+		steps, byteInterval_ns ? "DIN-paced" : "back-to-back", perByteLatency_ns / 1000.0, triggerWidth_ns / 1000.0);
+
+	bool realTime = feedUnderRealTime();
+	Harness harness(byteInterval_ns, perByteLatency_ns, triggerWidth_ns);
+	if (!harness.start(realTime)) {
+		return 1;
+	}
+	harness.clearLogs();
+
+	TimerProbe probe;
+	probe.interval_ns = triggerWidth_ns;
+	ThreadSchedule probeSchedule;
+	probeSchedule.priority = realTime ? OUTPUT_PRIORITY : 0;
+	probe.thread.setSchedule(probeSchedule);
+	if (!probe.timer.setup() || !probe.thread.start(&probeTimer, &probe)) {
+		printf("Error: Failed to start the timer probe\n");
+		return 1;
+	}
+
+	Report singleOn, singleOff, chordOn, chordOff, flood, bendStorm;
+	runSingleNotes(&harness, steps, &singleOn, &singleOff);
+	runChords(&harness, steps, &chordOn, &chordOff);
+	runFloods(&harness, steps, &flood);
+	runBendStorms(&harness, steps, &bendStorm);
+	harness.stop();
+	probe.running.store(false);
+	probe.thread.join();
+
+	bool passed = true;
+	passed = printReport("single on", &singleOn, maxLatency_us, maxSkew_us) && passed;
+	passed = printReport("single off", &singleOff, maxLatency_us, maxSkew_us) && passed;
+	passed = printReport("chord8 on", &chordOn, maxLatency_us, maxSkew_us) && passed;
+	passed = printReport("chord8 off", &chordOff, maxLatency_us, maxSkew_us) && passed;
+	passed = printReport("flood", &flood, maxLatency_us, maxSkew_us) && passed;
+	passed = printReport("bend storm", &bendStorm, maxLatency_us, maxSkew_us) && passed;
+	probe.lateness.print("timer lateness");
+	harness.triggerWidths.print("trigger width");
+	harness.triggerErrors.print("trigger width error");
+	if (realTime) {
+		passed = check("trigger width error", &harness.triggerErrors, maxTriggerError_us) && passed;
+	}
+	else {
+		printf("Skipped: trigger width error check, the process may not use SCHED_FIFO and its timers can wake\n");
+		printf("         milliseconds late\n");
+	}
+	printHistogram("trigger width error (worker)", harness.getMetrics()->buses[0].triggerError_ns);
+	printHistogram("worker wakeup", harness.getMetrics()->buses[0].workerWakeup_ns);
+	if (harness.getInvalidFrames() > 0) {
+		printf("Note: %llu DAC frames addressed channels the simulated DAC does not have\n",
+			(unsigned long long) harness.getInvalidFrames());
+	}
+
+	return passed ? 0 : 1;
+}
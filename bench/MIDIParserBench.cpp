@@ -0,0 +1,359 @@
+/*
+ * MIDIParser fuzz and throughput benchmark.
+ *
+ * Differential fuzz: random MIDI messages are encoded with random use of running status,
+ * real-time bytes dropped into the middle of other messages and SysEx of random length; the
+ * parser must return exactly the messages that were encoded, in the order they completed.
+ * Garbage fuzz: random bytes must only ever produce well-formed events.
+ * Throughput: a dense running-status stream with interleaved clock bytes.
+ * Running status: notes recovered from a keyboard-style stream by the parser main() used
+ * before, which assumed every message had its own three-byte packet.
+ *
+ * The program exits with status 1 if either fuzz finds a problem.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "BenchUtil.h"
+#include "../include/MIDIParser.h"
+#include "../include/MIDIEvent.h"
+#include "../include/Timer.h"
+
+static const size_t FUZZ_MESSAGES = 2000000;
+static const size_t GARBAGE_BYTES = 20000000;
+static const size_t THROUGHPUT_BYTES = 32000000;
+static const size_t SYSEX_MAX_GENERATED = 200;
+
+/*
+ * xorshift64 generator, so runs are repeatable
+ */
+class Random {
+	public:
+		Random(uint64_t seed) : state(seed) {}
+
+		uint64_t next() {
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			return state;
+		}
+
+		uint32_t below(uint32_t limit) {
+			return next() % limit;
+		}
+
+		bool chance(uint32_t percent) {
+			return below(100) < percent;
+		}
+
+	private:
+		uint64_t state;
+};
+
+struct Expected {
+	uint8_t data[MIDIEvent::MAX_LENGTH] = {0};
+	uint8_t length = 0;
+	uint8_t sysEx[MIDIParser::SYSEX_CAPACITY];
+	size_t sysExLength = 0;
+};
+
+/*
+ * Feeds bytes to the parser and checks every event against the next expected one
+ */
+class Checker {
+	public:
+		uint64_t checked = 0;
+		uint64_t mismatches = 0;
+
+		void expect(const Expected &expected) {
+			pending[numPending++] = expected;
+		}
+
+		void feed(uint8_t byte) {
+			MIDIEvent event;
+			if (!parser.parse(byte, 0, &event)) {
+				return;
+			}
+			if (numPending == 0) {
+				report("unexpected event", event, nullptr);
+				return;
+			}
+			const Expected &expected = pending[0];
+			bool match = event.length == expected.length && memcmp(event.data, expected.data, expected.length) == 0;
+			if (match && event.data[0] == 0xF0) {
+				size_t length;
+				const uint8_t *sysEx = parser.getSysEx(&length);
+				match = length == expected.sysExLength && memcmp(sysEx, expected.sysEx, length) == 0;
+			}
+			if (!match) {
+				report("mismatch", event, &expected);
+			}
+			++checked;
+			for (uint8_t i = 1; i < numPending; ++i) {
+				pending[i - 1] = pending[i];
+			}
+			--numPending;
+		}
+
+		uint8_t getNumPending() const {
+			return numPending;
+		}
+
+	private:
+		MIDIParser parser;
+		Expected pending[8];
+		uint8_t numPending = 0;
+
+		void report(const char *what, const MIDIEvent &event, const Expected *expected) {
+			if (++mismatches <= 5) {
+				printf("  %s after %llu events: got %02x %02x %02x (length %d)", what,
+					(unsigned long long) checked, event.data[0], event.data[1], event.data[2], event.length);
+				if (expected) {
+					printf(", expected %02x %02x %02x (length %d)", expected->data[0], expected->data[1],
+						expected->data[2], expected->length);
+				}
+				printf("\n");
+			}
+		}
+};
+
+static const uint8_t REAL_TIME[] = {0xF8, 0xFA, 0xFB, 0xFC, 0xFE, 0xFF};
+static const uint8_t SYSTEM_COMMON[] = {0xF1, 0xF2, 0xF3, 0xF6};
+
+/*
+ * Sometimes feed a real-time byte, which may arrive between any two bytes of a message
+ */
+static void maybeFeedRealTime(Checker *checker, Random *random) {
+	if (random->chance(10)) {
+		Expected realTime;
+		realTime.data[0] = REAL_TIME[random->below(sizeof(REAL_TIME))];
+		realTime.length = 1;
+		checker->expect(realTime);
+		checker->feed(realTime.data[0]);
+	}
+}
+
+/*
+ * Feed the data bytes of a message; it is expected once its last byte goes in
+ */
+static void feedData(Checker *checker, Random *random, const Expected &message) {
+	for (uint8_t j = 1; j < message.length; ++j) {
+		maybeFeedRealTime(checker, random);
+		if (j == message.length - 1) {
+			checker->expect(message);
+		}
+		checker->feed(message.data[j]);
+	}
+}
+
+static bool runDifferentialFuzz() {
+	Random random(0x9E3779B97F4A7C15ull);
+	Checker checker;
+	uint8_t runningStatus = 0;
+	uint64_t runningStatusUsed = 0;
+	for (size_t i = 0; i < FUZZ_MESSAGES; ++i) {
+		Expected message;
+		uint32_t kind = random.below(100);
+		if (kind < 80) {
+			// Channel message, reusing the running status where possible
+			uint8_t status;
+			if (runningStatus != 0 && random.chance(60)) {
+				status = runningStatus;
+			}
+			else {
+				status = 0x80 + random.below(0x70);
+			}
+			message.data[0] = status;
+			message.length = 1 + MIDIParser::getDataLength(status);
+			for (uint8_t j = 1; j < message.length; ++j) {
+				message.data[j] = random.below(0x80);
+			}
+			bool omitStatus = status == runningStatus && random.chance(70);
+			runningStatusUsed += omitStatus;
+			if (!omitStatus) {
+				checker.feed(status);
+			}
+			feedData(&checker, &random, message);
+			runningStatus = status;
+		}
+		else if (kind < 88) {
+			// Real-time on its own
+			message.data[0] = REAL_TIME[random.below(sizeof(REAL_TIME))];
+			message.length = 1;
+			checker.expect(message);
+			checker.feed(message.data[0]);
+		}
+		else if (kind < 95) {
+			// System common, which cancels running status
+			uint8_t status = SYSTEM_COMMON[random.below(sizeof(SYSTEM_COMMON))];
+			message.data[0] = status;
+			message.length = 1 + MIDIParser::getDataLength(status);
+			for (uint8_t j = 1; j < message.length; ++j) {
+				message.data[j] = random.below(0x80);
+			}
+			if (message.length == 1) {
+				checker.expect(message);
+			}
+			checker.feed(status);
+			feedData(&checker, &random, message);
+			runningStatus = 0;
+		}
+		else {
+			// SysEx, which also cancels running status
+			size_t length = random.below(SYSEX_MAX_GENERATED);
+			message.data[0] = 0xF0;
+			message.length = 1;
+			checker.feed(0xF0);
+			for (size_t j = 0; j < length; ++j) {
+				uint8_t byte = random.below(0x80);
+				if (j < MIDIParser::SYSEX_CAPACITY) {
+					message.sysEx[message.sysExLength++] = byte;
+				}
+				maybeFeedRealTime(&checker, &random);
+				checker.feed(byte);
+			}
+			maybeFeedRealTime(&checker, &random);
+			checker.expect(message);
+			checker.feed(0xF7);
+			runningStatus = 0;
+		}
+	}
+
+	printf("%-28s messages=%zu events=%llu running-status=%llu mismatches=%llu unreturned=%d\n",
+		"differential fuzz", FUZZ_MESSAGES, (unsigned long long) checker.checked,
+		(unsigned long long) runningStatusUsed, (unsigned long long) checker.mismatches, checker.getNumPending());
+	return checker.mismatches == 0 && checker.getNumPending() == 0;
+}
+
+static bool runGarbageFuzz() {
+	Random random(12345);
+	MIDIParser parser;
+	MIDIEvent event;
+	uint64_t events = 0;
+	uint64_t malformed = 0;
+	for (size_t i = 0; i < GARBAGE_BYTES; ++i) {
+		// Biased towards status bytes so every state is visited often
+		uint8_t byte = random.chance(30) ? 0x80 + random.below(0x80) : random.below(0x80);
+		if (!parser.parse(byte, i, &event)) {
+			continue;
+		}
+		++events;
+		uint8_t status = event.data[0];
+		int8_t dataLength = status == 0xF0 ? 0 : MIDIParser::getDataLength(status);
+		bool wellFormed = status >= 0x80 && dataLength >= 0 && event.length == 1 + dataLength && event.timestamp_ns == i;
+		for (uint8_t j = 1; j < event.length && wellFormed; ++j) {
+			wellFormed = event.data[j] < 0x80;
+		}
+		malformed += !wellFormed;
+	}
+	const MIDIParser::Stats &stats = parser.getStats();
+	printf("%-28s bytes=%zu events=%llu malformed=%llu stray=%llu interrupted=%llu sysex=%llu\n",
+		"garbage fuzz", GARBAGE_BYTES, (unsigned long long) events, (unsigned long long) malformed,
+		(unsigned long long) stats.strayBytes, (unsigned long long) stats.interrupted,
+		(unsigned long long) stats.sysEx);
+	return malformed == 0;
+}
+
+/*
+ * Keyboard-style stream: Note On with running status for both presses and releases
+ * (velocity 0), and a clock byte every 8 notes
+ */
+static size_t fillDenseStream(uint8_t *buffer, size_t length, uint64_t *notes) {
+	size_t i = 0;
+	uint32_t note = 0;
+	while (i + 8 <= length) {
+		if (note % 64 == 0) {
+			buffer[i++] = 0x90;
+		}
+		buffer[i++] = 36 + note % 48;
+		buffer[i++] = note % 2 ? 0 : 100;
+		if (note % 8 == 7) {
+			buffer[i++] = 0xF8;
+		}
+		++note;
+	}
+	*notes = note;
+	return i;
+}
+
+static void runThroughput() {
+	uint8_t *stream = new uint8_t[THROUGHPUT_BYTES];
+	uint64_t notes;
+	size_t length = fillDenseStream(stream, THROUGHPUT_BYTES, &notes);
+	MIDIParser parser;
+	MIDIEvent event;
+	uint64_t events = 0;
+	uint64_t start = Timer::now_ns();
+	for (size_t i = 0; i < length; ++i) {
+		events += parser.parse(stream[i], start, &event);
+	}
+	uint64_t elapsed = Timer::now_ns() - start;
+	printf("%-28s bytes=%zu events=%llu  %.2f ns/byte  %.1f MB/s  %.1f M events/s\n", "throughput",
+		length, (unsigned long long) events, (double) elapsed / length, length * 1000.0 / elapsed,
+		events * 1000.0 / elapsed);
+	delete[] stream;
+}
+
+/*
+ * The parser midiRead() used before this one
+ */
+static bool legacyParse(uint8_t byte, uint8_t *packet, uint8_t *bytesInPacket) {
+	if (byte < 0b11110000) {
+		if (*bytesInPacket == 0) {
+			if (byte >= 0b10000000) {
+				packet[0] = byte;
+				*bytesInPacket = 1;
+			}
+		}
+		else if (byte < 0b10000000) {
+			packet[(*bytesInPacket)++] = byte;
+		}
+	}
+	if (*bytesInPacket == 3) {
+		*bytesInPacket = 0;
+		return true;
+	}
+	return false;
+}
+
+static void runRunningStatusComparison() {
+	const size_t LENGTH = 100000;
+	uint8_t *stream = new uint8_t[LENGTH];
+	uint64_t notes;
+	size_t length = fillDenseStream(stream, LENGTH, &notes);
+
+	MIDIParser parser;
+	MIDIEvent event;
+	uint64_t parsedNotes = 0;
+	for (size_t i = 0; i < length; ++i) {
+		if (parser.parse(stream[i], 0, &event) && (event.data[0] >> 4) == 0x9) {
+			++parsedNotes;
+		}
+	}
+
+	uint8_t packet[3];
+	uint8_t bytesInPacket = 0;
+	uint64_t legacyNotes = 0;
+	for (size_t i = 0; i < length; ++i) {
+		if (legacyParse(stream[i], packet, &bytesInPacket)) {
+			++legacyNotes;
+		}
+	}
+
+	printf("%-28s notes sent=%llu  recovered: table-driven=%llu  previous parser=%llu\n", "running status",
+		(unsigned long long) notes, (unsigned long long) parsedNotes, (unsigned long long) legacyNotes);
+	delete[] stream;
+}
+
+int main() {
+	bool passed = runDifferentialFuzz();
+	passed = runGarbageFuzz() && passed;
+	runThroughput();
+	runRunningStatusComparison();
+	if (!passed) {
+		printf("FAIL: MIDIParser fuzz found problems\n");
+	}
+	return passed ? 0 : 1;
+}
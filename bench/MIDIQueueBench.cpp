@@ -0,0 +1,142 @@
+/*
+ * Contention benchmark: MIDIPacketQueue guarded by a pthread mutex (held while dispatching,
+ * as main() used to) against the lock-free MIDIEventRing.
+ *
+ * The producer thread pushes bursts of events (a chord or a controller sweep) and records how long
+ * each push takes, sleeping between bursts.
+ * The consumer thread drains the queue and spins for DISPATCH_WORK_NS per event to stand in for
+ * the I2C writes done while dispatching.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#include "BenchUtil.h"
+#include "../include/MIDIPacketQueue.h"
+#include "../include/MIDIEventRing.h"
+#include "../include/Timer.h"
+
+static const size_t NUM_EVENTS = 100000;
+static const size_t BURST_SIZE = 16;
+static const uint64_t BURST_INTERVAL_NS = 200000;
+static const uint64_t DISPATCH_WORK_NS = 2000;
+
+static std::atomic<bool> producerDone(false);
+
+// Mutex-protected MIDIPacketQueue
+
+static MIDIPacketQueue packetQueue;
+static pthread_mutex_t packetLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *packetProducer(void *arg) {
+	BenchSamples *pushTimes = (BenchSamples*) arg;
+	uint8_t packet[MIDIPacketQueue::PACKET_SIZE] = {0x90, 60, 100, 0};
+	uint64_t next = Timer::now_ns();
+	for (size_t i = 0; i < NUM_EVENTS; ++i) {
+		if (i % BURST_SIZE == 0) {
+			benchSleepUntil_ns(next);
+			next += BURST_INTERVAL_NS;
+		}
+
+		uint64_t start = Timer::now_ns();
+		pthread_mutex_lock(&packetLock);
+		packetQueue.push(packet);
+		pthread_mutex_unlock(&packetLock);
+		pushTimes->add(Timer::now_ns() - start);
+	}
+	producerDone.store(true);
+	return nullptr;
+}
+
+static void *packetConsumer(void *arg) {
+	size_t *consumed = (size_t*) arg;
+	while (true) {
+		bool done = producerDone.load();
+		pthread_mutex_lock(&packetLock);
+		size_t length = packetQueue.getLength();
+		for (size_t i = 0; i < length; ++i) {
+			benchSpin_ns(DISPATCH_WORK_NS);
+		}
+		*consumed += length;
+		packetQueue.clear();
+		pthread_mutex_unlock(&packetLock);
+		if (done && length == 0) {
+			break;
+		}
+	}
+	return nullptr;
+}
+
+// Lock-free MIDIEventRing
+
+static MIDIEventRing eventRing;
+
+static void *ringProducer(void *arg) {
+	BenchSamples *pushTimes = (BenchSamples*) arg;
+	MIDIEvent event;
+	event.data[0] = 0x90;
+	event.data[1] = 60;
+	event.data[2] = 100;
+	event.length = 3;
+	uint64_t next = Timer::now_ns();
+	for (size_t i = 0; i < NUM_EVENTS; ++i) {
+		if (i % BURST_SIZE == 0) {
+			benchSleepUntil_ns(next);
+			next += BURST_INTERVAL_NS;
+		}
+
+		uint64_t start = Timer::now_ns();
+		event.timestamp_ns = start;
+		eventRing.push(event);
+		pushTimes->add(Timer::now_ns() - start);
+	}
+	producerDone.store(true);
+	return nullptr;
+}
+
+static void *ringConsumer(void *arg) {
+	size_t *consumed = (size_t*) arg;
+	MIDIEvent event;
+	while (true) {
+		bool done = producerDone.load();
+		size_t count = 0;
+		while (eventRing.pop(&event)) {
+			benchSpin_ns(DISPATCH_WORK_NS);
+			++count;
+		}
+		*consumed += count;
+		if (done && count == 0) {
+			break;
+		}
+	}
+	return nullptr;
+}
+
+static void run(const char *label, void *(*producer)(void*), void *(*consumer)(void*)) {
+	BenchSamples pushTimes(NUM_EVENTS);
+	size_t consumed = 0;
+	producerDone.store(false);
+
+	uint64_t start = Timer::now_ns();
+	pthread_t producerThread, consumerThread;
+	pthread_create(&consumerThread, NULL, consumer, &consumed);
+	pthread_create(&producerThread, NULL, producer, &pushTimes);
+	pthread_join(producerThread, NULL);
+	pthread_join(consumerThread, NULL);
+	double elapsed_s = (Timer::now_ns() - start) / 1e9;
+
+	pushTimes.print(label);
+	printf("%-28s consumed=%zu  throughput=%.0f events/s\n", "", consumed, consumed / elapsed_s);
+}
+
+int main() {
+	printf("MIDI queue contention: %zu events in bursts of %zu every %.1f us, %.1f us dispatch work per event\n",
+		NUM_EVENTS, BURST_SIZE, BURST_INTERVAL_NS / 1000.0, DISPATCH_WORK_NS / 1000.0);
+	run("MIDIPacketQueue + mutex", packetProducer, packetConsumer);
+	run("MIDIEventRing", ringProducer, ringConsumer);
+	printf("%-28s overflowed=%llu\n", "", (unsigned long long) eventRing.getOverflowCount());
+	return 0;
+}
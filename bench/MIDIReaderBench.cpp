@@ -0,0 +1,338 @@
+/*
+ * Reader cost benchmark: the old reader (one blocking read per byte, one notify per event)
+ * against MIDIInput, reading one source with a blocking read of everything available, and
+ * two sources with poll() and non-blocking reads. The MIDI port
+ * is stood in for by a pipe, fed by a writer thread at the 31.25 kbaud of a saturated DIN
+ * port in three shapes:
+ *   DIN bytes    - one byte every 320 us, as a UART delivers them
+ *   USB packets  - one three-byte message every 960 us, as USB MIDI delivers them
+ *   backlog      - 32 messages every 30.72 ms, as seen by a reader that was kept off the CPU
+ *
+ * Reported per MIDI message: syscalls made by the reader (reads, polls and eventfd writes)
+ * and reader CPU time.
+ */
+
+#include <pthread.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "BenchUtil.h"
+#include "../include/MIDIInput.h"
+#include "../include/MIDIByteSource.h"
+#include "../include/MIDIParser.h"
+#include "../include/MIDIEventRing.h"
+#include "../include/EventNotifier.h"
+#include "../include/Timer.h"
+
+static const uint64_t RUN_TIME_NS = 1000000000;
+static const uint64_t BYTE_TIME_NS = 320000;
+static const uint8_t MESSAGE_SIZE = 3;
+
+struct StreamShape {
+	const char *name;
+	uint16_t bytesPerWrite;
+};
+
+static const StreamShape SHAPES[] = {
+	{"DIN bytes", 1},
+	{"USB packets", MESSAGE_SIZE},
+	{"backlog", 32 * MESSAGE_SIZE}
+};
+
+/*
+ * Read end of a pipe standing in for a rawmidi port
+ */
+class PipeSource : public MIDIByteSource {
+	public:
+		PipeSource(int fd) : fd(fd) {}
+
+		bool open() override {
+			opened = 1;
+			return true;
+		}
+
+		void close() override {
+			opened = 0;
+		}
+
+		bool isOpen() const override {
+			return opened;
+		}
+
+		int getPollDescriptors(struct pollfd *fds, int space) override {
+			if (space < 1) {
+				return 0;
+			}
+			fds[0].fd = fd;
+			fds[0].events = POLLIN;
+			fds[0].revents = 0;
+			return 1;
+		}
+
+		unsigned short getPollEvents(struct pollfd *fds, int count) override {
+			return count > 0 ? fds[0].revents : 0;
+		}
+
+		ssize_t read(uint8_t *buffer, size_t length) override {
+			ssize_t result = ::read(fd, buffer, length);
+			if (result < 0) {
+				return errno == EAGAIN || errno == EINTR ? 0 : -1;
+			}
+			return result;
+		}
+
+		bool setBlocking(bool blocking) override {
+			int flags = fcntl(fd, F_GETFL);
+			return flags >= 0 && fcntl(fd, F_SETFL, blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK) == 0;
+		}
+
+		const char *getName() const override {
+			return "pipe";
+		}
+
+	private:
+		int fd;
+		bool opened = 0;
+};
+
+struct Writer {
+	int fd;
+	uint16_t bytesPerWrite;
+};
+
+static void *writeStream(void *arg) {
+	Writer *writer = (Writer*) arg;
+	uint8_t buffer[32 * MESSAGE_SIZE];
+	uint64_t start = Timer::now_ns();
+	uint64_t next = start;
+	uint32_t byteIndex = 0;
+	while (next - start < RUN_TIME_NS) {
+		for (uint16_t i = 0; i < writer->bytesPerWrite; ++i, ++byteIndex) {
+			uint8_t position = byteIndex % MESSAGE_SIZE;
+			buffer[i] = position == 0 ? 0x90 : (position == 1 ? 36 + byteIndex % 48 : 100);
+		}
+		benchSleepUntil_ns(next);
+		if (write(writer->fd, buffer, writer->bytesPerWrite) < 0) {
+			break;
+		}
+		next += BYTE_TIME_NS * writer->bytesPerWrite;
+	}
+	return nullptr;
+}
+
+// The dispatch side: sleep on the notifier and empty the queue
+
+struct Consumer {
+	MIDIEventRing *queue;
+	EventNotifier *notifier;
+	std::atomic<bool> running{true};
+	uint64_t events = 0;
+};
+
+static void *consume(void *arg) {
+	Consumer *consumer = (Consumer*) arg;
+	struct pollfd notifyDesc;
+	notifyDesc.fd = consumer->notifier->getFd();
+	notifyDesc.events = POLLIN;
+	MIDIEvent event;
+	while (consumer->running.load()) {
+		if (poll(&notifyDesc, 1, 10) <= 0) {
+			continue;
+		}
+		consumer->notifier->drain();
+		while (consumer->queue->pop(&event)) {
+			++consumer->events;
+		}
+	}
+	return nullptr;
+}
+
+// The reader main() used before: a blocking one-byte read per byte and a notify per event
+
+struct LegacyReader {
+	int fd;
+	MIDIEventRing *queue;
+	EventNotifier *notifier;
+	uint64_t reads = 0;
+	uint64_t notifies = 0;
+	uint64_t events = 0;
+	uint64_t cpu_ns = 0;
+};
+
+static void *legacyRead(void *arg) {
+	LegacyReader *reader = (LegacyReader*) arg;
+	MIDIParser parser;
+	MIDIEvent event;
+	uint8_t buffer[1];
+	while (true) {
+		++reader->reads;
+		if (read(reader->fd, buffer, 1) <= 0) {
+			break;
+		}
+		if (parser.parse(buffer[0], Timer::now_ns(), &event)) {
+			if (reader->queue->push(event)) {
+				++reader->events;
+				++reader->notifies;
+				reader->notifier->notify();
+			}
+		}
+	}
+	struct timespec cpu;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+	reader->cpu_ns = cpu.tv_sec * 1000000000ull + cpu.tv_nsec;
+	return nullptr;
+}
+
+/*
+ * CPU time of the thread of this process with the given name, from its schedstat, or 0 if no
+ * such thread runs
+ */
+static uint64_t threadCPU_ns(const char *name) {
+	DIR *tasks = opendir("/proc/self/task");
+	if (!tasks) {
+		return 0;
+	}
+	uint64_t cpu_ns = 0;
+	struct dirent *task;
+	while ((task = readdir(tasks)) != nullptr) {
+		char path[320];
+		char comm[32] = {0};
+		snprintf(path, sizeof(path), "/proc/self/task/%s/comm", task->d_name);
+		FILE *file = fopen(path, "r");
+		if (!file) {
+			continue;
+		}
+		bool found = fgets(comm, sizeof(comm), file) && strcspn(comm, "\n") == strlen(name) &&
+			strncmp(comm, name, strlen(name)) == 0;
+		fclose(file);
+		if (!found) {
+			continue;
+		}
+		snprintf(path, sizeof(path), "/proc/self/task/%s/schedstat", task->d_name);
+		file = fopen(path, "r");
+		unsigned long long ns;
+		if (file && fscanf(file, "%llu", &ns) == 1) {
+			cpu_ns = ns;
+		}
+		if (file) {
+			fclose(file);
+		}
+		break;
+	}
+	closedir(tasks);
+	return cpu_ns;
+}
+
+static void printResult(const char *reader, const char *shape, uint64_t events, uint64_t syscalls, uint64_t cpu_ns) {
+	printf("%-10s %-12s events=%-6llu syscalls/msg=%5.2f  cpu/msg=%6.2f us  cpu=%5.2f%%\n",
+		reader, shape, (unsigned long long) events,
+		events ? (double) syscalls / events : 0, events ? cpu_ns / 1000.0 / events : 0,
+		cpu_ns * 100.0 / RUN_TIME_NS);
+}
+
+static void runLegacy(const StreamShape &shape) {
+	int fds[2];
+	if (pipe(fds) != 0) {
+		return;
+	}
+	MIDIEventRing queue;
+	EventNotifier notifier;
+	notifier.setup();
+	Consumer consumer;
+	consumer.queue = &queue;
+	consumer.notifier = &notifier;
+	LegacyReader reader;
+	reader.fd = fds[0];
+	reader.queue = &queue;
+	reader.notifier = &notifier;
+	Writer writer;
+	writer.fd = fds[1];
+	writer.bytesPerWrite = shape.bytesPerWrite;
+
+	pthread_t consumerThread, readerThread, writerThread;
+	pthread_create(&consumerThread, NULL, &consume, &consumer);
+	pthread_create(&readerThread, NULL, &legacyRead, &reader);
+	pthread_create(&writerThread, NULL, &writeStream, &writer);
+	pthread_join(writerThread, NULL);
+	close(fds[1]);
+	pthread_join(readerThread, NULL);
+	consumer.running.store(false);
+	pthread_join(consumerThread, NULL);
+	close(fds[0]);
+
+	printResult("blocking", shape.name, reader.events, reader.reads + reader.notifies, reader.cpu_ns);
+}
+
+/*
+ * With polled, a second pipe that stays idle makes MIDIInput poll() both instead of blocking
+ * in the read of the only source
+ */
+static void runBulk(const StreamShape &shape, bool polled) {
+	int fds[2];
+	int idleFds[2];
+	if (pipe(fds) != 0) {
+		return;
+	}
+	if (pipe(idleFds) != 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return;
+	}
+	fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+	fcntl(idleFds[0], F_SETFL, fcntl(idleFds[0], F_GETFL) | O_NONBLOCK);
+	PipeSource source(fds[0]);
+	PipeSource idleSource(idleFds[0]);
+	MIDIEventRing queue;
+	EventNotifier notifier;
+	notifier.setup();
+	Consumer consumer;
+	consumer.queue = &queue;
+	consumer.notifier = &notifier;
+	MIDIInput input(&queue, &notifier);
+	input.addSource(&source);
+	if (polled) {
+		input.addSource(&idleSource);
+	}
+	Writer writer;
+	writer.fd = fds[1];
+	writer.bytesPerWrite = shape.bytesPerWrite;
+
+	pthread_t consumerThread, writerThread;
+	pthread_create(&consumerThread, NULL, &consume, &consumer);
+	input.start();
+	pthread_create(&writerThread, NULL, &writeStream, &writer);
+	pthread_join(writerThread, NULL);
+	benchSleepUntil_ns(Timer::now_ns() + 10 * BYTE_TIME_NS);
+
+	// MIDIInput's thread is not reachable from here, so it is found by name while it runs
+	uint64_t reader_ns = threadCPU_ns("midi");
+	input.stop();
+	consumer.running.store(false);
+	pthread_join(consumerThread, NULL);
+	close(fds[0]);
+	close(fds[1]);
+	close(idleFds[0]);
+	close(idleFds[1]);
+
+	MIDIInput::Stats stats;
+	input.getStats(&stats);
+	printResult(polled ? "poll+bulk" : "bulk", shape.name, stats.events, stats.polls + stats.reads + stats.notifies,
+		reader_ns);
+}
+
+int main() {
+	printf("MIDI reader cost: %.1f s per run, 31.25 kbaud saturated stream through a pipe\n", RUN_TIME_NS / 1e9);
+	for (size_t i = 0; i < sizeof(SHAPES) / sizeof(SHAPES[0]); ++i) {
+		runLegacy(SHAPES[i]);
+		runBulk(SHAPES[i], false);
+		runBulk(SHAPES[i], true);
+	}
+	return 0;
+}
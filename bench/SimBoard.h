@@ -0,0 +1,183 @@
+#ifndef SIM_BOARD_H
+#define SIM_BOARD_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+#include "../include/MIDIEventRing.h"
+#include "../include/MIDIDispatcher.h"
+#include "../include/OutputManager.h"
+#include "../include/OutputBank.h"
+#include "../include/OutputTopology.h"
+#include "../include/EventLoop.h"
+#include "../include/EventNotifier.h"
+#include "../include/Metrics.h"
+#include "../include/RealTime.h"
+#include "../include/LCD.h"
+#include "../include/LCDRenderer.h"
+#include "../include/DebouncedButton.h"
+#include "../include/SimI2CBus.h"
+#include "../include/SimMCP23017.h"
+#include "../include/SimDAC.h"
+#include "../include/SimGPIOLines.h"
+#include "../include/SimHD44780.h"
+
+/*
+ * SimI2CBus that lets the sending thread see when the worker is idle. The release increment
+ * after each transfer also publishes the device logs written during it.
+ */
+class ObservedBus : public SimI2CBus {
+	public:
+		std::atomic<bool> busy;
+		std::atomic<uint64_t> transfers;
+
+		ObservedBus() : busy(false), transfers(0) {}
+
+		bool transfer(I2CTransaction *transaction) override {
+			busy.store(true, std::memory_order_relaxed);
+			bool success = SimI2CBus::transfer(transaction);
+			transfers.fetch_add(1, std::memory_order_release);
+			busy.store(false, std::memory_order_release);
+			return success;
+		}
+};
+
+/*
+ * The default board with its expander, DAC, LCD and buttons replaced by their simulated models,
+ * driven from MIDIEvents the way main() drives the real one: an OutputBank over the default
+ * topology, and a dispatch thread running MIDIDispatcher from the same reactor callback main()
+ * registers for MIDI. The benchmarks feed queue and notify the dispatch loop in place of the
+ * MIDI reader, and read what reached the devices from their logs.
+ */
+class SimBoard {
+	public:
+		static const uint8_t NUM_OUTPUTS = 8;   // Of the default topology
+		static const uint8_t NUM_DACS = 1;      // Setting the pitch of the first DAC::NUM_CHANNELS outputs
+		static const uint8_t GATE_PORT = 0;
+		static const uint8_t TRIGGER_PORT = 1;
+
+		ObservedBus bus;
+		SimMCP23017 expander;
+		SimDAC dacs[NUM_DACS];
+		OutputTopology topology;
+		I2CBus *i2cBuses[1] = {&bus};
+		OutputBank bank;
+
+		MIDIEventRing queue;
+		EventNotifier notifier;
+		EventLoop loop;
+		std::atomic<uint64_t> dispatched{0};   // Events dispatched so far
+
+		SimBoard(uint64_t perByteLatency_ns, MIDIEventRing::OverflowPolicy overflowPolicy) :
+			expander(OutputTopology::DEFAULT_GPIO_ADDR),
+			dacs{SimDAC(OutputTopology::DEFAULT_DAC_ADDR)},
+			bank(&topology, i2cBuses), queue(overflowPolicy),
+			lcdLines(lcdPins, LCD::Line::NUM_LINES, true), lcd(&lcdLines), display(&lcd),
+			outputButtonLine(&outputButtonPin, 1, false), channelButtonLine(&channelButtonPin, 1, false),
+			outputButton(&outputButtonLine), channelButton(&channelButtonLine) {
+			bus.attach(&expander);
+			for (uint8_t i = 0; i < NUM_DACS; ++i) {
+				bus.attach(&dacs[i]);
+			}
+			bus.setLatency(0, perByteLatency_ns);
+			lcdLines.setListener(&lcdModel);
+		}
+
+		~SimBoard() {
+			delete dispatcher;
+			delete outManager;
+		}
+
+		/*
+		 * Start the output workers and the dispatch thread with the given schedules. The board
+		 * is instrumented as in main(), so the benchmarks include the cost of the metrics.
+		 */
+		bool start(const ThreadSchedule &outputSchedule, const ThreadSchedule &dispatchSchedule) {
+			if (!metricsSegment.create(nullptr)) {
+				return false;
+			}
+			bank.setMetrics(metricsSegment.get());
+			bank.setSchedule(outputSchedule);
+			dispatchThread.setSchedule(dispatchSchedule);
+			if (!notifier.setup() || !loop.setup() || !bank.start()) {
+				return false;
+			}
+			loop.addFd(notifier.getFd(), EPOLLIN, &onMIDIEvents, this);
+			loop.setIterationHistogram(&metricsSegment.get()->loopIteration_ns);
+			loop.setTimerLatenessHistogram(&metricsSegment.get()->timerLateness_ns);
+			outManager = new OutputManager(&bank, &loop, &display, &outputButton, &channelButton);
+			dispatcher = new MIDIDispatcher(outManager);
+			dispatcher->setMetrics(metricsSegment.get());
+			return dispatchThread.start(&dispatchLoop, this);
+		}
+
+		void stop() {
+			running.store(false);
+			notifier.notify();
+			dispatchThread.join();
+			bank.stop();
+		}
+
+		Metrics *getMetrics() {
+			return metricsSegment.get();
+		}
+
+		const Metrics *getMetrics() const {
+			return metricsSegment.get();
+		}
+
+		uint64_t getInvalidFrames() const {
+			uint64_t frames = 0;
+			for (uint8_t i = 0; i < NUM_DACS; ++i) {
+				frames += dacs[i].getInvalidFrames();
+			}
+			return frames;
+		}
+
+		void clearLogs() {
+			bus.clearLog();
+			expander.clearLog();
+			for (uint8_t i = 0; i < NUM_DACS; ++i) {
+				dacs[i].clearLog();
+			}
+		}
+
+	private:
+		const uint8_t lcdPins[LCD::Line::NUM_LINES] = {4, 5, 6, 7, 8, 9};
+		const uint8_t outputButtonPin = 16;
+		const uint8_t channelButtonPin = 17;
+
+		MetricsSegment metricsSegment;
+		SimHD44780 lcdModel;
+		SimGPIOLines lcdLines;
+		LCD lcd;
+		LCDRenderer display;
+		SimGPIOLines outputButtonLine;
+		SimGPIOLines channelButtonLine;
+		DebouncedButton outputButton;
+		DebouncedButton channelButton;
+
+		OutputManager *outManager = nullptr;
+		MIDIDispatcher *dispatcher = nullptr;
+		RealTimeThread dispatchThread{"dispatch"};
+		std::atomic<bool> running{true};
+
+		static void onMIDIEvents(void *context, uint32_t events) {
+			(void)events;
+			SimBoard *board = (SimBoard*) context;
+			board->notifier.drain();
+			size_t numEvents = board->dispatcher->dispatchAll(&board->queue);
+			board->dispatched.fetch_add(numEvents, std::memory_order_release);
+		}
+
+		static void *dispatchLoop(void *arg) {
+			SimBoard *board = (SimBoard*) arg;
+			while (board->running.load()) {
+				board->loop.wait(10);
+			}
+			return nullptr;
+		}
+};
+
+#endif
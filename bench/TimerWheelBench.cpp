@@ -0,0 +1,254 @@
+/*
+ * TimerWheel fuzz and cost benchmark.
+ *
+ * Fuzz: timers are scheduled, moved and cancelled at random distances (past deadlines, ticks,
+ * milliseconds, seconds and past the last level), from outside and from inside callbacks,
+ * while simulated time advances in random steps. After every advance() each timer due by then
+ * must have fired exactly once, none may fire early, and getNextDeadline_ns() must equal the
+ * earliest pending deadline.
+ * Cost: schedule, advance and fire per timer with 8 (the trigger outputs) and 4096 timers
+ * pending, next to the cost of the clock read that a cached "now" saves.
+ *
+ * The program exits with status 1 if the fuzz finds a problem.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "BenchUtil.h"
+#include "../include/TimerWheel.h"
+#include "../include/Timer.h"
+
+static const size_t NUM_TIMERS = 64;
+static const size_t FUZZ_STEPS = 300000;
+static const size_t COST_ROUNDS = 2000000;
+static const uint64_t START_NS = 123456789012345ull;
+
+/*
+ * xorshift64 generator, so runs are repeatable
+ */
+class Random {
+	public:
+		Random(uint64_t seed) : state(seed) {}
+
+		uint64_t next() {
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			return state;
+		}
+
+		uint64_t below(uint64_t limit) {
+			return next() % limit;
+		}
+
+	private:
+		uint64_t state;
+};
+
+struct FuzzTimer;
+
+struct Fuzz {
+	TimerWheel *wheel;
+	Random *random;
+	FuzzTimer *timers;
+	uint64_t failures = 0;
+	uint64_t fired = 0;
+};
+
+struct FuzzTimer {
+	TimerWheel::Entry entry;
+	Fuzz *fuzz;
+	bool pending = 0;
+	uint64_t deadline_ns = 0;
+};
+
+static void fail(Fuzz *fuzz, const char *what, uint64_t now_ns, uint64_t deadline_ns) {
+	if (++fuzz->failures <= 5) {
+		printf("  %s: now %llu, deadline %llu\n", what, (unsigned long long) (now_ns - START_NS),
+			(unsigned long long) (deadline_ns - START_NS));
+	}
+}
+
+/*
+ * Distance to a new deadline, spread over every level of the wheel
+ */
+static uint64_t randomDelay(Random *random) {
+	switch (random->below(6)) {
+		case 0:
+			return random->below(100000);
+		case 1:
+			return random->below(5000000);
+		case 2:
+			return random->below(300000000);
+		case 3:
+			return random->below(20000000000ull);
+		case 4:
+			return random->below(3000000000000ull);
+		default:
+			return random->below(1 << TimerWheel::TICK_SHIFT);
+	}
+}
+
+static void schedule(Fuzz *fuzz, FuzzTimer *timer, uint64_t deadline_ns) {
+	fuzz->wheel->schedule(&timer->entry, deadline_ns);
+	timer->pending = 1;
+	timer->deadline_ns = deadline_ns;
+}
+
+static void onFuzzTimer(void *context, uint64_t now_ns) {
+	FuzzTimer *timer = (FuzzTimer*) context;
+	Fuzz *fuzz = timer->fuzz;
+	++fuzz->fired;
+	if (!timer->pending) {
+		fail(fuzz, "fired while not pending", now_ns, timer->deadline_ns);
+	}
+	if (timer->deadline_ns > now_ns) {
+		fail(fuzz, "fired early", now_ns, timer->deadline_ns);
+	}
+	timer->pending = 0;
+
+	// Callbacks reschedule themselves and cancel or move others
+	uint64_t action = fuzz->random->below(4);
+	if (action == 0) {
+		schedule(fuzz, timer, now_ns + 1 + randomDelay(fuzz->random));
+	}
+	else if (action == 1) {
+		FuzzTimer *other = &fuzz->timers[fuzz->random->below(NUM_TIMERS)];
+		fuzz->wheel->cancel(&other->entry);
+		other->pending = 0;
+	}
+	else if (action == 2) {
+		FuzzTimer *other = &fuzz->timers[fuzz->random->below(NUM_TIMERS)];
+		schedule(fuzz, other, now_ns + 1 + randomDelay(fuzz->random));
+	}
+}
+
+static bool runFuzz() {
+	Random random(2024);
+	uint64_t now_ns = START_NS;
+	TimerWheel wheel(now_ns);
+	FuzzTimer timers[NUM_TIMERS];
+	Fuzz fuzz;
+	fuzz.wheel = &wheel;
+	fuzz.random = &random;
+	fuzz.timers = timers;
+	for (size_t i = 0; i < NUM_TIMERS; ++i) {
+		timers[i].entry.callback = &onFuzzTimer;
+		timers[i].entry.context = &timers[i];
+		timers[i].fuzz = &fuzz;
+	}
+
+	for (size_t step = 0; step < FUZZ_STEPS; ++step) {
+		for (uint64_t i = random.below(4); i > 0; --i) {
+			FuzzTimer *timer = &timers[random.below(NUM_TIMERS)];
+			if (random.below(5) == 0) {
+				wheel.cancel(&timer->entry);
+				timer->pending = 0;
+			}
+			else if (random.below(10) == 0) {
+				// Already due
+				schedule(&fuzz, timer, now_ns - random.below(1000000));
+			}
+			else {
+				schedule(&fuzz, timer, now_ns + randomDelay(&random));
+			}
+		}
+
+		// Mostly short steps, with the occasional long sleep
+		now_ns += random.below(20) == 0 ? randomDelay(&random) : random.below(200000);
+		wheel.advance(now_ns);
+
+		uint64_t earliest_ns = 0;
+		size_t numPending = 0;
+		for (size_t i = 0; i < NUM_TIMERS; ++i) {
+			if (!timers[i].pending) {
+				continue;
+			}
+			++numPending;
+			if (timers[i].deadline_ns <= now_ns) {
+				fail(&fuzz, "missed", now_ns, timers[i].deadline_ns);
+				wheel.cancel(&timers[i].entry);
+				timers[i].pending = 0;
+				continue;
+			}
+			if (earliest_ns == 0 || timers[i].deadline_ns < earliest_ns) {
+				earliest_ns = timers[i].deadline_ns;
+			}
+		}
+		if (wheel.getNextDeadline_ns() != earliest_ns) {
+			fail(&fuzz, "wrong next deadline", wheel.getNextDeadline_ns(), earliest_ns);
+		}
+		if (wheel.getNumPending() != numPending) {
+			fail(&fuzz, "wrong pending count", now_ns, now_ns);
+		}
+	}
+	printf("%-34s steps=%zu fired=%llu failures=%llu\n", "fuzz", FUZZ_STEPS,
+		(unsigned long long) fuzz.fired, (unsigned long long) fuzz.failures);
+	return fuzz.failures == 0;
+}
+
+static void onCostTimer(void *context, uint64_t now_ns) {
+	(void)now_ns;
+	++*(uint64_t*) context;
+}
+
+/*
+ * One timer started every 100 us with a 700 us deadline (a trigger), among others pending far out
+ */
+static void runCost(size_t numPending) {
+	uint64_t now_ns = START_NS;
+	TimerWheel wheel(now_ns);
+	uint64_t fired = 0;
+	TimerWheel::Entry *background = new TimerWheel::Entry[numPending];
+	for (size_t i = 0; i < numPending; ++i) {
+		background[i].callback = &onCostTimer;
+		background[i].context = &fired;
+		wheel.schedule(&background[i], now_ns + 3600000000000ull + i * 1000);
+	}
+	TimerWheel::Entry triggers[8];
+	for (uint8_t i = 0; i < 8; ++i) {
+		triggers[i].callback = &onCostTimer;
+		triggers[i].context = &fired;
+	}
+
+	uint64_t start = Timer::now_ns();
+	uint64_t deadlineSum = 0;
+	for (size_t round = 0; round < COST_ROUNDS; ++round) {
+		now_ns += 100000;
+		wheel.schedule(&triggers[round % 8], now_ns + 700000);
+		wheel.advance(now_ns);
+		deadlineSum += wheel.getNextDeadline_ns();
+	}
+	uint64_t elapsed = Timer::now_ns() - start;
+	char label[64];
+	snprintf(label, sizeof(label), "%zu timers pending", numPending + 8);
+	printf("%-34s %6.1f ns per schedule + advance + next deadline (%llu fired)\n", label,
+		(double) elapsed / COST_ROUNDS, (unsigned long long) fired);
+	if (deadlineSum == 0) {
+		printf("  no deadlines\n");
+	}
+	delete[] background;
+}
+
+static void runClockCost() {
+	uint64_t sum = 0;
+	uint64_t start = Timer::now_ns();
+	for (size_t i = 0; i < COST_ROUNDS; ++i) {
+		sum += Timer::now_ns();
+	}
+	uint64_t elapsed = Timer::now_ns() - start;
+	printf("%-34s %6.1f ns per read%s\n", "clock_gettime(CLOCK_MONOTONIC)", (double) elapsed / COST_ROUNDS,
+		sum == 0 ? " (no time)" : "");
+}
+
+int main() {
+	bool passed = runFuzz();
+	runCost(0);
+	runCost(4096);
+	runClockCost();
+	if (!passed) {
+		printf("FAIL: TimerWheel fuzz found problems\n");
+	}
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,280 @@
+/*
+ * Voice allocation benchmark.
+ *
+ * Cost: a keyboard-style stream that holds about 1.5 notes per voice, so most note ons steal,
+ * run through the allocation OutputManager used before (two scans of the outputs and two clock
+ * reads per stealing candidate) and through VoiceAllocator under each policy, for 8 voices
+ * (the hardware) and 64.
+ * Fuzz: random note ons, note offs and channel resets on four channels with random voice
+ * assignments and policies; sounding voices must always belong to held notes, no note may
+ * have two voices, and the note-priority and legato policies must never leave a voice idle
+ * while a held note waits.
+ *
+ * The program exits with status 1 if the fuzz finds a problem.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "BenchUtil.h"
+#include "../include/VoiceAllocator.h"
+#include "../include/Timer.h"
+
+static const size_t NUM_EVENTS = 2000000;
+static const size_t FUZZ_ROUNDS = 200;
+static const size_t FUZZ_EVENTS = 10000;
+static const uint8_t FUZZ_CHANNELS = 4;
+
+/*
+ * xorshift64 generator, so runs are repeatable
+ */
+class Random {
+	public:
+		Random(uint64_t seed) : state(seed) {}
+
+		uint32_t below(uint32_t limit) {
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			return state % limit;
+		}
+
+	private:
+		uint64_t state;
+};
+
+struct NoteEvent {
+	uint8_t note;
+	bool on;
+};
+
+/*
+ * The allocation OutputManager used before VoiceAllocator, without the hardware updates
+ */
+class LegacyAllocator {
+	public:
+		uint64_t clockReads = 0;
+
+		LegacyAllocator(uint8_t numOutputs) : numOutputs(numOutputs) {
+			outputs = new Output[numOutputs];
+		}
+
+		~LegacyAllocator() {
+			delete[] outputs;
+		}
+
+		uint8_t pressKey(uint8_t noteId, uint8_t channel) {
+			bool channelSet = 0;
+			bool outputFound = 0;
+			uint8_t outputIndex = 0;
+			for (uint8_t i = 0; i < numOutputs; ++i) {
+				if (outputs[i].channel == channel) {
+					channelSet = 1;
+					if (!outputs[i].gateIsOn) {
+						outputFound = 1;
+						outputIndex = i;
+						break;
+					}
+				}
+			}
+			if (!channelSet) {
+				return 0xFF;
+			}
+			if (!outputFound) {
+				bool longestGateOnTimeSet = 0;
+				double longestGateOnTime = 0;
+				for (uint8_t i = 0; i < numOutputs; ++i) {
+					if (outputs[i].channel != channel) {
+						continue;
+					}
+					clockReads += 1;
+					if (!longestGateOnTimeSet || outputs[i].gateOnTimer.get_s() > longestGateOnTime) {
+						longestGateOnTimeSet = 1;
+						clockReads += 1;
+						longestGateOnTime = outputs[i].gateOnTimer.get_s();
+						outputIndex = i;
+					}
+				}
+			}
+			outputs[outputIndex].noteId = noteId;
+			outputs[outputIndex].gateIsOn = 1;
+			outputs[outputIndex].gateOnTimer.set();
+			clockReads += 2;
+			return outputIndex;
+		}
+
+		void releaseKey(uint8_t noteId, uint8_t channel) {
+			for (uint8_t i = 0; i < numOutputs; ++i) {
+				if (outputs[i].noteId == noteId && outputs[i].channel == channel) {
+					outputs[i].gateIsOn = 0;
+				}
+			}
+		}
+
+	private:
+		struct Output {
+			uint8_t noteId = 0;
+			uint8_t channel = 0;
+			bool gateIsOn = 0;
+			Timer gateOnTimer;
+		};
+
+		uint8_t numOutputs;
+		Output *outputs;
+};
+
+/*
+ * Random presses and releases holding around 1.5 notes per voice on one channel
+ */
+static void fillStream(NoteEvent *events, size_t length, uint8_t numVoices) {
+	Random random(42);
+	uint8_t held[VoiceAllocator::NUM_NOTES];
+	uint8_t numHeld = 0;
+	bool isHeld[VoiceAllocator::NUM_NOTES] = {0};
+	uint8_t target = numVoices * 3 / 2;
+	for (size_t i = 0; i < length; ++i) {
+		if (numHeld == 0 || (numHeld < target && random.below(2) == 0) || (numHeld < 100 && random.below(8) == 0)) {
+			uint8_t note;
+			do {
+				note = random.below(VoiceAllocator::NUM_NOTES);
+			} while (isHeld[note]);
+			isHeld[note] = 1;
+			held[numHeld++] = note;
+			events[i] = {note, true};
+		}
+		else {
+			uint8_t index = random.below(numHeld);
+			uint8_t note = held[index];
+			held[index] = held[--numHeld];
+			isHeld[note] = 0;
+			events[i] = {note, false};
+		}
+	}
+}
+
+static void runCost(uint8_t numVoices) {
+	NoteEvent *events = new NoteEvent[NUM_EVENTS];
+	fillStream(events, NUM_EVENTS, numVoices);
+	char label[64];
+
+	LegacyAllocator legacy(numVoices);
+	uint64_t start = Timer::now_ns();
+	for (size_t i = 0; i < NUM_EVENTS; ++i) {
+		if (events[i].on) {
+			legacy.pressKey(events[i].note, 0);
+		}
+		else {
+			legacy.releaseKey(events[i].note, 0);
+		}
+	}
+	uint64_t elapsed = Timer::now_ns() - start;
+	snprintf(label, sizeof(label), "%d voices, previous", numVoices);
+	printf("%-30s %7.1f ns/event  clock reads/event=%.2f\n", label, (double) elapsed / NUM_EVENTS,
+		(double) legacy.clockReads / NUM_EVENTS);
+
+	for (uint8_t p = 0; p <= (uint8_t) VoiceAllocator::Policy::LEGATO; ++p) {
+		VoiceAllocator::Policy policy = (VoiceAllocator::Policy) p;
+		VoiceAllocator *allocator = new VoiceAllocator(numVoices);
+		allocator->setPolicy(policy);
+		VoiceAllocator::Change change;
+		uint64_t changes = 0;
+		start = Timer::now_ns();
+		for (size_t i = 0; i < NUM_EVENTS; ++i) {
+			if (events[i].on) {
+				changes += allocator->noteOn(events[i].note, 0, &change);
+			}
+			else {
+				changes += allocator->noteOff(events[i].note, 0, &change);
+			}
+		}
+		elapsed = Timer::now_ns() - start;
+		snprintf(label, sizeof(label), "%d voices, %s", numVoices, VoiceAllocator::getPolicyName(policy));
+		printf("%-30s %7.1f ns/event  voice changes/event=%.2f\n", label, (double) elapsed / NUM_EVENTS,
+			(double) changes / NUM_EVENTS);
+		delete allocator;
+	}
+	delete[] events;
+}
+
+static uint64_t checkInvariants(const VoiceAllocator &allocator, bool held[][VoiceAllocator::NUM_NOTES]) {
+	uint64_t failures = 0;
+	uint8_t voiceOf[FUZZ_CHANNELS][VoiceAllocator::NUM_NOTES];
+	memset(voiceOf, VoiceAllocator::NO_VOICE, sizeof(voiceOf));
+	uint8_t active[FUZZ_CHANNELS] = {0};
+	uint8_t assigned[FUZZ_CHANNELS] = {0};
+	for (uint8_t v = 0; v < allocator.getNumVoices(); ++v) {
+		uint8_t channel = allocator.getChannel(v);
+		++assigned[channel];
+		if (!allocator.isActive(v)) {
+			continue;
+		}
+		uint8_t note = allocator.getNote(v);
+		++active[channel];
+		failures += !held[channel][note];
+		failures += voiceOf[channel][note] != VoiceAllocator::NO_VOICE;
+		voiceOf[channel][note] = v;
+	}
+	for (uint8_t channel = 0; channel < FUZZ_CHANNELS; ++channel) {
+		VoiceAllocator::Policy policy = allocator.getPolicy(channel);
+		if (policy != VoiceAllocator::Policy::LOWEST_NOTE && policy != VoiceAllocator::Policy::HIGHEST_NOTE &&
+			policy != VoiceAllocator::Policy::LEGATO) {
+			continue;
+		}
+		uint8_t numHeld = 0;
+		for (uint8_t note = 0; note < VoiceAllocator::NUM_NOTES; ++note) {
+			numHeld += held[channel][note];
+		}
+		failures += active[channel] != (numHeld < assigned[channel] ? numHeld : assigned[channel]);
+	}
+	return failures;
+}
+
+static bool runFuzz() {
+	Random random(7);
+	uint64_t failures = 0;
+	uint64_t events = 0;
+	for (size_t round = 0; round < FUZZ_ROUNDS; ++round) {
+		VoiceAllocator allocator(1 + random.below(16));
+		bool held[FUZZ_CHANNELS][VoiceAllocator::NUM_NOTES];
+		memset(held, 0, sizeof(held));
+		for (uint8_t v = 0; v < allocator.getNumVoices(); ++v) {
+			allocator.assign(v, random.below(FUZZ_CHANNELS));
+		}
+		for (uint8_t channel = 0; channel < FUZZ_CHANNELS; ++channel) {
+			allocator.setPolicy(channel, (VoiceAllocator::Policy) random.below(5));
+		}
+		VoiceAllocator::Change change;
+		for (size_t i = 0; i < FUZZ_EVENTS; ++i, ++events) {
+			uint8_t channel = random.below(FUZZ_CHANNELS);
+			// A narrow note range so presses, repeats and releases of the same notes collide
+			uint8_t note = 60 + random.below(24);
+			uint32_t action = random.below(1000);
+			if (action == 0) {
+				allocator.releaseChannel(channel);
+				memset(held[channel], 0, sizeof(held[channel]));
+			}
+			else if (action < 500) {
+				allocator.noteOn(note, channel, &change);
+				held[channel][note] = 1;
+			}
+			else {
+				allocator.noteOff(note, channel, &change);
+				held[channel][note] = 0;
+			}
+			failures += checkInvariants(allocator, held);
+		}
+	}
+	printf("%-30s events=%llu failures=%llu\n", "fuzz", (unsigned long long) events, (unsigned long long) failures);
+	return failures == 0;
+}
+
+int main() {
+	runCost(8);
+	runCost(64);
+	bool passed = runFuzz();
+	if (!passed) {
+		printf("FAIL: VoiceAllocator fuzz found problems\n");
+	}
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+#ifndef CHIP_GPIO_LINES_H
+#define CHIP_GPIO_LINES_H
+
+#include <linux/gpio.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "GPIOLines.h"
+#include "Log.h"
+
+/*
+ * GPIO lines requested as one handle through the /dev/gpiochipN character device (uAPI v2).
+ * All lines of the group are read or written with a single ioctl.
+ */
+class ChipGPIOLines : public GPIOLines {
+	public:
+		/*
+		 * Line offsets are relative to the given chip (e.g. "/dev/gpiochip0")
+		 */
+		ChipGPIOLines(const char *chipPath, const uint8_t *offsets, uint8_t numLines, bool isOutput);
+		~ChipGPIOLines();
+
+		bool setup() override;
+		bool setValues(uint32_t mask, uint32_t values) override;
+		bool getValues(uint32_t mask, uint32_t *values) override;
+		bool closeLines() override;
+
+		int getEventFd() const override;
+		bool readEdge(uint8_t *line, bool *value, uint64_t *timestamp_ns) override;
+		bool hasKernelDebounce() const override;
+
+	private:
+		static const char *CONSUMER;
+
+		char chipPath[64] = {0};
+		int requestDesc = -1;
+		bool kernelDebounce = 0;
+
+		bool requestLines(int chipDesc, bool withDebounce);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef CONTROLLER_STATE_H
+#define CONTROLLER_STATE_H
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Front panel state kept in a small memory-mapped file across restarts: the channel of each
+ * output and the selected output. Setters only write the mapped memory, which the kernel writes
+ * back to the file in its own time, so they are safe on the dispatch thread. The file also
+ * records the boot it was last opened in, which tells a restart (devices still configured)
+ * apart from a power-up.
+ */
+class ControllerState {
+	public:
+		static constexpr const char *DEFAULT_PATH = "/var/lib/synth_controller.state";
+		static const uint32_t MAGIC = 0x53594e53;  // "SYNS"
+		static const uint16_t VERSION = 1;
+		static const uint8_t MAX_OUTPUTS = 64;     // OutputTopology::MAX_OUTPUTS
+		static const size_t BOOT_ID_SIZE = 37;     // UUID and terminator
+
+		ControllerState();
+		~ControllerState();
+
+		/*
+		 * Map the state file, creating it if needed. A file that does not hold this version's
+		 * state for numOutputs outputs is reset to every output on channel 0.
+		 */
+		bool open(const char *path, uint8_t numOutputs);
+
+		/*
+		 * Write the state back to the file and unmap it
+		 */
+		void close();
+
+		bool isOpen() const;
+
+		/*
+		 * Whether the file held state for the same outputs when opened
+		 */
+		bool isRestored() const;
+
+		/*
+		 * Whether the file was last opened since the machine booted
+		 */
+		bool isWarm() const;
+
+		uint8_t getNumOutputs() const;
+		uint8_t getChannel(uint8_t output) const;
+		uint8_t getSelectedOutput() const;
+
+		void setChannel(uint8_t output, uint8_t channel);
+		void setSelectedOutput(uint8_t output);
+
+	private:
+		struct Data {
+			uint32_t magic;
+			uint16_t version;
+			uint8_t numOutputs;
+			uint8_t selectedOutput;
+			char bootId[BOOT_ID_SIZE];
+			uint8_t channels[MAX_OUTPUTS];
+		};
+
+		Data *data = nullptr;
+		bool restored = 0;
+		bool warm = 0;
+
+		/*
+		 * Identifier of the current boot, or an empty string if the kernel does not give one
+		 */
+		static void readBootId(char *bootId);
+};
+
+#endif
@@ -5,9 +5,12 @@
 #include <stdint.h>
 
 #include "I2CDevice.h"
+#include "Log.h"
 
 class DAC : public I2CDevice {
 	public:
+		static const uint8_t NUM_CHANNELS = 4;
+
 		struct Command {
 			static const uint8_t WRITE = 0b0000;
 			static const uint8_t UPDATE = 0b0001;
@@ -15,14 +18,37 @@ class DAC : public I2CDevice {
 			static const uint8_t WRITE_UPDATE = 0b0011;
 		};
 
-		DAC(int i2cFile);
+		DAC(I2CBus *bus, uint8_t addr);
 		DAC();
 
 		/*
 		 * Set command and access byte and write a 12-bit (0 to 4095) value to the DAC
 		 */
 		bool writeData(uint16_t value, uint8_t command, uint8_t channel);
+
+		/*
+		 * Same as writeData(), but appended to a transaction instead of written immediately
+		 */
+		bool stageData(I2CTransaction *transaction, uint16_t value, uint8_t command, uint8_t channel);
+
+		/*
+		 * Write several channels in one I2C message: every value but the last is stored with WRITE
+		 * and the last frame uses WRITE_UPDATE_ALL, so all channels change at the same instant.
+		 * Every channel must be below NUM_CHANNELS, or nothing is written.
+		 */
+		bool writeBatch(const uint8_t *channels, const uint16_t *values, uint8_t count);
+		bool stageBatch(I2CTransaction *transaction, const uint8_t *channels, const uint16_t *values, uint8_t count);
+
+	private:
+		static const uint8_t FRAME_SIZE = 3;
+		static const uint8_t MAX_BATCH_SIZE = NUM_CHANNELS;
+
+		/*
+		 * Encode a batch into buffer, returning its length in bytes (0 if the batch is invalid)
+		 */
+		static uint8_t encodeBatch(uint8_t *buffer, const uint8_t *channels, const uint16_t *values, uint8_t count);
+
+		static void encode(uint8_t *frame, uint16_t value, uint8_t command, uint8_t channel);
 };
 
 #endif
-
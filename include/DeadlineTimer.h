@@ -0,0 +1,44 @@
+#ifndef DEADLINE_TIMER_H
+#define DEADLINE_TIMER_H
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Log.h"
+
+/*
+ * timerfd that becomes readable at an absolute CLOCK_MONOTONIC deadline
+ */
+class DeadlineTimer {
+	public:
+		DeadlineTimer();
+		~DeadlineTimer();
+
+		bool setup();
+
+		/*
+		 * Fire once at deadline_ns (see Timer::now_ns()); a deadline in the past fires immediately
+		 */
+		bool arm(uint64_t deadline_ns);
+		bool disarm();
+
+		/*
+		 * Clear a pending expiration after the timer fired
+		 */
+		void acknowledge();
+
+		/*
+		 * Deadline currently armed, or 0 if disarmed
+		 */
+		uint64_t getDeadline_ns() const;
+
+		int getFd() const;
+
+	private:
+		int timerDesc = -1;
+		uint64_t deadline_ns = 0;
+};
+
+#endif
@@ -4,22 +4,64 @@
 #include <stdint.h>
 
 #include "Timer.h"
-#include "DigitalInputPin.h"
+#include "GPIOLines.h"
+#include "SysfsGPIOLines.h"
 
+/*
+ * Front panel button driven by GPIO edge events. The debounce state only changes in
+ * handleEdges(), and the queries take the time from the caller (see EventLoop::getNow_ns()),
+ * so none of them make syscalls.
+ */
 class DebouncedButton {
 	public:
 		DebouncedButton(uint8_t pin);
-		bool isPressed();
-		bool wasClicked();
-		double getHoldTime_s();
+
+		/*
+		 * Use an existing single input line, which must not have been set up yet
+		 */
+		DebouncedButton(GPIOLines *line);
+
+		~DebouncedButton();
+
+		/*
+		 * Descriptor to poll for getEventMask(); call handleEdges() when it is ready
+		 */
+		int getEventFd() const;
+		uint32_t getEventMask() const;
+		void handleEdges();
+
+		bool isPressed(uint64_t now_ns) const;
+		bool wasClicked(uint64_t now_ns);
+
+		/*
+		 * Time the button has been held down, or 0 if it is released
+		 */
+		uint64_t getHoldTime_ns(uint64_t now_ns) const;
+
+		/*
+		 * Time at which the current press began, or 0 if the button is released
+		 */
+		uint64_t getPressTime_ns() const;
+
+		/*
+		 * Time at which a press being debounced will be reported by isPressed(), or 0 if none is pending
+		 */
+		uint64_t getDebounceDeadline_ns() const;
 
 	private:
-		DigitalInputPin buttonPin;
-		bool prevValue = 0;
-		Timer debounceTimer;
-		bool timerWasSet = 0;
+		static const uint64_t DEBOUNCE_TIME_NS = 20000000;
+
+		GPIOLines *line;
+		bool ownsLine = 0;
+
+		// Zero when the kernel already debounces the line
+		uint64_t debounceTime_ns = DEBOUNCE_TIME_NS;
+
+		bool rawValue = 0;
+		uint64_t pressStart_ns = 0;
 		bool wasPressed = 0;
+
+		void setupLine();
 };
 
 #endif
-
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 
 #include "GPIOPin.h"
+#include "Log.h"
 
 class DigitalInputPin : public GPIOPin {
 	public:
@@ -12,6 +13,14 @@ class DigitalInputPin : public GPIOPin {
 
 		bool setup() override;
 		bool readValue(bool *out);
+
+		/*
+		 * Select which edges ("none", "rising", "falling" or "both") make the value file
+		 * report POLLPRI. Must be called after setup().
+		 */
+		bool setEdge(const char *edge);
+
+		int getValueDesc() const;
 };
 
 #endif
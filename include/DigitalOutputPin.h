@@ -2,6 +2,7 @@
 #define DIGITAL_OUTPUT_PIN_H
 
 #include "GPIOPin.h"
+#include "Log.h"
 
 class DigitalOutputPin : public GPIOPin {
 	public:
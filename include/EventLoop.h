@@ -0,0 +1,88 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Metrics.h"
+#include "Timer.h"
+#include "TimerWheel.h"
+#include "DeadlineTimer.h"
+#include "Log.h"
+
+/*
+ * epoll reactor: callbacks registered for file descriptors, and timers scheduled on its wheel,
+ * run on the thread calling wait(). The clock is read once per wakeup; callbacks take the
+ * time from getNow_ns(). One timerfd, armed for the wheel's earliest deadline, wakes the loop
+ * for all timers.
+ */
+class EventLoop {
+	public:
+		typedef void (*Callback)(void *context, uint32_t events);
+
+		static const uint8_t MAX_HANDLERS = 16;
+
+		EventLoop();
+		~EventLoop();
+
+		/*
+		 * Create the epoll instance and the wheel's timerfd, which takes one handler slot
+		 */
+		bool setup();
+
+		/*
+		 * Call callback(context, events) whenever fd reports any of the given epoll events
+		 */
+		bool addFd(int fd, uint32_t events, Callback callback, void *context);
+		bool removeFd(int fd);
+
+		/*
+		 * Sleep until at least one registered descriptor is ready (or timeout_ms passes, -1 = forever)
+		 * and run its callbacks, returning the number of callbacks run or -1 on error
+		 */
+		int wait(int timeout_ms);
+
+		/*
+		 * Time the current wakeup began (or setup() ran, before the first wakeup)
+		 */
+		uint64_t getNow_ns() const;
+
+		/*
+		 * Timers fire from wait() at their deadline; those scheduled between calls are picked
+		 * up when wait() is next called
+		 */
+		TimerWheel *getTimers();
+
+		/*
+		 * Record the time spent running callbacks after each wakeup
+		 */
+		void setIterationHistogram(MetricHistogram *histogram);
+
+		/*
+		 * Record how late each timer fires after its deadline
+		 */
+		void setTimerLatenessHistogram(MetricHistogram *histogram);
+
+	private:
+		struct Handler {
+			int fd = -1;
+			Callback callback = nullptr;
+			void *context = nullptr;
+		};
+
+		int epollDesc = -1;
+		Handler handlers[MAX_HANDLERS];
+		MetricHistogram *iterationHistogram = nullptr;
+
+		uint64_t now_ns = 0;
+		TimerWheel timers;
+		DeadlineTimer wheelTimer;
+
+		static void onWheelTimer(void *context, uint32_t events);
+		void armWheelTimer();
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef EVENT_NOTIFIER_H
+#define EVENT_NOTIFIER_H
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * eventfd used by one thread to wake another that is waiting in an EventLoop
+ */
+class EventNotifier {
+	public:
+		EventNotifier();
+		~EventNotifier();
+
+		bool setup();
+
+		/*
+		 * Wake the waiting thread; safe to call from any thread and never blocks
+		 */
+		void notify();
+
+		/*
+		 * Reset the notifier after waking, returning the number of notifications since the last drain
+		 */
+		uint64_t drain();
+
+		int getFd() const;
+
+	private:
+		int eventDesc = -1;
+};
+
+#endif
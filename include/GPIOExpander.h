@@ -5,12 +5,13 @@
 #include <stdio.h>
 
 #include "I2CDevice.h"
+#include "Log.h"
 
 class GPIOExpander : public I2CDevice {
 	public:
 		enum class Port {A, B};
 
-		GPIOExpander(int i2cFile);
+		GPIOExpander(I2CBus *bus, uint8_t addr);
 		GPIOExpander();
 
 		/*
@@ -18,6 +19,12 @@ class GPIOExpander : public I2CDevice {
 		 */
 		bool pinMode(Port port, uint8_t configuration);
 
+		/*
+		 * Set direction of the pins on both ports, clearing every output with one write to the
+		 * port registers before the pins are switched to outputs
+		 */
+		bool pinModes(uint8_t configurationA, uint8_t configurationB);
+
 		/*
 		 * Write state to specified pin
 		 */
@@ -28,15 +35,39 @@ class GPIOExpander : public I2CDevice {
 		 */
 		bool writePins(Port port, uint8_t states);
 
+		/*
+		 * Write states to all pins on both ports with one sequential register write
+		 */
+		bool writePorts(uint8_t statesA, uint8_t statesB);
+
+		/*
+		 * Same as writePorts(), but appended to a transaction instead of written immediately.
+		 * The cached pin states are updated right away, assuming the transaction succeeds.
+		 */
+		bool stagePorts(I2CTransaction *transaction, uint8_t statesA, uint8_t statesB);
+
 		bool readPin(Port port, uint8_t pinNum, bool *state);
 		bool readPins(Port port, uint8_t *states);
 
+		/*
+		 * Last states written to the specified port
+		 */
+		uint8_t getPinValues(Port port) const;
+
+		/*
+		 * Return states with the bit at position pinNum set to state
+		 */
+		static uint8_t setPinValue(uint8_t states, uint8_t pinNum, bool state);
+
 	protected:
 		static const uint8_t NUM_PORTS = 2;
 		static const uint8_t PINS_PER_PORT = 8;
 
+		// Registers with IOCON.BANK = 0, where port B follows port A
+		static const uint8_t IODIRA = 0x00;
+		static const uint8_t GPIOA = 0x12;
+
 		uint8_t pinValues[NUM_PORTS] = {0b00000000, 0b00000000};
 };
 
 #endif
-
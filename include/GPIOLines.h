@@ -0,0 +1,73 @@
+#ifndef GPIO_LINES_H
+#define GPIO_LINES_H
+
+#include <sys/epoll.h>
+#include <stdint.h>
+
+/*
+ * A group of GPIO lines of the same direction that are driven together.
+ * Bit i of every mask and value refers to the i-th line passed to the constructor.
+ */
+class GPIOLines {
+	public:
+		static const uint8_t MAX_LINES = 32;
+
+		virtual ~GPIOLines();
+
+		virtual bool setup() = 0;
+
+		/*
+		 * Set lines selected by mask to the corresponding bits of values
+		 */
+		virtual bool setValues(uint32_t mask, uint32_t values) = 0;
+
+		/*
+		 * Read lines selected by mask into the corresponding bits of values
+		 */
+		virtual bool getValues(uint32_t mask, uint32_t *values) = 0;
+
+		virtual bool closeLines() = 0;
+
+		/*
+		 * Report rising and falling edges of input lines through getEventFd() and readEdge().
+		 * Must be called before setup(). A nonzero debounce period is applied by the kernel
+		 * where the backend supports it.
+		 */
+		void enableEdgeEvents(uint32_t debouncePeriod_us);
+
+		/*
+		 * Descriptor that reports getEventMask() to epoll while an edge is pending, or -1
+		 */
+		virtual int getEventFd() const;
+
+		/*
+		 * Epoll events that signal a pending edge on getEventFd(); EPOLLIN unless the backend
+		 * reports edges otherwise
+		 */
+		virtual uint32_t getEventMask() const;
+
+		/*
+		 * Read one pending edge as the line index, its new value and the edge time (see Timer::now_ns()).
+		 * Returns false once no edge is pending.
+		 */
+		virtual bool readEdge(uint8_t *line, bool *value, uint64_t *timestamp_ns);
+
+		/*
+		 * Whether reported edges have already been debounced by the kernel
+		 */
+		virtual bool hasKernelDebounce() const;
+
+		uint8_t getNumLines() const;
+
+	protected:
+		uint8_t pinNums[MAX_LINES] = {0};
+		uint8_t numLines = 0;
+		bool isOutput = 0;
+
+		bool edgeEvents = 0;
+		uint32_t debouncePeriod_us = 0;
+
+		GPIOLines(const uint8_t *pinNums, uint8_t numLines, bool isOutput);
+};
+
+#endif
@@ -7,26 +7,45 @@
 #include <stdint.h>
 #include <fcntl.h>
 
+/*
+ * Line of the legacy /sys/class/gpio interface. Lines are left exported when closed, and a line
+ * that is already exported and configured is reused as it is, so a restart does not wait for the
+ * kernel and udev to recreate its files.
+ */
 class GPIOPin {
 	public:
 		virtual bool setup() = 0;
 
-		~GPIOPin();
+		virtual ~GPIOPin();
 
+		/*
+		 * Close the value file, leaving the line exported
+		 */
 		virtual bool closePin();
 
 	protected:
 		uint8_t pinNum;
-		char pinNumStr[3] = {0};
+		char pinNumStr[4] = {0};
+
+		// Value file is opened once in setup() and kept open until closePin()
+		int valueDesc = -1;
 
 		GPIOPin(uint8_t pinNum);
 		GPIOPin();
 		
+		/*
+		 * Export the line unless it already is
+		 */
 		bool exportPin();
 		bool setDirection(char direction[]);
-		bool openPin(int *valueDesc, uint8_t accessType);
+
+		/*
+		 * Write value to an attribute file of the line (e.g. direction) unless it already holds it
+		 */
+		bool setAttribute(const char *attribute, const char *value);
+		bool openPin(uint8_t accessType);
+		void closeValueDesc();
 		bool unexportPin(bool displayErrors);
 };
 
 #endif
-
@@ -0,0 +1,80 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Log.h"
+
+/*
+ * Batch of I2C messages submitted to the bus with a single I2C_RDWR ioctl.
+ * Messages are sent back to back with repeated starts, in the order they were added.
+ */
+class I2CTransaction {
+	public:
+		static const uint8_t MAX_MESSAGES = 16;
+		static const uint16_t BUFFER_SIZE = 256;
+
+		I2CTransaction();
+
+		void clear();
+
+		/*
+		 * Append a write of length bytes to the slave at addr, copying the data
+		 */
+		bool addWrite(uint8_t addr, const uint8_t *data, uint16_t length);
+
+		uint8_t getNumMessages() const;
+
+	private:
+		friend class I2CBus;
+
+		struct i2c_msg messages[MAX_MESSAGES];
+		uint8_t numMessages = 0;
+		uint8_t buffer[BUFFER_SIZE];
+		uint16_t bufferUsed = 0;
+};
+
+/*
+ * I2C bus device (e.g. /dev/i2c-1) that remembers the selected slave address,
+ * so repeated accesses to the same device skip the I2C_SLAVE ioctl.
+ * Subclasses may override the bus operations to talk to something other than the kernel.
+ */
+class I2CBus {
+	public:
+		I2CBus(int i2cFile);
+		virtual ~I2CBus();
+
+		/*
+		 * Select the slave for subsequent write() and read() calls
+		 */
+		virtual bool selectAddress(uint8_t addr);
+
+		virtual bool write(uint8_t addr, const uint8_t *data, size_t length);
+		virtual bool read(uint8_t addr, uint8_t *data, size_t length);
+
+		/*
+		 * Send every message of the transaction in one ioctl
+		 */
+		virtual bool transfer(I2CTransaction *transaction);
+
+		int getFile() const;
+
+	protected:
+		static const int NO_ADDRESS = -1;
+
+		int i2cFile;
+		int selectedAddr = NO_ADDRESS;
+
+		/*
+		 * Messages of a transaction, for subclasses that handle them without the kernel
+		 */
+		static const struct i2c_msg *getMessages(const I2CTransaction *transaction);
+};
+
+#endif
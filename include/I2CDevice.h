@@ -1,25 +1,29 @@
 #ifndef I2C_DEVICE_H
 #define I2C_DEVICE_H
 
-#include <linux/i2c-dev.h>
 #include <stdint.h>
 #include <stdio.h>
 
-#include <sys/ioctl.h>
+#include "I2CBus.h"
 
 class I2CDevice {
 	public:
-		I2CDevice(int i2cFile);
+		I2CDevice(I2CBus *bus, uint8_t addr);
 		I2CDevice();
 
 		/*
-		 * Initialize communications with the I2C slave of given address
+		 * Initialize communications with the I2C slave; a no-op if it is already selected
 		 */
-		bool open(uint8_t addr);
+		bool open();
+
+		uint8_t getAddress() const;
 
 	protected:
-		int i2cFile = -1;
+		I2CBus *bus = nullptr;
+		uint8_t addr = 0;
+
+		bool writeBytes(const uint8_t *data, size_t length);
+		bool readBytes(uint8_t *data, size_t length);
 };
 
 #endif
-
@@ -4,14 +4,37 @@
 #include <unistd.h>
 #include <stdint.h>
 
-#include "DigitalOutputPin.h"
+#include "GPIOLines.h"
+#include "SysfsGPIOLines.h"
 #include "Timer.h"
 
 class LCD {
 	public:
+		// Line order expected of a GPIOLines group passed to the LCD
+		struct Line {
+			static const uint8_t E = 0;
+			static const uint8_t RS = 1;
+			static const uint8_t DB4 = 2;
+			static const uint8_t DB5 = 3;
+			static const uint8_t DB6 = 4;
+			static const uint8_t DB7 = 5;
+			static const uint8_t NUM_LINES = 6;
+		};
+
 		LCD(uint8_t ePin, uint8_t rsPin, uint8_t db4Pin, uint8_t db5Pin, uint8_t db6Pin, uint8_t db7Pin);
 
-		void setup();
+		/*
+		 * Drive the LCD through an existing output line group ordered as in LCD::Line
+		 */
+		LCD(GPIOLines *lines);
+
+		~LCD();
+
+		/*
+		 * Set up the lines and initialize the panel by instruction. A warm setup is for a panel
+		 * that has stayed powered since it was last set up, and skips the power-on wait.
+		 */
+		void setup(bool warm = false);
 		void setDisplayOn(bool on);
 		void clear();
 		void returnHome();
@@ -20,11 +43,12 @@ class LCD {
 		void writeStr(const char *str);
 
 	private:
-		DigitalOutputPin ePin, rsPin, db4Pin, db5Pin, db6Pin, db7Pin;
+		GPIOLines *lines;
+		bool ownsLines = 0;
 
+		void setRS(bool rs);
 		void pulseEnable();
 		void writeData(bool db7, bool db6, bool db5, bool db4);
 };
 
 #endif
-
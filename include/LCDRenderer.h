@@ -0,0 +1,76 @@
+#ifndef LCD_RENDERER_H
+#define LCD_RENDERER_H
+
+#include <pthread.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+#include "LCD.h"
+#include "RealTime.h"
+
+/*
+ * Shadow framebuffer for the 2x16 LCD. Writers only touch memory; a background thread diffs
+ * the framebuffer against what the panel shows and sends just the changed cells.
+ */
+class LCDRenderer {
+	public:
+		static const uint8_t ROWS = 2;
+		static const uint8_t COLS = 16;
+
+		/*
+		 * At most maxCellsPerRefresh cells are sent to the panel every refreshPeriod_us
+		 */
+		LCDRenderer(LCD *lcd, uint32_t refreshPeriod_us = 10000, uint8_t maxCellsPerRefresh = ROWS * COLS);
+		~LCDRenderer();
+
+		/*
+		 * Start the renderer thread, which clears the panel before rendering. With setupLCD the
+		 * thread first sets up the LCD (see LCD::setup), so the caller does not wait on it;
+		 * the framebuffer may be written meanwhile.
+		 */
+		bool start(bool setupLCD = false, bool warmLCD = false);
+
+		/*
+		 * Flush pending cells and stop the renderer thread, after which the LCD may be used directly
+		 */
+		void stop();
+
+		void setChar(uint8_t row, uint8_t col, char character);
+		void writeStr(uint8_t row, uint8_t col, const char *str);
+		void clear();
+
+		void setRefreshBudget(uint32_t refreshPeriod_us, uint8_t maxCellsPerRefresh);
+
+		/*
+		 * Priority and core of the renderer thread; must be called before start()
+		 */
+		void setSchedule(const ThreadSchedule &schedule);
+
+	private:
+		LCD *lcd;
+		std::atomic<uint32_t> refreshPeriod_us;
+		std::atomic<uint8_t> maxCellsPerRefresh;
+
+		std::atomic<char> frame[ROWS][COLS];
+		char shown[ROWS][COLS];
+
+		// Panel cursor position; cursorCol may run past the last visible column
+		uint8_t cursorRow = 0;
+		uint8_t cursorCol = 0;
+
+		RealTimeThread renderThread;
+		std::atomic<bool> running;
+		bool setupLCD = 0;
+		bool warmLCD = 0;
+
+		static void *renderLoop(void *arg);
+
+		/*
+		 * Send up to maxCells changed cells, returning the number sent
+		 */
+		uint8_t render(uint8_t maxCells);
+};
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#include "EventNotifier.h"
+#include "RealTime.h"
+#include "Timer.h"
+
+/*
+ * Logging that keeps formatting and output off the calling thread. A call stores a fixed-size
+ * record (time, level, format and up to MAX_ARGS arguments) in a ring owned by the calling
+ * thread; the log thread collects the records of all threads every FLUSH_INTERVAL_MS and
+ * writes them to stdout in time order. Logging never makes a syscall, takes a lock or
+ * allocates: a full ring drops the record and counts it.
+ *
+ * The format is a printf format that must outlive the log thread (a string literal), and so
+ * must every string argument. Before start() and after stop(), records are written at once.
+ */
+namespace Log {
+	enum Level : uint8_t {
+		DEBUG,
+		INFO,
+		WARNING,
+		ERROR,
+		NUM_LEVELS
+	};
+
+	static const uint8_t MAX_ARGS = 4;
+	static const uint8_t MAX_THREADS = 16;
+	static const size_t RING_CAPACITY = 256;  // Records per thread, must be a power of two
+	static const uint32_t FLUSH_INTERVAL_MS = 10;
+	static const size_t LINE_SIZE = 256;
+
+	struct Arg {
+		enum class Type : uint8_t {
+			INT,
+			UINT,
+			DOUBLE,
+			STRING
+		};
+
+		Type type = Type::INT;
+		union {
+			int64_t i;
+			uint64_t u;
+			double d;
+			const char *s;
+		};
+
+		Arg() : i(0) {}
+		Arg(int value) : type(Type::INT), i(value) {}
+		Arg(long value) : type(Type::INT), i(value) {}
+		Arg(long long value) : type(Type::INT), i(value) {}
+		Arg(unsigned value) : type(Type::UINT), u(value) {}
+		Arg(unsigned long value) : type(Type::UINT), u(value) {}
+		Arg(unsigned long long value) : type(Type::UINT), u(value) {}
+		Arg(double value) : type(Type::DOUBLE), d(value) {}
+		Arg(const char *value) : type(Type::STRING), s(value) {}
+	};
+
+	// One cache line per record
+	struct alignas(64) Record {
+		uint64_t timestamp_ns;
+		const char *format;
+		Arg args[MAX_ARGS];
+		Level level;
+		uint8_t numArgs;
+	};
+
+	struct Stats {
+		uint64_t records = 0;  // Written by the log thread or at once
+		uint64_t dropped = 0;  // Lost to full rings or with no ring left to claim
+		uint8_t threads = 0;   // Rings claimed
+	};
+
+	/*
+	 * Start the log thread. Threads that log claim a ring the first time they do. The thread
+	 * is stopped, and what is left written, when the process exits.
+	 */
+	bool start();
+
+	/*
+	 * Write what is left in the rings and stop the log thread
+	 */
+	void stop();
+
+	void setLevel(Level level);
+	Level getLevel();
+
+	/*
+	 * Level from its name (debug, info, warning or error)
+	 */
+	bool parseLevel(const char *name, Level *level);
+
+	void getStats(Stats *stats);
+
+	/*
+	 * Store a record unless level is filtered out
+	 */
+	void record(Level level, const char *format, const Arg *args, uint8_t numArgs);
+
+	/*
+	 * Format a record into line as text ending in a newline, returning its length. The time
+	 * is given in seconds since start_ns, or left out if start_ns is 0.
+	 */
+	size_t format(const Record &record, uint64_t start_ns, char *line, size_t size);
+
+	bool isEnabled(Level level);
+
+	template <typename... Args>
+	void write(Level level, const char *format, Args... args) {
+		static_assert(sizeof...(Args) <= MAX_ARGS, "Too many log arguments");
+		if (!isEnabled(level)) {
+			return;
+		}
+		const Arg argArray[sizeof...(Args) + 1] = {Arg(args)...};
+		record(level, format, argArray, sizeof...(Args));
+	}
+
+	template <typename... Args>
+	void debug(const char *format, Args... args) {
+		write(DEBUG, format, args...);
+	}
+
+	template <typename... Args>
+	void info(const char *format, Args... args) {
+		write(INFO, format, args...);
+	}
+
+	template <typename... Args>
+	void warning(const char *format, Args... args) {
+		write(WARNING, format, args...);
+	}
+
+	template <typename... Args>
+	void error(const char *format, Args... args) {
+		write(ERROR, format, args...);
+	}
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef MIDI_BYTE_SOURCE_H
+#define MIDI_BYTE_SOURCE_H
+
+#include <poll.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * MIDI byte stream that is waited on with poll() and read without blocking
+ */
+class MIDIByteSource {
+	public:
+		virtual ~MIDIByteSource();
+
+		virtual bool open() = 0;
+		virtual void close() = 0;
+		virtual bool isOpen() const = 0;
+
+		/*
+		 * Fill fds with the descriptors to poll for input, returning how many were written
+		 */
+		virtual int getPollDescriptors(struct pollfd *fds, int space) = 0;
+
+		/*
+		 * Poll events (POLLIN, POLLERR, ...) the source reports after poll() returned on fds
+		 */
+		virtual unsigned short getPollEvents(struct pollfd *fds, int count) = 0;
+
+		/*
+		 * Read up to length bytes, returning the number read, 0 if none were available,
+		 * or -1 if the source failed and must be reopened
+		 */
+		virtual ssize_t read(uint8_t *buffer, size_t length) = 0;
+
+		/*
+		 * CLOCK_MONOTONIC time the bytes returned by the last read() arrived, or 0 if the source
+		 * does not timestamp its input and the time of the read should be used
+		 */
+		virtual uint64_t getReadTimestamp_ns() const;
+
+		/*
+		 * Whether input is waiting that poll() would not report, e.g. because the source has
+		 * already buffered it in user space, so a short read does not mean the source is drained
+		 */
+		virtual bool hasPendingInput();
+
+		/*
+		 * Switch the open source to reads that wait for input, returning false if it cannot.
+		 * A blocking read must return 0 when interrupted by a signal.
+		 */
+		virtual bool setBlocking(bool blocking);
+
+		virtual const char *getName() const = 0;
+};
+
+#endif
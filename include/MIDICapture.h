@@ -0,0 +1,123 @@
+#ifndef MIDI_CAPTURE_H
+#define MIDI_CAPTURE_H
+
+#include <poll.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#include "EventNotifier.h"
+#include "RealTime.h"
+#include "Timer.h"
+
+/*
+ * Binary log of every byte read from the MIDI ports, with the time each read arrived, for
+ * replaying later (see ReplayMIDISource). The reader encodes each read into a byte ring, which
+ * a writer thread empties to the file every FLUSH_INTERVAL_MS; the reader never makes a
+ * syscall or waits, and a read that does not fit in the ring is dropped and counted.
+ *
+ * The file starts with a Header, followed by one record per read:
+ *   varint   ns since the previous record (the first since Header::start_ns)
+ *   uint8    port, an index into Header::portNames
+ *   varint   number of bytes
+ *   bytes
+ * Varints are little-endian base 128, 7 bits per byte with the top bit set on all but the last.
+ * Times are CLOCK_MONOTONIC, and a dropped read still counts towards the next record's time.
+ */
+class MIDICapture {
+	public:
+		static const uint32_t MAGIC = 0x434d5953;  // "SYMC"
+		static const uint16_t VERSION = 1;
+		static const uint8_t MAX_PORTS = 8;
+		static const size_t PORT_NAME_SIZE = 32;
+		static const size_t RING_CAPACITY = 1 << 20;  // Bytes, must be a power of two
+		static const uint32_t FLUSH_INTERVAL_MS = 20;
+		static const size_t MAX_VARINT_SIZE = 10;
+
+		struct Header {
+			uint32_t magic;
+			uint16_t version;
+			uint8_t numPorts;
+			uint8_t reserved;
+			uint64_t start_ns;
+			char portNames[MAX_PORTS][PORT_NAME_SIZE];
+		};
+
+		struct Stats {
+			uint64_t records = 0;      // Reads logged
+			uint64_t bytes = 0;        // MIDI bytes logged
+			uint64_t dropped = 0;      // Reads lost because the ring was full
+			uint64_t fileBytes = 0;    // Written to the file
+			uint64_t writeErrors = 0;
+		};
+
+		MIDICapture();
+		~MIDICapture();
+
+		/*
+		 * Create path, write the header naming the ports, and start the writer thread
+		 */
+		bool start(const char *path, const char *const *portNames, uint8_t numPorts);
+
+		/*
+		 * Write what is left in the ring, close the file and stop the writer thread
+		 */
+		void stop();
+
+		/*
+		 * Log the bytes of one read from port. Must only be called from one thread, the reader.
+		 */
+		void record(uint8_t port, uint64_t timestamp_ns, const uint8_t *bytes, size_t length);
+
+		void getStats(Stats *stats) const;
+
+		/*
+		 * Encode value into out, returning the number of bytes written (at most MAX_VARINT_SIZE)
+		 */
+		static size_t encodeVarint(uint64_t value, uint8_t *out);
+
+		/*
+		 * Decode a value starting at data[*pos], advancing *pos past it. Returns false if the
+		 * varint runs past size or is too long.
+		 */
+		static bool decodeVarint(const uint8_t *data, size_t size, size_t *pos, uint64_t *value);
+
+	private:
+		static const size_t INDEX_MASK = RING_CAPACITY - 1;
+		static const size_t CACHE_LINE_SIZE = 64;
+
+		FILE *file = nullptr;
+		RealTimeThread writerThread;
+		EventNotifier stopNotifier;
+		std::atomic<bool> running;
+
+		// Reader-owned
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> head;
+		size_t cachedTail = 0;
+		uint64_t lastTimestamp_ns = 0;
+		std::atomic<uint64_t> records;
+		std::atomic<uint64_t> bytes;
+		std::atomic<uint64_t> dropped;
+
+		// Writer-owned
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail;
+		std::atomic<uint64_t> fileBytes;
+		std::atomic<uint64_t> writeErrors;
+
+		uint8_t *ring = nullptr;
+
+		static void *writeLoop(void *arg);
+
+		/*
+		 * Write everything in the ring to the file
+		 */
+		void drain();
+
+		void copyIn(size_t position, const uint8_t *data, size_t length);
+
+		static void increment(std::atomic<uint64_t> *counter, uint64_t amount = 1);
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef MIDI_DISPATCHER_H
+#define MIDI_DISPATCHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "MIDIEvent.h"
+#include "MIDIEventRing.h"
+#include "OutputManager.h"
+#include "Metrics.h"
+#include "Timer.h"
+#include "Log.h"
+
+/*
+ * Turns MIDI channel voice messages into OutputManager calls
+ */
+class MIDIDispatcher {
+	public:
+		// Events per output batch, so a long drain never holds an update open on the workers
+		static const size_t MAX_BATCH_EVENTS = 32;
+
+		MIDIDispatcher(OutputManager *outManager);
+
+		/*
+		 * Log every dispatched message through Log at info level, so -L warning silences them
+		 */
+		void setVerbose(bool verbose);
+
+		/*
+		 * Record queue depth and per-event dispatch time
+		 */
+		void setMetrics(Metrics *metrics);
+
+		/*
+		 * Dispatch every event waiting in the queue in output batches of up to MAX_BATCH_EVENTS,
+		 * returning the number dispatched
+		 */
+		size_t dispatchAll(MIDIEventRing *queue);
+
+		void dispatch(const MIDIEvent &event);
+
+	private:
+		OutputManager *outManager;
+		bool verbose = 0;
+		Metrics *metrics = nullptr;
+};
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef MIDI_EVENT_H
+#define MIDI_EVENT_H
+
+#include <stdint.h>
+
+struct MIDIEvent {
+	static const uint8_t MAX_LENGTH = 3;
+
+	uint64_t timestamp_ns = 0;  // CLOCK_MONOTONIC time the last byte was read
+	uint8_t data[MAX_LENGTH] = {0};
+	uint8_t length = 0;  // 1 to 3: the status byte and its data bytes
+};
+
+#endif
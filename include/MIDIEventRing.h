@@ -0,0 +1,58 @@
+#ifndef MIDI_EVENT_RING_H
+#define MIDI_EVENT_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sched.h>
+#include <atomic>
+
+#include "MIDIEvent.h"
+
+/*
+ * Fixed-capacity single-producer/single-consumer ring of MIDI events.
+ * push() may only be called from one thread and pop() from one other thread.
+ * No memory is allocated after construction.
+ */
+class MIDIEventRing {
+	public:
+		static const size_t CAPACITY = 1024;  // Must be a power of two
+		static const size_t CACHE_LINE_SIZE = 64;
+
+		enum class OverflowPolicy {
+			DROP_NEWEST,  // Discard the event being pushed and count it
+			WAIT          // Yield until the consumer frees a slot
+		};
+
+		MIDIEventRing(OverflowPolicy policy = OverflowPolicy::DROP_NEWEST);
+
+		/*
+		 * Add an event, returning false if it was dropped because the ring was full
+		 */
+		bool push(const MIDIEvent &event);
+
+		/*
+		 * Remove the oldest event, returning false if the ring was empty
+		 */
+		bool pop(MIDIEvent *event);
+
+		size_t getLength() const;
+		uint64_t getOverflowCount() const;
+
+	private:
+		static const size_t INDEX_MASK = CAPACITY - 1;
+
+		const OverflowPolicy policy;
+
+		// Producer-owned
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> head;
+		size_t cachedTail = 0;
+		std::atomic<uint64_t> overflowCount;
+
+		// Consumer-owned
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail;
+		size_t cachedHead = 0;
+
+		alignas(CACHE_LINE_SIZE) MIDIEvent events[CAPACITY];
+};
+
+#endif
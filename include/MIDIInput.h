@@ -0,0 +1,163 @@
+#ifndef MIDI_INPUT_H
+#define MIDI_INPUT_H
+
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+#include "MIDIByteSource.h"
+#include "MIDIParser.h"
+#include "MIDIEventRing.h"
+#include "EventNotifier.h"
+#include "Metrics.h"
+#include "MIDICapture.h"
+#include "RealTime.h"
+#include "Timer.h"
+#include "Log.h"
+
+/*
+ * Reader thread that sleeps in one poll() on every source until any has input, drains each
+ * ready source with bulk reads through its own parser, and queues the events of the wakeup
+ * merged in timestamp order. A source that fails is closed and reopened on its own
+ * exponential backoff while the others keep being read. A single source that supports it is
+ * read with one blocking read per wakeup instead, since bytes arriving one at a time (DIN)
+ * would otherwise cost a poll() each; stop() cancels the thread out of that read.
+ */
+class MIDIInput {
+	public:
+		static const uint8_t MAX_SOURCES = 8;
+		static const size_t BUFFER_SIZE = 256;
+		static const size_t MERGE_CAPACITY = 512;  // Events held for merging before they are queued
+		static const uint8_t MAX_DESCRIPTORS = 8;  // Per source
+		static const uint32_t MIN_BACKOFF_MS = 10;
+		static const uint32_t MAX_BACKOFF_MS = 2000;
+
+		struct Stats {
+			uint64_t polls = 0;       // poll() calls
+			uint64_t reads = 0;       // Read calls on the sources
+			uint64_t bytes = 0;
+			uint64_t events = 0;      // Events queued
+			uint64_t dropped = 0;     // Events lost because the queue was full
+			uint64_t notifies = 0;    // Wakeups sent to the dispatch loop
+			uint64_t errors = 0;      // Failed opens and reads
+			uint64_t reconnects = 0;  // Successful opens after the first
+		};
+
+		struct SourceStats {
+			uint64_t bytes = 0;
+			uint64_t events = 0;
+			uint64_t dropped = 0;
+			uint64_t errors = 0;
+			uint64_t reconnects = 0;
+			bool open = 0;
+		};
+
+		MIDIInput(MIDIEventRing *queue, EventNotifier *notifier);
+		~MIDIInput();
+
+		/*
+		 * Must be called before start(). Returns false if MAX_SOURCES are already added.
+		 */
+		bool addSource(MIDIByteSource *source);
+		void setMetrics(Metrics *metrics);
+
+		/*
+		 * Log every read to capture, with the index of its source as the port. Must be called
+		 * before start(), and capture started with the sources' names.
+		 */
+		void setCapture(MIDICapture *capture);
+		void setSchedule(const ThreadSchedule &schedule);
+
+		bool start();
+
+		/*
+		 * Stop the reader thread and close the sources
+		 */
+		void stop();
+
+		uint8_t getNumSources() const;
+		MIDIByteSource *getSource(uint8_t source) const;
+
+		void getStats(Stats *stats) const;
+		void getSourceStats(uint8_t source, SourceStats *stats) const;
+
+	private:
+		struct Source {
+			MIDIByteSource *source = nullptr;
+			Metrics::MIDIPortMetrics *metrics = nullptr;
+			MIDIParser parser;
+
+			// Reader-owned
+			bool opened = 0;           // Opened at least once
+			bool blocking = 0;         // Open and read with blocking reads instead of after poll()
+			uint32_t backoff_ms = MIN_BACKOFF_MS;
+			uint64_t retry_ns = 0;     // Time to try opening again while closed
+			uint8_t firstDescriptor = 0;
+			uint8_t numDescriptors = 0;
+
+			std::atomic<bool> open{false};
+			std::atomic<uint64_t> bytes{0};
+			std::atomic<uint64_t> events{0};
+			std::atomic<uint64_t> dropped{0};
+			std::atomic<uint64_t> errors{0};
+			std::atomic<uint64_t> reconnects{0};
+		};
+
+		struct PendingEvent {
+			MIDIEvent event;
+			uint8_t source;
+		};
+
+		Source sources[MAX_SOURCES];
+		uint8_t numSources = 0;
+		MIDIEventRing *queue;
+		EventNotifier *notifier;
+		Metrics *metrics = nullptr;
+		MIDICapture *capture = nullptr;
+
+		RealTimeThread readerThread;
+		EventNotifier stopNotifier;
+		std::atomic<bool> running;
+
+		uint8_t buffer[BUFFER_SIZE];
+		PendingEvent pending[MERGE_CAPACITY];
+		size_t numPending = 0;
+
+		std::atomic<uint64_t> polls;
+		std::atomic<uint64_t> reads;
+		std::atomic<uint64_t> notifies;
+
+		static void *readLoop(void *arg);
+
+		/*
+		 * Open a closed source if its backoff has passed, returning whether it is open
+		 */
+		bool tryOpen(uint8_t index, uint64_t now_ns);
+
+		/*
+		 * Close a source after a failure and schedule the next attempt to reopen it
+		 */
+		void fail(uint8_t index, uint64_t now_ns);
+
+		/*
+		 * Read once from a source and parse what it returned, returning the number of bytes
+		 * read or -1 if it failed. A blocking read is the only point the thread can be cancelled.
+		 */
+		ssize_t readOnce(uint8_t index);
+
+		/*
+		 * Read and parse everything a source has, returning false if it failed
+		 */
+		bool readAvailable(uint8_t index);
+
+		/*
+		 * Queue the parsed events in timestamp order (ties keep the order they were read in)
+		 * and wake the dispatch loop once
+		 */
+		void flush();
+
+		static void increment(std::atomic<uint64_t> *counter, uint64_t amount = 1);
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef MIDI_PARSER_H
+#define MIDI_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "MIDIEvent.h"
+
+/*
+ * MIDI 1.0 byte stream parser. Channel voice and mode messages (with running status),
+ * system common messages, system exclusive and real-time bytes are all recognised; the
+ * number of data bytes each status takes comes from a lookup table. No memory is allocated.
+ *
+ * Events carry the status byte and its data bytes. Real-time bytes may arrive in the middle
+ * of any other message and are returned on their own without disturbing it. A SysEx message
+ * ended by 0xF7 is returned as a one-byte 0xF0 event whose data is read with getSysEx();
+ * one cut short by another status byte is dropped.
+ */
+class MIDIParser {
+	public:
+		static const size_t SYSEX_CAPACITY = 128;
+
+		struct Stats {
+			uint64_t messages = 0;       // Events returned, including real-time and SysEx
+			uint64_t sysEx = 0;          // SysEx messages returned
+			uint64_t strayBytes = 0;     // Data bytes with no status to belong to
+			uint64_t interrupted = 0;    // Messages and SysEx cut short by a new status byte
+			uint64_t sysExOverflow = 0;  // SysEx messages truncated to SYSEX_CAPACITY
+		};
+
+		/*
+		 * Feed one byte, returning true and filling event when it completes a message.
+		 * timestamp_ns is the time the byte was read.
+		 */
+		bool parse(uint8_t byte, uint64_t timestamp_ns, MIDIEvent *event);
+
+		/*
+		 * Forget any partial message and the running status, e.g. after reconnecting
+		 */
+		void reset();
+
+		/*
+		 * Payload (without the 0xF0 and 0xF7) of the SysEx message returned last, valid until
+		 * the next call to parse()
+		 */
+		const uint8_t *getSysEx(size_t *length) const;
+
+		const Stats &getStats() const;
+
+		/*
+		 * Number of data bytes that follow a status byte, or -1 if the status is SysEx or undefined
+		 */
+		static int8_t getDataLength(uint8_t status);
+
+	private:
+		// Data bytes per channel message, by the high nibble of the status
+		static const int8_t CHANNEL_DATA_LENGTHS[8];
+
+		// Data bytes per system message, by the low nibble of the status (0xF0-0xFF)
+		static const int8_t SYSTEM_DATA_LENGTHS[16];
+
+		uint8_t status = 0;        // Status of the message being assembled (the running status for channel messages)
+		uint8_t data[2] = {0};
+		uint8_t dataCount = 0;
+		int8_t dataLength = -1;    // Data bytes the current status takes, -1 if none is active
+
+		bool inSysEx = 0;
+		uint8_t sysEx[SYSEX_CAPACITY];
+		size_t sysExLength = 0;
+		bool sysExOverflowed = 0;
+
+		Stats stats;
+
+		bool finishSysEx(uint64_t timestamp_ns, MIDIEvent *event);
+		bool emit(uint8_t statusByte, uint8_t numData, uint64_t timestamp_ns, MIDIEvent *event);
+};
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+
+#include "Timer.h"
+
+/*
+ * Event count with a single writing thread. Readers in any thread or process see it without
+ * locks, and the writer never issues a locked instruction.
+ */
+class MetricCounter {
+	public:
+		MetricCounter();
+
+		void add(uint64_t amount = 1);
+		uint64_t get() const;
+
+	private:
+		std::atomic<uint64_t> value;
+};
+
+/*
+ * Log-linear histogram with a single writing thread and lock-free readers. Values below
+ * SUB_BUCKETS get a bucket each; larger values fall into one of SUB_BUCKETS equal buckets per
+ * power of two, so a bucket is never more than 12.5% wide.
+ */
+class MetricHistogram {
+	public:
+		static const uint8_t SUB_BUCKET_BITS = 3;
+		static const uint8_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+		static const uint16_t NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+		MetricHistogram();
+
+		void record(uint64_t value);
+
+		/*
+		 * Add the values recorded by another histogram, e.g. to total those of several threads
+		 */
+		void merge(const MetricHistogram &other);
+
+		uint64_t getCount() const;
+		uint64_t getSum() const;
+		uint64_t getMax() const;
+		uint64_t getBucketCount(uint16_t bucket) const;
+
+		/*
+		 * Lower bound of the bucket holding the value at the given fraction (0 to 1) of the
+		 * recorded values, or 0 if nothing was recorded
+		 */
+		uint64_t percentile(double fraction) const;
+
+		static uint16_t getBucket(uint64_t value);
+		static uint64_t getBucketStart(uint16_t bucket);
+
+	private:
+		std::atomic<uint64_t> count;
+		std::atomic<uint64_t> sum;
+		std::atomic<uint64_t> max;
+		std::atomic<uint64_t> buckets[NUM_BUCKETS];
+};
+
+/*
+ * Hot-path instrumentation of the controller. The layout is shared with external tools
+ * through MetricsSegment, so VERSION must be bumped whenever it changes.
+ * Every metric has exactly one writing thread, noted below.
+ */
+struct Metrics {
+	static const uint32_t MAGIC = 0x53594e54;  // "SYNT"
+	static const uint32_t VERSION = 6;
+	static const uint8_t MAX_BUSES = 8;          // OutputTopology::MAX_BUSES
+	static const uint8_t MAX_I2C_DEVICES = 32;
+	static const uint8_t MAX_TRIGGERS = 64;      // OutputTopology::MAX_OUTPUTS
+	static const uint8_t MAX_MIDI_PORTS = 8;     // MIDIInput::MAX_SOURCES
+	static const uint8_t MIDI_PORT_NAME_SIZE = 32;
+
+	// Written by the MIDI input thread
+	struct MIDIPortMetrics {
+		char name[MIDI_PORT_NAME_SIZE];
+		MetricCounter bytes;
+		MetricCounter events;      // Queued
+		MetricCounter dropped;     // Lost because the queue was full
+		MetricCounter errors;      // Failed opens and reads
+		MetricCounter reconnects;
+	};
+
+	struct I2CDeviceMetrics {
+		std::atomic<uint8_t> bus;
+		std::atomic<uint8_t> addr;
+		MetricHistogram transferTime_ns;  // Share of each I2C_RDWR batch spent on this device
+	};
+
+	// Written by the output worker of the bus
+	struct BusMetrics {
+		MetricCounter batches;
+		MetricCounter bytes;              // Written, address bytes included
+		MetricCounter busy_ns;            // Time spent inside I2C transfers
+		MetricCounter failures;
+		MetricHistogram workerWakeup_ns;  // Time between a commit and the worker picking it up
+		MetricHistogram triggerError_ns;  // Distance of each timed pulse from its configured width
+	};
+
+	std::atomic<uint32_t> magic;  // Set last, once the rest is initialized
+	uint32_t version = VERSION;
+	uint64_t size = sizeof(Metrics);
+	uint64_t start_ns = 0;        // CLOCK_MONOTONIC time the controller started
+	int32_t pid = 0;
+
+	// MIDI input thread, totals over all ports and then each port
+	MetricCounter midiBytesRead;
+	MetricCounter midiEventsQueued;
+	MetricCounter midiEventsDropped;
+	std::atomic<uint8_t> numMIDIPorts;
+	MIDIPortMetrics midiPorts[MAX_MIDI_PORTS];
+
+	// Main loop thread
+	MetricHistogram queueDepth;        // Events waiting at each MIDI wakeup
+	MetricHistogram dispatchTime_ns;   // Time to dispatch one event
+	MetricHistogram eventLatency_ns;   // From an event's read to the start of its dispatch
+	MetricHistogram loopIteration_ns;  // Time spent running callbacks per wakeup
+	MetricHistogram timerLateness_ns;  // Time between a deadline and its callback running
+
+	// Output worker threads, each writing the metrics of its own bus and outputs
+	std::atomic<uint8_t> numBuses;
+	BusMetrics buses[MAX_BUSES];
+	MetricHistogram triggerWidth_ns[MAX_TRIGGERS];  // Time between a trigger's rising and falling edge
+	std::atomic<uint8_t> numI2CDevices;
+	I2CDeviceMetrics i2cDevices[MAX_I2C_DEVICES];
+
+	Metrics();
+
+	/*
+	 * Metrics of a bus, counting it as in use. Returns nullptr for a bus past MAX_BUSES.
+	 * Must be called before the output workers start.
+	 */
+	BusMetrics *getBus(uint8_t bus);
+
+	/*
+	 * Histogram for a device on a bus, claiming a free slot the first time it is seen.
+	 * Returns nullptr if all slots are taken. Must be called before the output workers start.
+	 */
+	MetricHistogram *getI2CDevice(uint8_t bus, uint8_t addr);
+
+	/*
+	 * Metrics of a MIDI input port, claiming the next slot. Returns nullptr if all slots are
+	 * taken. Must be called before the MIDI input thread starts.
+	 */
+	MIDIPortMetrics *addMIDIPort(const char *name);
+
+	/*
+	 * Totals over the buses in use
+	 */
+	uint64_t getI2CFailures() const;
+	void mergeTriggerErrors(MetricHistogram *total) const;
+};
+
+/*
+ * Memory holding the Metrics. The controller creates it as a POSIX shared memory object that
+ * tools map read-only, so scraping never takes a lock or a syscall on the controller's side.
+ */
+class MetricsSegment {
+	public:
+		static constexpr const char *DEFAULT_NAME = "/synth_controller_metrics";
+
+		MetricsSegment();
+		~MetricsSegment();
+
+		/*
+		 * Create the metrics in the shared memory object name, replacing any left by an earlier
+		 * run, or in private memory if name is nullptr
+		 */
+		bool create(const char *name);
+
+		/*
+		 * Map metrics created by another process read-only
+		 */
+		bool open(const char *name);
+
+		Metrics *get();
+		const Metrics *get() const;
+
+	private:
+		Metrics *metrics = nullptr;
+		const char *name = nullptr;
+		bool owner = 0;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef OUTPUT_BANK_H
+#define OUTPUT_BANK_H
+
+#include <stdint.h>
+
+#include "I2CBus.h"
+#include "OutputTopology.h"
+#include "OutputWorker.h"
+#include "Metrics.h"
+#include "RealTime.h"
+
+/*
+ * All outputs of a topology, numbered as in the topology, with one OutputWorker per I2C bus so
+ * the buses are written in parallel. Updates follow the worker's beginUpdate()/commit()
+ * protocol; only the workers whose outputs changed are woken by commit().
+ */
+class OutputBank {
+	public:
+		/*
+		 * buses[i] carries bus i of the topology; the topology and buses must outlive the bank
+		 */
+		OutputBank(const OutputTopology *topology, I2CBus *const *buses);
+		~OutputBank();
+
+		bool start();
+		void stop();
+
+		uint8_t getNumOutputs() const;
+		uint8_t getNumWorkers() const;
+		OutputWorker *getWorker(uint8_t bus);
+
+		void beginUpdate();
+		void setGate(uint8_t output, bool on);
+		void setPitch(uint8_t output, uint16_t dacValue);
+		void startTrigger(uint8_t output);
+		void stopTrigger(uint8_t output);
+		void commit();
+
+		bool setTriggerWidth(uint8_t output, uint64_t width_ns);
+		uint64_t getTriggerWidth(uint8_t output) const;
+
+		/*
+		 * Must be called before start(); every worker thread gets the same schedule
+		 */
+		void setMetrics(Metrics *metrics);
+		void setSchedule(const ThreadSchedule &schedule);
+
+	private:
+		OutputWorker *workers[OutputTopology::MAX_BUSES] = {nullptr};
+		uint8_t numWorkers;
+		uint8_t numOutputs;
+		uint8_t firstOutputs[OutputTopology::MAX_BUSES];
+		uint8_t outputWorkers[OutputTopology::MAX_OUTPUTS];
+		uint8_t updating = 0;   // Workers inside beginUpdate()
+
+		/*
+		 * Worker of an output, begun for the current update
+		 */
+		OutputWorker *getUpdating(uint8_t output);
+};
+
+#endif
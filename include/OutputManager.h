@@ -4,51 +4,81 @@
 #include <stdint.h>
 
 #include "Timer.h"
-#include "DAC.h"
-#include "GPIOExpander.h"
-#include "LCD.h"
+#include "EventLoop.h"
+#include "OutputBank.h"
+#include "VoiceAllocator.h"
+#include "PitchCalibration.h"
+#include "LCDRenderer.h"
 #include "DebouncedButton.h"
+#include "ControllerState.h"
 
 class OutputManager {
 	public:
-		OutputManager(int i2cFile, LCD *lcd, DebouncedButton *outputButton, DebouncedButton *channelButton);
+		/*
+		 * Must be used from the thread running loop, whose cached time the buttons are read at.
+		 * Voices are allocated over every output of the bank.
+		 */
+		OutputManager(OutputBank *bank, EventLoop *loop, LCDRenderer *display, DebouncedButton *outputButton, DebouncedButton *channelButton);
+
+		/*
+		 * Group the output changes of several events (e.g. the notes of a chord) into one update,
+		 * so they reach the hardware together. Calls may not be nested, and a batch should be
+		 * kept short: the workers it touches send nothing until it ends.
+		 */
+		void beginBatch();
+		void endBatch();
 
 		void pressKey(uint8_t noteId, uint8_t channel);
 		void releaseKey(uint8_t noteId, uint8_t channel);
 		void turnOffChannel(uint8_t channel);
 
-		// Below must be called every iteration of main loop
-		void updateTriggers();
+		/*
+		 * Voice allocation policy for every channel
+		 */
+		void setVoicePolicy(VoiceAllocator::Policy policy);
+
+		/*
+		 * Replace the nominal pitch tables from a calibration file (see PitchCalibration)
+		 */
+		bool loadCalibration(const char *path);
+
+		/*
+		 * Take the channel assignments and selected output kept in state, and keep later
+		 * changes made with the front panel in it
+		 */
+		void restoreState(ControllerState *state);
+
+		// Below must be called whenever the front panel buttons are sampled
 		void updateSelectedOutput();
 		void updateChannelAssignments();
 
 	private:
-		struct Output {
-			uint8_t noteId = 0;
-			uint8_t channel = 0;
-
-			bool gateIsOn = 0;
-			Timer gateOnTimer;
+		// The panel shows one page of outputs at a time, and one digit per channel
+		static const uint8_t OUTPUTS_PER_PAGE = 8;
+		static const uint8_t PANEL_CHANNELS = 8;
 
-			bool triggerIsOn = 0;
-			Timer triggerOnTimer;
-		};
+		// Notes, gates and channels are kept by the voice allocator, trigger pulses by the workers
+		uint8_t numOutputs;
+		VoiceAllocator voices;
+		PitchCalibration calibration;
 
-		static const uint8_t DAC_ADDR = 0b1001000;
-		static const uint8_t GPIO_ADDR = 0b0100000;
-		static const uint8_t NUM_OUTPUTS = 8;
+		OutputBank *bank;
+		EventLoop *loop;
 
-		Output outputs[NUM_OUTPUTS];
-		
-		int i2cFile;
-		DAC dac;
-		GPIOExpander gpio;
-
-		LCD *lcd;
+		LCDRenderer *display;
 		DebouncedButton *outputButton;
 		DebouncedButton *channelButton;
 		uint8_t selectedOutput = 0;
+		ControllerState *state = nullptr;
+
+		bool inBatch = 0;
+
+		void beginUpdate();
+		void commitUpdate();
+
+		void applyVoiceChange(const VoiceAllocator::Change &change);
 
+		void lcdShowPage();
 		void lcdDeselectOutput();
 		void lcdSelectOutput();
 		void lcdSetChannel();
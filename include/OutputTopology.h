@@ -0,0 +1,98 @@
+#ifndef OUTPUT_TOPOLOGY_H
+#define OUTPUT_TOPOLOGY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "DAC.h"
+
+/*
+ * Where each output lives: the I2C bus, the DAC channel setting its pitch and the expander
+ * pins carrying its gate and trigger. Outputs are numbered in the order they are described,
+ * and the outputs of one bus are numbered consecutively.
+ *
+ * The description is text with one statement per line; '#' starts a comment:
+ *
+ *   bus /dev/i2c-1
+ *   output 0x48 0 0x20 A0 B0
+ *
+ * "bus <device>" starts a bus, and each following "output <DAC address> <DAC channel>
+ * <expander address> <gate pin> <trigger pin>" adds an output to it. Pins are A0 to A7 and B0
+ * to B7; a DAC address of "-" gives an output without pitch. A device is named by one bus
+ * line only, and a DAC and an expander on the same bus cannot share an address.
+ */
+class OutputTopology {
+	public:
+		static const uint8_t MAX_BUSES = 8;
+		static const uint8_t MAX_OUTPUTS = 64;
+		static const uint8_t MAX_OUTPUTS_PER_BUS = 32;
+		static const uint8_t MAX_DEVICES_PER_BUS = 8;   // Of each kind
+		static const uint8_t NO_DAC = 0xFF;
+		static const uint8_t PINS_PER_EXPANDER = 16;
+		static const size_t MAX_DEVICE_LENGTH = 64;
+
+		// The board the controller was built around
+		static const uint8_t DEFAULT_DAC_ADDR = 0b1001000;
+		static const uint8_t DEFAULT_GPIO_ADDR = 0b0100000;
+		static constexpr const char *DEFAULT_DEVICE = "/dev/i2c-1";
+
+		struct Output {
+			uint8_t bus = 0;
+			uint8_t dacAddr = NO_DAC;
+			uint8_t dacChannel = 0;
+			uint8_t gpioAddr = 0;
+			uint8_t gatePin = 0;     // 0 to 7 on port A, 8 to 15 on port B
+			uint8_t triggerPin = 0;
+		};
+
+		struct Bus {
+			char device[MAX_DEVICE_LENGTH] = {0};
+			uint8_t firstOutput = 0;
+			uint8_t numOutputs = 0;
+		};
+
+		/*
+		 * The default board on DEFAULT_DEVICE: eight outputs with gates on expander port A,
+		 * triggers on port B, and pitches for the first four on the channels of the DAC at
+		 * DEFAULT_DAC_ADDR. A board with more DACs is described in a topology file.
+		 */
+		OutputTopology();
+
+		/*
+		 * Replace the topology with the one described in a file, keeping it if the file is invalid
+		 */
+		bool load(const char *path);
+
+		uint8_t getNumBuses() const;
+		const Bus &getBus(uint8_t bus) const;
+		uint8_t getNumOutputs() const;
+		const Output &getOutput(uint8_t output) const;
+
+		/*
+		 * Distinct DAC and expander addresses on a bus, in order of first use; returns the count
+		 */
+		uint8_t getDACAddresses(uint8_t bus, uint8_t *addrs) const;
+		uint8_t getGPIOAddresses(uint8_t bus, uint8_t *addrs) const;
+
+		void print() const;
+
+	private:
+		static const size_t MAX_LINE_LENGTH = 256;
+
+		Bus buses[MAX_BUSES];
+		Output outputs[MAX_OUTPUTS];
+		uint8_t numBuses = 0;
+		uint8_t numOutputs = 0;
+
+		void clear();
+		bool addBus(const char *device, unsigned lineNumber);
+		bool addOutput(const Output &output, unsigned lineNumber);
+		bool parseLine(char *line, unsigned lineNumber);
+
+		static bool parseAddress(const char *text, uint8_t *addr);
+		static bool parsePin(const char *text, uint8_t *pin);
+};
+
+#endif
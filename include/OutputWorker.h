@@ -0,0 +1,221 @@
+#ifndef OUTPUT_WORKER_H
+#define OUTPUT_WORKER_H
+
+#include <sys/prctl.h>
+#include <pthread.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+#include "I2CBus.h"
+#include "DAC.h"
+#include "GPIOExpander.h"
+#include "EventNotifier.h"
+#include "DeadlineTimer.h"
+#include "Timer.h"
+#include "Metrics.h"
+#include "RealTime.h"
+#include "OutputTopology.h"
+#include "Log.h"
+
+/*
+ * Thread that owns one I2C bus and brings the gate, trigger and pitch outputs of the boards on
+ * it to the state posted by producers. Outputs are numbered from 0 within the bus and mapped
+ * to DAC channels and expander pins by the topology. Each wakeup compares the posted state with
+ * what was last sent and submits the difference for every device as one I2C_RDWR batch, so
+ * changes superseded before the bus was free (e.g. a gate turned on and off again) are never
+ * written. A device that does not answer is left out of the batches for OFFLINE_RETRY_NS at a
+ * time, so it cannot hold back the others.
+ *
+ * Trigger pulses are timed by the worker itself: each one ends its configured width after its
+ * rising edge was sent, independent of the producer's loop. The falling edge is sent early by
+ * the measured time an expander write takes to land, and edges due together go out in one
+ * write.
+ *
+ * Producers call set*() between beginUpdate() and commit() from a single thread; none of
+ * these calls block. The worker sends nothing while an update is open, so updates should be
+ * short.
+ */
+class OutputWorker {
+	public:
+		static const uint8_t MAX_OUTPUTS = OutputTopology::MAX_OUTPUTS_PER_BUS;
+		static const uint64_t DEFAULT_TRIGGER_WIDTH_NS = 1000000;
+		static const uint64_t MAX_TRIGGER_WIDTH_NS = 1000000000;
+		static const uint64_t OFFLINE_RETRY_NS = 1000000000;
+
+		struct Stats {
+			uint64_t commits = 0;         // Updates committed by producers
+			uint64_t batches = 0;         // I2C_RDWR batches sent
+			uint64_t coalesced = 0;       // Commits folded into a later batch
+			uint32_t queueDepth = 0;      // Commits waiting for the next batch
+			uint64_t bytes = 0;           // Bytes written, address bytes included
+			uint64_t busBusy_ns = 0;      // Time spent inside I2C transfers
+			uint64_t elapsed_ns = 0;      // Time since start()
+			double busUtilization = 0;    // busBusy_ns / elapsed_ns
+		};
+
+		/*
+		 * Drive the outputs of one bus of the topology, which must outlive the worker
+		 */
+		OutputWorker(I2CBus *bus, const OutputTopology *topology, uint8_t busIndex);
+		~OutputWorker();
+
+		/*
+		 * Start the worker thread, which first configures the expander outputs and turns everything off
+		 */
+		bool start();
+
+		uint8_t getNumOutputs() const;
+
+		/*
+		 * Send any pending state and stop the worker thread
+		 */
+		void stop();
+
+		void beginUpdate();
+		void setGate(uint8_t output, bool on);
+		void setPitch(uint8_t output, uint16_t dacValue);
+
+		/*
+		 * Start a trigger pulse, or restart the one already on so it lasts another full width
+		 */
+		void startTrigger(uint8_t output);
+
+		/*
+		 * End a trigger pulse before its time
+		 */
+		void stopTrigger(uint8_t output);
+
+		void commit();
+
+		/*
+		 * Width of the trigger pulses of an output, from 1 ns to MAX_TRIGGER_WIDTH_NS. May be
+		 * called from any thread at any time; pulses already on keep their width.
+		 */
+		bool setTriggerWidth(uint8_t output, uint64_t width_ns);
+		uint64_t getTriggerWidth(uint8_t output) const;
+
+		void getStats(Stats *stats) const;
+
+		/*
+		 * Record bus throughput, I2C time per device, failed batches and achieved trigger
+		 * widths. Must be called before start().
+		 */
+		void setMetrics(Metrics *metrics);
+
+		/*
+		 * Priority and core of the worker thread; must be called before start()
+		 */
+		void setSchedule(const ThreadSchedule &schedule);
+
+	private:
+		static const uint64_t MAX_TRIGGER_LEAD_NS = 2000000;
+		static const uint64_t MAX_LEAD_STEP_NS = 10000;
+
+		// Where each output of the bus is wired, as indices into dacs and gpios
+		struct OutputMap {
+			uint8_t dac = OutputTopology::NO_DAC;
+			uint8_t dacChannel = 0;
+			uint8_t gpio = 0;
+			uint8_t gatePin = 0;
+			uint8_t triggerPin = 0;
+		};
+
+		I2CBus *bus;
+		uint8_t busIndex;
+		uint8_t firstOutput;   // Topology number of output 0
+		uint8_t numOutputs;
+		OutputMap outputMaps[MAX_OUTPUTS];
+		DAC dacs[OutputTopology::MAX_DEVICES_PER_BUS];
+		uint8_t numDACs = 0;
+		GPIOExpander gpios[OutputTopology::MAX_DEVICES_PER_BUS];
+		uint8_t numGPIOs = 0;
+		I2CTransaction transaction;
+
+		char threadName[16];
+		RealTimeThread workerThread;
+		std::atomic<bool> running;
+		EventNotifier notifier;
+		DeadlineTimer triggerTimer;
+
+		// Posted state, guarded by an even/odd sequence count (seqlock) so the worker never
+		// sends a half-finished update
+		std::atomic<uint32_t> sequence;
+		std::atomic<uint32_t> gates;
+		std::atomic<uint32_t> triggers;                      // Outputs whose pulse was not stopped
+		std::atomic<uint8_t> triggerPulses[MAX_OUTPUTS];     // Pulses started, wrapping around
+		std::atomic<uint16_t> pitches[MAX_OUTPUTS];
+		std::atomic<uint64_t> triggerWidths_ns[MAX_OUTPUTS];
+		std::atomic<uint32_t> pendingCommits;
+		std::atomic<uint64_t> firstPending_ns;  // Time of the first commit since the last sync()
+
+		// Worker-owned copy of what the hardware was last sent
+		uint16_t sentPins[OutputTopology::MAX_DEVICES_PER_BUS] = {0};  // Port B in the high byte
+		uint16_t sentPitches[MAX_OUTPUTS] = {0};
+
+		// Time until which a device that failed to answer is left out of batches, or 0
+		uint64_t dacOffline_ns[OutputTopology::MAX_DEVICES_PER_BUS] = {0};
+		uint64_t gpioOffline_ns[OutputTopology::MAX_DEVICES_PER_BUS] = {0};
+
+		// Worker-owned pulse state
+		uint32_t pulsing = 0;                           // Outputs whose trigger should be on
+		uint32_t unsentStarts = 0;                      // Started pulses whose rising edge was not sent
+		uint8_t seenPulses[MAX_OUTPUTS] = {0};
+		uint64_t pulseWidth_ns[MAX_OUTPUTS] = {0};
+		uint64_t pulseStart_ns[MAX_OUTPUTS] = {0};      // When the pulse was (re)started on the wire
+		uint64_t pulseEnd_ns[MAX_OUTPUTS] = {0};        // 0 until the rising edge was sent
+		uint64_t triggerLead_ns = 0;                    // How early a falling edge is written
+		bool triggerTimerFired = 0;
+
+		Metrics *metrics = nullptr;
+		Metrics::BusMetrics *busMetrics = nullptr;
+		MetricHistogram *dacTime_ns[OutputTopology::MAX_DEVICES_PER_BUS] = {nullptr};
+		MetricHistogram *gpioTime_ns[OutputTopology::MAX_DEVICES_PER_BUS] = {nullptr};
+
+		std::atomic<uint64_t> commits;
+		std::atomic<uint64_t> batches;
+		std::atomic<uint64_t> coalesced;
+		std::atomic<uint64_t> bytes;
+		std::atomic<uint64_t> busBusy_ns;
+		uint64_t start_ns = 0;
+
+		static void *workLoop(void *arg);
+
+		/*
+		 * Send the difference between the posted and the sent state
+		 */
+		void sync();
+
+		/*
+		 * Trigger lines wanted now: started pulses on, stopped and due pulses off
+		 */
+		uint32_t updatePulses(uint32_t enabled, const uint8_t *pulses, uint64_t now_ns, uint32_t *started, uint32_t *ended);
+
+		/*
+		 * Time the pulses whose edges reached the expander at edge_ns, given as a mask of the
+		 * outputs whose expander holds its new pins
+		 */
+		void finishPulses(uint32_t started, uint32_t ended, uint64_t edge_ns, uint32_t sent);
+		uint32_t getPinsSent(const uint16_t *newPins) const;
+		void armTriggerTimer();
+
+		/*
+		 * Stage the changed pins and pitches of every device not left out, filling in the bytes
+		 * written to each
+		 */
+		void stageChanges(const uint16_t *newPitches, uint32_t newGates, uint32_t newTriggers, uint64_t now_ns, uint16_t *newPins, uint32_t *dacBytes, uint32_t *gpioBytes);
+		uint32_t stageDAC(uint8_t dac, const uint16_t *newPitches);
+
+		/*
+		 * After a failed batch, send each device's part on its own, marking which made it and
+		 * leaving out the devices that still fail
+		 */
+		void retryDevices(const uint16_t *newPitches, const uint16_t *newPins, const uint32_t *dacBytes, const uint32_t *gpioBytes, bool *dacSent, bool *gpioSent);
+		bool sendRetry(uint32_t numBytes);
+		void setOffline(uint64_t *offline_ns, uint8_t addr, bool offline);
+
+		void recordMetrics(const uint32_t *dacBytes, const uint32_t *gpioBytes, uint32_t totalBytes, bool success, uint64_t transferStart_ns, uint64_t transferEnd_ns);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef PITCH_CALIBRATION_H
+#define PITCH_CALIBRATION_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Per-output tables of the DAC value for each MIDI note at 1 V/octave. The tables start out
+ * as the nominal curve (0 V at note 0, 5 V full scale), which is computed at compile time, and
+ * can be replaced from a calibration file or fitted to voltages measured on each output.
+ * Notes beyond the DAC's range are clamped to its last value.
+ *
+ * The file is text: '#' starts a comment, and each other line holds an output number (1 to
+ * the number of outputs) followed by the DAC values of all NUM_NOTES notes. Outputs without a
+ * line keep their current table.
+ */
+class PitchCalibration {
+	public:
+		static const uint8_t MAX_OUTPUTS = 64;
+		static const uint8_t NUM_NOTES = 128;
+		static const uint16_t MAX_VALUE = 4095;
+
+		PitchCalibration(uint8_t numOutputs = MAX_OUTPUTS);
+
+		uint8_t getNumOutputs() const;
+
+		/*
+		 * DAC value of a note on an output; both must be in range
+		 */
+		uint16_t getValue(uint8_t output, uint8_t note) const {
+			return tables[output][note];
+		}
+
+		/*
+		 * Highest note that is not clamped on an output
+		 */
+		uint8_t getHighestNote(uint8_t output) const;
+
+		bool load(const char *path);
+		bool save(const char *path) const;
+
+		/*
+		 * Replace the table of an output with the straight line through measured (DAC value,
+		 * volts) points, fitted by least squares. At least two distinct values are needed.
+		 */
+		bool fit(uint8_t output, const uint16_t *values, const double *volts, uint8_t numPoints);
+
+		static uint16_t getNominalValue(uint8_t note);
+
+	private:
+		static const size_t MAX_LINE_LENGTH = 1024;
+
+		uint8_t numOutputs;
+		uint16_t tables[MAX_OUTPUTS][NUM_NOTES];
+
+		// Fitted line of each output, written to the file as a comment (0 if not fitted)
+		double offsets_V[MAX_OUTPUTS];
+		double gains_V[MAX_OUTPUTS];
+
+		bool parseLine(char *line, unsigned lineNumber);
+};
+
+#endif
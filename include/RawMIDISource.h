@@ -0,0 +1,33 @@
+#ifndef RAW_MIDI_SOURCE_H
+#define RAW_MIDI_SOURCE_H
+
+#include <alsa/asoundlib.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include "MIDIByteSource.h"
+#include "Log.h"
+
+/*
+ * ALSA rawmidi input port opened in non-blocking mode
+ */
+class RawMIDISource : public MIDIByteSource {
+	public:
+		RawMIDISource(const char *port);
+		~RawMIDISource();
+
+		bool open() override;
+		void close() override;
+		bool isOpen() const override;
+		int getPollDescriptors(struct pollfd *fds, int space) override;
+		unsigned short getPollEvents(struct pollfd *fds, int count) override;
+		ssize_t read(uint8_t *buffer, size_t length) override;
+		bool setBlocking(bool blocking) override;
+		const char *getName() const override;
+
+	private:
+		const char *port;
+		snd_rawmidi_t *midi = nullptr;
+};
+
+#endif
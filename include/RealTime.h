@@ -0,0 +1,83 @@
+#ifndef REAL_TIME_H
+#define REAL_TIME_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+/*
+ * How one thread is scheduled
+ */
+struct ThreadSchedule {
+	int priority = 0;  // SCHED_FIFO priority, or 0 to stay under the default scheduler
+	int cpu = -1;      // Core to pin the thread to, or -1 for any
+};
+
+/*
+ * Thread whose stack is allocated and faulted in before it starts, and whose scheduling is set
+ * explicitly rather than inherited from the creating thread
+ */
+class RealTimeThread {
+	public:
+		static const size_t STACK_SIZE = 256 * 1024;
+
+		RealTimeThread(const char *name);
+		~RealTimeThread();
+
+		/*
+		 * Takes effect the next time the thread is started
+		 */
+		void setSchedule(const ThreadSchedule &schedule);
+
+		/*
+		 * Start routine(arg). If the process may not use SCHED_FIFO, the thread runs under the
+		 * default scheduler instead and a warning is printed.
+		 */
+		bool start(void *(*routine)(void*), void *arg);
+
+		bool join();
+
+		/*
+		 * Request deferred cancellation, which the thread acts on only at a cancellation point
+		 * (e.g. read()) reached while it has cancellation enabled
+		 */
+		void cancel();
+
+		/*
+		 * Let the thread run until the process exits; its stack is then never freed
+		 */
+		void detach();
+
+	private:
+		const char *name;
+		ThreadSchedule schedule;
+		pthread_t thread;
+		void *stack = nullptr;
+		bool started = 0;
+		bool detached = 0;
+};
+
+namespace RealTime {
+	static const size_t HEAP_PREFAULT_SIZE = 4 * 1024 * 1024;
+	static const size_t STACK_PREFAULT_SIZE = 256 * 1024;
+
+	/*
+	 * Lock all current and future memory, stop malloc() from returning memory to the kernel
+	 * and fault in heap and stack, so the hot path never takes a page fault
+	 */
+	bool lockMemory();
+
+	/*
+	 * Apply a schedule to the calling thread
+	 */
+	bool setCurrentThread(const ThreadSchedule &schedule, const char *name);
+}
+
+#endif
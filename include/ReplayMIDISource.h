@@ -0,0 +1,114 @@
+#ifndef REPLAY_MIDI_SOURCE_H
+#define REPLAY_MIDI_SOURCE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#include "MIDIByteSource.h"
+#include "MIDICapture.h"
+#include "DeadlineTimer.h"
+#include "Timer.h"
+#include "Log.h"
+
+/*
+ * Plays back the reads of one port of a capture (see MIDICapture) as a MIDI source. Each read
+ * returns the bytes of one captured read, so the parser sees the input split exactly as it
+ * was, and the events carry the time their read is due. At a speed of 1 the reads come at
+ * their captured times, at N they come N times as fast, and at 0 they come as fast as they
+ * are read, stamped with the time they are read; either way the same bytes reach the parser
+ * in the same order on every run.
+ *
+ * The capture is loaded into memory by load(), which must be called before the source is used.
+ */
+class ReplayMIDISource : public MIDIByteSource {
+	public:
+		static const uint16_t RECORDS_PER_WAKEUP = 64;  // Before the reader goes back to poll(), at speed 0
+
+		ReplayMIDISource(const char *path, uint8_t port, double speed);
+		~ReplayMIDISource();
+
+		/*
+		 * Read the capture and check its records, returning false if it cannot be replayed
+		 */
+		bool load();
+
+		/*
+		 * Time the capture's start is played at, shared by the sources of one capture so
+		 * their ports stay in step. Defaults to when the source is first opened.
+		 */
+		void setStartTime(uint64_t start_ns);
+
+		/*
+		 * Stop at the current read, as if the capture ended there
+		 */
+		void cancel();
+
+		/*
+		 * Whether every read of the port has been returned
+		 */
+		bool isFinished() const;
+
+		bool open() override;
+		void close() override;
+		bool isOpen() const override;
+		int getPollDescriptors(struct pollfd *fds, int space) override;
+		unsigned short getPollEvents(struct pollfd *fds, int count) override;
+		ssize_t read(uint8_t *buffer, size_t length) override;
+		uint64_t getReadTimestamp_ns() const override;
+		bool hasPendingInput() override;
+		const char *getName() const override;
+
+		/*
+		 * Read the port names of a capture, returning the number of ports or -1 if the file
+		 * is not a capture
+		 */
+		static int readPortNames(const char *path, char names[][MIDICapture::PORT_NAME_SIZE], uint8_t space);
+
+	private:
+		const char *path;
+		uint8_t port;
+		double speed;
+		char name[MIDICapture::PORT_NAME_SIZE + 8];
+
+		uint8_t *data = nullptr;
+		size_t size = 0;
+		bool opened = 0;
+		DeadlineTimer timer;
+
+		uint64_t start_ns = 0;
+		uint64_t captureStart_ns = 0;
+
+		// Position of the next record header to scan and the capture time of the last one scanned
+		size_t scanPos = 0;
+		uint64_t scanTime_ns = 0;
+
+		// Record of the port being returned: where its bytes not yet returned start, how many
+		// are left, and its time in the capture
+		size_t recordOffset = 0;
+		size_t recordLength = 0;
+		uint64_t recordTime_ns = 0;
+		bool atEnd = 0;
+
+		uint64_t readTimestamp_ns = 0;
+		uint16_t recordsThisWakeup = 0;
+
+		std::atomic<bool> cancelled;
+		std::atomic<bool> finished;
+
+		/*
+		 * Move to the next record of the port, or to the end of the capture
+		 */
+		void nextRecord();
+
+		/*
+		 * Time the current record is due, or 0 at speed 0
+		 */
+		uint64_t getDue_ns() const;
+
+		static bool readHeader(FILE *file, MIDICapture::Header *header);
+};
+
+#endif
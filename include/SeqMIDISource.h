@@ -0,0 +1,48 @@
+#ifndef SEQ_MIDI_SOURCE_H
+#define SEQ_MIDI_SOURCE_H
+
+#include <alsa/asoundlib.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include "MIDIByteSource.h"
+#include "Timer.h"
+#include "Log.h"
+
+/*
+ * ALSA sequencer client with one writable port, for DAWs and software that play into the
+ * controller with aconnect or their own routing. Events are stamped by the kernel on arrival
+ * against a real-time queue and turned back into MIDI bytes; each read returns only events
+ * that share a timestamp, which getReadTimestamp_ns() reports on the CLOCK_MONOTONIC scale.
+ */
+class SeqMIDISource : public MIDIByteSource {
+	public:
+		static const size_t DECODER_BUFFER_SIZE = 256;
+
+		SeqMIDISource(const char *name);
+		~SeqMIDISource();
+
+		bool open() override;
+		void close() override;
+		bool isOpen() const override;
+		int getPollDescriptors(struct pollfd *fds, int space) override;
+		unsigned short getPollEvents(struct pollfd *fds, int count) override;
+		ssize_t read(uint8_t *buffer, size_t length) override;
+		uint64_t getReadTimestamp_ns() const override;
+		bool hasPendingInput() override;
+		const char *getName() const override;
+
+	private:
+		const char *name;
+		snd_seq_t *seq = nullptr;
+		snd_midi_event_t *decoder = nullptr;
+		int queue = -1;
+		uint64_t queueStart_ns = 0;  // CLOCK_MONOTONIC time the queue started
+
+		snd_seq_event_t *event = nullptr;  // Fetched but not yet returned by read()
+		uint64_t readTimestamp_ns = 0;
+
+		uint64_t getEventTimestamp_ns(const snd_seq_event_t *event) const;
+};
+
+#endif
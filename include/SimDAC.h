@@ -0,0 +1,59 @@
+#ifndef SIM_DAC_H
+#define SIM_DAC_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "SimI2CBus.h"
+#include "DAC.h"
+
+/*
+ * Register model of the quad 12-bit DAC driven by the DAC class. Each channel has an input
+ * register and a DAC register; frames of command/access byte plus two data bytes are decoded
+ * as in DAC::Command. Every change of an output is recorded with the time it happened.
+ */
+class SimDAC : public SimI2CDevice {
+	public:
+		static const uint8_t NUM_CHANNELS = 4;
+		static const size_t LOG_CAPACITY = 4096;
+
+		struct Update {
+			uint64_t timestamp_ns = 0;
+			uint8_t channel = 0;
+			uint16_t value = 0;
+		};
+
+		SimDAC(uint8_t addr);
+
+		void handleWrite(const uint8_t *data, uint16_t length, uint64_t timestamp_ns) override;
+		void handleRead(uint8_t *data, uint16_t length, uint64_t timestamp_ns) override;
+
+		uint16_t getOutput(uint8_t channel) const;
+
+		/*
+		 * Number of output updates recorded since the last clearLog(), including any that were overwritten
+		 */
+		uint64_t getNumUpdates() const;
+		const Update &getUpdate(uint64_t index) const;
+
+		/*
+		 * Frames addressed to a channel the DAC does not have, with an unknown command, or truncated
+		 */
+		uint64_t getInvalidFrames() const;
+
+		void clearLog();
+
+	private:
+		static const uint8_t FRAME_SIZE = 3;
+
+		uint16_t inputRegisters[NUM_CHANNELS] = {0};
+		uint16_t dacRegisters[NUM_CHANNELS] = {0};
+
+		Update log[LOG_CAPACITY];
+		uint64_t numUpdates = 0;
+		uint64_t invalidFrames = 0;
+
+		void latch(uint8_t channel, uint64_t timestamp_ns);
+};
+
+#endif
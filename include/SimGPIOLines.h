@@ -0,0 +1,110 @@
+#ifndef SIM_GPIO_LINES_H
+#define SIM_GPIO_LINES_H
+
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "GPIOLines.h"
+#include "Timer.h"
+#include "Log.h"
+
+/*
+ * Receives the levels of a SimGPIOLines output group whenever they change
+ */
+class SimGPIOListener {
+	public:
+		virtual ~SimGPIOListener();
+		virtual void onLinesChanged(uint32_t values, uint32_t changed, uint64_t timestamp_ns) = 0;
+};
+
+/*
+ * In-memory GPIO lines standing in for sysfs or gpiochip lines. Output changes are forwarded to
+ * an optional listener (e.g. a SimHD44780); input levels are driven with injectValue(), which
+ * raises an edge event through getEventFd() like a real line. Every access is recorded with the
+ * time it happened.
+ */
+class SimGPIOLines : public GPIOLines {
+	public:
+		static const uint8_t MAX_PENDING_EDGES = 64;
+		static const size_t LOG_CAPACITY = 4096;
+
+		enum class Access : uint8_t {
+			SET,      // setValues()
+			GET,      // getValues()
+			INJECT    // injectValue() changing a level
+		};
+
+		struct Record {
+			uint64_t timestamp_ns = 0;
+			Access access = Access::SET;
+			uint32_t mask = 0;
+			uint32_t values = 0;      // Levels of the lines in mask after a SET or INJECT, as read by a GET
+		};
+
+		SimGPIOLines(const uint8_t *pinNums, uint8_t numLines, bool isOutput);
+		~SimGPIOLines();
+
+		bool setup() override;
+		bool setValues(uint32_t mask, uint32_t values) override;
+		bool getValues(uint32_t mask, uint32_t *values) override;
+		bool closeLines() override;
+
+		int getEventFd() const override;
+		bool readEdge(uint8_t *line, bool *value, uint64_t *timestamp_ns) override;
+
+		void setListener(SimGPIOListener *listener);
+
+		/*
+		 * Drive an input line to the given level from any thread
+		 */
+		void injectValue(uint8_t line, bool value);
+
+		/*
+		 * Number of setValues() and getValues() calls, each standing for a syscall on real hardware
+		 */
+		uint64_t getNumAccesses() const;
+
+		/*
+		 * Number of accesses recorded since the last clearLog(), including any that were overwritten
+		 */
+		uint64_t getNumRecords() const;
+
+		/*
+		 * Record with the given index, where index >= getNumRecords() - LOG_CAPACITY
+		 */
+		const Record &getRecord(uint64_t index) const;
+
+		void clearLog();
+
+	private:
+		struct PendingEdge {
+			uint8_t line;
+			bool value;
+			uint64_t timestamp_ns;
+		};
+
+		uint32_t values = 0;
+		SimGPIOListener *listener = nullptr;
+		uint64_t numAccesses = 0;
+
+		// Accesses may come from several threads (e.g. a button read by the dispatch loop while a
+		// test injects presses), so the log is kept under the lock
+		Record log[LOG_CAPACITY];
+		uint64_t numRecords = 0;
+
+		int eventDesc = -1;
+		pthread_mutex_t edgeLock;
+		PendingEdge pendingEdges[MAX_PENDING_EDGES];
+		uint8_t edgeHead = 0;
+		uint8_t numPendingEdges = 0;
+
+		/*
+		 * Append to the log; edgeLock must be held
+		 */
+		void record(Access access, uint32_t mask, uint32_t values, uint64_t timestamp_ns);
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SIM_HD44780_H
+#define SIM_HD44780_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "SimGPIOLines.h"
+#include "LCD.h"
+
+/*
+ * Model of an HD44780 character LCD wired in 4-bit mode with the line order of LCD::Line.
+ * Nibbles are latched on the falling edge of E; instructions and data are decoded into DDRAM.
+ * Every byte received is recorded with a timestamp, and bytes sent before the previous
+ * instruction could have finished are counted as busy violations.
+ */
+class SimHD44780 : public SimGPIOListener {
+	public:
+		static const uint8_t ROWS = 2;
+		static const uint8_t COLS = 16;
+		static const size_t LOG_CAPACITY = 4096;
+
+		struct Transfer {
+			uint64_t timestamp_ns = 0;
+			bool isData = 0;  // RS level
+			uint8_t value = 0;
+		};
+
+		SimHD44780();
+
+		void onLinesChanged(uint32_t values, uint32_t changed, uint64_t timestamp_ns) override;
+
+		/*
+		 * Copy the visible characters of a row into text, which must hold COLS + 1 characters
+		 */
+		void getRow(uint8_t row, char *text) const;
+
+		bool isDisplayOn() const;
+		bool isFourBitMode() const;
+
+		/*
+		 * Number of bytes recorded since the last clearLog(), including any that were overwritten
+		 */
+		uint64_t getNumTransfers() const;
+		const Transfer &getTransfer(uint64_t index) const;
+
+		uint64_t getBusyViolations() const;
+
+		void clearLog();
+
+	private:
+		static const uint8_t DDRAM_SIZE = 0x80;
+		static const uint64_t CLEAR_TIME_NS = 1520000;
+		static const uint64_t COMMAND_TIME_NS = 37000;
+
+		char ddram[DDRAM_SIZE];
+		uint8_t address = 0;
+		bool increment = 1;
+		bool displayOn = 0;
+		bool twoLines = 0;
+		bool fourBitMode = 0;
+
+		bool waitingForLowNibble = 0;
+		uint8_t highNibble = 0;
+		uint64_t busyUntil_ns = 0;
+
+		Transfer log[LOG_CAPACITY];
+		uint64_t numTransfers = 0;
+		uint64_t busyViolations = 0;
+
+		void latchNibble(uint8_t nibble, bool isData, uint64_t timestamp_ns);
+		void execute(uint8_t value, bool isData, uint64_t timestamp_ns);
+		void advanceAddress(bool forward);
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef SIM_I2C_BUS_H
+#define SIM_I2C_BUS_H
+
+#include <time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "I2CBus.h"
+#include "Timer.h"
+
+/*
+ * Software model of an I2C slave attached to a SimI2CBus
+ */
+class SimI2CDevice {
+	public:
+		SimI2CDevice(uint8_t addr);
+		virtual ~SimI2CDevice();
+
+		uint8_t getAddress() const;
+
+		/*
+		 * Handle the data bytes of one write message (everything between START and STOP or repeated START)
+		 */
+		virtual void handleWrite(const uint8_t *data, uint16_t length, uint64_t timestamp_ns) = 0;
+
+		/*
+		 * Supply the data bytes of one read message
+		 */
+		virtual void handleRead(uint8_t *data, uint16_t length, uint64_t timestamp_ns) = 0;
+
+	protected:
+		uint8_t addr;
+};
+
+/*
+ * I2C bus that delivers messages to in-process device models instead of the kernel.
+ * Every message is recorded with a timestamp, and an injectable delay stands in for bus time.
+ */
+class SimI2CBus : public I2CBus {
+	public:
+		static const uint8_t MAX_DEVICES = 16;
+		static const size_t LOG_CAPACITY = 4096;
+		static const uint8_t MAX_LOGGED_BYTES = 24;
+
+		struct Record {
+			uint64_t timestamp_ns = 0;  // Time the message finished on the simulated bus
+			uint32_t transferId = 0;    // Messages sent in one transfer() share an id
+			uint8_t addr = 0;
+			bool isRead = 0;
+			bool acknowledged = 0;      // False if no device answered at addr
+			uint16_t length = 0;
+			uint8_t data[MAX_LOGGED_BYTES] = {0};
+		};
+
+		struct Counters {
+			uint64_t addressSelects = 0;  // I2C_SLAVE ioctls that would have been made
+			uint64_t writes = 0;          // write() syscalls
+			uint64_t reads = 0;           // read() syscalls
+			uint64_t transfers = 0;       // I2C_RDWR ioctls
+			uint64_t messages = 0;
+			uint64_t bytes = 0;
+			uint64_t nacks = 0;
+		};
+
+		SimI2CBus();
+
+		/*
+		 * Attach a device model; the bus does not take ownership
+		 */
+		bool attach(SimI2CDevice *device);
+
+		/*
+		 * Delay every syscall by perCall_ns plus perByte_ns for each byte on the wire, including
+		 * the address byte of each message (about 90000 per byte on a 100 kHz bus)
+		 */
+		void setLatency(uint64_t perCall_ns, uint64_t perByte_ns);
+
+		bool selectAddress(uint8_t addr) override;
+		bool write(uint8_t addr, const uint8_t *data, size_t length) override;
+		bool read(uint8_t addr, uint8_t *data, size_t length) override;
+		bool transfer(I2CTransaction *transaction) override;
+
+		/*
+		 * Number of messages recorded since the last clearLog(), including any that were overwritten
+		 */
+		uint64_t getNumRecords() const;
+
+		/*
+		 * Record with the given index, where index >= getNumRecords() - LOG_CAPACITY
+		 */
+		const Record &getRecord(uint64_t index) const;
+
+		void getCounters(Counters *counters) const;
+		void clearLog();
+
+	private:
+		SimI2CDevice *devices[MAX_DEVICES] = {nullptr};
+		uint8_t numDevices = 0;
+
+		uint64_t perCall_ns = 0;
+		uint64_t perByte_ns = 0;
+
+		Record log[LOG_CAPACITY];
+		uint64_t numRecords = 0;
+		uint32_t transferId = 0;
+		Counters counters;
+
+		SimI2CDevice *findDevice(uint8_t addr);
+
+		/*
+		 * Deliver one message to its device after its simulated bus time has passed
+		 */
+		bool deliver(uint8_t addr, bool isRead, uint8_t *data, uint16_t length, uint64_t *busTime_ns);
+
+		void waitUntil(uint64_t deadline_ns);
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef SIM_MCP23017_H
+#define SIM_MCP23017_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "SimI2CBus.h"
+
+/*
+ * Register model of the MCP23017 16-bit I/O expander in its default IOCON.BANK = 0 layout.
+ * Every change of an output pin's level is recorded with the time it happened.
+ */
+class SimMCP23017 : public SimI2CDevice {
+	public:
+		static const uint8_t NUM_PORTS = 2;
+		static const uint8_t PINS_PER_PORT = 8;
+		static const size_t LOG_CAPACITY = 4096;
+
+		struct Register {
+			static const uint8_t IODIRA = 0x00;
+			static const uint8_t IPOLA = 0x02;
+			static const uint8_t IOCON = 0x0A;
+			static const uint8_t IOCONB = 0x0B;
+			static const uint8_t INTFA = 0x0E;
+			static const uint8_t INTCAPA = 0x10;
+			static const uint8_t GPIOA = 0x12;
+			static const uint8_t OLATA = 0x14;
+			static const uint8_t NUM_REGISTERS = 0x16;
+		};
+
+		struct Edge {
+			uint64_t timestamp_ns = 0;
+			uint8_t port = 0;  // 0 = A, 1 = B
+			uint8_t pin = 0;
+			bool value = 0;
+		};
+
+		SimMCP23017(uint8_t addr);
+
+		void handleWrite(const uint8_t *data, uint16_t length, uint64_t timestamp_ns) override;
+		void handleRead(uint8_t *data, uint16_t length, uint64_t timestamp_ns) override;
+
+		/*
+		 * Drive the external level of the input pins of a port
+		 */
+		void setInputs(uint8_t port, uint8_t levels);
+
+		/*
+		 * Level currently driven on the output pins of a port (input pins read as 0)
+		 */
+		uint8_t getOutputs(uint8_t port) const;
+
+		uint8_t getRegister(uint8_t reg) const;
+
+		/*
+		 * Number of output edges recorded since the last clearLog(), including any that were overwritten
+		 */
+		uint64_t getNumEdges() const;
+		const Edge &getEdge(uint64_t index) const;
+
+		/*
+		 * Writes to read-only registers or with IOCON.BANK = 1, which this model does not support
+		 */
+		uint64_t getUnsupportedWrites() const;
+
+		void clearLog();
+
+	private:
+		uint8_t registers[Register::NUM_REGISTERS] = {0};
+		uint8_t pointer = 0;
+		uint8_t inputs[NUM_PORTS] = {0};
+
+		Edge log[LOG_CAPACITY];
+		uint64_t numEdges = 0;
+		uint64_t unsupportedWrites = 0;
+
+		void writeRegister(uint8_t reg, uint8_t value, uint64_t timestamp_ns);
+		uint8_t readRegister(uint8_t reg) const;
+		void advancePointer();
+		void recordEdges(uint8_t port, uint8_t before, uint8_t after, uint64_t timestamp_ns);
+};
+
+#endif
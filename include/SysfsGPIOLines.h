@@ -0,0 +1,44 @@
+#ifndef SYSFS_GPIO_LINES_H
+#define SYSFS_GPIO_LINES_H
+
+#include <stdint.h>
+
+#include "GPIOLines.h"
+#include "DigitalOutputPin.h"
+#include "DigitalInputPin.h"
+#include "Timer.h"
+#include "Log.h"
+
+/*
+ * GPIO lines backed by the legacy /sys/class/gpio interface, one value file per line.
+ * Edge events are only supported for single-line input groups, since each line has its own file.
+ */
+class SysfsGPIOLines : public GPIOLines {
+	public:
+		SysfsGPIOLines(const uint8_t *pinNums, uint8_t numLines, bool isOutput);
+		~SysfsGPIOLines();
+
+		bool setup() override;
+		bool setValues(uint32_t mask, uint32_t values) override;
+		bool getValues(uint32_t mask, uint32_t *values) override;
+		bool closeLines() override;
+
+		int getEventFd() const override;
+		uint32_t getEventMask() const override;
+		bool readEdge(uint8_t *line, bool *value, uint64_t *timestamp_ns) override;
+
+	private:
+		DigitalOutputPin *outputPins[MAX_LINES] = {nullptr};
+		DigitalInputPin *inputPins[MAX_LINES] = {nullptr};
+
+		// Last values written, so unchanged output lines are not rewritten
+		uint32_t outputValues = 0;
+		uint32_t knownMask = 0;
+
+		// Last value reported by readEdge()
+		bool edgeValue = 0;
+
+		void deletePins();
+};
+
+#endif
@@ -3,17 +3,29 @@
 
 #include <sys/time.h>
 #include <time.h>
+#include <stdint.h>
 
+/*
+ * Stopwatch on CLOCK_MONOTONIC, kept in integer nanoseconds
+ */
 class Timer {
 	public:
+		static const uint64_t NS_PER_S = 1000000000ull;
+		static const uint64_t NS_PER_MS = 1000000ull;
+
 		Timer();
 		void set();
-		double get_s();
-		double get_ms();
+		uint64_t get_ns() const;
+		double get_s() const;
+		double get_ms() const;
+
+		/*
+		 * Current CLOCK_MONOTONIC time in nanoseconds
+		 */
+		static uint64_t now_ns();
 
 	private:
-		struct timespec setTime;
+		uint64_t setTime_ns;
 };
 
 #endif
-
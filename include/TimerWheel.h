@@ -0,0 +1,86 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Metrics.h"
+
+/*
+ * Hierarchical timing wheel of one-shot deadlines on CLOCK_MONOTONIC. Four levels of 64 slots
+ * cover 2^16 ns (65.5 us) ticks out to about 18 minutes; later deadlines wait in the last
+ * level. Scheduling and cancelling are constant time, and advance() only visits slots that
+ * hold timers. Callbacks still run at their exact deadline, not rounded to a tick.
+ *
+ * Entries are owned by the caller and linked in place, so nothing is allocated. All calls
+ * must come from one thread.
+ */
+class TimerWheel {
+	public:
+		typedef void (*Callback)(void *context, uint64_t now_ns);
+
+		struct Entry {
+			Callback callback = nullptr;
+			void *context = nullptr;
+			uint64_t deadline_ns = 0;
+
+			// Owned by the wheel
+			bool pending = 0;
+			uint8_t level = 0;
+			uint8_t slot = 0;
+			Entry *prev = nullptr;
+			Entry *next = nullptr;
+		};
+
+		static const uint8_t TICK_SHIFT = 16;
+		static const uint8_t LEVEL_BITS = 6;
+		static const uint8_t NUM_SLOTS = 1 << LEVEL_BITS;
+		static const uint8_t NUM_LEVELS = 4;
+
+		/*
+		 * now_ns is the current time; deadlines before it fire on the first advance()
+		 */
+		TimerWheel(uint64_t now_ns);
+
+		/*
+		 * Fire entry at deadline_ns, moving it if it is already pending
+		 */
+		void schedule(Entry *entry, uint64_t deadline_ns);
+		void cancel(Entry *entry);
+
+		/*
+		 * Run the callback of every entry due at now_ns, returning how many ran. Callbacks may
+		 * schedule and cancel entries.
+		 */
+		size_t advance(uint64_t now_ns);
+
+		/*
+		 * Earliest pending deadline, or 0 if nothing is pending
+		 */
+		uint64_t getNextDeadline_ns() const;
+
+		size_t getNumPending() const;
+
+		/*
+		 * Record how late each callback runs after its deadline
+		 */
+		void setLatenessHistogram(MetricHistogram *histogram);
+
+	private:
+		static const uint8_t SLOT_MASK = NUM_SLOTS - 1;
+
+		Entry *slots[NUM_LEVELS][NUM_SLOTS];
+		uint64_t occupied[NUM_LEVELS];   // Bit per non-empty slot
+		uint64_t currentTick;            // Every tick before this one has been processed
+		size_t numPending = 0;
+		MetricHistogram *latenessHistogram = nullptr;
+
+		void insert(Entry *entry);
+		void unlink(Entry *entry);
+		void cascade(uint64_t tick);
+		size_t expire(uint64_t now_ns);
+		uint64_t getNextTick(uint64_t nowTick) const;
+		uint64_t getRotatedOccupancy(uint8_t level, uint8_t start) const;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef VOICE_ALLOCATOR_H
+#define VOICE_ALLOCATOR_H
+
+#include <stdint.h>
+
+/*
+ * Assigns MIDI notes to voices (outputs). Every voice belongs to one MIDI channel; each channel
+ * keeps bit masks of its voices and free voices, and its sounding voices in note-on order
+ * (integer ticks, no clock reads). A 16x128 table maps each held note to its voice. Note on
+ * and off take constant time under every policy. No memory is allocated after construction.
+ *
+ * Notes that lose their voice under the note-priority and legato policies stay held, and take
+ * the voice back when the note that replaced them is released.
+ */
+class VoiceAllocator {
+	public:
+		static const uint8_t MAX_VOICES = 64;
+		static const uint8_t NUM_CHANNELS = 16;
+		static const uint8_t NUM_NOTES = 128;
+		static const uint8_t NO_VOICE = 0xFF;
+
+		enum class Policy {
+			OLDEST,        // Lowest-numbered free voice, else steal the oldest note
+			ROUND_ROBIN,   // Next free voice in a fixed rotation, else steal the next one in it
+			LOWEST_NOTE,   // Low-note priority: the highest sounding note gives way to a lower one
+			HIGHEST_NOTE,  // High-note priority: the lowest sounding note gives way to a higher one
+			LEGATO         // Newest note takes over the most recent voice without retriggering it
+		};
+
+		/*
+		 * What a voice must do after a note on or off
+		 */
+		struct Change {
+			uint8_t voice = NO_VOICE;
+			uint8_t note = 0;      // Note the voice plays, if gate is set
+			bool gate = 0;         // Gate state after the change
+			bool retrigger = 0;    // A new note starts: restart the gate and fire the trigger
+		};
+
+		/*
+		 * All voices start on channel 0 under the OLDEST policy
+		 */
+		VoiceAllocator(uint8_t numVoices);
+
+		/*
+		 * Returns true and fills change if a voice has to change
+		 */
+		bool noteOn(uint8_t note, uint8_t channel, Change *change);
+		bool noteOff(uint8_t note, uint8_t channel, Change *change);
+
+		/*
+		 * Release every note and voice of a channel
+		 */
+		void releaseChannel(uint8_t channel);
+
+		/*
+		 * Move a voice to another channel, silencing it
+		 */
+		void assign(uint8_t voice, uint8_t channel);
+
+		/*
+		 * Policy changes release the channel's held notes that have no voice
+		 */
+		void setPolicy(uint8_t channel, Policy policy);
+		void setPolicy(Policy policy);
+
+		uint8_t getNumVoices() const;
+		uint8_t getChannel(uint8_t voice) const;
+		bool isActive(uint8_t voice) const;
+		uint8_t getNote(uint8_t voice) const;
+		Policy getPolicy(uint8_t channel) const;
+
+		/*
+		 * Policy by name: oldest, round-robin, lowest, highest or legato
+		 */
+		static bool parsePolicy(const char *name, Policy *policy);
+		static const char *getPolicyName(Policy policy);
+
+	private:
+		struct Voice {
+			uint8_t channel = 0;
+			uint8_t note = 0;
+			bool active = 0;
+			uint8_t prev = NO_VOICE;
+			uint8_t next = NO_VOICE;
+		};
+
+		// Doubly linked list of voices, oldest at the head
+		struct List {
+			uint8_t head = NO_VOICE;
+			uint8_t tail = NO_VOICE;
+		};
+
+		// Set of notes as a 128-bit mask
+		struct NoteSet {
+			uint64_t bits[2] = {0, 0};
+
+			void add(uint8_t note);
+			void remove(uint8_t note);
+			bool isEmpty() const;
+			uint8_t lowest() const;
+			uint8_t highest() const;
+		};
+
+		struct Channel {
+			Policy policy = Policy::OLDEST;
+			uint64_t voiceMask = 0;  // Voices on this channel
+			uint64_t freeMask = 0;   // Those not sounding
+			List activeVoices;
+			uint8_t rotation = 0;   // Round-robin: voice to try first
+			NoteSet sounding;       // Held notes that have a voice
+			NoteSet waiting;        // Held notes that lost or never got one
+		};
+
+		const uint8_t numVoices;
+		Voice voices[MAX_VOICES];
+		Channel channels[NUM_CHANNELS];
+		uint8_t noteVoices[NUM_CHANNELS][NUM_NOTES];
+		uint32_t noteTicks[NUM_CHANNELS][NUM_NOTES];  // Tick of each note's last note on
+		uint32_t tick = 0;
+
+		static uint8_t findFrom(uint64_t mask, uint8_t start);
+
+		void pushBack(List *list, uint8_t voice);
+		void remove(List *list, uint8_t voice);
+
+		uint8_t findFreeVoice(Channel *channel);
+		uint8_t findVictim(Channel *channel, uint8_t channelIndex, uint8_t note);
+		void start(uint8_t voice, uint8_t note, Change *change, bool retrigger);
+		bool restoresNotes(Policy policy) const;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "../include/ChipGPIOLines.h"
+
+const char *ChipGPIOLines::CONSUMER = "synth_controller";
+
+ChipGPIOLines::ChipGPIOLines(const char *chipPath, const uint8_t *offsets, uint8_t numLines, bool isOutput) :
+	GPIOLines(offsets, numLines, isOutput) {
+	strncpy(this->chipPath, chipPath, sizeof(this->chipPath) - 1);
+}
+
+ChipGPIOLines::~ChipGPIOLines() {
+	closeLines();
+}
+
+bool ChipGPIOLines::setup() {
+	closeLines();
+
+	int chipDesc = open(chipPath, O_RDWR | O_CLOEXEC);
+	if (chipDesc == -1) {
+		printf("Error: Failed to open %s\n", chipPath);
+		return false;
+	}
+
+	bool success = requestLines(chipDesc, edgeEvents && debouncePeriod_us > 0);
+	if (!success && edgeEvents && debouncePeriod_us > 0) {
+		// Fall back to software debouncing if the kernel rejects the debounce attribute
+		success = requestLines(chipDesc, false);
+	}
+	close(chipDesc);
+	if (!success) {
+		printf("Error: Failed to request lines from %s\n", chipPath);
+		return false;
+	}
+
+	if (edgeEvents && fcntl(requestDesc, F_SETFL, fcntl(requestDesc, F_GETFL) | O_NONBLOCK) == -1) {
+		printf("Error: Failed to make line events non-blocking\n");
+		return false;
+	}
+	return true;
+}
+
+bool ChipGPIOLines::requestLines(int chipDesc, bool withDebounce) {
+	struct gpio_v2_line_request request;
+	memset(&request, 0, sizeof(request));
+	for (uint8_t i = 0; i < numLines; ++i) {
+		request.offsets[i] = pinNums[i];
+	}
+	strncpy(request.consumer, CONSUMER, GPIO_MAX_NAME_SIZE - 1);
+	request.num_lines = numLines;
+	uint64_t allLines = (numLines >= 64) ? ~0ull : ((1ull << numLines) - 1);
+
+	if (isOutput) {
+		// Request outputs low, matching DigitalOutputPin::setup()
+		request.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+		request.config.num_attrs = 1;
+		request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+		request.config.attrs[0].attr.values = 0;
+		request.config.attrs[0].mask = allLines;
+	}
+	else {
+		request.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+		if (edgeEvents) {
+			request.config.flags |= GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+		}
+		if (withDebounce) {
+			request.config.num_attrs = 1;
+			request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+			request.config.attrs[0].attr.debounce_period_us = debouncePeriod_us;
+			request.config.attrs[0].mask = allLines;
+		}
+	}
+
+	if (ioctl(chipDesc, GPIO_V2_GET_LINE_IOCTL, &request) == -1) {
+		return false;
+	}
+
+	requestDesc = request.fd;
+	kernelDebounce = withDebounce;
+	return true;
+}
+
+bool ChipGPIOLines::setValues(uint32_t mask, uint32_t values) {
+	if (!isOutput) {
+		Log::error("Cannot write to input lines");
+		return false;
+	}
+	struct gpio_v2_line_values lineValues;
+	lineValues.bits = values & mask;
+	lineValues.mask = mask;
+	if (ioctl(requestDesc, GPIO_V2_LINE_SET_VALUES_IOCTL, &lineValues) == -1) {
+		Log::error("Failed to set line values");
+		return false;
+	}
+	return true;
+}
+
+bool ChipGPIOLines::getValues(uint32_t mask, uint32_t *values) {
+	struct gpio_v2_line_values lineValues;
+	lineValues.bits = 0;
+	lineValues.mask = mask;
+	if (ioctl(requestDesc, GPIO_V2_LINE_GET_VALUES_IOCTL, &lineValues) == -1) {
+		Log::error("Failed to get line values");
+		return false;
+	}
+	*values = (uint32_t) lineValues.bits;
+	return true;
+}
+
+bool ChipGPIOLines::closeLines() {
+	if (requestDesc == -1) {
+		return true;
+	}
+	bool success = true;
+	if (isOutput) {
+		success = setValues((uint32_t) -1, 0);
+	}
+
+	// Lines are released by the kernel once the request handle is closed
+	close(requestDesc);
+	requestDesc = -1;
+	return success;
+}
+
+int ChipGPIOLines::getEventFd() const {
+	return edgeEvents && !isOutput ? requestDesc : -1;
+}
+
+bool ChipGPIOLines::readEdge(uint8_t *line, bool *value, uint64_t *timestamp_ns) {
+	if (getEventFd() == -1) {
+		return false;
+	}
+
+	// An event for an offset that is not one of the lines is skipped rather than reported
+	// with a stale line index
+	struct gpio_v2_line_event event;
+	while (read(requestDesc, &event, sizeof(event)) == sizeof(event)) {
+		for (uint8_t i = 0; i < numLines; ++i) {
+			if (pinNums[i] == event.offset) {
+				// Event timestamps are CLOCK_MONOTONIC unless a different clock was requested
+				*line = i;
+				*value = event.id == GPIO_V2_LINE_EVENT_RISING_EDGE;
+				*timestamp_ns = event.timestamp_ns;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool ChipGPIOLines::hasKernelDebounce() const {
+	return kernelDebounce;
+}
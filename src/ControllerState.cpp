@@ -0,0 +1,112 @@
+#include "../include/ControllerState.h"
+
+ControllerState::ControllerState() {}
+
+ControllerState::~ControllerState() {
+	close();
+}
+
+bool ControllerState::open(const char *path, uint8_t numOutputs) {
+	close();
+	if (numOutputs > MAX_OUTPUTS) {
+		printf("Error: At most %u outputs can be kept in %s\n", MAX_OUTPUTS, path);
+		return false;
+	}
+
+	int stateDesc = ::open(path, O_RDWR | O_CREAT, 0644);
+	if (stateDesc == -1) {
+		printf("Error: Failed to open state file %s\n", path);
+		return false;
+	}
+	struct stat info;
+	bool sized = fstat(stateDesc, &info) == 0 && (size_t) info.st_size >= sizeof(Data);
+	if (!sized && ftruncate(stateDesc, sizeof(Data)) == -1) {
+		printf("Error: Failed to size state file %s\n", path);
+		::close(stateDesc);
+		return false;
+	}
+	void *memory = mmap(NULL, sizeof(Data), PROT_READ | PROT_WRITE, MAP_SHARED, stateDesc, 0);
+	::close(stateDesc);
+	if (memory == MAP_FAILED) {
+		printf("Error: Failed to map state file %s\n", path);
+		return false;
+	}
+	data = (Data*) memory;
+
+	char bootId[BOOT_ID_SIZE];
+	readBootId(bootId);
+	restored = sized && data->magic == MAGIC && data->version == VERSION && data->numOutputs == numOutputs;
+	warm = restored && bootId[0] != '\0' && strncmp(data->bootId, bootId, BOOT_ID_SIZE) == 0;
+	if (!restored) {
+		memset(data, 0, sizeof(Data));
+		data->magic = MAGIC;
+		data->version = VERSION;
+		data->numOutputs = numOutputs;
+	}
+	memcpy(data->bootId, bootId, BOOT_ID_SIZE);
+	return true;
+}
+
+void ControllerState::close() {
+	if (!data) {
+		return;
+	}
+	msync(data, sizeof(Data), MS_SYNC);
+	munmap(data, sizeof(Data));
+	data = nullptr;
+}
+
+bool ControllerState::isOpen() const {
+	return data != nullptr;
+}
+
+bool ControllerState::isRestored() const {
+	return restored;
+}
+
+bool ControllerState::isWarm() const {
+	return warm;
+}
+
+uint8_t ControllerState::getNumOutputs() const {
+	return data ? data->numOutputs : 0;
+}
+
+uint8_t ControllerState::getChannel(uint8_t output) const {
+	return data && output < data->numOutputs ? data->channels[output] : 0;
+}
+
+uint8_t ControllerState::getSelectedOutput() const {
+	return data ? data->selectedOutput : 0;
+}
+
+void ControllerState::setChannel(uint8_t output, uint8_t channel) {
+	if (data && output < data->numOutputs) {
+		data->channels[output] = channel;
+	}
+}
+
+void ControllerState::setSelectedOutput(uint8_t output) {
+	if (data && output < data->numOutputs) {
+		data->selectedOutput = output;
+	}
+}
+
+void ControllerState::readBootId(char *bootId) {
+	memset(bootId, 0, BOOT_ID_SIZE);
+	int bootIdDesc = ::open("/proc/sys/kernel/random/boot_id", O_RDONLY);
+	if (bootIdDesc == -1) {
+		return;
+	}
+	ssize_t length = read(bootIdDesc, bootId, BOOT_ID_SIZE - 1);
+	::close(bootIdDesc);
+	if (length <= 0) {
+		bootId[0] = '\0';
+		return;
+	}
+	bootId[length] = '\0';
+	char *newline = strchr(bootId, '\n');
+	if (newline) {
+		*newline = '\0';
+	}
+}
@@ -1,17 +1,74 @@
 #include "../include/DAC.h"
 
-DAC::DAC(int i2cFile) : I2CDevice(i2cFile) {}
+DAC::DAC(I2CBus *bus, uint8_t addr) : I2CDevice(bus, addr) {}
 DAC::DAC() {}
 
 bool DAC::writeData(uint16_t value, uint8_t command, uint8_t channel) {
-	uint8_t msdb = value >> 4;
-	uint8_t lsdb = (value & 0b1111) << 4;
-	uint8_t ca = (command << 4) + channel;
-	uint8_t buffer[3] = {ca, msdb, lsdb};
-	if (write(i2cFile, buffer, 3) != 3) {
-		printf("Error: Failed to write data to DAC\n");
+	uint8_t buffer[FRAME_SIZE];
+	encode(buffer, value, command, channel);
+	if (!writeBytes(buffer, FRAME_SIZE)) {
+		Log::error("Failed to write data to DAC");
 		return false;
 	}
 	return true;
 }
 
+bool DAC::stageData(I2CTransaction *transaction, uint16_t value, uint8_t command, uint8_t channel) {
+	uint8_t buffer[FRAME_SIZE];
+	encode(buffer, value, command, channel);
+	return transaction->addWrite(addr, buffer, FRAME_SIZE);
+}
+
+bool DAC::writeBatch(const uint8_t *channels, const uint16_t *values, uint8_t count) {
+	uint8_t buffer[FRAME_SIZE * MAX_BATCH_SIZE];
+	uint8_t length = encodeBatch(buffer, channels, values, count);
+	if (length == 0 || !writeBytes(buffer, length)) {
+		Log::error("Failed to write batch to DAC");
+		return false;
+	}
+	return true;
+}
+
+bool DAC::stageBatch(I2CTransaction *transaction, const uint8_t *channels, const uint16_t *values, uint8_t count) {
+	uint8_t buffer[FRAME_SIZE * MAX_BATCH_SIZE];
+	uint8_t length = encodeBatch(buffer, channels, values, count);
+	if (length == 0) {
+		Log::error("Invalid DAC batch");
+		return false;
+	}
+	return transaction->addWrite(addr, buffer, length);
+}
+
+uint8_t DAC::encodeBatch(uint8_t *buffer, const uint8_t *channels, const uint16_t *values, uint8_t count) {
+	if (count == 0 || count > MAX_BATCH_SIZE) {
+		return 0;
+	}
+
+	// A frame for a channel the DAC lacks is ignored, and if it were the last one its
+	// WRITE_UPDATE_ALL would leave the values stored before it unlatched
+	for (uint8_t i = 0; i < count; ++i) {
+		if (channels[i] >= NUM_CHANNELS) {
+			return 0;
+		}
+	}
+	if (count == 1) {
+		encode(buffer, values[0], Command::WRITE_UPDATE, channels[0]);
+		return FRAME_SIZE;
+	}
+
+	// The DAC accepts consecutive command/data frames within one write
+	for (uint8_t i = 0; i < count; ++i) {
+		uint8_t command = (i == count - 1) ? Command::WRITE_UPDATE_ALL : Command::WRITE;
+		encode(buffer + i * FRAME_SIZE, values[i], command, channels[i]);
+	}
+	return count * FRAME_SIZE;
+}
+
+void DAC::encode(uint8_t *frame, uint16_t value, uint8_t command, uint8_t channel) {
+	uint8_t msdb = value >> 4;
+	uint8_t lsdb = (value & 0b1111) << 4;
+	uint8_t ca = (command << 4) + channel;
+	frame[0] = ca;
+	frame[1] = msdb;
+	frame[2] = lsdb;
+}
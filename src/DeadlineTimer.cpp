@@ -0,0 +1,70 @@
+#include "../include/DeadlineTimer.h"
+
+DeadlineTimer::DeadlineTimer() {}
+
+DeadlineTimer::~DeadlineTimer() {
+	if (timerDesc != -1) {
+		close(timerDesc);
+	}
+}
+
+bool DeadlineTimer::setup() {
+	timerDesc = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timerDesc == -1) {
+		printf("Error: Failed to create timerfd\n");
+		return false;
+	}
+	return true;
+}
+
+bool DeadlineTimer::arm(uint64_t deadline_ns) {
+	if (deadline_ns == this->deadline_ns) {
+		return true;
+	}
+
+	// A zero it_value would disarm the timer instead of firing it
+	if (deadline_ns == 0) {
+		deadline_ns = 1;
+	}
+
+	struct itimerspec spec;
+	spec.it_interval.tv_sec = 0;
+	spec.it_interval.tv_nsec = 0;
+	spec.it_value.tv_sec = deadline_ns / 1000000000ull;
+	spec.it_value.tv_nsec = deadline_ns % 1000000000ull;
+	if (timerfd_settime(timerDesc, TFD_TIMER_ABSTIME, &spec, NULL) == -1) {
+		Log::error("Failed to arm timerfd");
+		return false;
+	}
+	this->deadline_ns = deadline_ns;
+	return true;
+}
+
+bool DeadlineTimer::disarm() {
+	if (deadline_ns == 0) {
+		return true;
+	}
+	struct itimerspec spec = {};
+	if (timerfd_settime(timerDesc, 0, &spec, NULL) == -1) {
+		Log::error("Failed to disarm timerfd");
+		return false;
+	}
+	deadline_ns = 0;
+	return true;
+}
+
+void DeadlineTimer::acknowledge() {
+	uint64_t expirations;
+	if (read(timerDesc, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+		// Nothing pending
+	}
+	deadline_ns = 0;
+}
+
+uint64_t DeadlineTimer::getDeadline_ns() const {
+	return deadline_ns;
+}
+
+int DeadlineTimer::getFd() const {
+	return timerDesc;
+}
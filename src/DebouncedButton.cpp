@@ -1,37 +1,79 @@
 #include "../include/DebouncedButton.h"
 
-DebouncedButton::DebouncedButton(uint8_t pin) : buttonPin(pin) {
-	buttonPin.setup();
+DebouncedButton::DebouncedButton(uint8_t pin) {
+	line = new SysfsGPIOLines(&pin, 1, false);
+	ownsLine = 1;
+	setupLine();
 }
 
-bool DebouncedButton::isPressed() {
-	bool currentValue = 0;
-	bool returnValue = 0;
-	buttonPin.readValue(&currentValue);
-	if (currentValue && !prevValue && !timerWasSet) {
-		debounceTimer.set();
-		timerWasSet = 1;
+DebouncedButton::DebouncedButton(GPIOLines *line) : line(line) {
+	setupLine();
+}
+
+DebouncedButton::~DebouncedButton() {
+	if (ownsLine) {
+		delete line;
 	}
-	if (!currentValue && prevValue && timerWasSet) {
-		timerWasSet = 0;
+}
+
+void DebouncedButton::setupLine() {
+	line->enableEdgeEvents(DEBOUNCE_TIME_NS / 1000);
+	line->setup();
+	if (line->hasKernelDebounce()) {
+		debounceTime_ns = 0;
 	}
-	if (timerWasSet && debounceTimer.get_ms() >= 20.0) {
-		if (currentValue) {
-			returnValue = 1;
+
+	uint32_t value = 0;
+	line->getValues(1, &value);
+	rawValue = value & 1;
+	pressStart_ns = rawValue ? Timer::now_ns() : 0;
+}
+
+int DebouncedButton::getEventFd() const {
+	return line->getEventFd();
+}
+
+uint32_t DebouncedButton::getEventMask() const {
+	return line->getEventMask();
+}
+
+void DebouncedButton::handleEdges() {
+	uint8_t lineIndex;
+	bool value;
+	uint64_t timestamp_ns;
+	while (line->readEdge(&lineIndex, &value, &timestamp_ns)) {
+		if (value && !rawValue) {
+			pressStart_ns = timestamp_ns;
 		}
+		rawValue = value;
 	}
-	prevValue = currentValue;
-	return returnValue;
 }
 
-bool DebouncedButton::wasClicked() {
-	bool pressed = isPressed();
+bool DebouncedButton::isPressed(uint64_t now_ns) const {
+	return rawValue && now_ns >= pressStart_ns + debounceTime_ns;
+}
+
+bool DebouncedButton::wasClicked(uint64_t now_ns) {
+	bool pressed = isPressed(now_ns);
 	bool out = pressed && !wasPressed;
 	wasPressed = pressed;
 	return out;
 }
 
-double DebouncedButton::getHoldTime_s() {
-	return debounceTimer.get_s();
+uint64_t DebouncedButton::getHoldTime_ns(uint64_t now_ns) const {
+	if (!rawValue || now_ns < pressStart_ns) {
+		return 0;
+	}
+	return now_ns - pressStart_ns;
 }
 
+uint64_t DebouncedButton::getPressTime_ns() const {
+	return rawValue ? pressStart_ns : 0;
+}
+
+uint64_t DebouncedButton::getDebounceDeadline_ns() const {
+	if (rawValue && !wasPressed) {
+		return pressStart_ns + debounceTime_ns;
+	}
+	return 0;
+}
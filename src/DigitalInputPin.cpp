@@ -8,21 +8,26 @@ bool DigitalInputPin::setup() {
 	if (!exportPin()) {
 		return false;
 	}
-	return setDirection((char*) "in");
+	if (!setDirection((char*) "in")) {
+		return false;
+	}
+	return openPin(O_RDONLY);
 }
 
 bool DigitalInputPin::readValue(bool *out) {
-	int valueDesc;
-	if (!openPin(&valueDesc, O_RDONLY)) {
-		return false;
-	}
 	char valueStr[3];
-	if (read(valueDesc, valueStr, 3) == -1) {
-		printf("Error: Failed to read pin value\n");
+	if (pread(valueDesc, valueStr, 3, 0) <= 0) {
+		Log::error("Failed to read pin value");
 		return false;
 	}
-	*out = (bool) atoi(valueStr);
-	close(valueDesc);
+	*out = valueStr[0] == '1';
 	return true;
 }
 
+bool DigitalInputPin::setEdge(const char *edge) {
+	return setAttribute("edge", edge);
+}
+
+int DigitalInputPin::getValueDesc() const {
+	return valueDesc;
+}
@@ -11,32 +11,24 @@ bool DigitalOutputPin::setup() {
 	if (!setDirection((char*) "out")) {
 		return false;
 	}
+	if (!openPin(O_WRONLY)) {
+		return false;
+	}
 	return writeValue(0);
 }
 
 bool DigitalOutputPin::writeValue(bool value) {
-	int valueDesc;
-	if (!openPin(&valueDesc, O_WRONLY)) {
+	if (pwrite(valueDesc, value ? "1" : "0", 1, 0) != 1) {
+		Log::error("Failed to write pin value");
 		return false;
 	}
-	if (write(valueDesc, value ? "1" : "0", 1) != 1) {
-		printf("Error: Failed to write pin value\n");
-		return false;
-	}
-	close(valueDesc);
 	return true;
 }
 
 bool DigitalOutputPin::closePin() {
-	int valueDesc;
-	if (!openPin(&valueDesc, O_WRONLY)) {
-		return false;
+	if (valueDesc != -1 && pwrite(valueDesc, "0", 1, 0) != 1) {
+		Log::error("Failed to turn off pin");
 	}
-	if (write(valueDesc, "0", 1) != 1) {
-		printf("Error: Failed to turn off pin\n");
-		return false;
-	}
-	close(valueDesc);
-	return unexportPin(true);
+	closeValueDesc();
+	return true;
 }
-
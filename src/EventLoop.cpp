@@ -0,0 +1,118 @@
+#include "../include/EventLoop.h"
+
+EventLoop::EventLoop() : now_ns(Timer::now_ns()), timers(now_ns) {}
+
+EventLoop::~EventLoop() {
+	if (epollDesc != -1) {
+		close(epollDesc);
+	}
+}
+
+bool EventLoop::setup() {
+	epollDesc = epoll_create1(EPOLL_CLOEXEC);
+	if (epollDesc == -1) {
+		printf("Error: Failed to create epoll instance\n");
+		return false;
+	}
+	now_ns = Timer::now_ns();
+	return wheelTimer.setup() && addFd(wheelTimer.getFd(), EPOLLIN, &onWheelTimer, this);
+}
+
+bool EventLoop::addFd(int fd, uint32_t events, Callback callback, void *context) {
+	for (uint8_t i = 0; i < MAX_HANDLERS; ++i) {
+		if (handlers[i].fd != -1) {
+			continue;
+		}
+
+		struct epoll_event event;
+		event.events = events;
+		event.data.ptr = &handlers[i];
+		if (epoll_ctl(epollDesc, EPOLL_CTL_ADD, fd, &event) == -1) {
+			printf("Error: Failed to add descriptor to epoll instance\n");
+			return false;
+		}
+
+		handlers[i].fd = fd;
+		handlers[i].callback = callback;
+		handlers[i].context = context;
+		return true;
+	}
+	printf("Error: Too many descriptors in event loop\n");
+	return false;
+}
+
+bool EventLoop::removeFd(int fd) {
+	for (uint8_t i = 0; i < MAX_HANDLERS; ++i) {
+		if (handlers[i].fd == fd) {
+			epoll_ctl(epollDesc, EPOLL_CTL_DEL, fd, NULL);
+			handlers[i].fd = -1;
+			handlers[i].callback = nullptr;
+			handlers[i].context = nullptr;
+			return true;
+		}
+	}
+	return false;
+}
+
+int EventLoop::wait(int timeout_ms) {
+	// Timers scheduled since the last wakeup are picked up before sleeping
+	armWheelTimer();
+
+	struct epoll_event events[MAX_HANDLERS];
+	int numEvents = epoll_wait(epollDesc, events, MAX_HANDLERS, timeout_ms);
+	if (numEvents == -1) {
+		if (errno == EINTR) {
+			return 0;
+		}
+		Log::error("Failed to wait for events");
+		return -1;
+	}
+
+	// Due timers run first, whichever descriptor caused the wakeup
+	now_ns = Timer::now_ns();
+	int numCallbacks = timers.advance(now_ns);
+	for (int i = 0; i < numEvents; ++i) {
+		Handler *handler = (Handler*) events[i].data.ptr;
+		if (handler->fd != -1) {
+			handler->callback(handler->context, events[i].events);
+			++numCallbacks;
+		}
+	}
+	if (iterationHistogram && numEvents > 0) {
+		iterationHistogram->record(Timer::now_ns() - now_ns);
+	}
+	return numCallbacks;
+}
+
+uint64_t EventLoop::getNow_ns() const {
+	return now_ns;
+}
+
+TimerWheel *EventLoop::getTimers() {
+	return &timers;
+}
+
+void EventLoop::setIterationHistogram(MetricHistogram *histogram) {
+	iterationHistogram = histogram;
+}
+
+void EventLoop::setTimerLatenessHistogram(MetricHistogram *histogram) {
+	timers.setLatenessHistogram(histogram);
+}
+
+void EventLoop::onWheelTimer(void *context, uint32_t events) {
+	(void)events;
+	EventLoop *loop = (EventLoop*) context;
+	loop->wheelTimer.acknowledge();
+}
+
+void EventLoop::armWheelTimer() {
+	// DeadlineTimer skips the syscall when the deadline has not changed
+	uint64_t deadline_ns = timers.getNextDeadline_ns();
+	if (deadline_ns == 0) {
+		wheelTimer.disarm();
+	}
+	else {
+		wheelTimer.arm(deadline_ns);
+	}
+}
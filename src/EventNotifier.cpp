@@ -0,0 +1,37 @@
+#include "../include/EventNotifier.h"
+
+EventNotifier::EventNotifier() {}
+
+EventNotifier::~EventNotifier() {
+	if (eventDesc != -1) {
+		close(eventDesc);
+	}
+}
+
+bool EventNotifier::setup() {
+	eventDesc = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (eventDesc == -1) {
+		printf("Error: Failed to create eventfd\n");
+		return false;
+	}
+	return true;
+}
+
+void EventNotifier::notify() {
+	uint64_t one = 1;
+	if (write(eventDesc, &one, sizeof(one)) != sizeof(one)) {
+		// Counter is saturated, so the waiting thread is already due to wake
+	}
+}
+
+uint64_t EventNotifier::drain() {
+	uint64_t count = 0;
+	if (read(eventDesc, &count, sizeof(count)) != sizeof(count)) {
+		return 0;
+	}
+	return count;
+}
+
+int EventNotifier::getFd() const {
+	return eventDesc;
+}
@@ -1,39 +1,43 @@
 #include "../include/GPIOExpander.h"
 
-GPIOExpander::GPIOExpander(int i2cFile) : I2CDevice(i2cFile) {}
+GPIOExpander::GPIOExpander(I2CBus *bus, uint8_t addr) : I2CDevice(bus, addr) {}
 GPIOExpander::GPIOExpander() {}
 
 bool GPIOExpander::pinMode(Port port, uint8_t configuration) {
-	uint8_t addr = (port == GPIOExpander::Port::A ? 0 : 1);
-	uint8_t buffer[2] = {addr, configuration};
-	if (write(i2cFile, buffer, 2) != 2) {
-		printf("Error: Failed to write to GPIO expander pin\n");
+	// Turn off all outputs with one write before enabling them
+	if (!writePins(port, pinValues[(uint8_t) port] & configuration)) {
 		return false;
 	}
+	uint8_t reg = IODIRA + (uint8_t) port;
+	uint8_t buffer[2] = {reg, configuration};
+	if (!writeBytes(buffer, 2)) {
+		Log::error("Failed to write to GPIO expander pin");
+		return false;
+	}
+	return true;
+}
 
-	// Turn off all outputs
-	for (uint8_t i = 0; i < 8; ++i) {
-		uint8_t pinIsInput = configuration & 1;
-		if (!pinIsInput) {
-			writePin(port, i, 0);
-		}
-		configuration >>= 1;
+bool GPIOExpander::pinModes(uint8_t configurationA, uint8_t configurationB) {
+	if (!writePorts(pinValues[(uint8_t) Port::A] & configurationA, pinValues[(uint8_t) Port::B] & configurationB)) {
+		return false;
 	}
 
+	// The register pointer advances from IODIRA to IODIRB after the first data byte
+	uint8_t buffer[3] = {IODIRA, configurationA, configurationB};
+	if (!writeBytes(buffer, 3)) {
+		Log::error("Failed to write to GPIO expander pins");
+		return false;
+	}
 	return true;
 }
 
 bool GPIOExpander::writePin(Port port, uint8_t pinNum, bool state) {
-	uint8_t addr = (port == GPIOExpander::Port::A ? 0x12 : 0x13);
-
-	// Set bit at position pinNum to value of state
-	uint8_t newPinValues = 
-		pinValues[(uint8_t) port] ^ 
-		(((-(uint8_t) state) ^ pinValues[(uint8_t) port]) & (1u << pinNum));
+	uint8_t reg = GPIOA + (uint8_t) port;
+	uint8_t newPinValues = setPinValue(pinValues[(uint8_t) port], pinNum, state);
 	
-	uint8_t buffer[2] = {addr, newPinValues};
-	if (write(i2cFile, buffer, 2) != 2) {
-		printf("Error: Failed to write to GPIO expander pin\n");
+	uint8_t buffer[2] = {reg, newPinValues};
+	if (!writeBytes(buffer, 2)) {
+		Log::error("Failed to write to GPIO expander pin");
 		return false;
 	}
 	pinValues[(uint8_t) port] = newPinValues;
@@ -41,20 +45,42 @@ bool GPIOExpander::writePin(Port port, uint8_t pinNum, bool state) {
 }
 
 bool GPIOExpander::writePins(Port port, uint8_t states) {
-	uint8_t addr = (port == GPIOExpander::Port::A ? 0x12 : 0x13);
-	uint8_t buffer[2] = {addr, states};
-	if (write(i2cFile, buffer, 2) != 2) {
-		printf("Error: Failed to write to GPIO expander pin\n");
+	uint8_t reg = GPIOA + (uint8_t) port;
+	uint8_t buffer[2] = {reg, states};
+	if (!writeBytes(buffer, 2)) {
+		Log::error("Failed to write to GPIO expander pin");
 		return false;
 	}
 	pinValues[(uint8_t) port] = states;
 	return true;
 }
 
+bool GPIOExpander::writePorts(uint8_t statesA, uint8_t statesB) {
+	// The register pointer advances from GPIOA to GPIOB after the first data byte
+	uint8_t buffer[3] = {GPIOA, statesA, statesB};
+	if (!writeBytes(buffer, 3)) {
+		Log::error("Failed to write to GPIO expander pins");
+		return false;
+	}
+	pinValues[(uint8_t) Port::A] = statesA;
+	pinValues[(uint8_t) Port::B] = statesB;
+	return true;
+}
+
+bool GPIOExpander::stagePorts(I2CTransaction *transaction, uint8_t statesA, uint8_t statesB) {
+	uint8_t buffer[3] = {GPIOA, statesA, statesB};
+	if (!transaction->addWrite(addr, buffer, 3)) {
+		return false;
+	}
+	pinValues[(uint8_t) Port::A] = statesA;
+	pinValues[(uint8_t) Port::B] = statesB;
+	return true;
+}
+
 bool GPIOExpander::readPin(Port port, uint8_t pinNum, bool *state) {
 	uint8_t states;
 	if (!readPins(port, &states)) {
-		printf("Error: Failed to read from GPIO expander pin\n");
+		Log::error("Failed to read from GPIO expander pin");
 		return false;
 	}
 	*state = (states >> pinNum) & 1;
@@ -62,15 +88,24 @@ bool GPIOExpander::readPin(Port port, uint8_t pinNum, bool *state) {
 }
 
 bool GPIOExpander::readPins(Port port, uint8_t *states) {
-	uint8_t addr = (port == GPIOExpander::Port::A ? 0x12 : 0x13);
-	if (write(i2cFile, &addr, 1) != 1) {
-		printf("Error: Failed to write to GPIO expander pin\n");
+	uint8_t reg = GPIOA + (uint8_t) port;
+	if (!writeBytes(&reg, 1)) {
+		Log::error("Failed to write to GPIO expander pin");
 		return false;
 	}
-	if (read(i2cFile, states, 1) != 1) {
-		printf("Error: Failed to read from GPIO expander pin\n");
+	if (!readBytes(states, 1)) {
+		Log::error("Failed to read from GPIO expander pin");
 		return false;
 	}
 	return true;
 }
 
+
+uint8_t GPIOExpander::getPinValues(Port port) const {
+	return pinValues[(uint8_t) port];
+}
+
+uint8_t GPIOExpander::setPinValue(uint8_t states, uint8_t pinNum, bool state) {
+	// Set bit at position pinNum to value of state
+	return states ^ (((-(uint8_t) state) ^ states) & (1u << pinNum));
+}
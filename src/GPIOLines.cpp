@@ -0,0 +1,41 @@
+#include "../include/GPIOLines.h"
+
+GPIOLines::GPIOLines(const uint8_t *pinNums, uint8_t numLines, bool isOutput) : isOutput(isOutput) {
+	if (numLines > MAX_LINES) {
+		numLines = MAX_LINES;
+	}
+	for (uint8_t i = 0; i < numLines; ++i) {
+		this->pinNums[i] = pinNums[i];
+	}
+	this->numLines = numLines;
+}
+
+GPIOLines::~GPIOLines() {}
+
+void GPIOLines::enableEdgeEvents(uint32_t debouncePeriod_us) {
+	edgeEvents = 1;
+	this->debouncePeriod_us = debouncePeriod_us;
+}
+
+int GPIOLines::getEventFd() const {
+	return -1;
+}
+
+uint32_t GPIOLines::getEventMask() const {
+	return EPOLLIN;
+}
+
+bool GPIOLines::readEdge(uint8_t *line, bool *value, uint64_t *timestamp_ns) {
+	(void)line;
+	(void)value;
+	(void)timestamp_ns;
+	return false;
+}
+
+bool GPIOLines::hasKernelDebounce() const {
+	return false;
+}
+
+uint8_t GPIOLines::getNumLines() const {
+	return numLines;
+}
@@ -5,17 +5,23 @@ GPIOPin::~GPIOPin() {
 }
 
 bool GPIOPin::closePin() {
-	return unexportPin(true);
+	closeValueDesc();
+	return true;
 }
 
 GPIOPin::GPIOPin(uint8_t pinNum) : pinNum(pinNum) {
 	sprintf(pinNumStr, "%d", pinNum);
-	unexportPin(false);
 }
 
 GPIOPin::GPIOPin() {}
 
 bool GPIOPin::exportPin() {
+	char pinPath[28] = "/sys/class/gpio/gpio";
+	strcat(pinPath, pinNumStr);
+	if (access(pinPath, F_OK) == 0) {
+		return true;
+	}
+
 	int exportDesc = open("/sys/class/gpio/export", O_WRONLY);
 	if (exportDesc == -1) {
 		printf("Error: Failed to open /sys/class/gpio/export\n");
@@ -33,33 +39,49 @@ bool GPIOPin::exportPin() {
 }
 
 bool GPIOPin::setDirection(char direction[]) {
-	char directionPath[36] = "/sys/class/gpio/gpio";
-	strcat(directionPath, pinNumStr);
-	strcat(directionPath, "/direction");
-	
-	int directionDesc = open(directionPath, O_WRONLY);
-	if (directionDesc == -1) {
-		printf("Error: Failed to open %s\n", directionPath);
+	return setAttribute("direction", direction);
+}
+
+bool GPIOPin::setAttribute(const char *attribute, const char *value) {
+	char attributePath[40] = "/sys/class/gpio/gpio";
+	strcat(attributePath, pinNumStr);
+	strcat(attributePath, "/");
+	strncat(attributePath, attribute, sizeof(attributePath) - strlen(attributePath) - 1);
+
+	int attributeDesc = open(attributePath, O_RDWR);
+	if (attributeDesc == -1) {
+		printf("Error: Failed to open %s\n", attributePath);
 		return false;
 	}
 
-	uint8_t directionBytes = strlen(direction);
-	if (write(directionDesc, direction, directionBytes) != directionBytes) {
-		printf("Error: Failed to write pin direction\n");
+	// Attribute files read back their value followed by a newline
+	uint8_t valueBytes = strlen(value);
+	char current[16] = {0};
+	ssize_t currentBytes = read(attributeDesc, current, sizeof(current) - 1);
+	if (currentBytes == valueBytes + 1 && strncmp(current, value, valueBytes) == 0) {
+		close(attributeDesc);
+		return true;
+	}
+
+	if (pwrite(attributeDesc, value, valueBytes, 0) != valueBytes) {
+		printf("Error: Failed to write %s\n", attributePath);
+		close(attributeDesc);
 		return false;
 	}
 
-	close(directionDesc);
+	close(attributeDesc);
 	return true;
 }
 
-bool GPIOPin::openPin(int *valueDesc, uint8_t accessType) {
+bool GPIOPin::openPin(uint8_t accessType) {
+	closeValueDesc();
+
 	char valuePath[32] = "/sys/class/gpio/gpio";
 	strcat(valuePath, pinNumStr);
 	strcat(valuePath, "/value");
 	
-	*valueDesc = open(valuePath, accessType);
-	if (*valueDesc == -1) {
+	valueDesc = open(valuePath, accessType);
+	if (valueDesc == -1) {
 		printf("Error: Failed to open %s\n", valuePath);
 		return false;
 	}
@@ -67,6 +89,13 @@ bool GPIOPin::openPin(int *valueDesc, uint8_t accessType) {
 	return true;
 }
 
+void GPIOPin::closeValueDesc() {
+	if (valueDesc != -1) {
+		close(valueDesc);
+		valueDesc = -1;
+	}
+}
+
 bool GPIOPin::unexportPin(bool displayErrors) {
 	int unexportDesc = open("/sys/class/gpio/unexport", O_WRONLY);
 	if (unexportDesc == -1) {
@@ -0,0 +1,85 @@
+#include "../include/I2CBus.h"
+
+I2CTransaction::I2CTransaction() {}
+
+void I2CTransaction::clear() {
+	numMessages = 0;
+	bufferUsed = 0;
+}
+
+bool I2CTransaction::addWrite(uint8_t addr, const uint8_t *data, uint16_t length) {
+	if (numMessages >= MAX_MESSAGES || bufferUsed + length > BUFFER_SIZE) {
+		Log::error("I2C transaction is full");
+		return false;
+	}
+	memcpy(buffer + bufferUsed, data, length);
+
+	struct i2c_msg *message = &messages[numMessages];
+	message->addr = addr;
+	message->flags = 0;
+	message->len = length;
+	message->buf = buffer + bufferUsed;
+
+	bufferUsed += length;
+	++numMessages;
+	return true;
+}
+
+uint8_t I2CTransaction::getNumMessages() const {
+	return numMessages;
+}
+
+I2CBus::I2CBus(int i2cFile) : i2cFile(i2cFile) {}
+
+I2CBus::~I2CBus() {}
+
+bool I2CBus::selectAddress(uint8_t addr) {
+	if (selectedAddr == addr) {
+		return true;
+	}
+	if (ioctl(i2cFile, I2C_SLAVE, addr) < 0) {
+		Log::error("Failed to communicate with I2C device");
+		selectedAddr = NO_ADDRESS;
+		return false;
+	}
+	selectedAddr = addr;
+	return true;
+}
+
+bool I2CBus::write(uint8_t addr, const uint8_t *data, size_t length) {
+	if (!selectAddress(addr)) {
+		return false;
+	}
+	return ::write(i2cFile, data, length) == (ssize_t) length;
+}
+
+bool I2CBus::read(uint8_t addr, uint8_t *data, size_t length) {
+	if (!selectAddress(addr)) {
+		return false;
+	}
+	return ::read(i2cFile, data, length) == (ssize_t) length;
+}
+
+bool I2CBus::transfer(I2CTransaction *transaction) {
+	if (transaction->numMessages == 0) {
+		return true;
+	}
+
+	// I2C_RDWR addresses every message itself and leaves the I2C_SLAVE selection untouched
+	struct i2c_rdwr_ioctl_data data;
+	data.msgs = transaction->messages;
+	data.nmsgs = transaction->numMessages;
+	if (ioctl(i2cFile, I2C_RDWR, &data) != (int) transaction->numMessages) {
+		Log::error("Failed to transfer I2C messages");
+		return false;
+	}
+	return true;
+}
+
+int I2CBus::getFile() const {
+	return i2cFile;
+}
+
+const struct i2c_msg *I2CBus::getMessages(const I2CTransaction *transaction) {
+	return transaction->messages;
+}
@@ -1,13 +1,20 @@
 #include "../include/I2CDevice.h"
 
-I2CDevice::I2CDevice(int i2cFile) : i2cFile(i2cFile) {}
+I2CDevice::I2CDevice(I2CBus *bus, uint8_t addr) : bus(bus), addr(addr) {}
 I2CDevice::I2CDevice() {}
 
-bool I2CDevice::open(uint8_t addr) {
-	if (ioctl(i2cFile, I2C_SLAVE, addr) < 0) {
-		printf("Error: Failed to communicate with I2C device\n");
-		return false;
-	}
-	return true;
+bool I2CDevice::open() {
+	return bus->selectAddress(addr);
 }
 
+uint8_t I2CDevice::getAddress() const {
+	return addr;
+}
+
+bool I2CDevice::writeBytes(const uint8_t *data, size_t length) {
+	return bus->write(addr, data, length);
+}
+
+bool I2CDevice::readBytes(uint8_t *data, size_t length) {
+	return bus->read(addr, data, length);
+}
@@ -1,24 +1,27 @@
 #include "../include/LCD.h"
 
-LCD::LCD(uint8_t ePin, uint8_t rsPin, uint8_t db4Pin, uint8_t db5Pin, uint8_t db6Pin, uint8_t db7Pin) :
-	ePin(ePin), rsPin(rsPin), db4Pin(db4Pin), db5Pin(db5Pin), db6Pin(db6Pin), db7Pin(db7Pin) {}
-
-void LCD::setup() {
-	ePin.setup();
-	rsPin.setup();
-	db4Pin.setup();
-	db5Pin.setup();
-	db6Pin.setup();
-	db7Pin.setup();
-
-	usleep(50000);
-
-	this->ePin.writeValue(0);
-	this->rsPin.writeValue(0);
-	this->db4Pin.writeValue(0);
-	this->db5Pin.writeValue(0);
-	this->db6Pin.writeValue(0);
-	this->db7Pin.writeValue(0);
+LCD::LCD(uint8_t ePin, uint8_t rsPin, uint8_t db4Pin, uint8_t db5Pin, uint8_t db6Pin, uint8_t db7Pin) {
+	uint8_t pinNums[Line::NUM_LINES] = {ePin, rsPin, db4Pin, db5Pin, db6Pin, db7Pin};
+	lines = new SysfsGPIOLines(pinNums, Line::NUM_LINES, true);
+	ownsLines = 1;
+}
+
+LCD::LCD(GPIOLines *lines) : lines(lines) {}
+
+LCD::~LCD() {
+	if (ownsLines) {
+		delete lines;
+	}
+}
+
+void LCD::setup(bool warm) {
+	lines->setup();
+
+	if (!warm) {
+		usleep(50000);
+	}
+
+	lines->setValues((1u << Line::NUM_LINES) - 1, 0);
 
 	writeData(0, 0, 1, 1);
 	usleep(4500);
@@ -45,27 +48,27 @@ void LCD::setup() {
 }
 
 void LCD::setDisplayOn(bool on) {
-	rsPin.writeValue(0);
+	setRS(0);
 	writeData(0, 0, 0, 0);
 	writeData(1, on, 0, 0);
 }
 
 void LCD::clear() {
-	rsPin.writeValue(0);
+	setRS(0);
 	writeData(0, 0, 0, 0);
 	writeData(0, 0, 0, 1);
 	usleep(2000);
 }
 
 void LCD::returnHome() {
-	rsPin.writeValue(0);
+	setRS(0);
 	writeData(0, 0, 0, 0);
 	writeData(0, 0, 1, 0);
 	usleep(2000);
 }
 
 void LCD::setCursorPos(uint8_t row, uint8_t col) {
-	rsPin.writeValue(0);
+	setRS(0);
 	uint8_t pos = row * 0x40 + col;
 
 	writeData(1, (pos & 0b1000000) >> 6, (pos & 0b100000) >> 5, (pos & 0b10000) >> 4);
@@ -73,7 +76,7 @@ void LCD::setCursorPos(uint8_t row, uint8_t col) {
 }
 
 void LCD::writeChar(char character) {
-	rsPin.writeValue(1);
+	setRS(1);
 	bool bits[8] = {0};  // Lower bits ordered first
 	for (uint8_t i = 0; i < 8; ++i) {
 		bits[i] = character & 1;
@@ -89,20 +92,27 @@ void LCD::writeStr(const char *str) {
 	}
 }
 
+void LCD::setRS(bool rs) {
+	lines->setValues(1u << Line::RS, (uint32_t) rs << Line::RS);
+}
+
 void LCD::pulseEnable() {
-	ePin.writeValue(0);
-	usleep(1);
-	ePin.writeValue(1);
+	lines->setValues(1u << Line::E, 1u << Line::E);
 	usleep(1);
-	ePin.writeValue(0);
+	lines->setValues(1u << Line::E, 0);
 	usleep(100);
 }
 
 void LCD::writeData(bool db7, bool db6, bool db5, bool db4) {
-	db7Pin.writeValue(db7);
-	db6Pin.writeValue(db6);
-	db5Pin.writeValue(db5);
-	db4Pin.writeValue(db4);
+	// Data lines and a low enable are set together so the chip backend needs a single ioctl
+	uint32_t mask = (1u << Line::E) | (1u << Line::DB4) | (1u << Line::DB5) | (1u << Line::DB6) | (1u << Line::DB7);
+	uint32_t values =
+		((uint32_t) db4 << Line::DB4) |
+		((uint32_t) db5 << Line::DB5) |
+		((uint32_t) db6 << Line::DB6) |
+		((uint32_t) db7 << Line::DB7);
+	lines->setValues(mask, values);
+	usleep(1);
 	pulseEnable();
 }
 
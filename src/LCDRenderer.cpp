@@ -0,0 +1,122 @@
+#include "../include/LCDRenderer.h"
+
+LCDRenderer::LCDRenderer(LCD *lcd, uint32_t refreshPeriod_us, uint8_t maxCellsPerRefresh) :
+	lcd(lcd), refreshPeriod_us(refreshPeriod_us), maxCellsPerRefresh(maxCellsPerRefresh), renderThread("lcd"), running(false) {
+	for (uint8_t row = 0; row < ROWS; ++row) {
+		for (uint8_t col = 0; col < COLS; ++col) {
+			frame[row][col].store(' ', std::memory_order_relaxed);
+			shown[row][col] = ' ';
+		}
+	}
+}
+
+LCDRenderer::~LCDRenderer() {
+	stop();
+}
+
+bool LCDRenderer::start(bool setupLCD, bool warmLCD) {
+	if (running.load()) {
+		return true;
+	}
+
+	this->setupLCD = setupLCD;
+	this->warmLCD = warmLCD;
+	for (uint8_t row = 0; row < ROWS; ++row) {
+		for (uint8_t col = 0; col < COLS; ++col) {
+			shown[row][col] = ' ';
+		}
+	}
+	cursorRow = 0;
+	cursorCol = 0;
+
+	running.store(true);
+	if (!renderThread.start(&renderLoop, this)) {
+		running.store(false);
+		return false;
+	}
+	return true;
+}
+
+void LCDRenderer::stop() {
+	if (!running.exchange(false)) {
+		return;
+	}
+	renderThread.join();
+	while (render(ROWS * COLS) > 0) {}
+}
+
+void LCDRenderer::setChar(uint8_t row, uint8_t col, char character) {
+	if (row >= ROWS || col >= COLS) {
+		return;
+	}
+	frame[row][col].store(character, std::memory_order_relaxed);
+}
+
+void LCDRenderer::writeStr(uint8_t row, uint8_t col, const char *str) {
+	for (size_t i = 0; str[i] != '\0' && col + i < COLS; ++i) {
+		setChar(row, col + i, str[i]);
+	}
+}
+
+void LCDRenderer::clear() {
+	for (uint8_t row = 0; row < ROWS; ++row) {
+		for (uint8_t col = 0; col < COLS; ++col) {
+			setChar(row, col, ' ');
+		}
+	}
+}
+
+void LCDRenderer::setRefreshBudget(uint32_t refreshPeriod_us, uint8_t maxCellsPerRefresh) {
+	this->refreshPeriod_us.store(refreshPeriod_us);
+	this->maxCellsPerRefresh.store(maxCellsPerRefresh);
+}
+
+void LCDRenderer::setSchedule(const ThreadSchedule &schedule) {
+	renderThread.setSchedule(schedule);
+}
+
+void *LCDRenderer::renderLoop(void *arg) {
+	LCDRenderer *renderer = (LCDRenderer*) arg;
+	if (renderer->setupLCD) {
+		renderer->lcd->setup(renderer->warmLCD);
+	}
+	renderer->lcd->clear();
+	renderer->lcd->returnHome();
+	while (renderer->running.load(std::memory_order_relaxed)) {
+		renderer->render(renderer->maxCellsPerRefresh.load(std::memory_order_relaxed));
+		usleep(renderer->refreshPeriod_us.load(std::memory_order_relaxed));
+	}
+	return nullptr;
+}
+
+uint8_t LCDRenderer::render(uint8_t maxCells) {
+	uint8_t cellsSent = 0;
+	for (uint8_t row = 0; row < ROWS; ++row) {
+		for (uint8_t col = 0; col < COLS; ++col) {
+			char character = frame[row][col].load(std::memory_order_relaxed);
+			if (character == shown[row][col]) {
+				continue;
+			}
+			if (cellsSent >= maxCells) {
+				return cellsSent;
+			}
+
+			if (cursorRow != row || cursorCol != col) {
+				if (cursorRow == row && cursorCol + 1 == col) {
+					// Rewriting the single clean cell in between costs the same as a cursor move
+					lcd->writeChar(shown[row][cursorCol]);
+				}
+				else {
+					lcd->setCursorPos(row, col);
+				}
+			}
+
+			lcd->writeChar(character);
+			shown[row][col] = character;
+			cursorRow = row;
+			cursorCol = col + 1;
+			++cellsSent;
+		}
+	}
+	return cellsSent;
+}
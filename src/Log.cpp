@@ -0,0 +1,311 @@
+#include "../include/Log.h"
+
+namespace {
+	const size_t INDEX_MASK = Log::RING_CAPACITY - 1;
+	const size_t OUTPUT_SIZE = 8192;
+	const size_t THREAD_NAME_SIZE = 16;
+
+	/*
+	 * Records of one thread: that thread pushes and the log thread pops
+	 */
+	struct Ring {
+		// Producer-owned
+		alignas(64) std::atomic<size_t> head{0};
+		std::atomic<uint64_t> dropped{0};
+
+		// Consumer-owned
+		alignas(64) std::atomic<size_t> tail{0};
+		uint64_t reportedDrops = 0;
+
+		char threadName[THREAD_NAME_SIZE] = {0};
+		Log::Record records[Log::RING_CAPACITY];
+	};
+
+	Ring rings[Log::MAX_THREADS];
+	std::atomic<uint8_t> numRings{0};
+	thread_local Ring *threadRing = nullptr;
+
+	std::atomic<uint8_t> minLevel{Log::INFO};
+	std::atomic<bool> running{false};
+	std::atomic<uint64_t> records{0};
+	std::atomic<uint64_t> unclaimedDrops{0};
+	uint64_t start_ns = 0;
+
+	RealTimeThread logThread("log");
+	EventNotifier stopNotifier;
+	char output[OUTPUT_SIZE];
+	size_t outputLength = 0;
+
+	const char *const LEVEL_NAMES[Log::NUM_LEVELS] = {"debug", "info", "warning", "error"};
+	const char *const LEVEL_PREFIXES[Log::NUM_LEVELS] = {"", "", "Warning: ", "Error: "};
+
+	Ring *claimRing() {
+		uint8_t index = numRings.load(std::memory_order_relaxed);
+		do {
+			if (index >= Log::MAX_THREADS) {
+				return nullptr;
+			}
+		} while (!numRings.compare_exchange_weak(index, index + 1, std::memory_order_acq_rel));
+		pthread_getname_np(pthread_self(), rings[index].threadName, THREAD_NAME_SIZE);
+		return &rings[index];
+	}
+
+	void writeOutput() {
+		if (outputLength > 0) {
+			fwrite(output, 1, outputLength, stdout);
+			fflush(stdout);
+			outputLength = 0;
+		}
+	}
+
+	void appendLine(const char *line, size_t length) {
+		if (outputLength + length > OUTPUT_SIZE) {
+			writeOutput();
+		}
+		memcpy(output + outputLength, line, length);
+		outputLength += length;
+	}
+
+	/*
+	 * Write every record queued so far, oldest first across all rings
+	 */
+	void drain() {
+		uint8_t count = numRings.load(std::memory_order_acquire);
+		size_t heads[Log::MAX_THREADS];
+		for (uint8_t i = 0; i < count; ++i) {
+			heads[i] = rings[i].head.load(std::memory_order_acquire);
+		}
+
+		char line[Log::LINE_SIZE];
+		while (true) {
+			Ring *oldest = nullptr;
+			for (uint8_t i = 0; i < count; ++i) {
+				size_t tail = rings[i].tail.load(std::memory_order_relaxed);
+				if (tail == heads[i]) {
+					continue;
+				}
+				const Log::Record &record = rings[i].records[tail & INDEX_MASK];
+				if (!oldest || record.timestamp_ns < oldest->records[oldest->tail.load(std::memory_order_relaxed) & INDEX_MASK].timestamp_ns) {
+					oldest = &rings[i];
+				}
+			}
+			if (!oldest) {
+				break;
+			}
+			size_t tail = oldest->tail.load(std::memory_order_relaxed);
+			appendLine(line, Log::format(oldest->records[tail & INDEX_MASK], start_ns, line, sizeof(line)));
+			oldest->tail.store(tail + 1, std::memory_order_release);
+			records.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		for (uint8_t i = 0; i < count; ++i) {
+			uint64_t dropped = rings[i].dropped.load(std::memory_order_relaxed);
+			if (dropped != rings[i].reportedDrops) {
+				int length = snprintf(line, sizeof(line), "Warning: Dropped %llu log records from the %s thread\n",
+					(unsigned long long) (dropped - rings[i].reportedDrops), rings[i].threadName);
+				appendLine(line, length < (int) sizeof(line) ? length : sizeof(line) - 1);
+				rings[i].reportedDrops = dropped;
+			}
+		}
+		writeOutput();
+	}
+
+	void *logLoop(void *arg) {
+		(void)arg;
+		struct pollfd stopDesc;
+		stopDesc.fd = stopNotifier.getFd();
+		stopDesc.events = POLLIN;
+		while (running.load(std::memory_order_relaxed)) {
+			stopDesc.revents = 0;
+			poll(&stopDesc, 1, Log::FLUSH_INTERVAL_MS);
+			drain();
+		}
+		return nullptr;
+	}
+}
+
+bool Log::start() {
+	if (running.load()) {
+		return true;
+	}
+	if (!stopNotifier.setup()) {
+		return false;
+	}
+	static bool stopAtExit = 0;
+	if (!stopAtExit) {
+		atexit(&Log::stop);
+		stopAtExit = 1;
+	}
+	start_ns = Timer::now_ns();
+	running.store(true, std::memory_order_release);
+	if (!logThread.start(&logLoop, nullptr)) {
+		running.store(false);
+		return false;
+	}
+	return true;
+}
+
+void Log::stop() {
+	if (!running.exchange(false)) {
+		return;
+	}
+	stopNotifier.notify();
+	logThread.join();
+	drain();
+}
+
+void Log::setLevel(Level level) {
+	minLevel.store(level, std::memory_order_relaxed);
+}
+
+Log::Level Log::getLevel() {
+	return (Level) minLevel.load(std::memory_order_relaxed);
+}
+
+bool Log::parseLevel(const char *name, Level *level) {
+	for (uint8_t i = 0; i < NUM_LEVELS; ++i) {
+		if (strcmp(name, LEVEL_NAMES[i]) == 0) {
+			*level = (Level) i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void Log::getStats(Stats *stats) {
+	stats->records = records.load(std::memory_order_relaxed);
+	stats->threads = numRings.load(std::memory_order_acquire);
+	stats->dropped = unclaimedDrops.load(std::memory_order_relaxed);
+	for (uint8_t i = 0; i < stats->threads; ++i) {
+		stats->dropped += rings[i].dropped.load(std::memory_order_relaxed);
+	}
+}
+
+bool Log::isEnabled(Level level) {
+	return level >= minLevel.load(std::memory_order_relaxed);
+}
+
+void Log::record(Level level, const char *format, const Arg *args, uint8_t numArgs) {
+	Record record;
+	record.timestamp_ns = Timer::now_ns();
+	record.format = format;
+	record.level = level;
+	record.numArgs = numArgs;
+	for (uint8_t i = 0; i < numArgs; ++i) {
+		record.args[i] = args[i];
+	}
+
+	if (!running.load(std::memory_order_acquire)) {
+		char line[LINE_SIZE];
+		fwrite(line, 1, Log::format(record, 0, line, sizeof(line)), stdout);
+		records.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	if (!threadRing) {
+		threadRing = claimRing();
+		if (!threadRing) {
+			unclaimedDrops.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+	Ring *ring = threadRing;
+	size_t head = ring->head.load(std::memory_order_relaxed);
+	if (head - ring->tail.load(std::memory_order_acquire) >= RING_CAPACITY) {
+		ring->dropped.store(ring->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return;
+	}
+	ring->records[head & INDEX_MASK] = record;
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+size_t Log::format(const Record &record, uint64_t start_ns, char *line, size_t size) {
+	size_t length = 0;
+	int written = 0;
+	if (start_ns != 0) {
+		written = snprintf(line, size, "[%12.6f] ", (record.timestamp_ns - start_ns) / 1e9);
+		length += written > 0 ? written : 0;
+	}
+	written = snprintf(line + length, size - length, "%s", LEVEL_PREFIXES[record.level]);
+	length += written > 0 ? written : 0;
+
+	// Each conversion is handed to snprintf on its own with the argument widened to the
+	// type it expects; length modifiers in the format are ignored
+	uint8_t argIndex = 0;
+	for (const char *pos = record.format; *pos && length < size - 2; ++pos) {
+		if (*pos != '%') {
+			line[length++] = *pos;
+			continue;
+		}
+		if (pos[1] == '%') {
+			line[length++] = '%';
+			++pos;
+			continue;
+		}
+
+		char spec[16] = {'%'};
+		size_t specLength = 1;
+		++pos;
+		while (*pos && strchr("-+ #0123456789.", *pos) && specLength < sizeof(spec) - 4) {
+			spec[specLength++] = *pos++;
+		}
+		while (*pos && strchr("hlLqjzt", *pos)) {
+			++pos;
+		}
+		if (!*pos) {
+			break;
+		}
+		char conversion = *pos;
+		if (argIndex >= record.numArgs) {
+			written = snprintf(line + length, size - length, "?");
+		}
+		else {
+			const Arg &arg = record.args[argIndex++];
+			if (strchr("di", conversion)) {
+				memcpy(spec + specLength, "lld", 4);
+				written = snprintf(line + length, size - length, spec,
+					arg.type == Arg::Type::DOUBLE ? (long long) arg.d : (long long) arg.i);
+			}
+			else if (strchr("ouxXc", conversion)) {
+				if (conversion == 'c') {
+					spec[specLength] = 'c';
+					spec[specLength + 1] = '\0';
+					written = snprintf(line + length, size - length, spec, (int) arg.i);
+				}
+				else {
+					spec[specLength] = 'l';
+					spec[specLength + 1] = 'l';
+					spec[specLength + 2] = conversion;
+					spec[specLength + 3] = '\0';
+					written = snprintf(line + length, size - length, spec,
+						arg.type == Arg::Type::DOUBLE ? (unsigned long long) arg.d : (unsigned long long) arg.u);
+				}
+			}
+			else if (strchr("fFeEgGaA", conversion)) {
+				spec[specLength] = conversion;
+				spec[specLength + 1] = '\0';
+				double value = arg.d;
+				if (arg.type == Arg::Type::INT) {
+					value = arg.i;
+				}
+				else if (arg.type == Arg::Type::UINT) {
+					value = arg.u;
+				}
+				written = snprintf(line + length, size - length, spec, value);
+			}
+			else if (conversion == 's') {
+				spec[specLength] = 's';
+				spec[specLength + 1] = '\0';
+				written = snprintf(line + length, size - length, spec, arg.type == Arg::Type::STRING ? arg.s : "?");
+			}
+			else {
+				written = snprintf(line + length, size - length, "?");
+			}
+		}
+		if (written > 0) {
+			length += (size_t) written < size - length ? written : size - length - 1;
+		}
+	}
+	line[length++] = '\n';
+	return length;
+}
@@ -0,0 +1,16 @@
+#include "../include/MIDIByteSource.h"
+
+MIDIByteSource::~MIDIByteSource() {}
+
+uint64_t MIDIByteSource::getReadTimestamp_ns() const {
+	return 0;
+}
+
+bool MIDIByteSource::hasPendingInput() {
+	return false;
+}
+
+bool MIDIByteSource::setBlocking(bool blocking) {
+	(void)blocking;
+	return false;
+}
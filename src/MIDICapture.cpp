@@ -0,0 +1,183 @@
+#include "../include/MIDICapture.h"
+
+MIDICapture::MIDICapture() :
+	writerThread("capture"), running(false), head(0), records(0), bytes(0), dropped(0),
+	tail(0), fileBytes(0), writeErrors(0) {
+	static_assert((RING_CAPACITY & (RING_CAPACITY - 1)) == 0, "MIDICapture::RING_CAPACITY must be a power of two");
+}
+
+MIDICapture::~MIDICapture() {
+	stop();
+	delete[] ring;
+}
+
+bool MIDICapture::start(const char *path, const char *const *portNames, uint8_t numPorts) {
+	if (running.load()) {
+		return true;
+	}
+	if (numPorts > MAX_PORTS) {
+		printf("Error: At most %u MIDI ports can be captured\n", MAX_PORTS);
+		return false;
+	}
+	if (!ring) {
+		// Touch every page now rather than on the reader's first records
+		ring = new uint8_t[RING_CAPACITY];
+		memset(ring, 0, RING_CAPACITY);
+	}
+	if (!stopNotifier.setup()) {
+		return false;
+	}
+
+	file = fopen(path, "wb");
+	if (!file) {
+		printf("Error: Failed to create capture file %s\n", path);
+		return false;
+	}
+	Header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.numPorts = numPorts;
+	header.start_ns = Timer::now_ns();
+	for (uint8_t i = 0; i < numPorts; ++i) {
+		strncpy(header.portNames[i], portNames[i], PORT_NAME_SIZE - 1);
+	}
+	if (fwrite(&header, sizeof(header), 1, file) != 1 || fflush(file) != 0) {
+		printf("Error: Failed to write capture file %s\n", path);
+		fclose(file);
+		file = nullptr;
+		return false;
+	}
+	fileBytes.store(sizeof(header), std::memory_order_relaxed);
+	lastTimestamp_ns = header.start_ns;
+
+	running.store(true);
+	if (!writerThread.start(&writeLoop, this)) {
+		running.store(false);
+		fclose(file);
+		file = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void MIDICapture::stop() {
+	if (!running.exchange(false)) {
+		return;
+	}
+	stopNotifier.notify();
+	writerThread.join();
+	drain();
+	fclose(file);
+	file = nullptr;
+}
+
+void MIDICapture::record(uint8_t port, uint64_t timestamp_ns, const uint8_t *data, size_t length) {
+	if (!running.load(std::memory_order_relaxed)) {
+		return;
+	}
+
+	// Sources that timestamp their own input may report a read slightly before the last one
+	uint64_t delta_ns = timestamp_ns > lastTimestamp_ns ? timestamp_ns - lastTimestamp_ns : 0;
+	uint8_t prefix[2 * MAX_VARINT_SIZE + 1];
+	size_t prefixLength = encodeVarint(delta_ns, prefix);
+	prefix[prefixLength++] = port;
+	prefixLength += encodeVarint(length, prefix + prefixLength);
+
+	size_t currentHead = head.load(std::memory_order_relaxed);
+	size_t recordLength = prefixLength + length;
+	if (currentHead + recordLength - cachedTail > RING_CAPACITY) {
+		cachedTail = tail.load(std::memory_order_acquire);
+		if (currentHead + recordLength - cachedTail > RING_CAPACITY) {
+			increment(&dropped);
+			return;
+		}
+	}
+
+	copyIn(currentHead, prefix, prefixLength);
+	copyIn(currentHead + prefixLength, data, length);
+	head.store(currentHead + recordLength, std::memory_order_release);
+	lastTimestamp_ns += delta_ns;
+	increment(&records);
+	increment(&bytes, length);
+}
+
+void MIDICapture::getStats(Stats *stats) const {
+	stats->records = records.load(std::memory_order_relaxed);
+	stats->bytes = bytes.load(std::memory_order_relaxed);
+	stats->dropped = dropped.load(std::memory_order_relaxed);
+	stats->fileBytes = fileBytes.load(std::memory_order_relaxed);
+	stats->writeErrors = writeErrors.load(std::memory_order_relaxed);
+}
+
+size_t MIDICapture::encodeVarint(uint64_t value, uint8_t *out) {
+	size_t length = 0;
+	while (value >= 0x80) {
+		out[length++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	out[length++] = value;
+	return length;
+}
+
+bool MIDICapture::decodeVarint(const uint8_t *data, size_t size, size_t *pos, uint64_t *value) {
+	uint64_t result = 0;
+	for (size_t i = 0; i < MAX_VARINT_SIZE && *pos < size; ++i) {
+		uint8_t byte = data[(*pos)++];
+		result |= (uint64_t) (byte & 0x7F) << (7 * i);
+		if (!(byte & 0x80)) {
+			*value = result;
+			return true;
+		}
+	}
+	return false;
+}
+
+void *MIDICapture::writeLoop(void *arg) {
+	MIDICapture *capture = (MIDICapture*) arg;
+	struct pollfd stopDesc;
+	stopDesc.fd = capture->stopNotifier.getFd();
+	stopDesc.events = POLLIN;
+	while (capture->running.load(std::memory_order_relaxed)) {
+		stopDesc.revents = 0;
+		poll(&stopDesc, 1, FLUSH_INTERVAL_MS);
+		capture->drain();
+	}
+	return nullptr;
+}
+
+void MIDICapture::drain() {
+	size_t currentTail = tail.load(std::memory_order_relaxed);
+	size_t currentHead = head.load(std::memory_order_acquire);
+	if (currentHead == currentTail) {
+		return;
+	}
+
+	// The filled part of the ring may wrap around its end
+	size_t start = currentTail & INDEX_MASK;
+	size_t length = currentHead - currentTail;
+	size_t firstLength = length < RING_CAPACITY - start ? length : RING_CAPACITY - start;
+	bool written = fwrite(ring + start, 1, firstLength, file) == firstLength;
+	if (firstLength < length) {
+		written = fwrite(ring, 1, length - firstLength, file) == length - firstLength && written;
+	}
+	written = fflush(file) == 0 && written;
+	if (written) {
+		increment(&fileBytes, length);
+	}
+	else {
+		increment(&writeErrors);
+	}
+	tail.store(currentHead, std::memory_order_release);
+}
+
+void MIDICapture::copyIn(size_t position, const uint8_t *data, size_t length) {
+	size_t start = position & INDEX_MASK;
+	size_t firstLength = length < RING_CAPACITY - start ? length : RING_CAPACITY - start;
+	memcpy(ring + start, data, firstLength);
+	memcpy(ring, data + firstLength, length - firstLength);
+}
+
+void MIDICapture::increment(std::atomic<uint64_t> *counter, uint64_t amount) {
+	counter->store(counter->load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
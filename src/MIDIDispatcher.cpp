@@ -0,0 +1,81 @@
+#include "../include/MIDIDispatcher.h"
+
+MIDIDispatcher::MIDIDispatcher(OutputManager *outManager) : outManager(outManager) {}
+
+void MIDIDispatcher::setVerbose(bool verbose) {
+	this->verbose = verbose;
+}
+
+void MIDIDispatcher::setMetrics(Metrics *metrics) {
+	this->metrics = metrics;
+}
+
+size_t MIDIDispatcher::dispatchAll(MIDIEventRing *queue) {
+	if (metrics) {
+		metrics->queueDepth.record(queue->getLength());
+	}
+
+	// Events dispatched together (e.g. a chord) reach the outputs in the same I2C batch. A
+	// worker cannot read the posted state while an update is open, so a long drain is committed
+	// in parts.
+	size_t numEvents = 0;
+	outManager->beginBatch();
+	MIDIEvent event;
+	while (queue->pop(&event)) {
+		if (metrics) {
+			uint64_t start_ns = Timer::now_ns();
+			metrics->eventLatency_ns.record(start_ns > event.timestamp_ns ? start_ns - event.timestamp_ns : 0);
+			dispatch(event);
+			metrics->dispatchTime_ns.record(Timer::now_ns() - start_ns);
+		}
+		else {
+			dispatch(event);
+		}
+		++numEvents;
+		if (numEvents % MAX_BATCH_EVENTS == 0) {
+			outManager->endBatch();
+			outManager->beginBatch();
+		}
+	}
+	outManager->endBatch();
+	return numEvents;
+}
+
+void MIDIDispatcher::dispatch(const MIDIEvent &event) {
+	const uint8_t *packet = event.data;
+	if (packet[0] >= 0xF0) {
+		// System messages (clock, transport, SysEx) do not affect the outputs
+		return;
+	}
+	uint8_t command = packet[0] >> 4;
+	uint8_t channel = packet[0] & 0b00001111;
+	if (command == 0b1001 && packet[2] > 0) {
+		// Key pressed
+		if (verbose) {
+			Log::info("Key pressed on channel %d (%d, %d)", channel, packet[1], packet[2]);
+		}
+		outManager->pressKey(packet[1], channel);
+	}
+	else if (command == 0b1000 || command == 0b1001) {
+		// Key released (a Note On with velocity 0 is a Note Off, which running status relies on)
+		if (verbose) {
+			Log::info("Key released on channel %d (%d, %d)", channel, packet[1], packet[2]);
+		}
+		outManager->releaseKey(packet[1], channel);
+	}
+	else if (command == 0b1110) {
+		// Pitch bend
+		if (verbose) {
+			Log::info("Pitch bend on channel %d", channel);
+		}
+	}
+	else if (command == 0b1011 && packet[1] > 122) {
+		if (verbose) {
+			Log::info("Turning all notes off on channel %d", channel);
+		}
+		outManager->turnOffChannel(channel);
+	}
+	else if (verbose) {
+		Log::info("Unknown command %d on channel %d (%d, %d)", command, channel, packet[1], packet[2]);
+	}
+}
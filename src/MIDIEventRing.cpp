@@ -0,0 +1,47 @@
+#include "../include/MIDIEventRing.h"
+
+MIDIEventRing::MIDIEventRing(OverflowPolicy policy) : policy(policy), head(0), overflowCount(0), tail(0) {
+	static_assert((CAPACITY & (CAPACITY - 1)) == 0, "MIDIEventRing::CAPACITY must be a power of two");
+}
+
+bool MIDIEventRing::push(const MIDIEvent &event) {
+	size_t currentHead = head.load(std::memory_order_relaxed);
+	while (currentHead - cachedTail >= CAPACITY) {
+		// Only re-read the consumer's index once the cached copy says the ring is full
+		cachedTail = tail.load(std::memory_order_acquire);
+		if (currentHead - cachedTail < CAPACITY) {
+			break;
+		}
+		if (policy == OverflowPolicy::DROP_NEWEST) {
+			overflowCount.store(overflowCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return false;
+		}
+		sched_yield();
+	}
+
+	events[currentHead & INDEX_MASK] = event;
+	head.store(currentHead + 1, std::memory_order_release);
+	return true;
+}
+
+bool MIDIEventRing::pop(MIDIEvent *event) {
+	size_t currentTail = tail.load(std::memory_order_relaxed);
+	if (currentTail == cachedHead) {
+		cachedHead = head.load(std::memory_order_acquire);
+		if (currentTail == cachedHead) {
+			return false;
+		}
+	}
+
+	*event = events[currentTail & INDEX_MASK];
+	tail.store(currentTail + 1, std::memory_order_release);
+	return true;
+}
+
+size_t MIDIEventRing::getLength() const {
+	return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
+
+uint64_t MIDIEventRing::getOverflowCount() const {
+	return overflowCount.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,351 @@
+#include "../include/MIDIInput.h"
+
+MIDIInput::MIDIInput(MIDIEventRing *queue, EventNotifier *notifier) :
+	queue(queue), notifier(notifier), readerThread("midi"), running(false),
+	polls(0), reads(0), notifies(0) {}
+
+MIDIInput::~MIDIInput() {
+	stop();
+}
+
+bool MIDIInput::addSource(MIDIByteSource *source) {
+	if (numSources >= MAX_SOURCES) {
+		printf("Error: At most %u MIDI sources can be read\n", MAX_SOURCES);
+		return false;
+	}
+	sources[numSources++].source = source;
+	return true;
+}
+
+void MIDIInput::setMetrics(Metrics *metrics) {
+	this->metrics = metrics;
+}
+
+void MIDIInput::setCapture(MIDICapture *capture) {
+	this->capture = capture;
+}
+
+void MIDIInput::setSchedule(const ThreadSchedule &schedule) {
+	readerThread.setSchedule(schedule);
+}
+
+bool MIDIInput::start() {
+	if (running.load()) {
+		return true;
+	}
+	if (numSources == 0) {
+		printf("Error: No MIDI sources to read\n");
+		return false;
+	}
+	if (!stopNotifier.setup()) {
+		return false;
+	}
+	if (metrics) {
+		for (uint8_t i = 0; i < numSources; ++i) {
+			if (!sources[i].metrics) {
+				sources[i].metrics = metrics->addMIDIPort(sources[i].source->getName());
+			}
+		}
+	}
+	running.store(true);
+	if (!readerThread.start(&readLoop, this)) {
+		running.store(false);
+		return false;
+	}
+	return true;
+}
+
+void MIDIInput::stop() {
+	if (!running.exchange(false)) {
+		return;
+	}
+	stopNotifier.notify();
+	readerThread.cancel();
+	readerThread.join();
+	for (uint8_t i = 0; i < numSources; ++i) {
+		sources[i].source->close();
+		sources[i].blocking = 0;
+		sources[i].open.store(false, std::memory_order_relaxed);
+	}
+}
+
+uint8_t MIDIInput::getNumSources() const {
+	return numSources;
+}
+
+MIDIByteSource *MIDIInput::getSource(uint8_t source) const {
+	return source < numSources ? sources[source].source : nullptr;
+}
+
+void MIDIInput::getStats(Stats *stats) const {
+	*stats = Stats();
+	stats->polls = polls.load(std::memory_order_relaxed);
+	stats->reads = reads.load(std::memory_order_relaxed);
+	stats->notifies = notifies.load(std::memory_order_relaxed);
+	for (uint8_t i = 0; i < numSources; ++i) {
+		SourceStats sourceStats;
+		getSourceStats(i, &sourceStats);
+		stats->bytes += sourceStats.bytes;
+		stats->events += sourceStats.events;
+		stats->dropped += sourceStats.dropped;
+		stats->errors += sourceStats.errors;
+		stats->reconnects += sourceStats.reconnects;
+	}
+}
+
+void MIDIInput::getSourceStats(uint8_t source, SourceStats *stats) const {
+	const Source &s = sources[source];
+	stats->bytes = s.bytes.load(std::memory_order_relaxed);
+	stats->events = s.events.load(std::memory_order_relaxed);
+	stats->dropped = s.dropped.load(std::memory_order_relaxed);
+	stats->errors = s.errors.load(std::memory_order_relaxed);
+	stats->reconnects = s.reconnects.load(std::memory_order_relaxed);
+	stats->open = s.open.load(std::memory_order_relaxed);
+}
+
+void *MIDIInput::readLoop(void *arg) {
+	MIDIInput *input = (MIDIInput*) arg;
+	struct pollfd fds[MAX_SOURCES * MAX_DESCRIPTORS + 1];
+
+	// Cancellation is enabled only around blocking reads, so it never interrupts the queue
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, nullptr);
+
+	Source &first = input->sources[0];
+	while (input->running.load(std::memory_order_relaxed)) {
+		// The only source waits in its own read, saving a poll() on every wakeup
+		if (first.blocking) {
+			ssize_t length = input->readOnce(0);
+			if (length < 0) {
+				input->fail(0, Timer::now_ns());
+			}
+			else if (length > 0) {
+				first.backoff_ms = MIN_BACKOFF_MS;
+			}
+			input->flush();
+			continue;
+		}
+
+		// Closed sources are retried on their own deadlines, so an unplugged device only
+		// bounds how long poll() may sleep
+		uint64_t now_ns = Timer::now_ns();
+		uint64_t nextRetry_ns = 0;
+		int numDescriptors = 0;
+		for (uint8_t i = 0; i < input->numSources; ++i) {
+			Source &source = input->sources[i];
+			source.numDescriptors = 0;
+			if (!input->tryOpen(i, now_ns)) {
+				if (nextRetry_ns == 0 || source.retry_ns < nextRetry_ns) {
+					nextRetry_ns = source.retry_ns;
+				}
+				continue;
+			}
+			source.firstDescriptor = numDescriptors;
+			source.numDescriptors = source.source->getPollDescriptors(fds + numDescriptors, MAX_DESCRIPTORS);
+			numDescriptors += source.numDescriptors;
+		}
+		if (first.blocking) {
+			// Opened just now, waited on in its read from the next iteration
+			continue;
+		}
+
+		fds[numDescriptors].fd = input->stopNotifier.getFd();
+		fds[numDescriptors].events = POLLIN;
+		fds[numDescriptors].revents = 0;
+
+		int timeout_ms = -1;
+		if (nextRetry_ns != 0) {
+			timeout_ms = nextRetry_ns > now_ns ? (int) ((nextRetry_ns - now_ns + 999999) / 1000000) : 0;
+		}
+		increment(&input->polls);
+		if (poll(fds, numDescriptors + 1, timeout_ms) < 0) {
+			continue;
+		}
+		if (fds[numDescriptors].revents & POLLIN) {
+			break;
+		}
+
+		now_ns = Timer::now_ns();
+		for (uint8_t i = 0; i < input->numSources; ++i) {
+			Source &source = input->sources[i];
+			if (!source.source->isOpen()) {
+				continue;
+			}
+			unsigned short events = source.numDescriptors > 0 ?
+				source.source->getPollEvents(fds + source.firstDescriptor, source.numDescriptors) : 0;
+			bool failed = events & (POLLERR | POLLHUP | POLLNVAL);
+			if (!failed && ((events & POLLIN) || source.source->hasPendingInput())) {
+				failed = !input->readAvailable(i);
+			}
+			if (failed) {
+				input->fail(i, now_ns);
+			}
+			else if (events & POLLIN) {
+				source.backoff_ms = MIN_BACKOFF_MS;
+			}
+		}
+		input->flush();
+	}
+	input->flush();
+	return nullptr;
+}
+
+bool MIDIInput::tryOpen(uint8_t index, uint64_t now_ns) {
+	Source &source = sources[index];
+	if (source.source->isOpen()) {
+		return true;
+	}
+	if (now_ns < source.retry_ns) {
+		return false;
+	}
+	if (!source.source->open()) {
+		increment(&source.errors);
+		if (source.metrics) {
+			source.metrics->errors.add();
+		}
+		source.retry_ns = now_ns + source.backoff_ms * 1000000ull;
+		source.backoff_ms = source.backoff_ms * 2 < MAX_BACKOFF_MS ? source.backoff_ms * 2 : MAX_BACKOFF_MS;
+		return false;
+	}
+	if (source.opened) {
+		increment(&source.reconnects);
+		if (source.metrics) {
+			source.metrics->reconnects.add();
+		}
+	}
+	source.opened = 1;
+	source.blocking = numSources == 1 && source.source->setBlocking(true);
+	source.parser.reset();
+	source.open.store(true, std::memory_order_relaxed);
+	return true;
+}
+
+void MIDIInput::fail(uint8_t index, uint64_t now_ns) {
+	Source &source = sources[index];
+	increment(&source.errors);
+	if (source.metrics) {
+		source.metrics->errors.add();
+	}
+	source.source->close();
+	source.blocking = 0;
+	source.open.store(false, std::memory_order_relaxed);
+	Log::warning("Lost MIDI port %s, reconnecting", source.source->getName());
+	source.retry_ns = now_ns + source.backoff_ms * 1000000ull;
+	source.backoff_ms = source.backoff_ms * 2 < MAX_BACKOFF_MS ? source.backoff_ms * 2 : MAX_BACKOFF_MS;
+}
+
+ssize_t MIDIInput::readOnce(uint8_t index) {
+	Source &source = sources[index];
+	increment(&reads);
+	if (source.blocking) {
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, nullptr);
+	}
+	ssize_t length = source.source->read(buffer, BUFFER_SIZE);
+	if (source.blocking) {
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, nullptr);
+	}
+	if (length <= 0) {
+		return length;
+	}
+
+	// Bytes read together share one timestamp, the source's own if it has one
+	uint64_t timestamp_ns = source.source->getReadTimestamp_ns();
+	if (timestamp_ns == 0) {
+		timestamp_ns = Timer::now_ns();
+	}
+	if (capture) {
+		capture->record(index, timestamp_ns, buffer, length);
+	}
+	increment(&source.bytes, length);
+	if (metrics) {
+		metrics->midiBytesRead.add(length);
+	}
+	if (source.metrics) {
+		source.metrics->bytes.add(length);
+	}
+	for (ssize_t i = 0; i < length; ++i) {
+		PendingEvent &next = pending[numPending];
+		if (source.parser.parse(buffer[i], timestamp_ns, &next.event)) {
+			next.source = index;
+			++numPending;
+		}
+	}
+	return length;
+}
+
+bool MIDIInput::readAvailable(uint8_t index) {
+	Source &source = sources[index];
+	while (true) {
+		// A full merge buffer is queued early rather than losing events
+		if (MERGE_CAPACITY - numPending < BUFFER_SIZE) {
+			flush();
+		}
+
+		ssize_t length = readOnce(index);
+		if (length < 0) {
+			return false;
+		}
+		if (length == 0) {
+			return true;
+		}
+
+		// Only a full buffer or input the source holds itself can leave more behind
+		if ((size_t) length < BUFFER_SIZE && !source.source->hasPendingInput()) {
+			return true;
+		}
+	}
+}
+
+void MIDIInput::flush() {
+	if (numPending == 0) {
+		return;
+	}
+
+	// Each source's events are already in order, so insertion sort only moves events past
+	// those of other sources read in the same wakeup
+	for (size_t i = 1; i < numPending; ++i) {
+		if (pending[i].event.timestamp_ns >= pending[i - 1].event.timestamp_ns) {
+			continue;
+		}
+		PendingEvent event = pending[i];
+		size_t j = i;
+		while (j > 0 && pending[j - 1].event.timestamp_ns > event.event.timestamp_ns) {
+			pending[j] = pending[j - 1];
+			--j;
+		}
+		pending[j] = event;
+	}
+
+	bool queued = 0;
+	for (size_t i = 0; i < numPending; ++i) {
+		Source &source = sources[pending[i].source];
+		if (queue->push(pending[i].event)) {
+			increment(&source.events);
+			if (metrics) {
+				metrics->midiEventsQueued.add();
+			}
+			if (source.metrics) {
+				source.metrics->events.add();
+			}
+			queued = 1;
+		}
+		else {
+			increment(&source.dropped);
+			if (metrics) {
+				metrics->midiEventsDropped.add();
+			}
+			if (source.metrics) {
+				source.metrics->dropped.add();
+			}
+			Log::warning("MIDI queue full, dropped event from %s", source.source->getName());
+		}
+	}
+	numPending = 0;
+	if (queued) {
+		increment(&notifies);
+		notifier->notify();
+	}
+}
+
+void MIDIInput::increment(std::atomic<uint64_t> *counter, uint64_t amount) {
+	counter->store(counter->load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
@@ -13,13 +13,13 @@ void MIDIPacketQueue::push(uint8_t *packet) {
 		uint8_t **newQueue = new uint8_t*[length + BUFFER_SIZE];
 		
 		// Copy old queue data
-		for (uint8_t i = 0; i < length; ++i) {
+		for (size_t i = 0; i < length; ++i) {
 			newQueue[i] = new uint8_t[PACKET_SIZE];
 			memcpy(newQueue[i], queue[i], PACKET_SIZE);
 		}
 		
 		// Expand to length + BUFFER_SIZE
-		for (uint8_t i = length; i < length + BUFFER_SIZE; ++i) {
+		for (size_t i = length; i < length + BUFFER_SIZE; ++i) {
 			newQueue[i] = new uint8_t[PACKET_SIZE];
 		}
 
@@ -35,7 +35,7 @@ void MIDIPacketQueue::push(uint8_t *packet) {
 }
 
 void MIDIPacketQueue::deallocate() {
-	for (uint8_t i = 0; i < capacity; ++i) {
+	for (size_t i = 0; i < capacity; ++i) {
 		delete[] queue[i];
 	}
 	delete[] queue;
@@ -49,7 +49,7 @@ void MIDIPacketQueue::reset() {
 
 void MIDIPacketQueue::clear() {
 	// Only leave a capacity of BUFFER_SIZE remaining
-	for (uint8_t i = BUFFER_SIZE; i < capacity; ++i) {
+	for (size_t i = BUFFER_SIZE; i < capacity; ++i) {
 		delete[] queue[i];
 	}
 	capacity = BUFFER_SIZE;
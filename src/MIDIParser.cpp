@@ -0,0 +1,162 @@
+#include "../include/MIDIParser.h"
+
+const int8_t MIDIParser::CHANNEL_DATA_LENGTHS[8] = {
+	2,  // 0x8n Note Off
+	2,  // 0x9n Note On
+	2,  // 0xAn Polyphonic Key Pressure
+	2,  // 0xBn Control Change / Channel Mode
+	1,  // 0xCn Program Change
+	1,  // 0xDn Channel Pressure
+	2,  // 0xEn Pitch Bend
+	-1  // 0xFn System, see SYSTEM_DATA_LENGTHS
+};
+
+const int8_t MIDIParser::SYSTEM_DATA_LENGTHS[16] = {
+	-1, // 0xF0 System Exclusive
+	1,  // 0xF1 MIDI Time Code Quarter Frame
+	2,  // 0xF2 Song Position Pointer
+	1,  // 0xF3 Song Select
+	-1, // 0xF4 Undefined
+	-1, // 0xF5 Undefined
+	0,  // 0xF6 Tune Request
+	-1, // 0xF7 End of Exclusive
+	0,  // 0xF8 Timing Clock
+	-1, // 0xF9 Undefined
+	0,  // 0xFA Start
+	0,  // 0xFB Continue
+	0,  // 0xFC Stop
+	-1, // 0xFD Undefined
+	0,  // 0xFE Active Sensing
+	0   // 0xFF System Reset
+};
+
+int8_t MIDIParser::getDataLength(uint8_t status) {
+	if (status < 0x80) {
+		return -1;
+	}
+	if (status < 0xF0) {
+		return CHANNEL_DATA_LENGTHS[(status >> 4) & 0x07];
+	}
+	return SYSTEM_DATA_LENGTHS[status & 0x0F];
+}
+
+bool MIDIParser::parse(uint8_t byte, uint64_t timestamp_ns, MIDIEvent *event) {
+	if (byte >= 0xF8) {
+		// Real-time: passes through anything, including SysEx, without changing the parser state
+		if (getDataLength(byte) < 0) {
+			return false;
+		}
+		return emit(byte, 0, timestamp_ns, event);
+	}
+
+	if (byte == 0xF7 && inSysEx) {
+		// End of Exclusive, which also cancels running status
+		inSysEx = 0;
+		status = 0;
+		dataLength = -1;
+		return finishSysEx(timestamp_ns, event);
+	}
+
+	if (byte >= 0x80) {
+		// Any other status byte abandons a partial message or SysEx
+		if (inSysEx || (dataLength > 0 && dataCount > 0)) {
+			++stats.interrupted;
+		}
+		inSysEx = 0;
+		dataCount = 0;
+
+		if (byte == 0xF0) {
+			inSysEx = 1;
+			sysExLength = 0;
+			sysExOverflowed = 0;
+			status = 0;
+			dataLength = -1;
+			return false;
+		}
+
+		int8_t length = getDataLength(byte);
+		if (byte >= 0xF0) {
+			// System common messages cancel running status; undefined ones are dropped
+			status = length > 0 ? byte : 0;
+			dataLength = length > 0 ? length : -1;
+			if (length == 0) {
+				return emit(byte, 0, timestamp_ns, event);
+			}
+			return false;
+		}
+
+		status = byte;
+		dataLength = length;
+		return false;
+	}
+
+	// Data byte
+	if (inSysEx) {
+		if (sysExLength < SYSEX_CAPACITY) {
+			sysEx[sysExLength++] = byte;
+		}
+		else {
+			sysExOverflowed = 1;
+		}
+		return false;
+	}
+	if (dataLength <= 0) {
+		++stats.strayBytes;
+		return false;
+	}
+
+	data[dataCount++] = byte;
+	if (dataCount < dataLength) {
+		return false;
+	}
+
+	// Channel messages keep their status for running status; system common messages do not
+	uint8_t statusByte = status;
+	uint8_t numData = dataCount;
+	dataCount = 0;
+	if (statusByte >= 0xF0) {
+		status = 0;
+		dataLength = -1;
+	}
+	return emit(statusByte, numData, timestamp_ns, event);
+}
+
+void MIDIParser::reset() {
+	status = 0;
+	dataCount = 0;
+	dataLength = -1;
+	inSysEx = 0;
+	sysExLength = 0;
+	sysExOverflowed = 0;
+}
+
+const uint8_t *MIDIParser::getSysEx(size_t *length) const {
+	*length = sysExLength;
+	return sysEx;
+}
+
+const MIDIParser::Stats &MIDIParser::getStats() const {
+	return stats;
+}
+
+bool MIDIParser::finishSysEx(uint64_t timestamp_ns, MIDIEvent *event) {
+	++stats.sysEx;
+	if (sysExOverflowed) {
+		++stats.sysExOverflow;
+	}
+	return emit(0xF0, 0, timestamp_ns, event);
+}
+
+bool MIDIParser::emit(uint8_t statusByte, uint8_t numData, uint64_t timestamp_ns, MIDIEvent *event) {
+	event->timestamp_ns = timestamp_ns;
+	event->data[0] = statusByte;
+	for (uint8_t i = 0; i < numData; ++i) {
+		event->data[1 + i] = data[i];
+	}
+	for (uint8_t i = numData; i < MIDIEvent::MAX_LENGTH - 1; ++i) {
+		event->data[1 + i] = 0;
+	}
+	event->length = 1 + numData;
+	++stats.messages;
+	return true;
+}
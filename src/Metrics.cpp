@@ -0,0 +1,248 @@
+#include "../include/Metrics.h"
+
+MetricCounter::MetricCounter() : value(0) {}
+
+void MetricCounter::add(uint64_t amount) {
+	value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+uint64_t MetricCounter::get() const {
+	return value.load(std::memory_order_relaxed);
+}
+
+MetricHistogram::MetricHistogram() : count(0), sum(0), max(0) {
+	for (uint16_t i = 0; i < NUM_BUCKETS; ++i) {
+		buckets[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void MetricHistogram::record(uint64_t value) {
+	std::atomic<uint64_t> &bucket = buckets[getBucket(value)];
+	bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	sum.store(sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	if (value > max.load(std::memory_order_relaxed)) {
+		max.store(value, std::memory_order_relaxed);
+	}
+	count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void MetricHistogram::merge(const MetricHistogram &other) {
+	for (uint16_t i = 0; i < NUM_BUCKETS; ++i) {
+		buckets[i].store(buckets[i].load(std::memory_order_relaxed) + other.getBucketCount(i), std::memory_order_relaxed);
+	}
+	sum.store(sum.load(std::memory_order_relaxed) + other.getSum(), std::memory_order_relaxed);
+	if (other.getMax() > max.load(std::memory_order_relaxed)) {
+		max.store(other.getMax(), std::memory_order_relaxed);
+	}
+	count.store(count.load(std::memory_order_relaxed) + other.getCount(), std::memory_order_relaxed);
+}
+
+uint64_t MetricHistogram::getCount() const {
+	return count.load(std::memory_order_relaxed);
+}
+
+uint64_t MetricHistogram::getSum() const {
+	return sum.load(std::memory_order_relaxed);
+}
+
+uint64_t MetricHistogram::getMax() const {
+	return max.load(std::memory_order_relaxed);
+}
+
+uint64_t MetricHistogram::getBucketCount(uint16_t bucket) const {
+	return buckets[bucket].load(std::memory_order_relaxed);
+}
+
+uint64_t MetricHistogram::percentile(double fraction) const {
+	// Bucket counts are summed rather than using count, which a reader may see out of step
+	uint64_t total = 0;
+	for (uint16_t i = 0; i < NUM_BUCKETS; ++i) {
+		total += getBucketCount(i);
+	}
+	if (total == 0) {
+		return 0;
+	}
+
+	uint64_t rank = (uint64_t) (fraction * (total - 1) + 0.5) + 1;
+	uint64_t seen = 0;
+	for (uint16_t i = 0; i < NUM_BUCKETS; ++i) {
+		seen += getBucketCount(i);
+		if (seen >= rank) {
+			return getBucketStart(i);
+		}
+	}
+	return getMax();
+}
+
+uint16_t MetricHistogram::getBucket(uint64_t value) {
+	if (value < SUB_BUCKETS) {
+		return value;
+	}
+	uint8_t msb = 63 - __builtin_clzll(value);
+	uint8_t shift = msb - SUB_BUCKET_BITS;
+	uint8_t subBucket = (value >> shift) & (SUB_BUCKETS - 1);
+	return (shift + 1) * SUB_BUCKETS + subBucket;
+}
+
+uint64_t MetricHistogram::getBucketStart(uint16_t bucket) {
+	if (bucket < SUB_BUCKETS) {
+		return bucket;
+	}
+	uint8_t shift = bucket / SUB_BUCKETS - 1;
+	uint64_t subBucket = bucket % SUB_BUCKETS;
+	return (SUB_BUCKETS + subBucket) << shift;
+}
+
+Metrics::Metrics() : magic(0), numMIDIPorts(0), numBuses(0), numI2CDevices(0) {
+	for (uint8_t i = 0; i < MAX_MIDI_PORTS; ++i) {
+		midiPorts[i].name[0] = '\0';
+	}
+	for (uint8_t i = 0; i < MAX_I2C_DEVICES; ++i) {
+		i2cDevices[i].bus.store(0, std::memory_order_relaxed);
+		i2cDevices[i].addr.store(0, std::memory_order_relaxed);
+	}
+}
+
+Metrics::BusMetrics *Metrics::getBus(uint8_t bus) {
+	if (bus >= MAX_BUSES) {
+		return nullptr;
+	}
+	if (bus >= numBuses.load(std::memory_order_relaxed)) {
+		numBuses.store(bus + 1, std::memory_order_release);
+	}
+	return &buses[bus];
+}
+
+MetricHistogram *Metrics::getI2CDevice(uint8_t bus, uint8_t addr) {
+	uint8_t numDevices = numI2CDevices.load(std::memory_order_relaxed);
+	for (uint8_t i = 0; i < numDevices; ++i) {
+		if (i2cDevices[i].bus.load(std::memory_order_relaxed) == bus && i2cDevices[i].addr.load(std::memory_order_relaxed) == addr) {
+			return &i2cDevices[i].transferTime_ns;
+		}
+	}
+	if (numDevices >= MAX_I2C_DEVICES) {
+		return nullptr;
+	}
+	i2cDevices[numDevices].bus.store(bus, std::memory_order_relaxed);
+	i2cDevices[numDevices].addr.store(addr, std::memory_order_relaxed);
+	numI2CDevices.store(numDevices + 1, std::memory_order_release);
+	return &i2cDevices[numDevices].transferTime_ns;
+}
+
+Metrics::MIDIPortMetrics *Metrics::addMIDIPort(const char *name) {
+	uint8_t port = numMIDIPorts.load(std::memory_order_relaxed);
+	if (port >= MAX_MIDI_PORTS) {
+		return nullptr;
+	}
+	snprintf(midiPorts[port].name, MIDI_PORT_NAME_SIZE, "%s", name);
+	numMIDIPorts.store(port + 1, std::memory_order_release);
+	return &midiPorts[port];
+}
+
+uint64_t Metrics::getI2CFailures() const {
+	uint64_t total = 0;
+	for (uint8_t i = 0; i < numBuses.load(std::memory_order_acquire) && i < MAX_BUSES; ++i) {
+		total += buses[i].failures.get();
+	}
+	return total;
+}
+
+void Metrics::mergeTriggerErrors(MetricHistogram *total) const {
+	for (uint8_t i = 0; i < numBuses.load(std::memory_order_acquire) && i < MAX_BUSES; ++i) {
+		total->merge(buses[i].triggerError_ns);
+	}
+}
+
+MetricsSegment::MetricsSegment() {}
+
+MetricsSegment::~MetricsSegment() {
+	if (!metrics) {
+		return;
+	}
+	if (owner) {
+		metrics->~Metrics();
+	}
+	munmap(metrics, sizeof(Metrics));
+	if (owner && name) {
+		shm_unlink(name);
+	}
+}
+
+bool MetricsSegment::create(const char *name) {
+	void *memory;
+	if (name) {
+		shm_unlink(name);
+		int shmDesc = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+		if (shmDesc == -1) {
+			printf("Error: Failed to create shared memory %s\n", name);
+			return false;
+		}
+		if (ftruncate(shmDesc, sizeof(Metrics)) == -1) {
+			printf("Error: Failed to size shared memory %s\n", name);
+			close(shmDesc);
+			shm_unlink(name);
+			return false;
+		}
+		memory = mmap(NULL, sizeof(Metrics), PROT_READ | PROT_WRITE, MAP_SHARED, shmDesc, 0);
+		close(shmDesc);
+	}
+	else {
+		memory = mmap(NULL, sizeof(Metrics), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	}
+	if (memory == MAP_FAILED) {
+		printf("Error: Failed to map metrics\n");
+		if (name) {
+			shm_unlink(name);
+		}
+		return false;
+	}
+
+	metrics = new (memory) Metrics();
+	metrics->pid = getpid();
+	metrics->start_ns = Timer::now_ns();
+	metrics->magic.store(Metrics::MAGIC, std::memory_order_release);
+
+	this->name = name;
+	owner = 1;
+	return true;
+}
+
+bool MetricsSegment::open(const char *name) {
+	int shmDesc = shm_open(name, O_RDONLY, 0);
+	if (shmDesc == -1) {
+		printf("Error: Failed to open shared memory %s\n", name);
+		return false;
+	}
+	struct stat info;
+	if (fstat(shmDesc, &info) == -1 || (size_t) info.st_size < sizeof(Metrics)) {
+		printf("Error: Shared memory %s is too small for the metrics\n", name);
+		close(shmDesc);
+		return false;
+	}
+	void *memory = mmap(NULL, sizeof(Metrics), PROT_READ, MAP_SHARED, shmDesc, 0);
+	close(shmDesc);
+	if (memory == MAP_FAILED) {
+		printf("Error: Failed to map metrics\n");
+		return false;
+	}
+
+	Metrics *mapped = (Metrics*) memory;
+	if (mapped->magic.load(std::memory_order_acquire) != Metrics::MAGIC || mapped->version != Metrics::VERSION) {
+		printf("Error: Shared memory %s does not hold version %u metrics\n", name, Metrics::VERSION);
+		munmap(memory, sizeof(Metrics));
+		return false;
+	}
+
+	metrics = mapped;
+	this->name = name;
+	owner = 0;
+	return true;
+}
+
+Metrics *MetricsSegment::get() {
+	return metrics;
+}
+
+const Metrics *MetricsSegment::get() const {
+	return metrics;
+}
@@ -0,0 +1,112 @@
+#include "../include/OutputBank.h"
+
+static_assert(OutputTopology::MAX_BUSES <= 8, "Updating workers are kept in a byte");
+
+OutputBank::OutputBank(const OutputTopology *topology, I2CBus *const *buses) :
+	numWorkers(topology->getNumBuses()), numOutputs(topology->getNumOutputs()) {
+	for (uint8_t i = 0; i < numWorkers; ++i) {
+		workers[i] = new OutputWorker(buses[i], topology, i);
+		firstOutputs[i] = topology->getBus(i).firstOutput;
+	}
+	for (uint8_t i = 0; i < numOutputs; ++i) {
+		outputWorkers[i] = topology->getOutput(i).bus;
+	}
+}
+
+OutputBank::~OutputBank() {
+	for (uint8_t i = 0; i < numWorkers; ++i) {
+		delete workers[i];
+	}
+}
+
+bool OutputBank::start() {
+	for (uint8_t i = 0; i < numWorkers; ++i) {
+		if (!workers[i]->start()) {
+			stop();
+			return false;
+		}
+	}
+	return true;
+}
+
+void OutputBank::stop() {
+	for (uint8_t i = 0; i < numWorkers; ++i) {
+		workers[i]->stop();
+	}
+}
+
+uint8_t OutputBank::getNumOutputs() const {
+	return numOutputs;
+}
+
+uint8_t OutputBank::getNumWorkers() const {
+	return numWorkers;
+}
+
+OutputWorker *OutputBank::getWorker(uint8_t bus) {
+	return workers[bus];
+}
+
+void OutputBank::beginUpdate() {
+	// Workers are begun on first use, so an update touching one bus wakes only its worker
+	updating = 0;
+}
+
+void OutputBank::setGate(uint8_t output, bool on) {
+	getUpdating(output)->setGate(output - firstOutputs[outputWorkers[output]], on);
+}
+
+void OutputBank::setPitch(uint8_t output, uint16_t dacValue) {
+	getUpdating(output)->setPitch(output - firstOutputs[outputWorkers[output]], dacValue);
+}
+
+void OutputBank::startTrigger(uint8_t output) {
+	getUpdating(output)->startTrigger(output - firstOutputs[outputWorkers[output]]);
+}
+
+void OutputBank::stopTrigger(uint8_t output) {
+	getUpdating(output)->stopTrigger(output - firstOutputs[outputWorkers[output]]);
+}
+
+void OutputBank::commit() {
+	while (updating) {
+		uint8_t worker = __builtin_ctz(updating);
+		workers[worker]->commit();
+		updating &= updating - 1;
+	}
+}
+
+bool OutputBank::setTriggerWidth(uint8_t output, uint64_t width_ns) {
+	if (output >= numOutputs) {
+		printf("Error: Invalid output %u\n", output + 1);
+		return false;
+	}
+	uint8_t worker = outputWorkers[output];
+	return workers[worker]->setTriggerWidth(output - firstOutputs[worker], width_ns);
+}
+
+uint64_t OutputBank::getTriggerWidth(uint8_t output) const {
+	uint8_t worker = outputWorkers[output];
+	return workers[worker]->getTriggerWidth(output - firstOutputs[worker]);
+}
+
+void OutputBank::setMetrics(Metrics *metrics) {
+	for (uint8_t i = 0; i < numWorkers; ++i) {
+		workers[i]->setMetrics(metrics);
+	}
+}
+
+void OutputBank::setSchedule(const ThreadSchedule &schedule) {
+	for (uint8_t i = 0; i < numWorkers; ++i) {
+		workers[i]->setSchedule(schedule);
+	}
+}
+
+OutputWorker *OutputBank::getUpdating(uint8_t output) {
+	uint8_t worker = outputWorkers[output];
+	if (!(updating & 1 << worker)) {
+		workers[worker]->beginUpdate();
+		updating |= 1 << worker;
+	}
+	return workers[worker];
+}
@@ -1,151 +1,172 @@
 #include "../include/OutputManager.h"
 
-OutputManager::OutputManager(int i2cFile, LCD *lcd, DebouncedButton *outputButton, DebouncedButton *channelButton) : i2cFile(i2cFile), dac(i2cFile), gpio(i2cFile), lcd(lcd), outputButton(outputButton), channelButton(channelButton) {
-	gpio.open(GPIO_ADDR);
-	gpio.pinMode(GPIOExpander::Port::A, 0);
-	gpio.pinMode(GPIOExpander::Port::B, 0);
+static_assert(PitchCalibration::MAX_OUTPUTS >= OutputTopology::MAX_OUTPUTS, "Every output needs a pitch table");
+static_assert(VoiceAllocator::MAX_VOICES >= OutputTopology::MAX_OUTPUTS, "Every output needs a voice");
 
-	lcd->clear();
-	lcd->returnHome();
-	lcd->writeStr("Output  -2345678");
-	lcd->setCursorPos(1, 0);
-	lcd->writeStr("Channel 11111111");
+OutputManager::OutputManager(OutputBank *bank, EventLoop *loop, LCDRenderer *display, DebouncedButton *outputButton, DebouncedButton *channelButton) :
+	numOutputs(bank->getNumOutputs()), voices(numOutputs), calibration(numOutputs), bank(bank), loop(loop), display(display),
+	outputButton(outputButton), channelButton(channelButton) {
+	lcdShowPage();
 }
 
-void OutputManager::pressKey(uint8_t noteId, uint8_t channel) {
-	bool channelSet = 0;
-	bool outputFound = 0;
-	uint8_t outputIndex = 0;
-	
-	// First: look for free output with correct channel
-	for (uint8_t i = 0; i < NUM_OUTPUTS; ++i) {
-		if (outputs[i].channel == channel) {
-			// One of the outputs is set to this MIDI channel
-			channelSet = 1;
-			if (!outputs[i].gateIsOn) {
-				// Current output is not being used
-				outputFound = 1;
-				outputIndex = i;
-				break;
-			}
-		}
-	}
-
-	if (!channelSet) {
-		// No outputs set to correct channel, MIDI event ignored
-		return;
-	}
+void OutputManager::beginBatch() {
+	bank->beginUpdate();
+	inBatch = 1;
+}
 
-	// No free outputs but an output is set to correct channel
-	if (!outputFound) {
-		bool longestGateOnTimeSet = 0;
-		double longestGateOnTime = 0;
+void OutputManager::endBatch() {
+	inBatch = 0;
+	bank->commit();
+}
 
-		// Overwrite output that has been on the longest
-		for (uint8_t i = 0; i < NUM_OUTPUTS; ++i) {
-			if (outputs[i].channel != channel) {
-				continue;
-			}
-			if (!longestGateOnTimeSet || outputs[i].gateOnTimer.get_s() > longestGateOnTime) {
-				longestGateOnTimeSet = 1;
-				longestGateOnTime = outputs[i].gateOnTimer.get_s();
-				outputIndex = i;
-			}
-		}
+void OutputManager::pressKey(uint8_t noteId, uint8_t channel) {
+	VoiceAllocator::Change change;
+	if (voices.noteOn(noteId, channel, &change)) {
+		applyVoiceChange(change);
 	}
-
-	outputs[outputIndex].noteId = noteId;
-	outputs[outputIndex].gateIsOn = 1;
-	outputs[outputIndex].gateOnTimer.set();
-	outputs[outputIndex].triggerIsOn = 1;
-	outputs[outputIndex].triggerOnTimer.set();
-
-	gpio.open(GPIO_ADDR);
-	gpio.writePin(GPIOExpander::Port::A, outputIndex, 1);  // Gate
-	gpio.writePin(GPIOExpander::Port::B, outputIndex, 1);  // Trigger
-
-	double outVoltage = noteId / 12.0;
-	uint16_t dacVal = (uint16_t) (outVoltage / 5.0 * 4095);
-
-	dac.open(DAC_ADDR);
-	dac.writeData(dacVal, DAC::Command::WRITE_UPDATE, outputIndex);
 }
 
 void OutputManager::releaseKey(uint8_t noteId, uint8_t channel) {
-	for (uint8_t i = 0; i < NUM_OUTPUTS; ++i) {
-		if (outputs[i].noteId == noteId && outputs[i].channel == channel) {
-			outputs[i].gateIsOn = 0;
-			
-			gpio.open(GPIO_ADDR);
-			gpio.writePin(GPIOExpander::Port::A, i, 0);
-		}
+	VoiceAllocator::Change change;
+	if (voices.noteOff(noteId, channel, &change)) {
+		applyVoiceChange(change);
 	}
 }
 
 void OutputManager::turnOffChannel(uint8_t channel) {
-	for (uint8_t i = 0; i < NUM_OUTPUTS; ++i) {
-		if (outputs[i].channel == channel) {
-			outputs[i].gateIsOn = 0;
-			outputs[i].triggerIsOn = 0;
-
-			gpio.open(GPIO_ADDR);
-			gpio.writePin(GPIOExpander::Port::A, i, 0);
-			gpio.writePin(GPIOExpander::Port::B, i, 0);
+	voices.releaseChannel(channel);
+	beginUpdate();
+	for (uint8_t i = 0; i < numOutputs; ++i) {
+		if (voices.getChannel(i) == channel) {
+			bank->setGate(i, 0);
+			bank->stopTrigger(i);
 		}
 	}
+	commitUpdate();
 }
 
-void OutputManager::updateTriggers() {
-	for (uint8_t i = 0; i < NUM_OUTPUTS; ++i) {
-		if (outputs[i].triggerIsOn && outputs[i].triggerOnTimer.get_ms() >= 1) {
-			outputs[i].triggerIsOn = 0;
+void OutputManager::setVoicePolicy(VoiceAllocator::Policy policy) {
+	voices.setPolicy(policy);
+}
 
-			gpio.open(GPIO_ADDR);
-	 		gpio.writePin(GPIOExpander::Port::B, i, 0);
+bool OutputManager::loadCalibration(const char *path) {
+	return calibration.load(path);
+}
+
+void OutputManager::restoreState(ControllerState *state) {
+	this->state = state;
+	if (state->isRestored()) {
+		for (uint8_t i = 0; i < numOutputs; ++i) {
+			uint8_t channel = state->getChannel(i);
+			if (channel < PANEL_CHANNELS && channel != voices.getChannel(i)) {
+				voices.assign(i, channel);
+			}
 		}
-	}		
+		if (state->getSelectedOutput() < numOutputs) {
+			selectedOutput = state->getSelectedOutput();
+		}
+	}
+
+	// Write back the map in use, which replaces kept channels that were out of range
+	for (uint8_t i = 0; i < numOutputs; ++i) {
+		state->setChannel(i, voices.getChannel(i));
+	}
+	state->setSelectedOutput(selectedOutput);
+	lcdShowPage();
 }
 
 void OutputManager::updateSelectedOutput() {
-	if (outputButton->wasClicked()) {
+	if (outputButton->wasClicked(loop->getNow_ns())) {
 		lcdDeselectOutput();
 		++selectedOutput;
-		if (selectedOutput >= NUM_OUTPUTS) {
+		if (selectedOutput >= numOutputs) {
 			selectedOutput = 0;
 		}
-		lcdSelectOutput();
+		if (state) {
+			state->setSelectedOutput(selectedOutput);
+		}
+		if (selectedOutput % OUTPUTS_PER_PAGE == 0) {
+			lcdShowPage();
+		}
+		else {
+			lcdSelectOutput();
+		}
 	}
 }
 
 void OutputManager::updateChannelAssignments() {
-	if (channelButton->wasClicked()) {
-		++outputs[selectedOutput].channel;
-		if (outputs[selectedOutput].channel >= NUM_OUTPUTS) {
-			outputs[selectedOutput].channel = 0;
+	if (channelButton->wasClicked(loop->getNow_ns())) {
+		uint8_t channel = voices.getChannel(selectedOutput) + 1;
+		if (channel >= PANEL_CHANNELS) {
+			channel = 0;
+		}
+		voices.assign(selectedOutput, channel);
+		if (state) {
+			state->setChannel(selectedOutput, channel);
 		}
 		lcdSetChannel();
 
-		outputs[selectedOutput].gateIsOn = 0;
-		outputs[selectedOutput].triggerIsOn = 0;
-		
-		gpio.open(GPIO_ADDR);
-		gpio.writePin(GPIOExpander::Port::A, selectedOutput, 0);
-		gpio.writePin(GPIOExpander::Port::B, selectedOutput, 0);
+		beginUpdate();
+		bank->setGate(selectedOutput, 0);
+		bank->stopTrigger(selectedOutput);
+		commitUpdate();
+	}
+}
+
+void OutputManager::beginUpdate() {
+	if (!inBatch) {
+		bank->beginUpdate();
+	}
+}
+
+void OutputManager::commitUpdate() {
+	if (!inBatch) {
+		bank->commit();
+	}
+}
+
+void OutputManager::applyVoiceChange(const VoiceAllocator::Change &change) {
+	// Gate, trigger and pitch go out together in the next I2C batch of the output's bus
+	beginUpdate();
+	bank->setGate(change.voice, change.gate);
+	if (change.retrigger) {
+		bank->startTrigger(change.voice);
+	}
+	if (change.gate) {
+		bank->setPitch(change.voice, calibration.getValue(change.voice, change.note));
 	}
+	commitUpdate();
+}
+
+void OutputManager::lcdShowPage() {
+	// With more than one page, the label names the page and the digits count within it
+	uint8_t first = selectedOutput - selectedOutput % OUTPUTS_PER_PAGE;
+	char label[OUTPUTS_PER_PAGE + 1];
+	if (numOutputs > OUTPUTS_PER_PAGE) {
+		snprintf(label, sizeof(label), "Page %-3u", first / OUTPUTS_PER_PAGE + 1);
+	}
+	else {
+		snprintf(label, sizeof(label), "Output  ");
+	}
+	display->clear();
+	display->writeStr(0, 0, label);
+	display->writeStr(1, 0, "Channel ");
+	for (uint8_t i = first; i < numOutputs && i < first + OUTPUTS_PER_PAGE; ++i) {
+		display->setChar(0, i - first + 8, '0' + i - first + 1);
+		display->setChar(1, i - first + 8, '0' + voices.getChannel(i) + 1);
+	}
+	lcdSelectOutput();
 }
 
 void OutputManager::lcdDeselectOutput() {
-	lcd->setCursorPos(0, selectedOutput + 8);
-	lcd->writeChar('0' + selectedOutput + 1);
+	uint8_t column = selectedOutput % OUTPUTS_PER_PAGE;
+	display->setChar(0, column + 8, '0' + column + 1);
 }
 
 void OutputManager::lcdSelectOutput() {
-	lcd->setCursorPos(0, selectedOutput + 8);
-	lcd->writeChar('-');
+	display->setChar(0, selectedOutput % OUTPUTS_PER_PAGE + 8, '-');
 }
 
 void OutputManager::lcdSetChannel() {
-	lcd->setCursorPos(1, selectedOutput + 8);
-	lcd->writeChar('0' + outputs[selectedOutput].channel + 1);
+	display->setChar(1, selectedOutput % OUTPUTS_PER_PAGE + 8, '0' + voices.getChannel(selectedOutput) + 1);
 }
-
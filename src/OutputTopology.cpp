@@ -0,0 +1,245 @@
+#include "../include/OutputTopology.h"
+
+OutputTopology::OutputTopology() {
+	addBus(DEFAULT_DEVICE, 0);
+	for (uint8_t i = 0; i < 8; ++i) {
+		Output output;
+		if (i < DAC::NUM_CHANNELS) {
+			output.dacAddr = DEFAULT_DAC_ADDR;
+			output.dacChannel = i;
+		}
+		output.gpioAddr = DEFAULT_GPIO_ADDR;
+		output.gatePin = i;
+		output.triggerPin = 8 + i;
+		addOutput(output, 0);
+	}
+}
+
+bool OutputTopology::load(const char *path) {
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		printf("Error: Failed to open topology file %s\n", path);
+		return false;
+	}
+
+	OutputTopology loaded;
+	loaded.clear();
+	char line[MAX_LINE_LENGTH];
+	unsigned lineNumber = 0;
+	bool success = true;
+	while (success && fgets(line, sizeof(line), file)) {
+		++lineNumber;
+		success = loaded.parseLine(line, lineNumber);
+	}
+	fclose(file);
+	if (success && loaded.numOutputs == 0) {
+		printf("Error: Topology file %s has no outputs\n", path);
+		success = false;
+	}
+	if (success) {
+		*this = loaded;
+	}
+	return success;
+}
+
+uint8_t OutputTopology::getNumBuses() const {
+	return numBuses;
+}
+
+const OutputTopology::Bus &OutputTopology::getBus(uint8_t bus) const {
+	return buses[bus];
+}
+
+uint8_t OutputTopology::getNumOutputs() const {
+	return numOutputs;
+}
+
+const OutputTopology::Output &OutputTopology::getOutput(uint8_t output) const {
+	return outputs[output];
+}
+
+uint8_t OutputTopology::getDACAddresses(uint8_t bus, uint8_t *addrs) const {
+	uint8_t count = 0;
+	for (uint8_t i = buses[bus].firstOutput; i < buses[bus].firstOutput + buses[bus].numOutputs; ++i) {
+		if (outputs[i].dacAddr == NO_DAC || memchr(addrs, outputs[i].dacAddr, count)) {
+			continue;
+		}
+		addrs[count++] = outputs[i].dacAddr;
+	}
+	return count;
+}
+
+uint8_t OutputTopology::getGPIOAddresses(uint8_t bus, uint8_t *addrs) const {
+	uint8_t count = 0;
+	for (uint8_t i = buses[bus].firstOutput; i < buses[bus].firstOutput + buses[bus].numOutputs; ++i) {
+		if (!memchr(addrs, outputs[i].gpioAddr, count)) {
+			addrs[count++] = outputs[i].gpioAddr;
+		}
+	}
+	return count;
+}
+
+void OutputTopology::print() const {
+	for (uint8_t b = 0; b < numBuses; ++b) {
+		const Bus &bus = buses[b];
+		uint8_t dacs[MAX_DEVICES_PER_BUS], gpios[MAX_DEVICES_PER_BUS];
+		printf("Bus %u (%s): outputs %u-%u, %u DACs, %u expanders\n", b + 1, bus.device,
+			bus.firstOutput + 1, bus.firstOutput + bus.numOutputs, getDACAddresses(b, dacs), getGPIOAddresses(b, gpios));
+	}
+}
+
+void OutputTopology::clear() {
+	numBuses = 0;
+	numOutputs = 0;
+}
+
+bool OutputTopology::addBus(const char *device, unsigned lineNumber) {
+	if (numBuses >= MAX_BUSES) {
+		printf("Error: Topology line %u: more than %u I2C buses\n", lineNumber, MAX_BUSES);
+		return false;
+	}
+	if (strlen(device) >= MAX_DEVICE_LENGTH) {
+		printf("Error: Topology line %u: I2C device name %s is too long\n", lineNumber, device);
+		return false;
+	}
+
+	// Two workers on one device would interleave their transfers
+	for (uint8_t i = 0; i < numBuses; ++i) {
+		if (strcmp(buses[i].device, device) == 0) {
+			printf("Error: Topology line %u: I2C bus %s already in use\n", lineNumber, device);
+			return false;
+		}
+	}
+	Bus *bus = &buses[numBuses++];
+	strcpy(bus->device, device);
+	bus->firstOutput = numOutputs;
+	bus->numOutputs = 0;
+	return true;
+}
+
+bool OutputTopology::addOutput(const Output &output, unsigned lineNumber) {
+	if (numBuses == 0) {
+		printf("Error: Topology line %u: output before the first bus\n", lineNumber);
+		return false;
+	}
+	Bus *bus = &buses[numBuses - 1];
+	if (numOutputs >= MAX_OUTPUTS || bus->numOutputs >= MAX_OUTPUTS_PER_BUS) {
+		printf("Error: Topology line %u: more than %u outputs, or %u on one bus\n", lineNumber, MAX_OUTPUTS, MAX_OUTPUTS_PER_BUS);
+		return false;
+	}
+	if (output.dacAddr != NO_DAC && output.dacChannel >= DAC::NUM_CHANNELS) {
+		printf("Error: Topology line %u: DACs have channels 0 to %u\n", lineNumber, DAC::NUM_CHANNELS - 1);
+		return false;
+	}
+	if (output.gatePin == output.triggerPin) {
+		printf("Error: Topology line %u: gate and trigger share a pin\n", lineNumber);
+		return false;
+	}
+
+	if (output.dacAddr == output.gpioAddr) {
+		printf("Error: Topology line %u: DAC and expander share address 0x%02X\n", lineNumber, output.dacAddr);
+		return false;
+	}
+
+	// Every DAC channel and expander pin drives a single output, and every address on a bus
+	// belongs to one device
+	for (uint8_t i = bus->firstOutput; i < numOutputs; ++i) {
+		const Output &other = outputs[i];
+		if ((output.dacAddr != NO_DAC && output.dacAddr == other.gpioAddr) || (other.dacAddr != NO_DAC && other.dacAddr == output.gpioAddr)) {
+			printf("Error: Topology line %u: DAC and expander share address 0x%02X\n", lineNumber,
+				output.dacAddr == other.gpioAddr ? output.dacAddr : output.gpioAddr);
+			return false;
+		}
+		if (output.dacAddr != NO_DAC && other.dacAddr == output.dacAddr && other.dacChannel == output.dacChannel) {
+			printf("Error: Topology line %u: DAC channel already in use\n", lineNumber);
+			return false;
+		}
+		if (other.gpioAddr == output.gpioAddr && (other.gatePin == output.gatePin || other.gatePin == output.triggerPin ||
+			other.triggerPin == output.gatePin || other.triggerPin == output.triggerPin)) {
+			printf("Error: Topology line %u: expander pin already in use\n", lineNumber);
+			return false;
+		}
+	}
+
+	outputs[numOutputs] = output;
+	outputs[numOutputs].bus = numBuses - 1;
+	++numOutputs;
+	++bus->numOutputs;
+
+	uint8_t addrs[MAX_OUTPUTS_PER_BUS];
+	if (getDACAddresses(numBuses - 1, addrs) > MAX_DEVICES_PER_BUS || getGPIOAddresses(numBuses - 1, addrs) > MAX_DEVICES_PER_BUS) {
+		printf("Error: Topology line %u: more than %u DACs or expanders on one bus\n", lineNumber, MAX_DEVICES_PER_BUS);
+		--numOutputs;
+		--bus->numOutputs;
+		return false;
+	}
+	return true;
+}
+
+bool OutputTopology::parseLine(char *line, unsigned lineNumber) {
+	char *comment = strchr(line, '#');
+	if (comment) {
+		*comment = '\0';
+	}
+
+	const uint8_t MAX_FIELDS = 7;
+	char *fields[MAX_FIELDS];
+	uint8_t numFields = 0;
+	char *savePos;
+	for (char *field = strtok_r(line, " \t\r\n", &savePos); field; field = strtok_r(nullptr, " \t\r\n", &savePos)) {
+		if (numFields == MAX_FIELDS) {
+			printf("Error: Topology line %u has too many fields\n", lineNumber);
+			return false;
+		}
+		fields[numFields++] = field;
+	}
+	if (numFields == 0) {
+		return true;
+	}
+
+	if (strcmp(fields[0], "bus") == 0 && numFields == 2) {
+		return addBus(fields[1], lineNumber);
+	}
+	if (strcmp(fields[0], "output") == 0 && numFields == 6) {
+		Output output;
+		char *end;
+		unsigned long channel = strtoul(fields[2], &end, 10);
+		bool valid = *end == '\0' && end != fields[2] && channel < 256;
+		output.dacChannel = channel;
+		if (strcmp(fields[1], "-") == 0) {
+			output.dacAddr = NO_DAC;
+		}
+		else {
+			valid = parseAddress(fields[1], &output.dacAddr) && valid;
+		}
+		valid = parseAddress(fields[3], &output.gpioAddr) && valid;
+		valid = parsePin(fields[4], &output.gatePin) && valid;
+		valid = parsePin(fields[5], &output.triggerPin) && valid;
+		if (!valid) {
+			printf("Error: Topology line %u: expected output <DAC address> <channel> <expander address> <gate pin> <trigger pin>\n", lineNumber);
+			return false;
+		}
+		return addOutput(output, lineNumber);
+	}
+
+	printf("Error: Topology line %u: expected \"bus <device>\" or \"output ...\"\n", lineNumber);
+	return false;
+}
+
+bool OutputTopology::parseAddress(const char *text, uint8_t *addr) {
+	char *end;
+	unsigned long value = strtoul(text, &end, 0);
+	if (end == text || *end != '\0' || value > 0x7F) {
+		return false;
+	}
+	*addr = value;
+	return true;
+}
+
+bool OutputTopology::parsePin(const char *text, uint8_t *pin) {
+	if ((text[0] != 'A' && text[0] != 'B') || text[1] < '0' || text[1] > '7' || text[2] != '\0') {
+		return false;
+	}
+	*pin = (text[0] == 'B' ? 8 : 0) + text[1] - '0';
+	return true;
+}
@@ -0,0 +1,524 @@
+#include "../include/OutputWorker.h"
+
+OutputWorker::OutputWorker(I2CBus *bus, const OutputTopology *topology, uint8_t busIndex) :
+	bus(bus), busIndex(busIndex), firstOutput(topology->getBus(busIndex).firstOutput),
+	numOutputs(topology->getBus(busIndex).numOutputs),
+	workerThread(threadName), running(false),
+	sequence(0), gates(0), triggers(0), pendingCommits(0), firstPending_ns(0),
+	commits(0), batches(0), coalesced(0), bytes(0), busBusy_ns(0) {
+	// Named before start(), which is the first use
+	snprintf(threadName, sizeof(threadName), "output%u", busIndex + 1);
+
+	uint8_t dacAddrs[OutputTopology::MAX_OUTPUTS_PER_BUS], gpioAddrs[OutputTopology::MAX_OUTPUTS_PER_BUS];
+	numDACs = topology->getDACAddresses(busIndex, dacAddrs);
+	numGPIOs = topology->getGPIOAddresses(busIndex, gpioAddrs);
+	for (uint8_t i = 0; i < numDACs; ++i) {
+		dacs[i] = DAC(bus, dacAddrs[i]);
+	}
+	for (uint8_t i = 0; i < numGPIOs; ++i) {
+		gpios[i] = GPIOExpander(bus, gpioAddrs[i]);
+	}
+
+	for (uint8_t i = 0; i < numOutputs; ++i) {
+		const OutputTopology::Output &output = topology->getOutput(firstOutput + i);
+		OutputMap *map = &outputMaps[i];
+		if (output.dacAddr != OutputTopology::NO_DAC) {
+			map->dac = (const uint8_t*) memchr(dacAddrs, output.dacAddr, numDACs) - dacAddrs;
+		}
+		map->dacChannel = output.dacChannel;
+		map->gpio = (const uint8_t*) memchr(gpioAddrs, output.gpioAddr, numGPIOs) - gpioAddrs;
+		map->gatePin = output.gatePin;
+		map->triggerPin = output.triggerPin;
+	}
+
+	for (uint8_t i = 0; i < MAX_OUTPUTS; ++i) {
+		pitches[i].store(0, std::memory_order_relaxed);
+		triggerPulses[i].store(0, std::memory_order_relaxed);
+		triggerWidths_ns[i].store(DEFAULT_TRIGGER_WIDTH_NS, std::memory_order_relaxed);
+	}
+}
+
+OutputWorker::~OutputWorker() {
+	stop();
+}
+
+bool OutputWorker::start() {
+	if (running.load()) {
+		return true;
+	}
+	if (!notifier.setup() || !triggerTimer.setup()) {
+		return false;
+	}
+
+	start_ns = Timer::now_ns();
+
+	running.store(true);
+	if (!workerThread.start(&workLoop, this)) {
+		running.store(false);
+		return false;
+	}
+	return true;
+}
+
+uint8_t OutputWorker::getNumOutputs() const {
+	return numOutputs;
+}
+
+void OutputWorker::stop() {
+	if (!running.exchange(false)) {
+		return;
+	}
+	notifier.notify();
+	workerThread.join();
+	sync();
+}
+
+void OutputWorker::beginUpdate() {
+	sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+void OutputWorker::setGate(uint8_t output, bool on) {
+	uint32_t values = gates.load(std::memory_order_relaxed);
+	uint32_t bit = 1u << output;
+	gates.store(on ? values | bit : values & ~bit, std::memory_order_relaxed);
+}
+
+void OutputWorker::setPitch(uint8_t output, uint16_t dacValue) {
+	pitches[output].store(dacValue, std::memory_order_relaxed);
+}
+
+void OutputWorker::startTrigger(uint8_t output) {
+	triggers.store(triggers.load(std::memory_order_relaxed) | 1u << output, std::memory_order_relaxed);
+	uint8_t pulses = triggerPulses[output].load(std::memory_order_relaxed);
+	triggerPulses[output].store(pulses + 1, std::memory_order_relaxed);
+}
+
+void OutputWorker::stopTrigger(uint8_t output) {
+	triggers.store(triggers.load(std::memory_order_relaxed) & ~(1u << output), std::memory_order_relaxed);
+}
+
+void OutputWorker::commit() {
+	if (metrics && pendingCommits.load(std::memory_order_relaxed) == 0) {
+		firstPending_ns.store(Timer::now_ns(), std::memory_order_relaxed);
+	}
+	sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	pendingCommits.fetch_add(1, std::memory_order_release);
+	commits.store(commits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	notifier.notify();
+}
+
+bool OutputWorker::setTriggerWidth(uint8_t output, uint64_t width_ns) {
+	if (output >= numOutputs || width_ns == 0 || width_ns > MAX_TRIGGER_WIDTH_NS) {
+		printf("Error: Invalid trigger width %llu ns for output %u\n", (unsigned long long) width_ns, output + 1);
+		return false;
+	}
+	triggerWidths_ns[output].store(width_ns, std::memory_order_relaxed);
+	return true;
+}
+
+uint64_t OutputWorker::getTriggerWidth(uint8_t output) const {
+	return triggerWidths_ns[output].load(std::memory_order_relaxed);
+}
+
+void OutputWorker::getStats(Stats *stats) const {
+	stats->commits = commits.load(std::memory_order_relaxed);
+	stats->batches = batches.load(std::memory_order_relaxed);
+	stats->coalesced = coalesced.load(std::memory_order_relaxed);
+	stats->queueDepth = pendingCommits.load(std::memory_order_relaxed);
+	stats->bytes = bytes.load(std::memory_order_relaxed);
+	stats->busBusy_ns = busBusy_ns.load(std::memory_order_relaxed);
+	stats->elapsed_ns = Timer::now_ns() - start_ns;
+	stats->busUtilization = stats->elapsed_ns ? (double) stats->busBusy_ns / stats->elapsed_ns : 0;
+}
+
+void OutputWorker::setMetrics(Metrics *metrics) {
+	this->metrics = metrics;
+	busMetrics = metrics->getBus(busIndex);
+	if (!busMetrics) {
+		this->metrics = nullptr;
+		return;
+	}
+	for (uint8_t i = 0; i < numDACs; ++i) {
+		dacTime_ns[i] = metrics->getI2CDevice(busIndex, dacs[i].getAddress());
+	}
+	for (uint8_t i = 0; i < numGPIOs; ++i) {
+		gpioTime_ns[i] = metrics->getI2CDevice(busIndex, gpios[i].getAddress());
+	}
+}
+
+void OutputWorker::setSchedule(const ThreadSchedule &schedule) {
+	workerThread.setSchedule(schedule);
+}
+
+void *OutputWorker::workLoop(void *arg) {
+	OutputWorker *worker = (OutputWorker*) arg;
+
+	// Outside SCHED_FIFO the kernel may otherwise defer the pulse timer by up to 50 us
+	prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0);
+
+	// Expanders are configured here rather than in start(), so every bus is set up in parallel.
+	// Commits posted meanwhile are picked up by the first poll().
+	for (uint8_t i = 0; i < worker->numGPIOs; ++i) {
+		worker->gpios[i].pinModes(0, 0);
+		worker->sentPins[i] = worker->gpios[i].getPinValues(GPIOExpander::Port::A) | worker->gpios[i].getPinValues(GPIOExpander::Port::B) << 8;
+	}
+
+	struct pollfd pollDescs[2];
+	pollDescs[0].fd = worker->notifier.getFd();
+	pollDescs[0].events = POLLIN;
+	pollDescs[1].fd = worker->triggerTimer.getFd();
+	pollDescs[1].events = POLLIN;
+	while (worker->running.load(std::memory_order_relaxed)) {
+		if (poll(pollDescs, 2, -1) < 0) {
+			continue;
+		}
+		if (pollDescs[0].revents & POLLIN) {
+			worker->notifier.drain();
+		}
+		if (pollDescs[1].revents & POLLIN) {
+			worker->triggerTimer.acknowledge();
+			worker->triggerTimerFired = 1;
+		}
+		worker->sync();
+	}
+	return nullptr;
+}
+
+void OutputWorker::sync() {
+	// Take a consistent snapshot of the posted state. While a producer is inside an update
+	// nothing is sent: its commit() wakes the worker again, whereas waiting for it here would
+	// starve a producer of lower priority on the same core.
+	uint32_t newGates, enabledTriggers;
+	uint8_t newPulses[MAX_OUTPUTS];
+	uint16_t newPitches[MAX_OUTPUTS];
+	while (true) {
+		uint32_t before = sequence.load(std::memory_order_acquire);
+		if (before & 1) {
+			// A pulse end falling due now is sent late, so this wakeup says nothing of the timer
+			triggerTimerFired = 0;
+			return;
+		}
+		newGates = gates.load(std::memory_order_relaxed);
+		enabledTriggers = triggers.load(std::memory_order_relaxed);
+		for (uint8_t i = 0; i < numOutputs; ++i) {
+			newPulses[i] = triggerPulses[i].load(std::memory_order_relaxed);
+			newPitches[i] = pitches[i].load(std::memory_order_relaxed);
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequence.load(std::memory_order_relaxed) == before) {
+			break;
+		}
+	}
+
+	uint32_t numCommits = pendingCommits.exchange(0, std::memory_order_acquire);
+	if (metrics && numCommits > 0) {
+		// A commit landing right after the exchange may already have restamped the time
+		uint64_t now = Timer::now_ns();
+		uint64_t first = firstPending_ns.load(std::memory_order_relaxed);
+		if (first <= now) {
+			busMetrics->workerWakeup_ns.record(now - first);
+		}
+	}
+
+	uint32_t started, ended;
+	uint64_t now_ns = Timer::now_ns();
+	uint32_t newTriggers = updatePulses(enabledTriggers, newPulses, now_ns, &started, &ended);
+
+	uint16_t newPins[OutputTopology::MAX_DEVICES_PER_BUS];
+	uint32_t dacBytes[OutputTopology::MAX_DEVICES_PER_BUS];
+	uint32_t gpioBytes[OutputTopology::MAX_DEVICES_PER_BUS];
+	stageChanges(newPitches, newGates, newTriggers, now_ns, newPins, dacBytes, gpioBytes);
+
+	if (transaction.getNumMessages() == 0) {
+		if (numCommits > 0) {
+			coalesced.store(coalesced.load(std::memory_order_relaxed) + numCommits, std::memory_order_relaxed);
+		}
+		finishPulses(started, ended, Timer::now_ns(), getPinsSent(newPins));
+		return;
+	}
+
+	uint32_t totalBytes = 0;
+	for (uint8_t i = 0; i < numDACs; ++i) {
+		totalBytes += dacBytes[i];
+	}
+	for (uint8_t i = 0; i < numGPIOs; ++i) {
+		totalBytes += gpioBytes[i];
+	}
+
+	uint64_t transferStart_ns = Timer::now_ns();
+	bool success = bus->transfer(&transaction);
+	uint64_t transferEnd_ns = Timer::now_ns();
+	busBusy_ns.store(busBusy_ns.load(std::memory_order_relaxed) + transferEnd_ns - transferStart_ns, std::memory_order_relaxed);
+	if (success) {
+		bytes.store(bytes.load(std::memory_order_relaxed) + totalBytes, std::memory_order_relaxed);
+	}
+	if (metrics) {
+		recordMetrics(dacBytes, gpioBytes, totalBytes, success, transferStart_ns, transferEnd_ns);
+	}
+	batches.store(batches.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	if (numCommits > 1) {
+		coalesced.store(coalesced.load(std::memory_order_relaxed) + numCommits - 1, std::memory_order_relaxed);
+	}
+
+	bool dacSent[OutputTopology::MAX_DEVICES_PER_BUS], gpioSent[OutputTopology::MAX_DEVICES_PER_BUS];
+	for (uint8_t i = 0; i < numDACs; ++i) {
+		dacSent[i] = success && dacBytes[i] > 0;
+	}
+	for (uint8_t i = 0; i < numGPIOs; ++i) {
+		gpioSent[i] = success && gpioBytes[i] > 0;
+	}
+	if (!success) {
+		retryDevices(newPitches, newPins, dacBytes, gpioBytes, dacSent, gpioSent);
+		transferEnd_ns = Timer::now_ns();
+	}
+
+	// What did not make it stays different from the posted state, so it is sent again later
+	for (uint8_t i = 0; i < numGPIOs; ++i) {
+		if (gpioSent[i]) {
+			sentPins[i] = newPins[i];
+			setOffline(&gpioOffline_ns[i], gpios[i].getAddress(), false);
+		}
+	}
+	for (uint8_t i = 0; i < numDACs; ++i) {
+		if (dacSent[i]) {
+			setOffline(&dacOffline_ns[i], dacs[i].getAddress(), false);
+		}
+	}
+	for (uint8_t i = 0; i < numOutputs; ++i) {
+		if (outputMaps[i].dac == OutputTopology::NO_DAC || dacSent[outputMaps[i].dac]) {
+			sentPitches[i] = newPitches[i];
+		}
+	}
+	finishPulses(started, ended, transferEnd_ns, getPinsSent(newPins));
+}
+
+uint32_t OutputWorker::getPinsSent(const uint16_t *newPins) const {
+	uint32_t sent = 0;
+	for (uint8_t i = 0; i < numOutputs; ++i) {
+		if (sentPins[outputMaps[i].gpio] == newPins[outputMaps[i].gpio]) {
+			sent |= 1u << i;
+		}
+	}
+	return sent;
+}
+
+void OutputWorker::stageChanges(const uint16_t *newPitches, uint32_t newGates, uint32_t newTriggers, uint64_t now_ns, uint16_t *newPins, uint32_t *dacBytes, uint32_t *gpioBytes) {
+	transaction.clear();
+
+	for (uint8_t g = 0; g < numGPIOs; ++g) {
+		newPins[g] = 0;
+	}
+	for (uint8_t i = 0; i < numOutputs; ++i) {
+		const OutputMap &map = outputMaps[i];
+		if (newGates & 1u << i) {
+			newPins[map.gpio] |= 1 << map.gatePin;
+		}
+		if (newTriggers & 1u << i) {
+			newPins[map.gpio] |= 1 << map.triggerPin;
+		}
+	}
+
+	// Expanders go first: a device that does not answer ends the batch, and a missing DAC must
+	// not take the gates and triggers with it
+	for (uint8_t g = 0; g < numGPIOs; ++g) {
+		gpioBytes[g] = 0;
+		if (gpioOffline_ns[g] > now_ns) {
+			continue;
+		}
+		if (newPins[g] != sentPins[g] && gpios[g].stagePorts(&transaction, newPins[g] & 0xFF, newPins[g] >> 8)) {
+			gpioBytes[g] = 4;
+		}
+	}
+
+	for (uint8_t d = 0; d < numDACs; ++d) {
+		dacBytes[d] = dacOffline_ns[d] > now_ns ? 0 : stageDAC(d, newPitches);
+	}
+}
+
+uint32_t OutputWorker::stageDAC(uint8_t dac, const uint16_t *newPitches) {
+	// Chords are latched together so every voice of a DAC changes pitch at the same instant
+	uint8_t changedChannels[DAC::NUM_CHANNELS];
+	uint16_t changedValues[DAC::NUM_CHANNELS];
+	uint8_t numChanged = 0;
+	for (uint8_t i = 0; i < numOutputs; ++i) {
+		if (outputMaps[i].dac == dac && newPitches[i] != sentPitches[i]) {
+			changedChannels[numChanged] = outputMaps[i].dacChannel;
+			changedValues[numChanged] = newPitches[i];
+			++numChanged;
+		}
+	}
+	if (numChanged > 0 && dacs[dac].stageBatch(&transaction, changedChannels, changedValues, numChanged)) {
+		return 1 + 3 * numChanged;
+	}
+	return 0;
+}
+
+void OutputWorker::retryDevices(const uint16_t *newPitches, const uint16_t *newPins, const uint32_t *dacBytes, const uint32_t *gpioBytes, bool *dacSent, bool *gpioSent) {
+	for (uint8_t g = 0; g < numGPIOs; ++g) {
+		if (gpioBytes[g] > 0) {
+			transaction.clear();
+			gpioSent[g] = gpios[g].stagePorts(&transaction, newPins[g] & 0xFF, newPins[g] >> 8) && sendRetry(gpioBytes[g]);
+			if (!gpioSent[g]) {
+				setOffline(&gpioOffline_ns[g], gpios[g].getAddress(), true);
+			}
+		}
+	}
+	for (uint8_t d = 0; d < numDACs; ++d) {
+		if (dacBytes[d] > 0) {
+			transaction.clear();
+			dacSent[d] = stageDAC(d, newPitches) > 0 && sendRetry(dacBytes[d]);
+			if (!dacSent[d]) {
+				setOffline(&dacOffline_ns[d], dacs[d].getAddress(), true);
+			}
+		}
+	}
+}
+
+bool OutputWorker::sendRetry(uint32_t numBytes) {
+	uint64_t transferStart_ns = Timer::now_ns();
+	bool success = bus->transfer(&transaction);
+	busBusy_ns.store(busBusy_ns.load(std::memory_order_relaxed) + Timer::now_ns() - transferStart_ns, std::memory_order_relaxed);
+	if (success) {
+		bytes.store(bytes.load(std::memory_order_relaxed) + numBytes, std::memory_order_relaxed);
+	}
+	return success;
+}
+
+void OutputWorker::setOffline(uint64_t *offline_ns, uint8_t addr, bool offline) {
+	if (offline) {
+		if (*offline_ns == 0) {
+			Log::error("I2C device 0x%02X on bus %u does not answer, retrying every %llu ms", addr, busIndex + 1,
+				(unsigned long long) (OFFLINE_RETRY_NS / 1000000));
+		}
+		*offline_ns = Timer::now_ns() + OFFLINE_RETRY_NS;
+	}
+	else if (*offline_ns != 0) {
+		Log::info("I2C device 0x%02X on bus %u answers again", addr, busIndex + 1);
+		*offline_ns = 0;
+	}
+}
+
+uint32_t OutputWorker::updatePulses(uint32_t enabled, const uint8_t *pulses, uint64_t now_ns, uint32_t *started, uint32_t *ended) {
+	// A pulse whose rising edge did not reach the expander starts when it does
+	*started = unsentStarts & enabled;
+	*ended = 0;
+	for (uint8_t i = 0; i < numOutputs; ++i) {
+		uint32_t bit = 1u << i;
+		if (!(enabled & bit)) {
+			pulsing &= ~bit;
+			pulseEnd_ns[i] = 0;
+		}
+		else if (pulses[i] != seenPulses[i]) {
+			pulsing |= bit;
+			pulseEnd_ns[i] = 0;
+			pulseWidth_ns[i] = triggerWidths_ns[i].load(std::memory_order_relaxed);
+			*started |= bit;
+		}
+		else if ((pulsing & bit) && pulseEnd_ns[i] != 0 && pulseEnd_ns[i] <= now_ns + triggerLead_ns) {
+			// Due, or due by the time this write lands
+			pulsing &= ~bit;
+			pulseEnd_ns[i] = 0;
+			*ended |= bit;
+		}
+		seenPulses[i] = pulses[i];
+	}
+	return pulsing;
+}
+
+void OutputWorker::finishPulses(uint32_t started, uint32_t ended, uint64_t edge_ns, uint32_t sent) {
+	uint64_t earliestTarget_ns = 0;
+	unsentStarts = started & ~sent;
+	for (uint8_t i = 0; i < numOutputs; ++i) {
+		uint32_t bit = 1u << i;
+		if (started & sent & bit) {
+			// Timed from the rising edge, so bus and wakeup latency do not shorten the pulse
+			pulseStart_ns[i] = edge_ns;
+			pulseEnd_ns[i] = edge_ns + pulseWidth_ns[i];
+		}
+		else if (ended & sent & bit) {
+			uint64_t width_ns = edge_ns - pulseStart_ns[i];
+			uint64_t target_ns = pulseStart_ns[i] + pulseWidth_ns[i];
+			if (metrics) {
+				metrics->triggerWidth_ns[firstOutput + i].record(width_ns);
+				busMetrics->triggerError_ns.record(width_ns > pulseWidth_ns[i] ? width_ns - pulseWidth_ns[i] : pulseWidth_ns[i] - width_ns);
+			}
+			if (earliestTarget_ns == 0 || target_ns < earliestTarget_ns) {
+				earliestTarget_ns = target_ns;
+			}
+		}
+	}
+
+	// The timer is armed for the earliest end, so only its wakeups tell how far ahead of a
+	// deadline the falling edge must be written. Each miss moves the lead by a quarter, at
+	// most MAX_LEAD_STEP_NS, so a single preempted wakeup cannot cut later pulses short.
+	if (triggerTimerFired && earliestTarget_ns != 0) {
+		int64_t step_ns = ((int64_t) (edge_ns - earliestTarget_ns)) / 4;
+		if (step_ns > (int64_t) MAX_LEAD_STEP_NS) {
+			step_ns = MAX_LEAD_STEP_NS;
+		}
+		else if (step_ns < -(int64_t) MAX_LEAD_STEP_NS) {
+			step_ns = -(int64_t) MAX_LEAD_STEP_NS;
+		}
+		int64_t lead_ns = (int64_t) triggerLead_ns + step_ns;
+		if (lead_ns < 0) {
+			lead_ns = 0;
+		}
+		triggerLead_ns = (uint64_t) lead_ns < MAX_TRIGGER_LEAD_NS ? lead_ns : MAX_TRIGGER_LEAD_NS;
+	}
+	triggerTimerFired = 0;
+	armTriggerTimer();
+}
+
+void OutputWorker::armTriggerTimer() {
+	uint64_t next_ns = 0;
+	for (uint8_t i = 0; i < numOutputs; ++i) {
+		if (pulseEnd_ns[i] != 0 && (next_ns == 0 || pulseEnd_ns[i] < next_ns)) {
+			next_ns = pulseEnd_ns[i];
+		}
+	}
+	if (next_ns > triggerLead_ns) {
+		next_ns -= triggerLead_ns;
+	}
+	else if (next_ns != 0) {
+		next_ns = 1;
+	}
+
+	// A rising edge that did not make it is sent when its expander is tried again
+	for (uint8_t i = 0; i < numOutputs; ++i) {
+		uint64_t retry_ns = gpioOffline_ns[outputMaps[i].gpio];
+		if ((unsentStarts & 1u << i) && retry_ns != 0 && (next_ns == 0 || retry_ns < next_ns)) {
+			next_ns = retry_ns;
+		}
+	}
+	if (next_ns == 0) {
+		triggerTimer.disarm();
+	}
+	else {
+		triggerTimer.arm(next_ns);
+	}
+}
+
+void OutputWorker::recordMetrics(const uint32_t *dacBytes, const uint32_t *gpioBytes, uint32_t totalBytes, bool success, uint64_t transferStart_ns, uint64_t transferEnd_ns) {
+	uint64_t time_ns = transferEnd_ns - transferStart_ns;
+	busMetrics->batches.add();
+	busMetrics->busy_ns.add(time_ns);
+	if (!success) {
+		busMetrics->failures.add();
+		return;
+	}
+	busMetrics->bytes.add(totalBytes);
+
+	// Bus time is proportional to bytes on the wire, so the batch is split between the
+	// devices by their share of the bytes (address byte included)
+	for (uint8_t i = 0; i < numDACs; ++i) {
+		if (dacBytes[i] > 0 && dacTime_ns[i]) {
+			dacTime_ns[i]->record(time_ns * dacBytes[i] / totalBytes);
+		}
+	}
+	for (uint8_t i = 0; i < numGPIOs; ++i) {
+		if (gpioBytes[i] > 0 && gpioTime_ns[i]) {
+			gpioTime_ns[i]->record(time_ns * gpioBytes[i] / totalBytes);
+		}
+	}
+}
@@ -0,0 +1,179 @@
+#include "../include/PitchCalibration.h"
+
+struct NominalTable {
+	uint16_t values[PitchCalibration::NUM_NOTES];
+};
+
+/*
+ * note / 12 V out of 5 V full scale, rounded to the nearest value
+ */
+static constexpr NominalTable makeNominalTable() {
+	NominalTable table = {};
+	for (uint16_t note = 0; note < PitchCalibration::NUM_NOTES; ++note) {
+		uint32_t value = (note * PitchCalibration::MAX_VALUE * 2 + 60) / 120;
+		table.values[note] = value < PitchCalibration::MAX_VALUE ? value : PitchCalibration::MAX_VALUE;
+	}
+	return table;
+}
+
+static constexpr NominalTable NOMINAL_TABLE = makeNominalTable();
+
+static_assert(NOMINAL_TABLE.values[12] == 819 && NOMINAL_TABLE.values[60] == PitchCalibration::MAX_VALUE,
+	"Nominal table must be 1 V/octave over 5 V full scale");
+
+PitchCalibration::PitchCalibration(uint8_t numOutputs) : numOutputs(numOutputs < MAX_OUTPUTS ? numOutputs : MAX_OUTPUTS) {
+	for (uint8_t output = 0; output < MAX_OUTPUTS; ++output) {
+		memcpy(tables[output], NOMINAL_TABLE.values, sizeof(tables[output]));
+		offsets_V[output] = 0;
+		gains_V[output] = 0;
+	}
+}
+
+uint8_t PitchCalibration::getNumOutputs() const {
+	return numOutputs;
+}
+
+uint8_t PitchCalibration::getHighestNote(uint8_t output) const {
+	uint8_t note = NUM_NOTES - 1;
+	while (note > 0 && tables[output][note - 1] == tables[output][note]) {
+		--note;
+	}
+	return note;
+}
+
+bool PitchCalibration::load(const char *path) {
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		printf("Error: Failed to open calibration file %s\n", path);
+		return false;
+	}
+
+	// Nothing changes unless the whole file is valid
+	PitchCalibration loaded(*this);
+	char line[MAX_LINE_LENGTH];
+	unsigned lineNumber = 0;
+	bool success = true;
+	while (success && fgets(line, sizeof(line), file)) {
+		++lineNumber;
+		if (!strchr(line, '\n') && !feof(file)) {
+			printf("Error: Calibration file %s line %u is too long\n", path, lineNumber);
+			success = false;
+			break;
+		}
+		success = loaded.parseLine(line, lineNumber);
+	}
+	fclose(file);
+	if (success) {
+		*this = loaded;
+	}
+	return success;
+}
+
+bool PitchCalibration::save(const char *path) const {
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		printf("Error: Failed to create calibration file %s\n", path);
+		return false;
+	}
+
+	fprintf(file, "# Pitch calibration: output, then the DAC values of notes 0 to %u\n", NUM_NOTES - 1);
+	for (uint8_t output = 0; output < numOutputs; ++output) {
+		if (gains_V[output] > 0) {
+			fprintf(file, "# Output %u: %.4f V at 0, %.4f mV per step, notes up to %u\n", output + 1,
+				offsets_V[output], gains_V[output] * 1000, getHighestNote(output));
+		}
+		fprintf(file, "%u", output + 1);
+		for (uint8_t note = 0; note < NUM_NOTES; ++note) {
+			fprintf(file, " %u", tables[output][note]);
+		}
+		fprintf(file, "\n");
+	}
+
+	bool success = !ferror(file);
+	if (fclose(file) != 0 || !success) {
+		printf("Error: Failed to write calibration file %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+bool PitchCalibration::fit(uint8_t output, const uint16_t *values, const double *volts, uint8_t numPoints) {
+	if (output >= numOutputs || numPoints < 2) {
+		return false;
+	}
+
+	double meanValue = 0, meanVolts = 0;
+	for (uint8_t i = 0; i < numPoints; ++i) {
+		meanValue += values[i];
+		meanVolts += volts[i];
+	}
+	meanValue /= numPoints;
+	meanVolts /= numPoints;
+	double covariance = 0, variance = 0;
+	for (uint8_t i = 0; i < numPoints; ++i) {
+		covariance += (values[i] - meanValue) * (volts[i] - meanVolts);
+		variance += (values[i] - meanValue) * (values[i] - meanValue);
+	}
+	if (variance == 0 || covariance <= 0) {
+		printf("Error: Measurements of output %u do not rise with the DAC value\n", output + 1);
+		return false;
+	}
+	double gain = covariance / variance;
+	double offset = meanVolts - gain * meanValue;
+
+	for (uint8_t note = 0; note < NUM_NOTES; ++note) {
+		double value = round((note / 12.0 - offset) / gain);
+		tables[output][note] = value < 0 ? 0 : value > MAX_VALUE ? MAX_VALUE : (uint16_t) value;
+	}
+	offsets_V[output] = offset;
+	gains_V[output] = gain;
+	return true;
+}
+
+uint16_t PitchCalibration::getNominalValue(uint8_t note) {
+	return NOMINAL_TABLE.values[note < NUM_NOTES ? note : NUM_NOTES - 1];
+}
+
+bool PitchCalibration::parseLine(char *line, unsigned lineNumber) {
+	char *comment = strchr(line, '#');
+	if (comment) {
+		*comment = '\0';
+	}
+	char *pos = line;
+	while (*pos == ' ' || *pos == '\t') {
+		++pos;
+	}
+	if (*pos == '\0' || *pos == '\n' || *pos == '\r') {
+		return true;
+	}
+
+	char *end;
+	unsigned long output = strtoul(pos, &end, 10);
+	if (end == pos || output < 1 || output > numOutputs) {
+		printf("Error: Calibration line %u does not start with an output from 1 to %u\n", lineNumber, numOutputs);
+		return false;
+	}
+
+	uint16_t values[NUM_NOTES];
+	for (uint8_t note = 0; note < NUM_NOTES; ++note) {
+		pos = end;
+		unsigned long value = strtoul(pos, &end, 10);
+		if (end == pos || value > MAX_VALUE) {
+			printf("Error: Calibration line %u needs %u values from 0 to %u\n", lineNumber, NUM_NOTES, MAX_VALUE);
+			return false;
+		}
+		values[note] = value;
+	}
+	while (*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n') {
+		++end;
+	}
+	if (*end != '\0') {
+		printf("Error: Calibration line %u has more than %u values\n", lineNumber, NUM_NOTES);
+		return false;
+	}
+
+	memcpy(tables[output - 1], values, sizeof(values));
+	offsets_V[output - 1] = 0;
+	gains_V[output - 1] = 0;
+	return true;
+}
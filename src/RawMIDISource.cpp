@@ -0,0 +1,67 @@
+#include "../include/RawMIDISource.h"
+
+RawMIDISource::RawMIDISource(const char *port) : port(port) {}
+
+RawMIDISource::~RawMIDISource() {
+	close();
+}
+
+bool RawMIDISource::open() {
+	if (midi) {
+		return true;
+	}
+	int result = snd_rawmidi_open(&midi, nullptr, port, SND_RAWMIDI_NONBLOCK);
+	if (result < 0) {
+		Log::error("Failed to open MIDI port %s: %s", port, snd_strerror(result));
+		midi = nullptr;
+		return false;
+	}
+	Log::info("Successfully opened MIDI port %s", port);
+	return true;
+}
+
+void RawMIDISource::close() {
+	if (midi) {
+		snd_rawmidi_close(midi);
+		midi = nullptr;
+	}
+}
+
+bool RawMIDISource::isOpen() const {
+	return midi != nullptr;
+}
+
+int RawMIDISource::getPollDescriptors(struct pollfd *fds, int space) {
+	if (!midi || snd_rawmidi_poll_descriptors_count(midi) > space) {
+		return 0;
+	}
+	return snd_rawmidi_poll_descriptors(midi, fds, space);
+}
+
+unsigned short RawMIDISource::getPollEvents(struct pollfd *fds, int count) {
+	unsigned short events = 0;
+	if (snd_rawmidi_poll_descriptors_revents(midi, fds, count, &events) < 0) {
+		return POLLERR;
+	}
+	return events;
+}
+
+ssize_t RawMIDISource::read(uint8_t *buffer, size_t length) {
+	ssize_t result = snd_rawmidi_read(midi, buffer, length);
+	if (result == -EAGAIN || result == -EINTR) {
+		return 0;
+	}
+	if (result < 0) {
+		Log::error("Failed to read MIDI port %s: %s", port, snd_strerror((int) result));
+		return -1;
+	}
+	return result;
+}
+
+bool RawMIDISource::setBlocking(bool blocking) {
+	return midi && snd_rawmidi_nonblock(midi, blocking ? 0 : 1) == 0;
+}
+
+const char *RawMIDISource::getName() const {
+	return port;
+}
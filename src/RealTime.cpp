@@ -0,0 +1,146 @@
+#include "../include/RealTime.h"
+
+static bool setAttrSchedule(pthread_attr_t *attr, const ThreadSchedule &schedule, bool realTime) {
+	struct sched_param param;
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = realTime ? schedule.priority : 0;
+	if (pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED) != 0 ||
+		pthread_attr_setschedpolicy(attr, realTime ? SCHED_FIFO : SCHED_OTHER) != 0 ||
+		pthread_attr_setschedparam(attr, &param) != 0) {
+		return false;
+	}
+	if (schedule.cpu >= 0) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(schedule.cpu, &cpus);
+		if (pthread_attr_setaffinity_np(attr, sizeof(cpus), &cpus) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+RealTimeThread::RealTimeThread(const char *name) : name(name) {}
+
+RealTimeThread::~RealTimeThread() {
+	if (!detached) {
+		join();
+		free(stack);
+	}
+}
+
+void RealTimeThread::setSchedule(const ThreadSchedule &schedule) {
+	this->schedule = schedule;
+}
+
+bool RealTimeThread::start(void *(*routine)(void*), void *arg) {
+	if (started) {
+		return false;
+	}
+	if (!stack) {
+		if (posix_memalign(&stack, sysconf(_SC_PAGESIZE), STACK_SIZE) != 0) {
+			printf("Error: Failed to allocate stack for %s thread\n", name);
+			stack = nullptr;
+			return false;
+		}
+		// Touch every page now rather than on first use
+		memset(stack, 0, STACK_SIZE);
+	}
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setstack(&attr, stack, STACK_SIZE);
+	bool realTime = schedule.priority > 0;
+	if (!setAttrSchedule(&attr, schedule, realTime)) {
+		printf("Error: Invalid schedule for %s thread\n", name);
+		pthread_attr_destroy(&attr);
+		return false;
+	}
+
+	int result = pthread_create(&thread, &attr, routine, arg);
+	if (result == EPERM && realTime) {
+		printf("Warning: Not permitted to use SCHED_FIFO, %s thread runs under the default scheduler\n", name);
+		setAttrSchedule(&attr, schedule, false);
+		result = pthread_create(&thread, &attr, routine, arg);
+	}
+	pthread_attr_destroy(&attr);
+	if (result != 0) {
+		printf("Error: Failed to create %s thread\n", name);
+		return false;
+	}
+
+	pthread_setname_np(thread, name);
+	started = 1;
+	detached = 0;
+	return true;
+}
+
+bool RealTimeThread::join() {
+	if (!started || detached) {
+		return false;
+	}
+	pthread_join(thread, NULL);
+	started = 0;
+	return true;
+}
+
+void RealTimeThread::cancel() {
+	if (started && !detached) {
+		pthread_cancel(thread);
+	}
+}
+
+void RealTimeThread::detach() {
+	if (started && !detached) {
+		pthread_detach(thread);
+		detached = 1;
+	}
+}
+
+bool RealTime::lockMemory() {
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+		printf("Error: Failed to lock memory (needs CAP_IPC_LOCK or a higher RLIMIT_MEMLOCK)\n");
+		return false;
+	}
+
+	// Freed memory stays in the heap and large blocks come from it, not from fresh mmap()s
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+
+	char *heap = (char*) malloc(HEAP_PREFAULT_SIZE);
+	if (heap) {
+		for (size_t i = 0; i < HEAP_PREFAULT_SIZE; i += sysconf(_SC_PAGESIZE)) {
+			heap[i] = 0;
+		}
+		free(heap);
+	}
+
+	// The volatile accesses keep the compiler from dropping the unused array
+	volatile char stack[STACK_PREFAULT_SIZE];
+	for (size_t i = 0; i < STACK_PREFAULT_SIZE; i += sysconf(_SC_PAGESIZE)) {
+		stack[i] = 0;
+	}
+	return stack[0] == 0;
+}
+
+bool RealTime::setCurrentThread(const ThreadSchedule &schedule, const char *name) {
+	pthread_setname_np(pthread_self(), name);
+	if (schedule.cpu >= 0) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(schedule.cpu, &cpus);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+			printf("Error: Failed to pin %s thread to CPU %d\n", name, schedule.cpu);
+			return false;
+		}
+	}
+	if (schedule.priority > 0) {
+		struct sched_param param;
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = schedule.priority;
+		if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+			printf("Warning: Not permitted to use SCHED_FIFO, %s thread runs under the default scheduler\n", name);
+		}
+	}
+	return true;
+}
@@ -0,0 +1,237 @@
+#include "../include/ReplayMIDISource.h"
+
+ReplayMIDISource::ReplayMIDISource(const char *path, uint8_t port, double speed) :
+	path(path), port(port), speed(speed > 0 ? speed : 0), cancelled(false), finished(false) {
+	snprintf(name, sizeof(name), "replay");
+}
+
+ReplayMIDISource::~ReplayMIDISource() {
+	free(data);
+}
+
+bool ReplayMIDISource::load() {
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		printf("Error: Failed to open capture %s\n", path);
+		return false;
+	}
+	MIDICapture::Header header;
+	if (!readHeader(file, &header)) {
+		printf("Error: %s is not a version %u MIDI capture\n", path, MIDICapture::VERSION);
+		fclose(file);
+		return false;
+	}
+	if (port >= header.numPorts) {
+		printf("Error: Capture %s has no port %u\n", path, port + 1);
+		fclose(file);
+		return false;
+	}
+	snprintf(name, sizeof(name), "replay:%.*s", (int) MIDICapture::PORT_NAME_SIZE - 1, header.portNames[port]);
+
+	// The records are kept in memory so that reads never touch the file
+	long start = ftell(file);
+	fseek(file, 0, SEEK_END);
+	long end = ftell(file);
+	fseek(file, start, SEEK_SET);
+	size = end > start ? end - start : 0;
+	free(data);
+	data = (uint8_t*) malloc(size > 0 ? size : 1);
+	if (!data || fread(data, 1, size, file) != size) {
+		printf("Error: Failed to read capture %s\n", path);
+		fclose(file);
+		return false;
+	}
+	fclose(file);
+
+	// A capture cut short (e.g. by a crash) is replayed up to its last whole record
+	size_t pos = 0;
+	size_t numRecords = 0;
+	while (pos < size) {
+		size_t recordStart = pos;
+		uint64_t delta_ns, length;
+		if (!MIDICapture::decodeVarint(data, size, &pos, &delta_ns) || pos >= size ||
+			data[pos++] >= header.numPorts || !MIDICapture::decodeVarint(data, size, &pos, &length) ||
+			length > size - pos) {
+			printf("Warning: Capture %s ends in a partial record after %zu records\n", path, numRecords);
+			size = recordStart;
+			break;
+		}
+		pos += length;
+		++numRecords;
+	}
+
+	captureStart_ns = header.start_ns;
+	scanPos = 0;
+	scanTime_ns = captureStart_ns;
+	atEnd = 0;
+	finished.store(false);
+	nextRecord();
+	return true;
+}
+
+void ReplayMIDISource::setStartTime(uint64_t start_ns) {
+	this->start_ns = start_ns;
+}
+
+void ReplayMIDISource::cancel() {
+	cancelled.store(true);
+}
+
+bool ReplayMIDISource::isFinished() const {
+	return finished.load();
+}
+
+bool ReplayMIDISource::open() {
+	if (!data) {
+		Log::error("Capture %s was not loaded", path);
+		return false;
+	}
+	if (timer.getFd() == -1 && !timer.setup()) {
+		return false;
+	}
+	if (start_ns == 0) {
+		start_ns = Timer::now_ns();
+	}
+
+	// At speed 0 the timer is left expired, so poll() always returns until the end
+	if (!timer.arm(speed > 0 && !atEnd ? getDue_ns() : 1)) {
+		return false;
+	}
+	opened = 1;
+	return true;
+}
+
+void ReplayMIDISource::close() {
+	opened = 0;
+}
+
+bool ReplayMIDISource::isOpen() const {
+	return opened;
+}
+
+int ReplayMIDISource::getPollDescriptors(struct pollfd *fds, int space) {
+	if (space < 1) {
+		return 0;
+	}
+	fds[0].fd = timer.getFd();
+	fds[0].events = POLLIN;
+	fds[0].revents = 0;
+	return 1;
+}
+
+unsigned short ReplayMIDISource::getPollEvents(struct pollfd *fds, int count) {
+	unsigned short events = count > 0 ? fds[0].revents : 0;
+	recordsThisWakeup = 0;
+
+	// Reads rearm the timer for whatever comes due next
+	if ((events & POLLIN) && speed > 0) {
+		timer.disarm();
+	}
+	return events;
+}
+
+ssize_t ReplayMIDISource::read(uint8_t *buffer, size_t length) {
+	if (atEnd || cancelled.load(std::memory_order_relaxed)) {
+		// Only marked finished here, in a wakeup after the last events were queued
+		timer.disarm();
+		finished.store(true);
+		return 0;
+	}
+
+	uint64_t due_ns = getDue_ns();
+	uint64_t now_ns = Timer::now_ns();
+	if (due_ns > now_ns) {
+		timer.arm(due_ns);
+		return 0;
+	}
+
+	size_t count = length < recordLength ? length : recordLength;
+	memcpy(buffer, data + recordOffset, count);
+	readTimestamp_ns = due_ns;
+	recordOffset += count;
+	recordLength -= count;
+	if (recordLength > 0) {
+		return count;
+	}
+
+	++recordsThisWakeup;
+	nextRecord();
+	if (atEnd) {
+		// Wake once more to mark the replay finished
+		timer.arm(1);
+	}
+	else if (speed > 0 && (recordsThisWakeup >= RECORDS_PER_WAKEUP || getDue_ns() > now_ns)) {
+		timer.arm(getDue_ns());
+	}
+	return count;
+}
+
+uint64_t ReplayMIDISource::getReadTimestamp_ns() const {
+	return readTimestamp_ns;
+}
+
+bool ReplayMIDISource::hasPendingInput() {
+	if (!opened || atEnd || cancelled.load(std::memory_order_relaxed)) {
+		return false;
+	}
+	if (recordsThisWakeup >= RECORDS_PER_WAKEUP) {
+		return false;
+	}
+	return speed == 0 || getDue_ns() <= Timer::now_ns();
+}
+
+const char *ReplayMIDISource::getName() const {
+	return name;
+}
+
+int ReplayMIDISource::readPortNames(const char *path, char names[][MIDICapture::PORT_NAME_SIZE], uint8_t space) {
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		printf("Error: Failed to open capture %s\n", path);
+		return -1;
+	}
+	MIDICapture::Header header;
+	bool valid = readHeader(file, &header);
+	fclose(file);
+	if (!valid) {
+		printf("Error: %s is not a version %u MIDI capture\n", path, MIDICapture::VERSION);
+		return -1;
+	}
+	for (uint8_t i = 0; i < header.numPorts && i < space; ++i) {
+		memcpy(names[i], header.portNames[i], MIDICapture::PORT_NAME_SIZE);
+		names[i][MIDICapture::PORT_NAME_SIZE - 1] = '\0';
+	}
+	return header.numPorts;
+}
+
+void ReplayMIDISource::nextRecord() {
+	while (scanPos < size) {
+		uint64_t delta_ns, length;
+		MIDICapture::decodeVarint(data, size, &scanPos, &delta_ns);
+		uint8_t recordPort = data[scanPos++];
+		MIDICapture::decodeVarint(data, size, &scanPos, &length);
+		scanTime_ns += delta_ns;
+		size_t recordStart = scanPos;
+		scanPos += length;
+		if (recordPort == port && length > 0) {
+			recordOffset = recordStart;
+			recordLength = length;
+			recordTime_ns = scanTime_ns;
+			return;
+		}
+	}
+	recordLength = 0;
+	atEnd = 1;
+}
+
+uint64_t ReplayMIDISource::getDue_ns() const {
+	if (speed == 0) {
+		return 0;
+	}
+	return start_ns + (uint64_t) ((recordTime_ns - captureStart_ns) / speed);
+}
+
+bool ReplayMIDISource::readHeader(FILE *file, MIDICapture::Header *header) {
+	return fread(header, sizeof(*header), 1, file) == 1 && header->magic == MIDICapture::MAGIC &&
+		header->version == MIDICapture::VERSION && header->numPorts <= MIDICapture::MAX_PORTS;
+}
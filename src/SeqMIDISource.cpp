@@ -0,0 +1,161 @@
+#include "../include/SeqMIDISource.h"
+
+SeqMIDISource::SeqMIDISource(const char *name) : name(name) {}
+
+SeqMIDISource::~SeqMIDISource() {
+	close();
+}
+
+bool SeqMIDISource::open() {
+	if (seq) {
+		return true;
+	}
+	int result = snd_seq_open(&seq, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK);
+	if (result < 0) {
+		Log::error("Failed to open ALSA sequencer: %s", snd_strerror(result));
+		seq = nullptr;
+		return false;
+	}
+	snd_seq_set_client_name(seq, name);
+
+	// The port stamps events with the real time of a queue of its own as they arrive
+	queue = snd_seq_alloc_named_queue(seq, name);
+	if (queue < 0) {
+		Log::error("Failed to allocate sequencer queue: %s", snd_strerror(queue));
+		close();
+		return false;
+	}
+	snd_seq_port_info_t *info;
+	snd_seq_port_info_alloca(&info);
+	snd_seq_port_info_set_name(info, name);
+	snd_seq_port_info_set_capability(info, SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE);
+	snd_seq_port_info_set_type(info, SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+	snd_seq_port_info_set_timestamping(info, 1);
+	snd_seq_port_info_set_timestamp_real(info, 1);
+	snd_seq_port_info_set_timestamp_queue(info, queue);
+	result = snd_seq_create_port(seq, info);
+	if (result < 0) {
+		Log::error("Failed to create sequencer port %s: %s", name, snd_strerror(result));
+		close();
+		return false;
+	}
+	result = snd_seq_start_queue(seq, queue, nullptr);
+	if (result >= 0) {
+		result = snd_seq_drain_output(seq);
+	}
+	if (result < 0) {
+		Log::error("Failed to start sequencer queue: %s", snd_strerror(result));
+		close();
+		return false;
+	}
+	queueStart_ns = Timer::now_ns();
+
+	// Every event is decoded with its status byte, so the parser never depends on running status
+	result = snd_midi_event_new(DECODER_BUFFER_SIZE, &decoder);
+	if (result < 0) {
+		Log::error("Failed to create MIDI event decoder: %s", snd_strerror(result));
+		decoder = nullptr;
+		close();
+		return false;
+	}
+	snd_midi_event_no_status(decoder, 1);
+
+	Log::info("Successfully opened sequencer port %d:%d (%s)", snd_seq_client_id(seq), snd_seq_port_info_get_port(info), name);
+	return true;
+}
+
+void SeqMIDISource::close() {
+	if (decoder) {
+		snd_midi_event_free(decoder);
+		decoder = nullptr;
+	}
+	if (seq) {
+		snd_seq_close(seq);
+		seq = nullptr;
+	}
+	queue = -1;
+	event = nullptr;
+}
+
+bool SeqMIDISource::isOpen() const {
+	return seq != nullptr;
+}
+
+int SeqMIDISource::getPollDescriptors(struct pollfd *fds, int space) {
+	if (!seq || snd_seq_poll_descriptors_count(seq, POLLIN) > space) {
+		return 0;
+	}
+	return snd_seq_poll_descriptors(seq, fds, space, POLLIN);
+}
+
+unsigned short SeqMIDISource::getPollEvents(struct pollfd *fds, int count) {
+	unsigned short events = 0;
+	if (snd_seq_poll_descriptors_revents(seq, fds, count, &events) < 0) {
+		return POLLERR;
+	}
+	return events;
+}
+
+ssize_t SeqMIDISource::read(uint8_t *buffer, size_t length) {
+	size_t count = 0;
+	readTimestamp_ns = 0;
+	while (count < length) {
+		if (!event) {
+			int result = snd_seq_event_input(seq, &event);
+			if (result == -EAGAIN) {
+				event = nullptr;
+				break;
+			}
+			if (result == -ENOSPC) {
+				// The kernel's input pool overflowed and events were lost, but the client still works
+				Log::warning("Sequencer port %s overran", name);
+				event = nullptr;
+				continue;
+			}
+			if (result < 0) {
+				Log::error("Failed to read sequencer port %s: %s", name, snd_strerror(result));
+				event = nullptr;
+				return -1;
+			}
+		}
+
+		uint64_t timestamp_ns = getEventTimestamp_ns(event);
+		if (count > 0 && timestamp_ns != readTimestamp_ns) {
+			break;
+		}
+		long decoded = snd_midi_event_decode(decoder, buffer + count, length - count, event);
+		if (decoded == -ENOMEM && count > 0) {
+			// Returned by the next read
+			break;
+		}
+		if (decoded == -ENOMEM) {
+			Log::warning("Dropped %u-byte SysEx from sequencer port %s", event->data.ext.len, name);
+		}
+		else if (decoded > 0) {
+			readTimestamp_ns = timestamp_ns;
+			count += decoded;
+		}
+		// Anything else is a sequencer event with no MIDI bytes, such as a port subscription
+		event = nullptr;
+	}
+	return count;
+}
+
+uint64_t SeqMIDISource::getReadTimestamp_ns() const {
+	return readTimestamp_ns;
+}
+
+bool SeqMIDISource::hasPendingInput() {
+	return event || (seq && snd_seq_event_input_pending(seq, 0) > 0);
+}
+
+const char *SeqMIDISource::getName() const {
+	return name;
+}
+
+uint64_t SeqMIDISource::getEventTimestamp_ns(const snd_seq_event_t *event) const {
+	if ((event->flags & SND_SEQ_TIME_STAMP_MASK) != SND_SEQ_TIME_STAMP_REAL || event->queue != queue) {
+		return 0;
+	}
+	return queueStart_ns + event->time.time.tv_sec * 1000000000ull + event->time.time.tv_nsec;
+}
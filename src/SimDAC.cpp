@@ -0,0 +1,82 @@
+#include "../include/SimDAC.h"
+
+SimDAC::SimDAC(uint8_t addr) : SimI2CDevice(addr) {}
+
+void SimDAC::handleWrite(const uint8_t *data, uint16_t length, uint64_t timestamp_ns) {
+	if (length % FRAME_SIZE != 0) {
+		++invalidFrames;
+	}
+
+	for (uint16_t i = 0; i + FRAME_SIZE <= length; i += FRAME_SIZE) {
+		uint8_t command = data[i] >> 4;
+		uint8_t channel = data[i] & 0b1111;
+		uint16_t value = ((uint16_t) data[i + 1] << 4) | (data[i + 2] >> 4);
+		if (channel >= NUM_CHANNELS) {
+			++invalidFrames;
+			continue;
+		}
+
+		switch (command) {
+			case DAC::Command::WRITE:
+				inputRegisters[channel] = value;
+				break;
+			case DAC::Command::UPDATE:
+				latch(channel, timestamp_ns);
+				break;
+			case DAC::Command::WRITE_UPDATE_ALL:
+				inputRegisters[channel] = value;
+				for (uint8_t j = 0; j < NUM_CHANNELS; ++j) {
+					latch(j, timestamp_ns);
+				}
+				break;
+			case DAC::Command::WRITE_UPDATE:
+				inputRegisters[channel] = value;
+				latch(channel, timestamp_ns);
+				break;
+			default:
+				++invalidFrames;
+				break;
+		}
+	}
+}
+
+void SimDAC::handleRead(uint8_t *data, uint16_t length, uint64_t timestamp_ns) {
+	(void)timestamp_ns;
+	for (uint16_t i = 0; i < length; ++i) {
+		data[i] = 0xFF;
+	}
+}
+
+uint16_t SimDAC::getOutput(uint8_t channel) const {
+	return channel < NUM_CHANNELS ? dacRegisters[channel] : 0;
+}
+
+uint64_t SimDAC::getNumUpdates() const {
+	return numUpdates;
+}
+
+const SimDAC::Update &SimDAC::getUpdate(uint64_t index) const {
+	return log[index % LOG_CAPACITY];
+}
+
+uint64_t SimDAC::getInvalidFrames() const {
+	return invalidFrames;
+}
+
+void SimDAC::clearLog() {
+	numUpdates = 0;
+	invalidFrames = 0;
+}
+
+void SimDAC::latch(uint8_t channel, uint64_t timestamp_ns) {
+	if (dacRegisters[channel] == inputRegisters[channel]) {
+		return;
+	}
+	dacRegisters[channel] = inputRegisters[channel];
+
+	Update *update = &log[numUpdates % LOG_CAPACITY];
+	update->timestamp_ns = timestamp_ns;
+	update->channel = channel;
+	update->value = dacRegisters[channel];
+	++numUpdates;
+}
@@ -0,0 +1,144 @@
+#include "../include/SimGPIOLines.h"
+
+SimGPIOListener::~SimGPIOListener() {}
+
+SimGPIOLines::SimGPIOLines(const uint8_t *pinNums, uint8_t numLines, bool isOutput) :
+	GPIOLines(pinNums, numLines, isOutput) {
+	pthread_mutex_init(&edgeLock, NULL);
+}
+
+SimGPIOLines::~SimGPIOLines() {
+	closeLines();
+	pthread_mutex_destroy(&edgeLock);
+}
+
+bool SimGPIOLines::setup() {
+	values = 0;
+	if (edgeEvents && !isOutput && eventDesc == -1) {
+		eventDesc = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (eventDesc == -1) {
+			printf("Error: Failed to create eventfd\n");
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SimGPIOLines::setValues(uint32_t mask, uint32_t values) {
+	if (!isOutput) {
+		Log::error("Cannot write to input lines");
+		return false;
+	}
+	uint64_t timestamp_ns = Timer::now_ns();
+	pthread_mutex_lock(&edgeLock);
+	++numAccesses;
+	uint32_t newValues = (this->values & ~mask) | (values & mask);
+	uint32_t changed = newValues ^ this->values;
+	this->values = newValues;
+	record(Access::SET, mask, newValues & mask, timestamp_ns);
+	pthread_mutex_unlock(&edgeLock);
+	if (changed && listener) {
+		listener->onLinesChanged(newValues, changed, timestamp_ns);
+	}
+	return true;
+}
+
+bool SimGPIOLines::getValues(uint32_t mask, uint32_t *values) {
+	uint64_t timestamp_ns = Timer::now_ns();
+	pthread_mutex_lock(&edgeLock);
+	++numAccesses;
+	*values = this->values & mask;
+	record(Access::GET, mask, *values, timestamp_ns);
+	pthread_mutex_unlock(&edgeLock);
+	return true;
+}
+
+bool SimGPIOLines::closeLines() {
+	if (eventDesc != -1) {
+		close(eventDesc);
+		eventDesc = -1;
+	}
+	return true;
+}
+
+int SimGPIOLines::getEventFd() const {
+	return eventDesc;
+}
+
+bool SimGPIOLines::readEdge(uint8_t *line, bool *value, uint64_t *timestamp_ns) {
+	pthread_mutex_lock(&edgeLock);
+	if (numPendingEdges == 0) {
+		uint64_t count;
+		if (read(eventDesc, &count, sizeof(count)) != sizeof(count)) {
+			// Already drained
+		}
+		pthread_mutex_unlock(&edgeLock);
+		return false;
+	}
+	PendingEdge *edge = &pendingEdges[edgeHead];
+	*line = edge->line;
+	*value = edge->value;
+	*timestamp_ns = edge->timestamp_ns;
+	edgeHead = (edgeHead + 1) % MAX_PENDING_EDGES;
+	--numPendingEdges;
+	pthread_mutex_unlock(&edgeLock);
+	return true;
+}
+
+void SimGPIOLines::setListener(SimGPIOListener *listener) {
+	this->listener = listener;
+}
+
+void SimGPIOLines::injectValue(uint8_t line, bool value) {
+	uint32_t bit = 1u << line;
+	uint64_t timestamp_ns = Timer::now_ns();
+	pthread_mutex_lock(&edgeLock);
+	if (((values & bit) != 0) == value) {
+		pthread_mutex_unlock(&edgeLock);
+		return;
+	}
+	values ^= bit;
+	record(Access::INJECT, bit, values & bit, timestamp_ns);
+	if (edgeEvents && numPendingEdges < MAX_PENDING_EDGES) {
+		PendingEdge *edge = &pendingEdges[(edgeHead + numPendingEdges) % MAX_PENDING_EDGES];
+		edge->line = line;
+		edge->value = value;
+		edge->timestamp_ns = timestamp_ns;
+		++numPendingEdges;
+	}
+	pthread_mutex_unlock(&edgeLock);
+
+	if (eventDesc != -1) {
+		uint64_t one = 1;
+		if (write(eventDesc, &one, sizeof(one)) != sizeof(one)) {
+			// Counter saturated; the reader is already due to wake
+		}
+	}
+}
+
+uint64_t SimGPIOLines::getNumAccesses() const {
+	return numAccesses;
+}
+
+uint64_t SimGPIOLines::getNumRecords() const {
+	return numRecords;
+}
+
+const SimGPIOLines::Record &SimGPIOLines::getRecord(uint64_t index) const {
+	return log[index % LOG_CAPACITY];
+}
+
+void SimGPIOLines::clearLog() {
+	pthread_mutex_lock(&edgeLock);
+	numRecords = 0;
+	pthread_mutex_unlock(&edgeLock);
+}
+
+void SimGPIOLines::record(Access access, uint32_t mask, uint32_t values, uint64_t timestamp_ns) {
+	Record *entry = &log[numRecords % LOG_CAPACITY];
+	entry->timestamp_ns = timestamp_ns;
+	entry->access = access;
+	entry->mask = mask;
+	entry->values = values;
+	++numRecords;
+}
@@ -0,0 +1,155 @@
+#include "../include/SimHD44780.h"
+
+SimHD44780::SimHD44780() {
+	memset(ddram, ' ', DDRAM_SIZE);
+}
+
+void SimHD44780::onLinesChanged(uint32_t values, uint32_t changed, uint64_t timestamp_ns) {
+	uint32_t eBit = 1u << LCD::Line::E;
+	if (!(changed & eBit) || (values & eBit)) {
+		// Only the falling edge of E latches data
+		return;
+	}
+
+	uint8_t nibble =
+		((values >> LCD::Line::DB4) & 1) |
+		(((values >> LCD::Line::DB5) & 1) << 1) |
+		(((values >> LCD::Line::DB6) & 1) << 2) |
+		(((values >> LCD::Line::DB7) & 1) << 3);
+	bool isData = (values >> LCD::Line::RS) & 1;
+	latchNibble(nibble, isData, timestamp_ns);
+}
+
+void SimHD44780::getRow(uint8_t row, char *text) const {
+	uint8_t base = (row % ROWS) * 0x40;
+	for (uint8_t col = 0; col < COLS; ++col) {
+		text[col] = ddram[base + col];
+	}
+	text[COLS] = '\0';
+}
+
+bool SimHD44780::isDisplayOn() const {
+	return displayOn;
+}
+
+bool SimHD44780::isFourBitMode() const {
+	return fourBitMode;
+}
+
+uint64_t SimHD44780::getNumTransfers() const {
+	return numTransfers;
+}
+
+const SimHD44780::Transfer &SimHD44780::getTransfer(uint64_t index) const {
+	return log[index % LOG_CAPACITY];
+}
+
+uint64_t SimHD44780::getBusyViolations() const {
+	return busyViolations;
+}
+
+void SimHD44780::clearLog() {
+	numTransfers = 0;
+	busyViolations = 0;
+}
+
+void SimHD44780::latchNibble(uint8_t nibble, bool isData, uint64_t timestamp_ns) {
+	if (!fourBitMode) {
+		// In 8-bit mode DB0-DB3 are not connected and read as 0
+		execute(nibble << 4, isData, timestamp_ns);
+		return;
+	}
+	if (!waitingForLowNibble) {
+		highNibble = nibble;
+		waitingForLowNibble = 1;
+		return;
+	}
+	waitingForLowNibble = 0;
+	execute((highNibble << 4) | nibble, isData, timestamp_ns);
+}
+
+void SimHD44780::execute(uint8_t value, bool isData, uint64_t timestamp_ns) {
+	Transfer *transfer = &log[numTransfers % LOG_CAPACITY];
+	transfer->timestamp_ns = timestamp_ns;
+	transfer->isData = isData;
+	transfer->value = value;
+	++numTransfers;
+
+	// Function set is accepted during initialization regardless of the busy flag
+	bool isFunctionSet = !isData && (value & 0xE0) == 0x20;
+	if (timestamp_ns < busyUntil_ns && !isFunctionSet) {
+		++busyViolations;
+	}
+	busyUntil_ns = timestamp_ns + COMMAND_TIME_NS;
+
+	if (isData) {
+		ddram[address] = (char) value;
+		advanceAddress(increment);
+		return;
+	}
+
+	if (value & 0x80) {
+		// Set DDRAM address
+		address = value & 0x7F;
+	}
+	else if (value & 0x40) {
+		// Set CGRAM address; CGRAM is not modelled
+	}
+	else if (value & 0x20) {
+		fourBitMode = !(value & 0x10);
+		twoLines = value & 0x08;
+	}
+	else if (value & 0x10) {
+		// Cursor or display shift; moving the cursor leaves the entry mode direction alone
+		if (!(value & 0x08)) {
+			advanceAddress(value & 0x04);
+		}
+	}
+	else if (value & 0x08) {
+		displayOn = value & 0x04;
+	}
+	else if (value & 0x04) {
+		increment = value & 0x02;
+	}
+	else if (value & 0x02) {
+		address = 0;
+		busyUntil_ns = timestamp_ns + CLEAR_TIME_NS;
+	}
+	else if (value & 0x01) {
+		memset(ddram, ' ', DDRAM_SIZE);
+		address = 0;
+		increment = 1;
+		busyUntil_ns = timestamp_ns + CLEAR_TIME_NS;
+	}
+}
+
+void SimHD44780::advanceAddress(bool forward) {
+	if (!twoLines) {
+		address = forward ? (address + 1) % 0x50 : (address + 0x4F) % 0x50;
+		return;
+	}
+
+	// Two-line mode: 0x00-0x27 and 0x40-0x67, wrapping from one line to the other
+	if (forward) {
+		if (address == 0x27) {
+			address = 0x40;
+		}
+		else if (address == 0x67) {
+			address = 0x00;
+		}
+		else {
+			++address;
+		}
+	}
+	else {
+		if (address == 0x40) {
+			address = 0x27;
+		}
+		else if (address == 0x00) {
+			address = 0x67;
+		}
+		else {
+			--address;
+		}
+	}
+}
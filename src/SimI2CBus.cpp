@@ -0,0 +1,153 @@
+#include "../include/SimI2CBus.h"
+
+SimI2CDevice::SimI2CDevice(uint8_t addr) : addr(addr) {}
+
+SimI2CDevice::~SimI2CDevice() {}
+
+uint8_t SimI2CDevice::getAddress() const {
+	return addr;
+}
+
+SimI2CBus::SimI2CBus() : I2CBus(-1) {}
+
+bool SimI2CBus::attach(SimI2CDevice *device) {
+	if (numDevices >= MAX_DEVICES || findDevice(device->getAddress())) {
+		printf("Error: Failed to attach simulated I2C device\n");
+		return false;
+	}
+	devices[numDevices++] = device;
+	return true;
+}
+
+void SimI2CBus::setLatency(uint64_t perCall_ns, uint64_t perByte_ns) {
+	this->perCall_ns = perCall_ns;
+	this->perByte_ns = perByte_ns;
+}
+
+bool SimI2CBus::selectAddress(uint8_t addr) {
+	if (selectedAddr == addr) {
+		return true;
+	}
+	++counters.addressSelects;
+	selectedAddr = addr;
+	return true;
+}
+
+bool SimI2CBus::write(uint8_t addr, const uint8_t *data, size_t length) {
+	if (!selectAddress(addr)) {
+		return false;
+	}
+	++counters.writes;
+	++transferId;
+
+	uint8_t buffer[I2CTransaction::BUFFER_SIZE];
+	if (length > sizeof(buffer)) {
+		return false;
+	}
+	memcpy(buffer, data, length);
+	uint64_t busTime_ns = Timer::now_ns() + perCall_ns;
+	return deliver(addr, false, buffer, length, &busTime_ns);
+}
+
+bool SimI2CBus::read(uint8_t addr, uint8_t *data, size_t length) {
+	if (!selectAddress(addr)) {
+		return false;
+	}
+	++counters.reads;
+	++transferId;
+
+	uint64_t busTime_ns = Timer::now_ns() + perCall_ns;
+	return deliver(addr, true, data, length, &busTime_ns);
+}
+
+bool SimI2CBus::transfer(I2CTransaction *transaction) {
+	uint8_t numMessages = transaction->getNumMessages();
+	if (numMessages == 0) {
+		return true;
+	}
+	++counters.transfers;
+	++transferId;
+
+	const struct i2c_msg *messages = getMessages(transaction);
+	uint64_t busTime_ns = Timer::now_ns() + perCall_ns;
+	bool success = true;
+	for (uint8_t i = 0; i < numMessages; ++i) {
+		bool isRead = messages[i].flags & I2C_M_RD;
+		if (!deliver(messages[i].addr, isRead, messages[i].buf, messages[i].len, &busTime_ns)) {
+			// The kernel aborts the remaining messages after a NACK
+			success = false;
+			break;
+		}
+	}
+	return success;
+}
+
+uint64_t SimI2CBus::getNumRecords() const {
+	return numRecords;
+}
+
+const SimI2CBus::Record &SimI2CBus::getRecord(uint64_t index) const {
+	return log[index % LOG_CAPACITY];
+}
+
+void SimI2CBus::getCounters(Counters *counters) const {
+	*counters = this->counters;
+}
+
+void SimI2CBus::clearLog() {
+	numRecords = 0;
+	counters = Counters();
+}
+
+SimI2CDevice *SimI2CBus::findDevice(uint8_t addr) {
+	for (uint8_t i = 0; i < numDevices; ++i) {
+		if (devices[i]->getAddress() == addr) {
+			return devices[i];
+		}
+	}
+	return nullptr;
+}
+
+bool SimI2CBus::deliver(uint8_t addr, bool isRead, uint8_t *data, uint16_t length, uint64_t *busTime_ns) {
+	// Address byte plus data bytes
+	*busTime_ns += perByte_ns * (length + 1);
+	waitUntil(*busTime_ns);
+	uint64_t timestamp_ns = Timer::now_ns();
+
+	SimI2CDevice *device = findDevice(addr);
+	if (device) {
+		if (isRead) {
+			device->handleRead(data, length, timestamp_ns);
+		}
+		else {
+			device->handleWrite(data, length, timestamp_ns);
+		}
+	}
+	else {
+		++counters.nacks;
+	}
+	++counters.messages;
+	counters.bytes += length;
+
+	Record *record = &log[numRecords % LOG_CAPACITY];
+	record->timestamp_ns = timestamp_ns;
+	record->transferId = transferId;
+	record->addr = addr;
+	record->isRead = isRead;
+	record->acknowledged = device != nullptr;
+	record->length = length;
+	memcpy(record->data, data, length < MAX_LOGGED_BYTES ? length : MAX_LOGGED_BYTES);
+	++numRecords;
+
+	return device != nullptr;
+}
+
+void SimI2CBus::waitUntil(uint64_t deadline_ns) {
+	if (perCall_ns == 0 && perByte_ns == 0) {
+		return;
+	}
+	struct timespec deadline;
+	deadline.tv_sec = deadline_ns / 1000000000ull;
+	deadline.tv_nsec = deadline_ns % 1000000000ull;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) != 0) {}
+}
@@ -0,0 +1,116 @@
+#include "../include/SimMCP23017.h"
+
+SimMCP23017::SimMCP23017(uint8_t addr) : SimI2CDevice(addr) {
+	// Power-on state: every pin is an input
+	registers[Register::IODIRA] = 0xFF;
+	registers[Register::IODIRA + 1] = 0xFF;
+}
+
+void SimMCP23017::handleWrite(const uint8_t *data, uint16_t length, uint64_t timestamp_ns) {
+	if (length == 0) {
+		return;
+	}
+
+	// First byte sets the register pointer, the rest are written sequentially
+	pointer = data[0] % Register::NUM_REGISTERS;
+	for (uint16_t i = 1; i < length; ++i) {
+		writeRegister(pointer, data[i], timestamp_ns);
+		advancePointer();
+	}
+}
+
+void SimMCP23017::handleRead(uint8_t *data, uint16_t length, uint64_t timestamp_ns) {
+	(void)timestamp_ns;
+	for (uint16_t i = 0; i < length; ++i) {
+		data[i] = readRegister(pointer);
+		advancePointer();
+	}
+}
+
+void SimMCP23017::setInputs(uint8_t port, uint8_t levels) {
+	inputs[port % NUM_PORTS] = levels;
+}
+
+uint8_t SimMCP23017::getOutputs(uint8_t port) const {
+	port %= NUM_PORTS;
+	return registers[Register::OLATA + port] & ~registers[Register::IODIRA + port];
+}
+
+uint8_t SimMCP23017::getRegister(uint8_t reg) const {
+	return registers[reg % Register::NUM_REGISTERS];
+}
+
+uint64_t SimMCP23017::getNumEdges() const {
+	return numEdges;
+}
+
+const SimMCP23017::Edge &SimMCP23017::getEdge(uint64_t index) const {
+	return log[index % LOG_CAPACITY];
+}
+
+uint64_t SimMCP23017::getUnsupportedWrites() const {
+	return unsupportedWrites;
+}
+
+void SimMCP23017::clearLog() {
+	numEdges = 0;
+	unsupportedWrites = 0;
+}
+
+void SimMCP23017::writeRegister(uint8_t reg, uint8_t value, uint64_t timestamp_ns) {
+	if ((reg >= Register::INTFA && reg < Register::GPIOA)) {
+		// INTF and INTCAP are read-only
+		++unsupportedWrites;
+		return;
+	}
+	if (reg == Register::IOCON || reg == Register::IOCONB) {
+		if (value & 0x80) {
+			++unsupportedWrites;
+		}
+		registers[Register::IOCON] = value;
+		registers[Register::IOCONB] = value;
+		return;
+	}
+
+	uint8_t port = reg & 1;
+	uint8_t before = getOutputs(port);
+	if (reg == Register::GPIOA || reg == Register::GPIOA + 1) {
+		// Writing GPIO writes the output latch
+		reg = Register::OLATA + port;
+	}
+	registers[reg] = value;
+	recordEdges(port, before, getOutputs(port), timestamp_ns);
+}
+
+uint8_t SimMCP23017::readRegister(uint8_t reg) const {
+	if (reg == Register::GPIOA || reg == Register::GPIOA + 1) {
+		uint8_t port = reg & 1;
+		uint8_t directions = registers[Register::IODIRA + port];
+		uint8_t inputLevels = inputs[port] ^ registers[Register::IPOLA + port];
+		return (inputLevels & directions) | (registers[Register::OLATA + port] & ~directions);
+	}
+	return registers[reg];
+}
+
+void SimMCP23017::advancePointer() {
+	// IOCON.SEQOP disables the address pointer increment
+	if (registers[Register::IOCON] & 0x20) {
+		return;
+	}
+	pointer = (pointer + 1) % Register::NUM_REGISTERS;
+}
+
+void SimMCP23017::recordEdges(uint8_t port, uint8_t before, uint8_t after, uint64_t timestamp_ns) {
+	uint8_t changed = before ^ after;
+	for (uint8_t pin = 0; pin < PINS_PER_PORT; ++pin) {
+		if (!(changed & (1u << pin))) {
+			continue;
+		}
+		Edge *edge = &log[numEdges % LOG_CAPACITY];
+		edge->timestamp_ns = timestamp_ns;
+		edge->port = port;
+		edge->pin = pin;
+		edge->value = (after >> pin) & 1;
+		++numEdges;
+	}
+}
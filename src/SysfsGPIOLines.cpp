@@ -0,0 +1,137 @@
+#include "../include/SysfsGPIOLines.h"
+
+SysfsGPIOLines::SysfsGPIOLines(const uint8_t *pinNums, uint8_t numLines, bool isOutput) :
+	GPIOLines(pinNums, numLines, isOutput) {}
+
+SysfsGPIOLines::~SysfsGPIOLines() {
+	deletePins();
+}
+
+bool SysfsGPIOLines::setup() {
+	deletePins();
+	bool success = true;
+	for (uint8_t i = 0; i < numLines; ++i) {
+		if (isOutput) {
+			outputPins[i] = new DigitalOutputPin(pinNums[i]);
+			success = outputPins[i]->setup() && success;
+		}
+		else {
+			inputPins[i] = new DigitalInputPin(pinNums[i]);
+			success = inputPins[i]->setup() && success;
+			if (edgeEvents) {
+				success = inputPins[i]->setEdge("both") && success;
+			}
+		}
+	}
+
+	if (edgeEvents && !isOutput && inputPins[0]) {
+		// Reading also clears the pending POLLPRI left by opening the value file
+		inputPins[0]->readValue(&edgeValue);
+	}
+
+	// DigitalOutputPin::setup() drives every line low
+	outputValues = 0;
+	knownMask = isOutput ? (uint32_t) -1 : 0;
+	return success;
+}
+
+bool SysfsGPIOLines::setValues(uint32_t mask, uint32_t values) {
+	if (!isOutput) {
+		Log::error("Cannot write to input lines");
+		return false;
+	}
+	bool success = true;
+	for (uint8_t i = 0; i < numLines; ++i) {
+		uint32_t bit = 1u << i;
+		if (!(mask & bit) || !outputPins[i]) {
+			continue;
+		}
+		if ((knownMask & bit) && (outputValues & bit) == (values & bit)) {
+			continue;
+		}
+		if (outputPins[i]->writeValue(values & bit)) {
+			outputValues = (outputValues & ~bit) | (values & bit);
+			knownMask |= bit;
+		}
+		else {
+			knownMask &= ~bit;
+			success = false;
+		}
+	}
+	return success;
+}
+
+bool SysfsGPIOLines::getValues(uint32_t mask, uint32_t *values) {
+	if (isOutput) {
+		*values = outputValues & mask;
+		return true;
+	}
+	uint32_t result = 0;
+	for (uint8_t i = 0; i < numLines; ++i) {
+		uint32_t bit = 1u << i;
+		if (!(mask & bit) || !inputPins[i]) {
+			continue;
+		}
+		bool value = 0;
+		if (!inputPins[i]->readValue(&value)) {
+			return false;
+		}
+		if (value) {
+			result |= bit;
+		}
+	}
+	*values = result;
+	return true;
+}
+
+bool SysfsGPIOLines::closeLines() {
+	bool success = true;
+	for (uint8_t i = 0; i < numLines; ++i) {
+		if (outputPins[i]) {
+			success = outputPins[i]->writeValue(0) && success;
+		}
+	}
+
+	// Pin destructors close the value files, leaving the lines exported for the next start
+	deletePins();
+	knownMask = 0;
+	return success;
+}
+
+int SysfsGPIOLines::getEventFd() const {
+	if (!edgeEvents || isOutput || numLines != 1 || !inputPins[0]) {
+		return -1;
+	}
+	return inputPins[0]->getValueDesc();
+}
+
+uint32_t SysfsGPIOLines::getEventMask() const {
+	// A value file always polls readable; edges are signalled by sysfs_notify() as priority data
+	return EPOLLPRI | EPOLLERR;
+}
+
+bool SysfsGPIOLines::readEdge(uint8_t *line, bool *value, uint64_t *timestamp_ns) {
+	if (getEventFd() == -1) {
+		return false;
+	}
+
+	// sysfs reports no edge timestamps, so the edge is stamped when it is read
+	bool currentValue = 0;
+	if (!inputPins[0]->readValue(&currentValue) || currentValue == edgeValue) {
+		return false;
+	}
+	edgeValue = currentValue;
+	*line = 0;
+	*value = currentValue;
+	*timestamp_ns = Timer::now_ns();
+	return true;
+}
+
+void SysfsGPIOLines::deletePins() {
+	for (uint8_t i = 0; i < MAX_LINES; ++i) {
+		delete outputPins[i];
+		delete inputPins[i];
+		outputPins[i] = nullptr;
+		inputPins[i] = nullptr;
+	}
+}
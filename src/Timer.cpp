@@ -5,16 +5,23 @@ Timer::Timer() {
 }
 
 void Timer::set() {
-	clock_gettime(CLOCK_MONOTONIC, &setTime);
+	setTime_ns = now_ns();
 }
 
-double Timer::get_s() {
-	struct timespec currentTime;
-	clock_gettime(CLOCK_MONOTONIC, &currentTime);
-	return currentTime.tv_sec - setTime.tv_sec + (currentTime.tv_nsec - setTime.tv_nsec) / 1000000000.0;
+uint64_t Timer::get_ns() const {
+	return now_ns() - setTime_ns;
+}
+
+double Timer::get_s() const {
+	return (double) get_ns() / NS_PER_S;
 }
 
-double Timer::get_ms() {
-	return get_s() * 1000.0;
+double Timer::get_ms() const {
+	return (double) get_ns() / NS_PER_MS;
 }
 
+uint64_t Timer::now_ns() {
+	struct timespec currentTime;
+	clock_gettime(CLOCK_MONOTONIC, &currentTime);
+	return (uint64_t) currentTime.tv_sec * NS_PER_S + currentTime.tv_nsec;
+}
@@ -0,0 +1,197 @@
+#include "../include/TimerWheel.h"
+
+TimerWheel::TimerWheel(uint64_t now_ns) : currentTick(now_ns >> TICK_SHIFT) {
+	for (uint8_t level = 0; level < NUM_LEVELS; ++level) {
+		occupied[level] = 0;
+		for (uint8_t slot = 0; slot < NUM_SLOTS; ++slot) {
+			slots[level][slot] = nullptr;
+		}
+	}
+}
+
+void TimerWheel::schedule(Entry *entry, uint64_t deadline_ns) {
+	if (entry->pending) {
+		unlink(entry);
+	}
+	entry->deadline_ns = deadline_ns;
+	insert(entry);
+}
+
+void TimerWheel::cancel(Entry *entry) {
+	if (entry->pending) {
+		unlink(entry);
+	}
+}
+
+size_t TimerWheel::advance(uint64_t now_ns) {
+	uint64_t nowTick = now_ns >> TICK_SHIFT;
+	if (numPending == 0) {
+		if (nowTick > currentTick) {
+			currentTick = nowTick;
+		}
+		return 0;
+	}
+
+	size_t fired = 0;
+	while (true) {
+		cascade(currentTick);
+		fired += expire(now_ns);
+		if (currentTick >= nowTick) {
+			break;
+		}
+		currentTick = getNextTick(nowTick);
+	}
+	return fired;
+}
+
+uint64_t TimerWheel::getNextDeadline_ns() const {
+	if (numPending == 0) {
+		return 0;
+	}
+
+	// Slots are visited in time order from the current position, each level only until a slot
+	// starts after the earliest deadline found so far. The first slot of a level is not enough:
+	// an entry placed beyond the last level sits at the far end of it, ahead of its deadline.
+	uint64_t earliest_ns = UINT64_MAX;
+	for (uint8_t level = 0; level < NUM_LEVELS; ++level) {
+		uint8_t shift = LEVEL_BITS * level;
+		uint64_t firstPeriod = level == 0 ? currentTick : (currentTick >> shift) + 1;
+		uint64_t rotated = getRotatedOccupancy(level, firstPeriod & SLOT_MASK);
+		while (rotated != 0) {
+			uint8_t distance = __builtin_ctzll(rotated);
+			uint64_t slotStart_ns = ((firstPeriod + distance) << shift) << TICK_SHIFT;
+			if (slotStart_ns >= earliest_ns) {
+				break;
+			}
+			for (Entry *entry = slots[level][(firstPeriod + distance) & SLOT_MASK]; entry; entry = entry->next) {
+				if (entry->deadline_ns < earliest_ns) {
+					earliest_ns = entry->deadline_ns;
+				}
+			}
+			rotated &= rotated - 1;
+		}
+	}
+	return earliest_ns;
+}
+
+size_t TimerWheel::getNumPending() const {
+	return numPending;
+}
+
+void TimerWheel::setLatenessHistogram(MetricHistogram *histogram) {
+	latenessHistogram = histogram;
+}
+
+void TimerWheel::insert(Entry *entry) {
+	uint64_t tick = entry->deadline_ns >> TICK_SHIFT;
+	if (tick < currentTick) {
+		tick = currentTick;
+	}
+	uint64_t delta = tick - currentTick;
+	uint8_t level = 0;
+	while (level < NUM_LEVELS - 1 && delta >> (LEVEL_BITS * (level + 1)) != 0) {
+		++level;
+	}
+	if (delta >> (LEVEL_BITS * NUM_LEVELS) != 0) {
+		// Beyond the last level: park it at the far end and place it again when it cascades
+		tick = currentTick + (1ull << (LEVEL_BITS * NUM_LEVELS)) - 1;
+	}
+	uint8_t slot = (tick >> (LEVEL_BITS * level)) & SLOT_MASK;
+
+	entry->level = level;
+	entry->slot = slot;
+	entry->prev = nullptr;
+	entry->next = slots[level][slot];
+	if (entry->next) {
+		entry->next->prev = entry;
+	}
+	slots[level][slot] = entry;
+	occupied[level] |= 1ull << slot;
+	entry->pending = 1;
+	++numPending;
+}
+
+void TimerWheel::unlink(Entry *entry) {
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	}
+	else {
+		slots[entry->level][entry->slot] = entry->next;
+		if (!entry->next) {
+			occupied[entry->level] &= ~(1ull << entry->slot);
+		}
+	}
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	}
+	entry->prev = nullptr;
+	entry->next = nullptr;
+	entry->pending = 0;
+	--numPending;
+}
+
+void TimerWheel::cascade(uint64_t tick) {
+	// Highest level first, so entries can fall more than one level at a boundary
+	for (uint8_t level = NUM_LEVELS - 1; level > 0; --level) {
+		uint8_t shift = LEVEL_BITS * level;
+		if ((tick & ((1ull << shift) - 1)) != 0) {
+			continue;
+		}
+		uint8_t slot = (tick >> shift) & SLOT_MASK;
+		Entry *entry = slots[level][slot];
+		slots[level][slot] = nullptr;
+		occupied[level] &= ~(1ull << slot);
+		while (entry) {
+			Entry *next = entry->next;
+			--numPending;
+			insert(entry);
+			entry = next;
+		}
+	}
+}
+
+size_t TimerWheel::expire(uint64_t now_ns) {
+	size_t fired = 0;
+	uint8_t slot = currentTick & SLOT_MASK;
+	Entry *entry = slots[0][slot];
+	while (entry) {
+		if (entry->deadline_ns > now_ns) {
+			entry = entry->next;
+			continue;
+		}
+		unlink(entry);
+		if (latenessHistogram) {
+			latenessHistogram->record(now_ns - entry->deadline_ns);
+		}
+		entry->callback(entry->context, now_ns);
+		++fired;
+		// The callback may have changed this slot, so start over
+		entry = slots[0][slot];
+	}
+	return fired;
+}
+
+uint64_t TimerWheel::getNextTick(uint64_t nowTick) const {
+	// The next occupied level 0 slot, but never past a boundary where a non-empty level cascades
+	uint64_t next = UINT64_MAX;
+	if (occupied[0] != 0) {
+		next = currentTick + 1 + __builtin_ctzll(getRotatedOccupancy(0, (currentTick + 1) & SLOT_MASK));
+	}
+	for (uint8_t level = 1; level < NUM_LEVELS; ++level) {
+		if (occupied[level] != 0) {
+			uint8_t shift = LEVEL_BITS * level;
+			uint64_t boundary = ((currentTick >> shift) + 1) << shift;
+			if (boundary < next) {
+				next = boundary;
+			}
+			break;
+		}
+	}
+	return next < nowTick ? next : nowTick;
+}
+
+uint64_t TimerWheel::getRotatedOccupancy(uint8_t level, uint8_t start) const {
+	// Bit i is set if the slot i places after start is occupied
+	uint64_t bits = occupied[level];
+	return start == 0 ? bits : (bits >> start) | (bits << (NUM_SLOTS - start));
+}
@@ -0,0 +1,308 @@
+#include "../include/VoiceAllocator.h"
+
+#include <string.h>
+
+static const char *POLICY_NAMES[] = {"oldest", "round-robin", "lowest", "highest", "legato"};
+
+VoiceAllocator::VoiceAllocator(uint8_t numVoices) : numVoices(numVoices < MAX_VOICES ? numVoices : MAX_VOICES) {
+	memset(noteVoices, NO_VOICE, sizeof(noteVoices));
+	memset(noteTicks, 0, sizeof(noteTicks));
+	channels[0].voiceMask = this->numVoices == 64 ? UINT64_MAX : (1ull << this->numVoices) - 1;
+	channels[0].freeMask = channels[0].voiceMask;
+}
+
+bool VoiceAllocator::noteOn(uint8_t note, uint8_t channelIndex, Change *change) {
+	if (channelIndex >= NUM_CHANNELS || note >= NUM_NOTES) {
+		return false;
+	}
+	Channel *channel = &channels[channelIndex];
+	if (channel->voiceMask == 0) {
+		// No voices are set to this MIDI channel
+		return false;
+	}
+	noteTicks[channelIndex][note] = ++tick;
+	channel->waiting.remove(note);
+
+	uint8_t voice = noteVoices[channelIndex][note];
+	if (voice != NO_VOICE) {
+		// Same note again without a note off: restart its voice
+		remove(&channel->activeVoices, voice);
+		pushBack(&channel->activeVoices, voice);
+		start(voice, note, change, true);
+		return true;
+	}
+
+	bool retrigger = true;
+	voice = findFreeVoice(channel);
+	if (voice != NO_VOICE) {
+		channel->freeMask &= ~(1ull << voice);
+		voices[voice].active = 1;
+	}
+	else {
+		voice = findVictim(channel, channelIndex, note);
+		if (voice == NO_VOICE) {
+			// Every sounding note has priority over this one, which waits for a voice
+			channel->waiting.add(note);
+			return false;
+		}
+		uint8_t stolenNote = voices[voice].note;
+		noteVoices[channelIndex][stolenNote] = NO_VOICE;
+		channel->sounding.remove(stolenNote);
+		if (restoresNotes(channel->policy)) {
+			channel->waiting.add(stolenNote);
+		}
+		remove(&channel->activeVoices, voice);
+		retrigger = channel->policy != Policy::LEGATO;
+	}
+
+	pushBack(&channel->activeVoices, voice);
+	noteVoices[channelIndex][note] = voice;
+	channel->sounding.add(note);
+	start(voice, note, change, retrigger);
+	return true;
+}
+
+bool VoiceAllocator::noteOff(uint8_t note, uint8_t channelIndex, Change *change) {
+	if (channelIndex >= NUM_CHANNELS || note >= NUM_NOTES) {
+		return false;
+	}
+	Channel *channel = &channels[channelIndex];
+	uint8_t voice = noteVoices[channelIndex][note];
+	if (voice == NO_VOICE) {
+		// The note never had a voice or lost it; a stolen voice is not released
+		channel->waiting.remove(note);
+		return false;
+	}
+	noteVoices[channelIndex][note] = NO_VOICE;
+	channel->sounding.remove(note);
+	remove(&channel->activeVoices, voice);
+
+	if (!channel->waiting.isEmpty()) {
+		// Hand the voice back to a held note (only the restoring policies leave notes waiting)
+		uint8_t next;
+		if (channel->policy == Policy::LOWEST_NOTE) {
+			next = channel->waiting.lowest();
+		}
+		else if (channel->policy == Policy::HIGHEST_NOTE) {
+			next = channel->waiting.highest();
+		}
+		else {
+			// Legato returns to the most recently pressed note
+			next = channel->waiting.lowest();
+			for (uint8_t word = 0; word < 2; ++word) {
+				uint64_t bits = channel->waiting.bits[word];
+				while (bits) {
+					uint8_t candidate = word * 64 + __builtin_ctzll(bits);
+					if ((int32_t) (noteTicks[channelIndex][candidate] - noteTicks[channelIndex][next]) > 0) {
+						next = candidate;
+					}
+					bits &= bits - 1;
+				}
+			}
+		}
+		channel->waiting.remove(next);
+		channel->sounding.add(next);
+		noteVoices[channelIndex][next] = voice;
+		pushBack(&channel->activeVoices, voice);
+		start(voice, next, change, channel->policy != Policy::LEGATO);
+		return true;
+	}
+
+	voices[voice].active = 0;
+	channel->freeMask |= 1ull << voice;
+	change->voice = voice;
+	change->note = note;
+	change->gate = 0;
+	change->retrigger = 0;
+	return true;
+}
+
+void VoiceAllocator::releaseChannel(uint8_t channelIndex) {
+	if (channelIndex >= NUM_CHANNELS) {
+		return;
+	}
+	Channel *channel = &channels[channelIndex];
+	while (channel->activeVoices.head != NO_VOICE) {
+		uint8_t voice = channel->activeVoices.head;
+		noteVoices[channelIndex][voices[voice].note] = NO_VOICE;
+		voices[voice].active = 0;
+		remove(&channel->activeVoices, voice);
+	}
+	channel->freeMask = channel->voiceMask;
+	channel->sounding = NoteSet();
+	channel->waiting = NoteSet();
+}
+
+void VoiceAllocator::assign(uint8_t voice, uint8_t channelIndex) {
+	if (voice >= numVoices || channelIndex >= NUM_CHANNELS) {
+		return;
+	}
+	Voice *v = &voices[voice];
+	Channel *oldChannel = &channels[v->channel];
+	if (v->active) {
+		noteVoices[v->channel][v->note] = NO_VOICE;
+		oldChannel->sounding.remove(v->note);
+		remove(&oldChannel->activeVoices, voice);
+		v->active = 0;
+	}
+	oldChannel->voiceMask &= ~(1ull << voice);
+	oldChannel->freeMask &= ~(1ull << voice);
+
+	v->channel = channelIndex;
+	channels[channelIndex].voiceMask |= 1ull << voice;
+	channels[channelIndex].freeMask |= 1ull << voice;
+}
+
+void VoiceAllocator::setPolicy(uint8_t channelIndex, Policy policy) {
+	if (channelIndex >= NUM_CHANNELS) {
+		return;
+	}
+	channels[channelIndex].policy = policy;
+	channels[channelIndex].waiting = NoteSet();
+	channels[channelIndex].rotation = 0;
+}
+
+void VoiceAllocator::setPolicy(Policy policy) {
+	for (uint8_t i = 0; i < NUM_CHANNELS; ++i) {
+		setPolicy(i, policy);
+	}
+}
+
+uint8_t VoiceAllocator::getNumVoices() const {
+	return numVoices;
+}
+
+uint8_t VoiceAllocator::getChannel(uint8_t voice) const {
+	return voices[voice].channel;
+}
+
+bool VoiceAllocator::isActive(uint8_t voice) const {
+	return voices[voice].active;
+}
+
+uint8_t VoiceAllocator::getNote(uint8_t voice) const {
+	return voices[voice].note;
+}
+
+VoiceAllocator::Policy VoiceAllocator::getPolicy(uint8_t channel) const {
+	return channels[channel].policy;
+}
+
+bool VoiceAllocator::parsePolicy(const char *name, Policy *policy) {
+	for (uint8_t i = 0; i < sizeof(POLICY_NAMES) / sizeof(POLICY_NAMES[0]); ++i) {
+		if (strcmp(name, POLICY_NAMES[i]) == 0) {
+			*policy = (Policy) i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char *VoiceAllocator::getPolicyName(Policy policy) {
+	return POLICY_NAMES[(uint8_t) policy];
+}
+
+uint8_t VoiceAllocator::findFrom(uint64_t mask, uint8_t start) {
+	// First set bit at or after start, wrapping around; mask must not be empty
+	uint64_t rotated = start == 0 ? mask : (mask >> start) | (mask << (MAX_VOICES - start));
+	return (start + __builtin_ctzll(rotated)) % MAX_VOICES;
+}
+
+void VoiceAllocator::pushBack(List *list, uint8_t voice) {
+	voices[voice].prev = list->tail;
+	voices[voice].next = NO_VOICE;
+	if (list->tail != NO_VOICE) {
+		voices[list->tail].next = voice;
+	}
+	else {
+		list->head = voice;
+	}
+	list->tail = voice;
+}
+
+void VoiceAllocator::remove(List *list, uint8_t voice) {
+	uint8_t prev = voices[voice].prev;
+	uint8_t next = voices[voice].next;
+	if (prev != NO_VOICE) {
+		voices[prev].next = next;
+	}
+	else {
+		list->head = next;
+	}
+	if (next != NO_VOICE) {
+		voices[next].prev = prev;
+	}
+	else {
+		list->tail = prev;
+	}
+	voices[voice].prev = NO_VOICE;
+	voices[voice].next = NO_VOICE;
+}
+
+uint8_t VoiceAllocator::findFreeVoice(Channel *channel) {
+	if (channel->freeMask == 0) {
+		return NO_VOICE;
+	}
+	if (channel->policy != Policy::ROUND_ROBIN) {
+		// Lowest-numbered, so a single line of notes keeps to one output
+		return __builtin_ctzll(channel->freeMask);
+	}
+	uint8_t voice = findFrom(channel->freeMask, channel->rotation);
+	channel->rotation = (voice + 1) % MAX_VOICES;
+	return voice;
+}
+
+uint8_t VoiceAllocator::findVictim(Channel *channel, uint8_t channelIndex, uint8_t note) {
+	switch (channel->policy) {
+		case Policy::ROUND_ROBIN: {
+			uint8_t voice = findFrom(channel->voiceMask, channel->rotation);
+			channel->rotation = (voice + 1) % MAX_VOICES;
+			return voice;
+		}
+		case Policy::LOWEST_NOTE: {
+			uint8_t highest = channel->sounding.highest();
+			return note < highest ? noteVoices[channelIndex][highest] : NO_VOICE;
+		}
+		case Policy::HIGHEST_NOTE: {
+			uint8_t lowest = channel->sounding.lowest();
+			return note > lowest ? noteVoices[channelIndex][lowest] : NO_VOICE;
+		}
+		case Policy::LEGATO:
+			return channel->activeVoices.tail;
+		case Policy::OLDEST:
+		default:
+			return channel->activeVoices.head;
+	}
+}
+
+void VoiceAllocator::start(uint8_t voice, uint8_t note, Change *change, bool retrigger) {
+	voices[voice].note = note;
+	change->voice = voice;
+	change->note = note;
+	change->gate = 1;
+	change->retrigger = retrigger;
+}
+
+bool VoiceAllocator::restoresNotes(Policy policy) const {
+	return policy == Policy::LOWEST_NOTE || policy == Policy::HIGHEST_NOTE || policy == Policy::LEGATO;
+}
+
+void VoiceAllocator::NoteSet::add(uint8_t note) {
+	bits[note >> 6] |= 1ull << (note & 63);
+}
+
+void VoiceAllocator::NoteSet::remove(uint8_t note) {
+	bits[note >> 6] &= ~(1ull << (note & 63));
+}
+
+bool VoiceAllocator::NoteSet::isEmpty() const {
+	return (bits[0] | bits[1]) == 0;
+}
+
+uint8_t VoiceAllocator::NoteSet::lowest() const {
+	return bits[0] ? __builtin_ctzll(bits[0]) : 64 + __builtin_ctzll(bits[1]);
+}
+
+uint8_t VoiceAllocator::NoteSet::highest() const {
+	return bits[1] ? 127 - __builtin_clzll(bits[1]) : 63 - __builtin_clzll(bits[0]);
+}
@@ -1,4 +1,3 @@
-#include <alsa/asoundlib.h>
 #include <sys/time.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -11,146 +10,769 @@
 #include <signal.h>
 
 #include "../include/LCD.h"
-#include "../include/MIDIPacketQueue.h"
+#include "../include/LCDRenderer.h"
+#include "../include/ChipGPIOLines.h"
+#include "../include/MIDIEventRing.h"
+#include "../include/MIDIInput.h"
+#include "../include/RawMIDISource.h"
+#include "../include/SeqMIDISource.h"
+#include "../include/ReplayMIDISource.h"
+#include "../include/MIDICapture.h"
+#include "../include/MIDIDispatcher.h"
+#include "../include/Timer.h"
+#include "../include/Metrics.h"
+#include "../include/Log.h"
+#include "../include/RealTime.h"
+#include "../include/EventLoop.h"
+#include "../include/EventNotifier.h"
+#include "../include/TimerWheel.h"
 #include "../include/DebouncedButton.h"
+#include "../include/OutputTopology.h"
+#include "../include/OutputBank.h"
 #include "../include/OutputManager.h"
+#include "../include/VoiceAllocator.h"
+#include "../include/PitchCalibration.h"
+#include "../include/ControllerState.h"
+#include "../include/SimI2CBus.h"
+#include "../include/SimMCP23017.h"
+#include "../include/SimDAC.h"
+#include "../include/SimGPIOLines.h"
+#include "../include/SimHD44780.h"
 
-MIDIPacketQueue midiQueue;
-pthread_t midiThread;
-pthread_mutex_t midiLock;
-const uint8_t MIDI_PACKET_SIZE = 3;
+MIDIEventRing liveQueue;
+// A replay waits for the dispatch loop rather than dropping events, so every run dispatches the same ones
+MIDIEventRing replayQueue(MIDIEventRing::OverflowPolicy::WAIT);
+MIDIEventRing *midiQueue = &liveQueue;
+EventNotifier midiNotifier;
+MetricsSegment metricsSegment;
+Metrics *metrics = nullptr;
+const char *DEFAULT_MIDI_PORT = "hw:0,0";
 
-void *midiRead(void *arg) {
-	(void)arg;
+/*
+ * SCHED_FIFO priorities in real-time mode. The reader timestamps incoming bytes so it preempts
+ * everything else, and all three stay below the kernel's threaded interrupt handlers (50)
+ * that USB MIDI and I2C completions depend on.
+ */
+const int MIDI_PRIORITY = 45;
+const int OUTPUT_PRIORITY = 44;
+const int DISPATCH_PRIORITY = 43;
 
-	snd_rawmidi_t *midi = nullptr;
-	if (snd_rawmidi_open(&midi, nullptr, "hw:0,0", SND_RAWMIDI_SYNC) < 0) {
-		printf("Error: Failed to open MIDI port\n");
-		return nullptr;
+// How often the dispatch loop checks whether a replay has finished
+const int REPLAY_CHECK_MS = 100;
+
+// Both buttons must be held this long to exit
+const uint64_t EXIT_HOLD_TIME_NS = 5000000000ull;
+
+volatile sig_atomic_t exitRequested = 0;
+
+void onExitSignal(int signal) {
+	(void)signal;
+	exitRequested = 1;
+}
+
+struct Controller {
+	EventLoop *loop;
+	OutputManager *outManager;
+	MIDIDispatcher *dispatcher;
+	LCDRenderer *display;
+	DebouncedButton *outputButton;
+	DebouncedButton *channelButton;
+	TimerWheel::Entry outputDebounceTimer;
+	TimerWheel::Entry channelDebounceTimer;
+	TimerWheel::Entry exitTimer;
+	bool running = true;
+};
+
+void onMIDIEvents(void *context, uint32_t events) {
+	(void)events;
+	Controller *controller = (Controller*) context;
+	midiNotifier.drain();
+
+	controller->dispatcher->dispatchAll(midiQueue);
+}
+
+/*
+ * Schedule a timer at deadline_ns, or cancel it if deadline_ns is 0
+ */
+void setTimer(TimerWheel *timers, TimerWheel::Entry *timer, uint64_t deadline_ns) {
+	if (deadline_ns == 0) {
+		timers->cancel(timer);
 	}
+	else if (!timer->pending || timer->deadline_ns != deadline_ns) {
+		timers->schedule(timer, deadline_ns);
+	}
+}
 
-	printf("Successfully opened MIDI port\n");
-	
-	uint8_t bytesInPacket = 0;
-	uint8_t packet[MIDI_PACKET_SIZE];
-	uint8_t buffer[1];
-	while (true) {
-		if (snd_rawmidi_read(midi, buffer, 1) < 0) {
-			printf("Error: Failed to read MIDI input\n");
-			continue;
-		}
-		if (buffer[0] < 0b11110000) {
-			// Channel voice message
-			if (bytesInPacket == 0) {
-				if (buffer[0] >= 0b10000000) {
-					// Command byte
-					packet[0] = buffer[0];
-					bytesInPacket = 1;
-				}
+void updatePanel(Controller *controller) {
+	uint64_t now_ns = controller->loop->getNow_ns();
+	controller->outManager->updateSelectedOutput();
+	controller->outManager->updateChannelAssignments();
+
+	DebouncedButton *outputButton = controller->outputButton;
+	DebouncedButton *channelButton = controller->channelButton;
+	if (outputButton->getHoldTime_ns(now_ns) >= EXIT_HOLD_TIME_NS && channelButton->getHoldTime_ns(now_ns) >= EXIT_HOLD_TIME_NS) {
+		controller->display->clear();
+		controller->display->writeStr(0, 0, "Exiting...");
+		usleep(3000000);
+		controller->running = false;
+		return;
+	}
+
+	// Wake when a pending press finishes debouncing or both buttons have been held long enough to exit
+	TimerWheel *timers = controller->loop->getTimers();
+	setTimer(timers, &controller->outputDebounceTimer, outputButton->getDebounceDeadline_ns());
+	setTimer(timers, &controller->channelDebounceTimer, channelButton->getDebounceDeadline_ns());
+	uint64_t outputPress_ns = outputButton->getPressTime_ns();
+	uint64_t channelPress_ns = channelButton->getPressTime_ns();
+	uint64_t exitDeadline_ns = 0;
+	if (outputPress_ns != 0 && channelPress_ns != 0) {
+		uint64_t lastPress_ns = outputPress_ns > channelPress_ns ? outputPress_ns : channelPress_ns;
+		exitDeadline_ns = lastPress_ns + EXIT_HOLD_TIME_NS;
+	}
+	setTimer(timers, &controller->exitTimer, exitDeadline_ns);
+}
+
+void onPanelDeadline(void *context, uint64_t now_ns) {
+	(void)now_ns;
+	updatePanel((Controller*) context);
+}
+
+void onOutputButtonEdge(void *context, uint32_t events) {
+	(void)events;
+	Controller *controller = (Controller*) context;
+	controller->outputButton->handleEdges();
+	updatePanel(controller);
+}
+
+void onChannelButtonEdge(void *context, uint32_t events) {
+	(void)events;
+	Controller *controller = (Controller*) context;
+	controller->channelButton->handleEdges();
+	updatePanel(controller);
+}
+
+/*
+ * Calibration mode: hold each output at the DAC value of every octave in turn, read the
+ * voltage measured there from stdin, then fit the output's pitch table and store all tables
+ * in path. A line without a number skips the point; an output without points keeps its table.
+ */
+bool runCalibration(OutputBank *bank, LCDRenderer *display, PitchCalibration *calibration, const char *path) {
+	const uint8_t notes[] = {12, 24, 36, 48, 60};
+	const uint8_t numNotes = sizeof(notes) / sizeof(notes[0]);
+	printf("Calibration: enter the voltage measured at each output, or - to skip the point\n");
+	for (uint8_t output = 0; output < bank->getNumOutputs(); ++output) {
+		char label[17];
+		snprintf(label, sizeof(label), "Output %u", output + 1);
+		display->clear();
+		display->writeStr(0, 0, "Calibrating");
+		display->writeStr(1, 0, label);
+
+		uint16_t values[numNotes];
+		double volts[numNotes];
+		uint8_t numPoints = 0;
+		for (uint8_t i = 0; i < numNotes; ++i) {
+			uint16_t value = PitchCalibration::getNominalValue(notes[i]);
+			bank->beginUpdate();
+			bank->setPitch(output, value);
+			bank->setGate(output, 1);
+			bank->commit();
+
+			printf("Output %u, note %u (DAC %u, nominal %.3f V): ", output + 1, notes[i], value, value * 5.0 / PitchCalibration::MAX_VALUE);
+			fflush(stdout);
+			char line[64];
+			if (!fgets(line, sizeof(line), stdin)) {
+				printf("\nError: Calibration input ended\n");
+				return false;
 			}
-			else {
-				if (buffer[0] < 0b10000000) {
-					// Data byte
-					packet[bytesInPacket] = buffer[0];
-					++bytesInPacket;
-				}
+			char *end;
+			double measured = strtod(line, &end);
+			if (end != line) {
+				values[numPoints] = value;
+				volts[numPoints] = measured;
+				++numPoints;
 			}
 		}
-		if (bytesInPacket == MIDI_PACKET_SIZE) {
-			pthread_mutex_lock(&midiLock);
-			midiQueue.push(packet);
-			pthread_mutex_unlock(&midiLock);
-			bytesInPacket = 0;
+
+		bank->beginUpdate();
+		bank->setGate(output, 0);
+		bank->commit();
+		if (numPoints == 0) {
+			printf("Output %u keeps its table\n", output + 1);
+			continue;
+		}
+		if (!calibration->fit(output, values, volts, numPoints)) {
+			return false;
+		}
+		printf("Output %u plays notes up to %u\n", output + 1, calibration->getHighestNote(output));
+	}
+	return calibration->save(path);
+}
+
+/*
+ * Trigger widths in us, either one for every output or one per output separated by commas
+ */
+bool parseTriggerWidths(const char *arg, uint64_t *widths_ns, uint8_t numOutputs) {
+	uint8_t count = 0;
+	const char *pos = arg;
+	while (count < numOutputs) {
+		char *end;
+		double width_us = strtod(pos, &end);
+		if (end == pos || width_us <= 0) {
+			return false;
+		}
+		widths_ns[count++] = (uint64_t) (width_us * 1000 + 0.5);
+		if (*end == '\0') {
+			break;
+		}
+		if (*end != ',') {
+			return false;
+		}
+		pos = end + 1;
+	}
+	if (count == 1) {
+		for (uint8_t i = 1; i < numOutputs; ++i) {
+			widths_ns[i] = widths_ns[0];
 		}
 	}
+	return count == 1 || count == numOutputs;
+}
 
-	snd_rawmidi_close(midi);
+/*
+ * Commits, batches and bytes written per bus, with the share of the run each bus was busy
+ */
+void printBusThroughput(OutputBank *bank) {
+	for (uint8_t i = 0; i < bank->getNumWorkers(); ++i) {
+		OutputWorker::Stats stats;
+		bank->getWorker(i)->getStats(&stats);
+		double elapsed_s = stats.elapsed_ns / 1e9;
+		printf("Output bus %u: %llu commits, %llu I2C batches, %llu coalesced, %llu bytes (%.0f B/s), bus utilization %.2f%%\n",
+			i + 1, (unsigned long long) stats.commits, (unsigned long long) stats.batches,
+			(unsigned long long) stats.coalesced, (unsigned long long) stats.bytes,
+			elapsed_s > 0 ? stats.bytes / elapsed_s : 0, stats.busUtilization * 100);
+	}
+}
 
-	return nullptr;
+void printUsage(const char *name) {
+	printf("Usage: %s [-g gpiochip] [-m port]... [-q name] [-s] [-l latency] [-M name] [-r] [-c cpus] [-p policy] [-w widths]\n", name);
+	printf("       [-C file] [-K file] [-T file] [-L level]\n");
+	printf("  -g gpiochip  Drive the LCD and buttons through a GPIO character device (e.g. /dev/gpiochip0)\n");
+	printf("               instead of /sys/class/gpio\n");
+	printf("  -m port      ALSA rawmidi port to read, repeated for each port (default %s unless -q is given;\n", DEFAULT_MIDI_PORT);
+	printf("               \"virtual\" creates a sequencer port)\n");
+	printf("  -q name      Also read an ALSA sequencer client of this name, for DAWs to connect to\n");
+	printf("  -R file      Capture every byte read from the MIDI ports, with its arrival time, to file\n");
+	printf("  -P file      Replay a capture, each of its ports as a MIDI source, then exit\n");
+	printf("  -x speed     Replay speed: 1 (default) as captured, N times as fast, or 0 as fast as possible\n");
+	printf("  -s           Simulate the expanders, DACs, LCD and buttons in software\n");
+	printf("  -l latency   Simulated I2C time per byte in ns (default 0; about 90000 at 100 kHz)\n");
+	printf("  -M name      Shared memory object to publish metrics in (default %s)\n", MetricsSegment::DEFAULT_NAME);
+	printf("  -r           Real-time mode: lock memory and run the MIDI, dispatch and output threads under SCHED_FIFO\n");
+	printf("  -c cpus      Cores to pin the MIDI, dispatch and output threads to, e.g. 3,2,2 (-1 = any)\n");
+	printf("  -p policy    Voice allocation: oldest (default), round-robin, lowest, highest or legato\n");
+	printf("  -w widths    Trigger pulse width in us, for all outputs or per output, e.g. 5000 or\n");
+	printf("               1000,1000,5000,5000,10,10,10,10 (default %.0f)\n", OutputWorker::DEFAULT_TRIGGER_WIDTH_NS / 1000.0);
+	printf("  -T file      Output topology: the I2C buses, DACs and expanders of each output (see\n");
+	printf("               OutputTopology.h; default one board with 8 outputs on %s)\n", OutputTopology::DEFAULT_DEVICE);
+	printf("  -C file      Pitch calibration to load instead of the nominal 1 V/octave\n");
+	printf("  -S file      File to keep the channel assignments and selected output in across restarts\n");
+	printf("               (default %s)\n", ControllerState::DEFAULT_PATH);
+	printf("  -L level     Log messages of this level and above: debug, info (default), warning or error\n");
+	printf("  -K file      Calibration mode: step each output through its octaves, read the measured\n");
+	printf("               voltages from stdin and write the tables to file, then exit\n");
 }
 
-bool midiInit() {
-	if (pthread_mutex_init(&midiLock, NULL) != 0) {
-		printf("Error: Failed to set MIDI lock\n");
-		return false;
+int main(int argc, char **argv) {
+	const char *gpioChipPath = nullptr;
+	const char *midiPorts[MIDIInput::MAX_SOURCES];
+	uint8_t numMIDIPorts = 0;
+	const char *seqName = nullptr;
+	const char *capturePath = nullptr;
+	const char *replayPath = nullptr;
+	double replaySpeed = 1;
+	bool simulate = 0;
+	uint64_t simByteLatency_ns = 0;
+	const char *metricsName = MetricsSegment::DEFAULT_NAME;
+	bool realTime = 0;
+	int cpus[3] = {-1, -1, -1};
+	VoiceAllocator::Policy voicePolicy = VoiceAllocator::Policy::OLDEST;
+	const char *calibrationPath = nullptr;
+	const char *calibrationOutPath = nullptr;
+	const char *triggerWidthsArg = nullptr;
+	OutputTopology topology;
+	Log::Level logLevel = Log::INFO;
+	const char *statePath = ControllerState::DEFAULT_PATH;
+	int option;
+	while ((option = getopt(argc, argv, "g:m:q:R:P:x:sl:M:rc:p:w:C:K:T:S:L:h")) != -1) {
+		switch (option) {
+			case 'g':
+				gpioChipPath = optarg;
+				break;
+			case 'm':
+				if (numMIDIPorts + (seqName ? 1 : 0) >= MIDIInput::MAX_SOURCES) {
+					printUsage(argv[0]);
+					return 1;
+				}
+				midiPorts[numMIDIPorts++] = optarg;
+				break;
+			case 'q':
+				if (!seqName && numMIDIPorts >= MIDIInput::MAX_SOURCES) {
+					printUsage(argv[0]);
+					return 1;
+				}
+				seqName = optarg;
+				break;
+			case 'R':
+				capturePath = optarg;
+				break;
+			case 'P':
+				replayPath = optarg;
+				break;
+			case 'x':
+				if (sscanf(optarg, "%lf", &replaySpeed) != 1 || replaySpeed < 0) {
+					printUsage(argv[0]);
+					return 1;
+				}
+				break;
+			case 's':
+				simulate = 1;
+				break;
+			case 'l':
+				simByteLatency_ns = strtoull(optarg, nullptr, 10);
+				break;
+			case 'M':
+				metricsName = optarg;
+				break;
+			case 'r':
+				realTime = 1;
+				break;
+			case 'c':
+				if (sscanf(optarg, "%d,%d,%d", &cpus[0], &cpus[1], &cpus[2]) != 3) {
+					printUsage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'p':
+				if (!VoiceAllocator::parsePolicy(optarg, &voicePolicy)) {
+					printUsage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'w':
+				triggerWidthsArg = optarg;
+				break;
+			case 'C':
+				calibrationPath = optarg;
+				break;
+			case 'K':
+				calibrationOutPath = optarg;
+				break;
+			case 'T':
+				if (!topology.load(optarg)) {
+					return 1;
+				}
+				break;
+			case 'S':
+				statePath = optarg;
+				break;
+			case 'L':
+				if (!Log::parseLevel(optarg, &logLevel)) {
+					printUsage(argv[0]);
+					return 1;
+				}
+				break;
+			default:
+				printUsage(argv[0]);
+				return option == 'h' ? 0 : 1;
+		}
 	}
-	if (pthread_create(&midiThread, NULL, &midiRead, NULL) != 0) {
-		printf("Error: Failed to create MIDI input thread\n");
-		return false;
+
+	if (numMIDIPorts == 0 && !seqName && !replayPath) {
+		midiPorts[numMIDIPorts++] = DEFAULT_MIDI_PORT;
 	}
-	pthread_detach(midiThread);
-	return true;
-}
 
-int main() {
-	int i2cFile = open("/dev/i2c-1", O_RDWR);
-	if (i2cFile < 0) {
-		printf("Error: Failed to open I2C bus\n");
+	// Widths are per output, so they are checked against the topology
+	uint64_t triggerWidths_ns[OutputTopology::MAX_OUTPUTS];
+	for (uint8_t i = 0; i < OutputTopology::MAX_OUTPUTS; ++i) {
+		triggerWidths_ns[i] = OutputWorker::DEFAULT_TRIGGER_WIDTH_NS;
+	}
+	if (triggerWidthsArg && !parseTriggerWidths(triggerWidthsArg, triggerWidths_ns, topology.getNumOutputs())) {
+		printUsage(argv[0]);
 		return 1;
 	}
+	topology.print();
+
+	// A restart within the same boot finds the panel and lines still configured
+	ControllerState state;
+	if (!state.open(statePath, topology.getNumOutputs())) {
+		printf("Warning: Channel assignments will not be kept across restarts\n");
+	}
+	bool warm = state.isWarm() && !simulate;
+
+	struct sigaction exitAction;
+	memset(&exitAction, 0, sizeof(exitAction));
+	exitAction.sa_handler = &onExitSignal;
+	sigaction(SIGINT, &exitAction, NULL);
+	sigaction(SIGTERM, &exitAction, NULL);
 
-	LCD lcd(4, 5, 6, 7, 8, 9);
-	lcd.setup();
+	if (!metricsSegment.create(metricsName)) {
+		printf("Warning: Metrics will not be published\n");
+		if (!metricsSegment.create(nullptr)) {
+			return 1;
+		}
+	}
+	metrics = metricsSegment.get();
 
-	DebouncedButton outputButton(16);
-	DebouncedButton channelButton(17);
+	// Without -r the threads are still pinned if -c was given, but stay under the default scheduler
+	ThreadSchedule midiSchedule, dispatchSchedule, outputSchedule;
+	midiSchedule.cpu = cpus[0];
+	dispatchSchedule.cpu = cpus[1];
+	outputSchedule.cpu = cpus[2];
+	if (realTime) {
+		midiSchedule.priority = MIDI_PRIORITY;
+		dispatchSchedule.priority = DISPATCH_PRIORITY;
+		outputSchedule.priority = OUTPUT_PRIORITY;
+		if (!RealTime::lockMemory()) {
+			return 1;
+		}
+	}
 
-	OutputManager outManager(i2cFile, &lcd, &outputButton, &channelButton);
+	// From here on, messages from the MIDI, dispatch and output threads are written by the log thread
+	Log::setLevel(logLevel);
+	if (!Log::start()) {
+		return 1;
+	}
 
-	midiInit();
+	// Simulated devices, only used with -s: every DAC and expander of the topology on its own simulated bus
+	const uint8_t MAX_SIM_DEVICES = OutputTopology::MAX_BUSES * OutputTopology::MAX_DEVICES_PER_BUS;
+	SimI2CBus *simBuses[OutputTopology::MAX_BUSES] = {nullptr};
+	SimMCP23017 *simExpanders[MAX_SIM_DEVICES];
+	SimDAC *simDACs[MAX_SIM_DEVICES];
+	uint8_t numSimExpanders = 0;
+	uint8_t numSimDACs = 0;
+	SimHD44780 simLCD;
 
-	while (true) {
-		pthread_mutex_lock(&midiLock);
-		for (size_t i = 0; i < midiQueue.getLength(); ++i) {			
-			const uint8_t *packet = midiQueue.getPacket(i);
-			uint8_t command = packet[0] >> 4;
-			uint8_t channel = packet[0] & 0b00001111;
-			if (command == 0b1001) {
-				// Key pressed
-				printf("Key pressed on channel %d (%d, %d)\n", channel, packet[1], packet[2]);
-				outManager.pressKey(packet[1], channel);
+	I2CBus *i2cBuses[OutputTopology::MAX_BUSES];
+	for (uint8_t b = 0; b < topology.getNumBuses(); ++b) {
+		if (simulate) {
+			simBuses[b] = new SimI2CBus();
+			uint8_t addrs[OutputTopology::MAX_OUTPUTS_PER_BUS];
+			uint8_t numAddrs = topology.getGPIOAddresses(b, addrs);
+			for (uint8_t i = 0; i < numAddrs; ++i) {
+				simExpanders[numSimExpanders] = new SimMCP23017(addrs[i]);
+				simBuses[b]->attach(simExpanders[numSimExpanders++]);
 			}
-			else if (command == 0b1000) {
-				// Key released
-				printf("Key released on channel %d (%d, %d)\n", channel, packet[1], packet[2]);
-				outManager.releaseKey(packet[1], channel);
+			numAddrs = topology.getDACAddresses(b, addrs);
+			for (uint8_t i = 0; i < numAddrs; ++i) {
+				simDACs[numSimDACs] = new SimDAC(addrs[i]);
+				simBuses[b]->attach(simDACs[numSimDACs++]);
 			}
-			else if (command == 0b1110) {
-				// Pitch bend
-				printf("Pitch bend on channel %d\n", channel);
-			}
-			else if (command == 0b1011 && packet[1] > 122) {
-				printf("Turning all notes off on channel %d\n", channel);
-				outManager.turnOffChannel(channel);
+			simBuses[b]->setLatency(0, simByteLatency_ns);
+			i2cBuses[b] = simBuses[b];
+		}
+		else {
+			int i2cFile = open(topology.getBus(b).device, O_RDWR);
+			if (i2cFile < 0) {
+				printf("Error: Failed to open I2C bus %s\n", topology.getBus(b).device);
+				return 1;
 			}
-			else {
-				printf("Unknown command %d on channel %d (%d, %d)\n", command, channel, packet[1], packet[2]);
+			i2cBuses[b] = new I2CBus(i2cFile);
+		}
+	}
+
+	const uint8_t lcdPins[LCD::Line::NUM_LINES] = {4, 5, 6, 7, 8, 9};
+	GPIOLines *lcdLines;
+	if (simulate) {
+		SimGPIOLines *simLines = new SimGPIOLines(lcdPins, LCD::Line::NUM_LINES, true);
+		simLines->setListener(&simLCD);
+		lcdLines = simLines;
+	}
+	else if (gpioChipPath) {
+		lcdLines = new ChipGPIOLines(gpioChipPath, lcdPins, LCD::Line::NUM_LINES, true);
+	}
+	else {
+		lcdLines = new SysfsGPIOLines(lcdPins, LCD::Line::NUM_LINES, true);
+	}
+	// The LCD is set up on the renderer thread while the output workers set up their buses
+	LCD lcd(lcdLines);
+	LCDRenderer display(&lcd);
+	display.start(true, warm);
+
+	const uint8_t outputButtonPin = 16;
+	const uint8_t channelButtonPin = 17;
+	GPIOLines *outputButtonLine;
+	GPIOLines *channelButtonLine;
+	if (simulate) {
+		outputButtonLine = new SimGPIOLines(&outputButtonPin, 1, false);
+		channelButtonLine = new SimGPIOLines(&channelButtonPin, 1, false);
+	}
+	else if (gpioChipPath) {
+		outputButtonLine = new ChipGPIOLines(gpioChipPath, &outputButtonPin, 1, false);
+		channelButtonLine = new ChipGPIOLines(gpioChipPath, &channelButtonPin, 1, false);
+	}
+	else {
+		outputButtonLine = new SysfsGPIOLines(&outputButtonPin, 1, false);
+		channelButtonLine = new SysfsGPIOLines(&channelButtonPin, 1, false);
+	}
+	DebouncedButton outputButton(outputButtonLine);
+	DebouncedButton channelButton(channelButtonLine);
+
+	// One output worker per bus, so the buses are written in parallel
+	OutputBank outputBank(&topology, i2cBuses);
+	outputBank.setMetrics(metrics);
+	outputBank.setSchedule(outputSchedule);
+	for (uint8_t i = 0; i < outputBank.getNumOutputs(); ++i) {
+		if (!outputBank.setTriggerWidth(i, triggerWidths_ns[i])) {
+			return 1;
+		}
+	}
+	if (!outputBank.start()) {
+		return 1;
+	}
+
+	if (calibrationOutPath) {
+		// Starts from the loaded tables, so skipped outputs keep them
+		PitchCalibration calibration(outputBank.getNumOutputs());
+		bool calibrated = (!calibrationPath || calibration.load(calibrationPath)) &&
+			runCalibration(&outputBank, &display, &calibration, calibrationOutPath);
+		outputBank.stop();
+		display.stop();
+		lcd.clear();
+		lcdLines->closeLines();
+		return calibrated ? 0 : 1;
+	}
+
+	EventLoop loop;
+	if (!loop.setup() || !midiNotifier.setup()) {
+		return 1;
+	}
+	loop.setIterationHistogram(&metrics->loopIteration_ns);
+	loop.setTimerLatenessHistogram(&metrics->timerLateness_ns);
+
+	OutputManager outManager(&outputBank, &loop, &display, &outputButton, &channelButton);
+	outManager.setVoicePolicy(voicePolicy);
+	if (state.isOpen()) {
+		outManager.restoreState(&state);
+		if (state.isRestored()) {
+			printf("Restored channel assignments from %s%s\n", statePath, warm ? " (warm start)" : "");
+		}
+	}
+	if (calibrationPath && !outManager.loadCalibration(calibrationPath)) {
+		return 1;
+	}
+
+	MIDIDispatcher dispatcher(&outManager);
+	dispatcher.setVerbose(true);
+	dispatcher.setMetrics(metrics);
+
+	Controller controller;
+	controller.loop = &loop;
+	controller.outManager = &outManager;
+	controller.dispatcher = &dispatcher;
+	controller.display = &display;
+	controller.outputButton = &outputButton;
+	controller.channelButton = &channelButton;
+	TimerWheel::Entry *panelTimers[] = {&controller.outputDebounceTimer, &controller.channelDebounceTimer, &controller.exitTimer};
+	for (uint8_t i = 0; i < 3; ++i) {
+		panelTimers[i]->callback = &onPanelDeadline;
+		panelTimers[i]->context = &controller;
+	}
+
+	if (!RealTime::setCurrentThread(dispatchSchedule, "dispatch")) {
+		return 1;
+	}
+	loop.addFd(midiNotifier.getFd(), EPOLLIN, &onMIDIEvents, &controller);
+	loop.addFd(outputButton.getEventFd(), outputButton.getEventMask(), &onOutputButtonEdge, &controller);
+	loop.addFd(channelButton.getEventFd(), channelButton.getEventMask(), &onChannelButtonEdge, &controller);
+	updatePanel(&controller);
+
+	// One reader polls every port, each with its own parser, and merges their events into the queue
+	if (replayPath) {
+		midiQueue = &replayQueue;
+	}
+	MIDIInput midiInput(midiQueue, &midiNotifier);
+	MIDIByteSource *midiSources[MIDIInput::MAX_SOURCES];
+	uint8_t numMIDISources = 0;
+	for (uint8_t i = 0; i < numMIDIPorts; ++i) {
+		midiSources[numMIDISources] = new RawMIDISource(midiPorts[i]);
+		midiInput.addSource(midiSources[numMIDISources++]);
+	}
+	if (seqName) {
+		midiSources[numMIDISources] = new SeqMIDISource(seqName);
+		midiInput.addSource(midiSources[numMIDISources++]);
+	}
+
+	// Every port of a replayed capture is its own source, so each keeps its own parser as when captured
+	ReplayMIDISource *replaySources[MIDIInput::MAX_SOURCES];
+	uint8_t numReplaySources = 0;
+	if (replayPath) {
+		char replayPortNames[MIDICapture::MAX_PORTS][MIDICapture::PORT_NAME_SIZE];
+		int numReplayPorts = ReplayMIDISource::readPortNames(replayPath, replayPortNames, MIDICapture::MAX_PORTS);
+		if (numReplayPorts < 0) {
+			return 1;
+		}
+		if (numMIDISources + numReplayPorts > MIDIInput::MAX_SOURCES) {
+			printf("Error: At most %u MIDI sources can be read\n", MIDIInput::MAX_SOURCES);
+			return 1;
+		}
+		for (int i = 0; i < numReplayPorts; ++i) {
+			ReplayMIDISource *replaySource = new ReplayMIDISource(replayPath, i, replaySpeed);
+			replaySources[numReplaySources++] = replaySource;
+			midiSources[numMIDISources++] = replaySource;
+			if (!replaySource->load()) {
+				return 1;
 			}
+			midiInput.addSource(replaySource);
 		}
-		midiQueue.clear();
-		pthread_mutex_unlock(&midiLock);
+		printf("Replaying %d ports of %s", numReplayPorts, replayPath);
+		if (replaySpeed > 0) {
+			printf(" at %gx\n", replaySpeed);
+		}
+		else {
+			printf(" as fast as possible\n");
+		}
+	}
 
-		outManager.updateTriggers();
-		outManager.updateSelectedOutput();
-		outManager.updateChannelAssignments();
+	MIDICapture capture;
+	if (capturePath) {
+		const char *portNames[MIDIInput::MAX_SOURCES];
+		for (uint8_t i = 0; i < numMIDISources; ++i) {
+			portNames[i] = midiSources[i]->getName();
+		}
+		if (!capture.start(capturePath, portNames, numMIDISources)) {
+			return 1;
+		}
+		midiInput.setCapture(&capture);
+	}
+	midiInput.setMetrics(metrics);
+	midiInput.setSchedule(midiSchedule);
+	uint64_t replayStart_ns = Timer::now_ns();
+	for (uint8_t i = 0; i < numReplaySources; ++i) {
+		replaySources[i]->setStartTime(replayStart_ns);
+	}
+	if (!midiInput.start()) {
+		return 1;
+	}
 
-		if (outputButton.isPressed() && channelButton.isPressed() && outputButton.getHoldTime_s() > 5 && channelButton.getHoldTime_s() > 5) {
-			lcd.clear();
-			lcd.returnHome();
-			lcd.writeStr("Exiting...");
-			usleep(3000000);
+	while (controller.running && !exitRequested) {
+		if (loop.wait(numReplaySources > 0 ? REPLAY_CHECK_MS : -1) < 0) {
 			break;
 		}
+		if (numReplaySources > 0 && midiQueue->getLength() == 0) {
+			uint8_t numFinished = 0;
+			for (uint8_t i = 0; i < numReplaySources; ++i) {
+				numFinished += replaySources[i]->isFinished();
+			}
+			if (numFinished == numReplaySources) {
+				printf("Replay finished after %.3f s\n", (Timer::now_ns() - replayStart_ns) / 1e9);
+				break;
+			}
+		}
+	}
 
-		usleep(100);
+	// A replay cut short may have the reader waiting for queue space, which this makes for what
+	// it has left to queue
+	for (uint8_t i = 0; i < numReplaySources; ++i) {
+		replaySources[i]->cancel();
+	}
+	if (numReplaySources > 0) {
+		dispatcher.dispatchAll(midiQueue);
+	}
+	midiInput.stop();
+	capture.stop();
+	MIDIInput::Stats inputStats;
+	midiInput.getStats(&inputStats);
+	printf("MIDI input: %llu bytes, %llu events, %llu dropped, %llu polls, %llu reads, %llu errors, %llu reconnects\n",
+		(unsigned long long) inputStats.bytes, (unsigned long long) inputStats.events,
+		(unsigned long long) inputStats.dropped, (unsigned long long) inputStats.polls,
+		(unsigned long long) inputStats.reads, (unsigned long long) inputStats.errors,
+		(unsigned long long) inputStats.reconnects);
+	for (uint8_t i = 0; i < numMIDISources; ++i) {
+		MIDIInput::SourceStats sourceStats;
+		midiInput.getSourceStats(i, &sourceStats);
+		printf("MIDI port %s: %llu bytes, %llu events, %llu dropped, %llu errors, %llu reconnects\n",
+			midiSources[i]->getName(), (unsigned long long) sourceStats.bytes,
+			(unsigned long long) sourceStats.events, (unsigned long long) sourceStats.dropped,
+			(unsigned long long) sourceStats.errors, (unsigned long long) sourceStats.reconnects);
+	}
+	if (capturePath) {
+		MIDICapture::Stats captureStats;
+		capture.getStats(&captureStats);
+		printf("MIDI capture %s: %llu reads, %llu bytes, %llu dropped, %llu written, %llu write errors\n", capturePath,
+			(unsigned long long) captureStats.records, (unsigned long long) captureStats.bytes,
+			(unsigned long long) captureStats.dropped, (unsigned long long) captureStats.fileBytes,
+			(unsigned long long) captureStats.writeErrors);
 	}
 
 	for (uint8_t i = 0; i < 8; ++i) {
 		outManager.turnOffChannel(i);
 	}
+	outputBank.stop();
+
+	// The threads that log on the hot path have stopped, so what they left is written before the summary.
+	// Records hold pointers to the port names, so the sources are freed only once they are written.
+	Log::stop();
+	for (uint8_t i = 0; i < numMIDISources; ++i) {
+		delete midiSources[i];
+	}
+	Log::Stats logStats;
+	Log::getStats(&logStats);
+	printf("Log: %llu records from %u threads, %llu dropped\n", (unsigned long long) logStats.records,
+		logStats.threads, (unsigned long long) logStats.dropped);
+
+	printBusThroughput(&outputBank);
+	MetricHistogram *triggerError_ns = new MetricHistogram();
+	metrics->mergeTriggerErrors(triggerError_ns);
+	printf("Trigger pulses: %llu timed, width error p50 %.1f us, p99 %.1f us, max %.1f us\n",
+		(unsigned long long) triggerError_ns->getCount(),
+		triggerError_ns->percentile(0.5) / 1000.0, triggerError_ns->percentile(0.99) / 1000.0,
+		triggerError_ns->getMax() / 1000.0);
+	delete triggerError_ns;
+
+	if (realTime) {
+		printf("Scheduling: timer lateness p50 %.1f us, p99 %.1f us, max %.1f us\n",
+			metrics->timerLateness_ns.percentile(0.5) / 1000.0, metrics->timerLateness_ns.percentile(0.99) / 1000.0,
+			metrics->timerLateness_ns.getMax() / 1000.0);
+		for (uint8_t i = 0; i < metrics->numBuses.load(); ++i) {
+			const MetricHistogram &wakeup_ns = metrics->buses[i].workerWakeup_ns;
+			printf("Output bus %u: worker wakeup p50 %.1f us, p99 %.1f us, max %.1f us\n", i + 1,
+				wakeup_ns.percentile(0.5) / 1000.0, wakeup_ns.percentile(0.99) / 1000.0, wakeup_ns.getMax() / 1000.0);
+		}
+	}
 
+	display.stop();
 	lcd.clear();
 	lcd.returnHome();
+	lcdLines->closeLines();
+	delete lcdLines;
+	delete outputButtonLine;
+	delete channelButtonLine;
+
+	if (simulate) {
+		for (uint8_t b = 0; b < topology.getNumBuses(); ++b) {
+			SimI2CBus::Counters busCounters;
+			simBuses[b]->getCounters(&busCounters);
+			printf("Simulated I2C bus %u: %llu address selects, %llu writes, %llu transfers, %llu messages, %llu bytes, %llu NACKs\n",
+				b + 1, (unsigned long long) busCounters.addressSelects, (unsigned long long) busCounters.writes,
+				(unsigned long long) busCounters.transfers, (unsigned long long) busCounters.messages,
+				(unsigned long long) busCounters.bytes, (unsigned long long) busCounters.nacks);
+		}
+		uint64_t edges = 0, updates = 0, invalidFrames = 0;
+		for (uint8_t i = 0; i < numSimExpanders; ++i) {
+			edges += simExpanders[i]->getNumEdges();
+			delete simExpanders[i];
+		}
+		for (uint8_t i = 0; i < numSimDACs; ++i) {
+			updates += simDACs[i]->getNumUpdates();
+			invalidFrames += simDACs[i]->getInvalidFrames();
+			delete simDACs[i];
+		}
+		printf("Simulated expanders: %llu output edges; DACs: %llu updates, %llu invalid frames; LCD: %llu busy violations\n",
+			(unsigned long long) edges, (unsigned long long) updates,
+			(unsigned long long) invalidFrames, (unsigned long long) simLCD.getBusyViolations());
+	}
+	for (uint8_t b = 0; b < topology.getNumBuses(); ++b) {
+		delete i2cBuses[b];
+	}
 
 	return 0;
 }
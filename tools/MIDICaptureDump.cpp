@@ -0,0 +1,76 @@
+/*
+ * Print a MIDI capture written by synth_controller -R: one line per read, with its time since
+ * the capture started, the gap since the previous read of any port, the port and the bytes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "../include/MIDICapture.h"
+
+int main(int argc, char **argv) {
+	if (argc != 2) {
+		printf("Usage: %s capture\n", argv[0]);
+		return 1;
+	}
+
+	FILE *file = fopen(argv[1], "rb");
+	if (!file) {
+		printf("Error: Failed to open %s\n", argv[1]);
+		return 1;
+	}
+	MIDICapture::Header header;
+	if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != MIDICapture::MAGIC ||
+		header.version != MIDICapture::VERSION || header.numPorts > MIDICapture::MAX_PORTS) {
+		printf("Error: %s is not a version %u MIDI capture\n", argv[1], MIDICapture::VERSION);
+		fclose(file);
+		return 1;
+	}
+	for (uint8_t i = 0; i < header.numPorts; ++i) {
+		printf("Port %u: %.*s\n", i + 1, (int) MIDICapture::PORT_NAME_SIZE, header.portNames[i]);
+	}
+
+	long start = ftell(file);
+	fseek(file, 0, SEEK_END);
+	size_t size = ftell(file) - start;
+	fseek(file, start, SEEK_SET);
+	uint8_t *data = (uint8_t*) malloc(size > 0 ? size : 1);
+	if (!data || fread(data, 1, size, file) != size) {
+		printf("Error: Failed to read %s\n", argv[1]);
+		fclose(file);
+		free(data);
+		return 1;
+	}
+	fclose(file);
+
+	size_t pos = 0;
+	uint64_t time_ns = 0;
+	uint64_t numRecords = 0, numBytes = 0;
+	while (pos < size) {
+		uint64_t delta_ns, length;
+		if (!MIDICapture::decodeVarint(data, size, &pos, &delta_ns) || pos >= size) {
+			break;
+		}
+		uint8_t port = data[pos++];
+		if (!MIDICapture::decodeVarint(data, size, &pos, &length) || length > size - pos) {
+			break;
+		}
+		time_ns += delta_ns;
+		printf("%14.6f  +%10.3f ms  port %u ", time_ns / 1e9, delta_ns / 1e6, port + 1);
+		for (uint64_t i = 0; i < length; ++i) {
+			printf(" %02X", data[pos + i]);
+		}
+		printf("\n");
+		pos += length;
+		++numRecords;
+		numBytes += length;
+	}
+	if (pos < size) {
+		printf("Warning: Capture ends in a partial record\n");
+	}
+	printf("%llu reads, %llu bytes over %.3f s\n", (unsigned long long) numRecords,
+		(unsigned long long) numBytes, time_ns / 1e9);
+	free(data);
+	return 0;
+}
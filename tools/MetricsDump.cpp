@@ -0,0 +1,112 @@
+/*
+ * Print the metrics published by a running synth_controller. The shared memory is mapped
+ * read-only, so reading never disturbs the controller's timing.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "../include/Metrics.h"
+#include "../include/Timer.h"
+
+static void printHistogram(const char *label, const MetricHistogram &histogram, double scale, const char *unit) {
+	uint64_t count = histogram.getCount();
+	double mean = count ? (double) histogram.getSum() / count / scale : 0;
+	printf("%-24s n=%-10llu mean=%9.2f  p50=%9.2f  p99=%9.2f  p99.9=%9.2f  max=%9.2f %s\n",
+		label, (unsigned long long) count, mean,
+		histogram.percentile(0.5) / scale, histogram.percentile(0.99) / scale,
+		histogram.percentile(0.999) / scale, histogram.getMax() / scale, unit);
+}
+
+static void printMetrics(const Metrics *metrics) {
+	double uptime_s = (Timer::now_ns() - metrics->start_ns) / 1e9;
+	printf("synth_controller pid %d, up %.1f s\n", metrics->pid, uptime_s);
+	printf("%-24s bytes=%llu  queued=%llu  dropped=%llu\n", "MIDI input",
+		(unsigned long long) metrics->midiBytesRead.get(),
+		(unsigned long long) metrics->midiEventsQueued.get(),
+		(unsigned long long) metrics->midiEventsDropped.get());
+	uint8_t numPorts = metrics->numMIDIPorts.load(std::memory_order_acquire);
+	for (uint8_t i = 0; i < numPorts && i < Metrics::MAX_MIDI_PORTS; ++i) {
+		const Metrics::MIDIPortMetrics &port = metrics->midiPorts[i];
+		printf("  %-22.22s bytes=%llu (%.0f B/s)  queued=%llu  dropped=%llu  errors=%llu  reconnects=%llu\n", port.name,
+			(unsigned long long) port.bytes.get(), uptime_s > 0 ? port.bytes.get() / uptime_s : 0,
+			(unsigned long long) port.events.get(), (unsigned long long) port.dropped.get(),
+			(unsigned long long) port.errors.get(), (unsigned long long) port.reconnects.get());
+	}
+	printHistogram("Queue depth", metrics->queueDepth, 1, "events");
+	printHistogram("Dispatch per event", metrics->dispatchTime_ns, 1000, "us");
+	printHistogram("Event latency", metrics->eventLatency_ns, 1000, "us");
+	printHistogram("Main loop iteration", metrics->loopIteration_ns, 1000, "us");
+	printHistogram("Timer lateness", metrics->timerLateness_ns, 1000, "us");
+
+	char label[32];
+	uint8_t numBuses = metrics->numBuses.load(std::memory_order_acquire);
+	for (uint8_t i = 0; i < numBuses && i < Metrics::MAX_BUSES; ++i) {
+		const Metrics::BusMetrics &bus = metrics->buses[i];
+		snprintf(label, sizeof(label), "I2C bus %u", i + 1);
+		printf("%-24s batches=%llu  bytes=%llu (%.0f B/s)  utilization=%.2f%%  failed=%llu\n", label,
+			(unsigned long long) bus.batches.get(), (unsigned long long) bus.bytes.get(),
+			uptime_s > 0 ? bus.bytes.get() / uptime_s : 0, uptime_s > 0 ? bus.busy_ns.get() / uptime_s / 1e7 : 0,
+			(unsigned long long) bus.failures.get());
+		snprintf(label, sizeof(label), "Bus %u worker wakeup", i + 1);
+		printHistogram(label, bus.workerWakeup_ns, 1000, "us");
+		snprintf(label, sizeof(label), "Bus %u trigger error", i + 1);
+		printHistogram(label, bus.triggerError_ns, 1000, "us");
+	}
+
+	for (uint8_t i = 0; i < Metrics::MAX_TRIGGERS; ++i) {
+		if (metrics->triggerWidth_ns[i].getCount() > 0) {
+			snprintf(label, sizeof(label), "Trigger %u width", i + 1);
+			printHistogram(label, metrics->triggerWidth_ns[i], 1000, "us");
+		}
+	}
+
+	uint8_t numDevices = metrics->numI2CDevices.load(std::memory_order_acquire);
+	for (uint8_t i = 0; i < numDevices && i < Metrics::MAX_I2C_DEVICES; ++i) {
+		snprintf(label, sizeof(label), "I2C device %u:0x%02x", metrics->i2cDevices[i].bus.load(std::memory_order_relaxed) + 1,
+			metrics->i2cDevices[i].addr.load(std::memory_order_relaxed));
+		printHistogram(label, metrics->i2cDevices[i].transferTime_ns, 1000, "us");
+	}
+}
+
+static void printUsage(const char *name) {
+	printf("Usage: %s [-M name] [-i interval]\n", name);
+	printf("  -M name      Shared memory object the controller publishes to (default %s)\n", MetricsSegment::DEFAULT_NAME);
+	printf("  -i interval  Print again every interval seconds until interrupted\n");
+}
+
+int main(int argc, char **argv) {
+	const char *name = MetricsSegment::DEFAULT_NAME;
+	double interval_s = 0;
+	int option;
+	while ((option = getopt(argc, argv, "M:i:h")) != -1) {
+		switch (option) {
+			case 'M':
+				name = optarg;
+				break;
+			case 'i':
+				interval_s = atof(optarg);
+				break;
+			default:
+				printUsage(argv[0]);
+				return option == 'h' ? 0 : 1;
+		}
+	}
+
+	MetricsSegment segment;
+	if (!segment.open(name)) {
+		return 1;
+	}
+
+	while (true) {
+		printMetrics(segment.get());
+		if (interval_s <= 0) {
+			break;
+		}
+		printf("\n");
+		usleep((useconds_t) (interval_s * 1000000));
+	}
+	return 0;
+}